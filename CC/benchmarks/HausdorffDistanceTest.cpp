@@ -0,0 +1,173 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+//Regression test: cloud-to-cloud distances, multi-thread vs. single thread (with and without 'maxSearchDist')
+//Usage: HausdorffDistanceTest [point count (default: 200000)] [max search distance (default: 0.02)]
+
+#include "DistanceComputationTools.h"
+#include "ChunkedPointCloud.h"
+#include "CCConst.h"
+
+//system
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+using namespace CCLib;
+
+//! Fills a cloud with random points (unit cube)
+static bool FillCloud(ChunkedPointCloud& cloud, unsigned count)
+{
+	if (!cloud.reserve(count))
+		return false;
+
+	for (unsigned i=0; i<count; ++i)
+		cloud.addPoint(CCVector3(static_cast<PointCoordinateType>(rand())/RAND_MAX,
+								 static_cast<PointCoordinateType>(rand())/RAND_MAX,
+								 static_cast<PointCoordinateType>(rand())/RAND_MAX));
+
+	return true;
+}
+
+//! Computes the distances from 'compared' to 'reference' and copies them in 'dists'
+static bool ComputeDistances(ChunkedPointCloud& compared, ChunkedPointCloud& reference, bool multiThread, ScalarType maxSearchDist, std::vector<ScalarType>& dists)
+{
+	DistanceComputationTools::Cloud2CloudDistanceComputationParams params;
+	params.multiThread = multiThread;
+	params.maxSearchDist = maxSearchDist;
+
+	//distances are initialized with NaN (see computeHausdorffDistance)
+	if (!compared.enableScalarField())
+		return false;
+	unsigned count = compared.size();
+	for (unsigned i=0; i<count; ++i)
+		compared.setPointScalarValue(i,NAN_VALUE);
+
+	if (DistanceComputationTools::computeHausdorffDistance(&compared,&reference,params) != 0)
+		return false;
+
+	dists.resize(count);
+	for (unsigned i=0; i<count; ++i)
+		dists[i] = compared.getPointScalarValue(i);
+
+	return true;
+}
+
+//! Returns the number of values that are not strictly identical (NaN values included)
+static unsigned CountDifferences(const std::vector<ScalarType>& d1, const std::vector<ScalarType>& d2)
+{
+	unsigned diffCount = 0;
+	for (size_t i=0; i<d1.size(); ++i)
+	{
+		bool nan1 = (d1[i] != d1[i]);
+		bool nan2 = (d2[i] != d2[i]);
+		if (nan1 != nan2 || (!nan1 && d1[i] != d2[i]))
+			++diffCount;
+	}
+	return diffCount;
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned count = (argc > 1 ? static_cast<unsigned>(atol(argv[1])) : 200000);
+	ScalarType maxSearchDist = (argc > 2 ? static_cast<ScalarType>(atof(argv[2])) : static_cast<ScalarType>(0.02));
+	if (count == 0 || maxSearchDist <= 0)
+	{
+		fprintf(stderr,"Usage: %s [point count] [max search distance]\n",argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	//two synthetic clouds (the reference one is 4 times sparser)
+	srand(0);
+	ChunkedPointCloud compared, reference;
+	if (!FillCloud(compared,count) || !FillCloud(reference,count/4+1))
+	{
+		fprintf(stderr,"Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
+
+	int errors = 0;
+
+	//unbounded search
+	std::vector<ScalarType> distST, distMT;
+	if (!ComputeDistances(compared,reference,false,-1.0,distST) || !ComputeDistances(compared,reference,true,-1.0,distMT))
+	{
+		fprintf(stderr,"Distances computation failed!\n");
+		return EXIT_FAILURE;
+	}
+	unsigned diffCount = CountDifferences(distST,distMT);
+	printf("[unbounded] %u/%u different values (MT vs. ST)\n",diffCount,count);
+	if (diffCount != 0)
+		++errors;
+
+	//brute force check (on a subset of the compared points)
+	{
+		unsigned wrongCount = 0;
+		unsigned checkedCount = std::min<unsigned>(count,1000);
+		for (unsigned i=0; i<checkedCount; ++i)
+		{
+			const CCVector3* P = compared.getPoint(i);
+			double minSquareDist = -1.0;
+			for (unsigned j=0; j<reference.size(); ++j)
+			{
+				double squareDist = (*reference.getPoint(j)-*P).norm2();
+				if (minSquareDist < 0 || squareDist < minSquareDist)
+					minSquareDist = squareDist;
+			}
+			if (fabs(sqrt(minSquareDist)-distST[i]) > 1.0e-6)
+				++wrongCount;
+		}
+		printf("[unbounded] %u/%u wrong values (brute force)\n",wrongCount,checkedCount);
+		if (wrongCount != 0)
+			++errors;
+	}
+
+	//bounded search
+	std::vector<ScalarType> boundedST, boundedMT;
+	if (!ComputeDistances(compared,reference,false,maxSearchDist,boundedST) || !ComputeDistances(compared,reference,true,maxSearchDist,boundedMT))
+	{
+		fprintf(stderr,"Distances computation failed!\n");
+		return EXIT_FAILURE;
+	}
+	diffCount = CountDifferences(boundedST,boundedMT);
+	printf("[maxSearchDist=%f] %u/%u different values (MT vs. ST)\n",maxSearchDist,diffCount,count);
+	if (diffCount != 0)
+		++errors;
+
+	//bounded distances = true distances below 'maxSearchDist', 'maxSearchDist' above
+	{
+		unsigned wrongCount = 0, clampedCount = 0;
+		for (unsigned i=0; i<count; ++i)
+		{
+			ScalarType expected = distST[i];
+			if (expected > maxSearchDist)
+			{
+				expected = maxSearchDist;
+				++clampedCount;
+			}
+			if (boundedST[i] != expected)
+				++wrongCount;
+		}
+		printf("[maxSearchDist=%f] %u/%u wrong values (vs. unbounded, %u beyond maxSearchDist)\n",maxSearchDist,wrongCount,count,clampedCount);
+		if (wrongCount != 0)
+			++errors;
+	}
+
+	return (errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
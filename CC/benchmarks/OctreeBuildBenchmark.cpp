@@ -0,0 +1,114 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+//Benchmark: octree build, multi-threaded (radix sort) vs. single-threaded (std::sort) path
+//Usage: OctreeBuildBenchmark [point counts... (default: 1000000 10000000 100000000)]
+
+#include "DgmOctree.h"
+#include "ChunkedPointCloud.h"
+
+//Qt
+#include <QtCore/QTime>
+
+//system
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace CCLib;
+
+//! Builds the octree of a cloud and returns the elapsed time (in ms) or -1 on error
+static int BuildOctree(DgmOctree& octree, bool multiThread)
+{
+	octree.enableMultiThreadedBuild(multiThread);
+
+	QTime timer;
+	timer.start();
+	if (octree.build() <= 0)
+		return -1;
+
+	return timer.elapsed();
+}
+
+//! Runs the benchmark on a random cloud with 'count' points
+/** \return false if both octrees are not strictly identical (or if an error occurred)
+**/
+static bool Benchmark(unsigned count)
+{
+	ChunkedPointCloud cloud;
+	if (!cloud.reserve(count))
+	{
+		fprintf(stderr,"Not enough memory!\n");
+		return false;
+	}
+	srand(0);
+	for (unsigned i=0; i<count; ++i)
+		cloud.addPoint(CCVector3(static_cast<PointCoordinateType>(rand())/RAND_MAX,
+								 static_cast<PointCoordinateType>(rand())/RAND_MAX,
+								 static_cast<PointCoordinateType>(rand())/RAND_MAX));
+
+	DgmOctree octreeMT(&cloud);
+	int tMT = BuildOctree(octreeMT,true);
+	DgmOctree octreeST(&cloud);
+	int tST = BuildOctree(octreeST,false);
+	if (tMT < 0 || tST < 0)
+	{
+		fprintf(stderr,"Failed to build the octree (%u points)!\n",count);
+		return false;
+	}
+
+	printf("%u points: radix sort (MT) %i ms, std::sort (ST) %i ms (x%.2f)\n",count,tMT,tST,tMT > 0 ? static_cast<double>(tST)/tMT : 0.0);
+
+	//both structures must be strictly identical
+	const DgmOctree::cellsContainer& codesMT = octreeMT.pointsAndTheirCellCodes();
+	const DgmOctree::cellsContainer& codesST = octreeST.pointsAndTheirCellCodes();
+	if (codesMT.size() != codesST.size())
+	{
+		fprintf(stderr,"Different number of projected points!\n");
+		return false;
+	}
+	for (size_t i=0; i<codesMT.size(); ++i)
+	{
+		if (codesMT[i].theIndex != codesST[i].theIndex || codesMT[i].theCode != codesST[i].theCode)
+		{
+			fprintf(stderr,"Octrees differ (first difference at position %u)!\n",static_cast<unsigned>(i));
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<unsigned> counts;
+	for (int i=1; i<argc; ++i)
+		counts.push_back(static_cast<unsigned>(atol(argv[i])));
+	if (counts.empty())
+	{
+		counts.push_back(1000000);
+		counts.push_back(10000000);
+		counts.push_back(100000000);
+	}
+
+	bool success = true;
+	for (size_t i=0; i<counts.size(); ++i)
+		if (!Benchmark(counts[i]))
+			success = false;
+
+	return (success ? EXIT_SUCCESS : EXIT_FAILURE);
+}
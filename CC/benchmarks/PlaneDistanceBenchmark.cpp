@@ -0,0 +1,91 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+//Benchmark: cloud-to-plane mean distance, chunk-based (SIMD) kernel vs. generic (AoS iterator) loop
+//Usage: PlaneDistanceBenchmark [point count (default: 10000000)] [repetitions (default: 10)]
+
+#include "DistanceComputationTools.h"
+#include "ChunkedPointCloud.h"
+#include "SimpleCloud.h"
+
+//Qt
+#include <QtCore/QTime>
+
+//system
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+using namespace CCLib;
+
+int main(int argc, char* argv[])
+{
+	unsigned count = (argc > 1 ? static_cast<unsigned>(atol(argv[1])) : 10000000);
+	unsigned repeat = (argc > 2 ? static_cast<unsigned>(atol(argv[2])) : 10);
+	if (count == 0 || repeat == 0)
+	{
+		fprintf(stderr,"Usage: %s [point count] [repetitions]\n",argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	//same (random) points in both clouds
+	ChunkedPointCloud chunkedCloud;
+	SimpleCloud simpleCloud;
+	if (!chunkedCloud.reserve(count) || !simpleCloud.reserve(count))
+	{
+		fprintf(stderr,"Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
+	srand(0);
+	for (unsigned i=0; i<count; ++i)
+	{
+		CCVector3 P(static_cast<PointCoordinateType>(rand())/RAND_MAX,
+					static_cast<PointCoordinateType>(rand())/RAND_MAX,
+					static_cast<PointCoordinateType>(rand())/RAND_MAX);
+		chunkedCloud.addPoint(P);
+		simpleCloud.addPoint(P);
+	}
+
+	//plane: 0.3x+0.5y+0.8z = 0.7
+	const PointCoordinateType planeEquation[4] = {0.3f,0.5f,0.8f,0.7f};
+
+	QTime timer;
+	ScalarType dChunked = 0, dGeneric = 0;
+
+	timer.start();
+	for (unsigned r=0; r<repeat; ++r)
+		dChunked = DistanceComputationTools::computeCloud2PlaneDistance(&chunkedCloud,planeEquation);
+	double tChunked = static_cast<double>(timer.elapsed())/repeat;
+
+	//SimpleCloud is not a ChunkedPointCloud: it goes through the generic loop
+	timer.start();
+	for (unsigned r=0; r<repeat; ++r)
+		dGeneric = DistanceComputationTools::computeCloud2PlaneDistance(&simpleCloud,planeEquation);
+	double tGeneric = static_cast<double>(timer.elapsed())/repeat;
+
+	printf("%u points: chunk-based %.2f ms, generic %.2f ms (x%.2f)\n",count,tChunked,tGeneric,tChunked > 0 ? tGeneric/tChunked : 0.0);
+	printf("mean distance: chunk-based %.8f, generic %.8f\n",dChunked,dGeneric);
+
+	//both versions accumulate in double precision
+	if (fabs(dChunked-dGeneric) > 1.0e-6*fabs(dGeneric))
+	{
+		fprintf(stderr,"Results differ!\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -32,4 +32,13 @@ typedef float PointCoordinateType;
 //! Type of a single scalar field value
 typedef float ScalarType;
 
+//! SSE kernels switch (CCLib and its client libraries)
+/** Kernels are only written for single precision coordinates and scalar
+	values (see above) on SSE2 capable targets. Define CC_NO_SSE_KERNELS
+	to force the standard code paths.
+**/
+#if !defined(CC_NO_SSE_KERNELS) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CC_USE_SSE_KERNELS
+#endif
+
 #endif //CC_TYPES_HEADER
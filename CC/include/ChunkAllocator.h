@@ -0,0 +1,153 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_CHUNK_ALLOCATOR_HEADER
+#define CC_CHUNK_ALLOCATOR_HEADER
+
+//Qt
+#include <QtCore/QAtomicInt>
+#include <QtCore/QAtomicPointer>
+
+//system
+#include <stddef.h>
+
+//! Memory allocator for the GenericChunkedArray chunks
+/** By default, chunks are simply allocated in RAM (with malloc/realloc).
+	Once 'file mapping' is enabled, big chunks are backed by (temporary)
+	memory-mapped files instead. Their address never changes (the whole chunk
+	capacity is mapped at once) so that the GenericChunkedArray API (getValue,
+	chunkStartPtr, etc.) keeps working. Data can then be paged out by the
+	system, which makes it possible to handle clouds bigger than the physical
+	memory.
+
+	Residency is controlled by an LRU budget that works per chunk: each time a
+	chunk is 'touched' it becomes the most recently used one, and the least
+	recently used chunks are released from memory (their content is kept in
+	the scratch file) as soon as the budget is exceeded. Released chunks are
+	transparently reloaded (by the system) when accessed.
+
+	Warning: only chunk-level accesses touch a chunk (i.e. (re)allocation and
+	GenericChunkedArray::chunkStartPtr, used by the display and the chunk-wise
+	processing loops). Per-element accessors (getValue, setValue, etc.) don't,
+	so that they remain as cheap as before. Therefore the budget is only an
+	approximation of the real working set. This is harmless: a chunk that has
+	been released too early is simply reloaded.
+**/
+#ifdef CC_USE_AS_DLL
+#include "CloudCompareDll.h"
+class CC_DLL_API ChunkAllocator
+#else
+class ChunkAllocator
+#endif
+{
+public:
+
+	//! Enables memory-mapped chunks
+	/** Only affects chunks allocated after this call.
+		\param scratchDir directory where temporary files will be created (0 = system default)
+		\param residentBudget max amount of memory (in bytes) for resident mapped chunks (0 = no limit)
+		\param minChunkSize chunks smaller than this size (in bytes) stay in RAM
+		\return success
+	**/
+	static bool EnableFileMapping(const char* scratchDir = 0, size_t residentBudget = 0, size_t minChunkSize = (1<<18));
+
+	//! Disables memory-mapped chunks
+	/** Already mapped chunks remain valid (until they are released).
+	**/
+	static void DisableFileMapping();
+
+	//! Returns whether memory-mapped chunks are enabled
+	static bool IsFileMappingEnabled();
+
+	//! Sets the max amount of memory (in bytes) for resident mapped chunks (0 = no limit)
+	static void SetResidentBudget(size_t residentBudget);
+
+	//! Returns the number of currently mapped chunks
+	static unsigned MappedChunksCount();
+
+	//! (Re)allocates a chunk
+	/** Same behavior as 'realloc' (if the reallocation fails, the original chunk
+		is left untouched and 0 is returned).
+		\param chunk chunk to reallocate (0 for a new one)
+		\param currentSize current chunk size (in bytes)
+		\param newSize new chunk size (in bytes)
+		\param maxSize max size of this chunk (i.e. size of the mapping, in bytes)
+		\return the chunk (new) address or 0 if an error occured
+	**/
+	static void* Reallocate(void* chunk, size_t currentSize, size_t newSize, size_t maxSize);
+
+	//! Releases a chunk
+	static void Release(void* chunk);
+
+	//! Maps a region of an existing file as a chunk (zero-copy loading)
+	/** The region is mapped in 'copy-on-write' mode: the chunk can be modified
+		without affecting the file. Pages are only loaded when accessed.
+		Such chunks are not subject to the LRU budget.
+		Warning: the file shouldn't be modified while it is mapped (see
+		DetachFileViews).
+		\param fileDescriptor file descriptor (as returned by QFile::handle or 'open')
+		\param offset region offset in file (must be a multiple of 64 KB)
+		\param size region size (in bytes)
+		\return the chunk address or 0 if an error occured
+	**/
+	static void* MapFileView(int fileDescriptor, unsigned long long offset, size_t size);
+
+	//! Detaches the chunks mapped on a given file (see MapFileView)
+	/** Their content is copied in memory (at the same address). Must be called
+		before (over)writing a file that may be currently mapped. Views of other
+		files are left untouched. If a chunk can't be detached, it remains
+		mapped (and valid).
+		\param filename file that is about to be (over)written
+		\return success
+	**/
+	static bool DetachFileViews(const char* filename);
+
+	//! Marks a chunk as the most recently used one
+	/** Only relevant for memory-mapped chunks (does nothing otherwise).
+		Lock-free if the chunk is already the most recently used one: the two
+		shortcuts (s_hasMappedChunks and s_lastTouchedChunk) are atomics, only
+		updated with the allocator lock held. A thread may still see a value
+		that is being replaced: it then either locks the allocator for nothing
+		or misses one LRU update (harmless). If the allocator is busy (i.e.
+		another thread holds the lock), the LRU update is skipped as well: the
+		LRU order only drives which chunks are released first, never the
+		chunks validity.
+	**/
+	static inline void Touch(const void* chunk) { if (s_hasMappedChunks && chunk != static_cast<const void*>(s_lastTouchedChunk)) TouchMapped(chunk); }
+
+protected:
+
+	//! Marks a mapped chunk as the most recently used one (and applies the LRU budget)
+	static void TouchMapped(const void* chunk);
+
+	//! Updates s_lastTouchedChunk (must be called with the allocator lock held)
+	static void UpdateLastTouchedChunk();
+
+	//! Most recently used mapped chunk
+	/** Shortcut to avoid locking the allocator when the same chunk is accessed
+		several times in a row (read lock-free, see Touch).
+	**/
+	static QAtomicPointer<const void> s_lastTouchedChunk;
+
+	//! Whether at least one chunk is currently mapped (0 or 1)
+	/** Shortcut to avoid any lookup in the default (RAM only) case (read
+		lock-free, see Touch).
+	**/
+	static QAtomicInt s_hasMappedChunks;
+};
+
+#endif //CC_CHUNK_ALLOCATOR_HEADER
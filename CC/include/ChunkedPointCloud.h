@@ -25,6 +25,7 @@
 
 //System
 #include <assert.h>
+#include <algorithm>
 
 namespace CCLib
 {
@@ -122,6 +123,37 @@ public:
         **/
 		virtual void invalidateBoundingBox();
 
+		/*** chunk-based access ***/
+
+		//! Returns the number of chunks of points
+		/** Points are stored in chunks of (at most) MAX_NUMBER_OF_ELEMENTS_PER_CHUNK
+			points, with interleaved coordinates (x0 y0 z0 x1 y1 z1 ...). Processing
+			them chunk by chunk is much faster than calling getPoint for each point.
+		**/
+		inline unsigned pointsChunksCount() const { return m_points->chunksCount(); }
+
+		//! Returns the number of (valid) points in a given chunk
+		/** \param index chunk index (see pointsChunksCount)
+		**/
+		inline unsigned pointsChunkSize(unsigned index) const
+		{
+			unsigned firstIndex = (index << CHUNK_INDEX_BIT_DEC);
+			unsigned count = size();
+			return (firstIndex < count ? std::min(m_points->chunkSize(index),count-firstIndex) : 0);
+		}
+
+		//! Returns the (interleaved) coordinates of the points of a given chunk
+		/** \param index chunk index (see pointsChunksCount)
+		**/
+		inline const PointCoordinateType* pointsChunkStartPtr(unsigned index) const { return m_points->chunkStartPtr(index); }
+
+		//! Returns the (interleaved) coordinates of the points of a given chunk (write access)
+		/** Warning: the bounding-box must be invalidated once the points have been
+			modified (see invalidateBoundingBox).
+			\param index chunk index (see pointsChunksCount)
+		**/
+		inline PointCoordinateType* pointsChunkStartPtr(unsigned index) { return m_points->chunkStartPtr(index); }
+
 
 		/*** scalar fields management ***/
 
@@ -242,6 +274,23 @@ protected:
 		**/
 		inline virtual const CCVector3* point(unsigned index) const { assert(index < size()); return (CCVector3*)m_points->getValue(index); }
 
+		//! Translates all points (chunk-based)
+		/** Warning: doesn't update the bounding-box.
+		**/
+		void translatePoints(const CCVector3& T);
+
+		//! Scales all points along each dimension (chunk-based)
+		/** Warning: doesn't update the bounding-box.
+		**/
+		void scalePoints(PointCoordinateType fx, PointCoordinateType fy, PointCoordinateType fz);
+
+		//! Applies an affine transformation to all points (chunk-based)
+		/** P' = R.P + T (if T is not null). Warning: doesn't update the bounding-box.
+			\param R 3x3 matrix (row-major order)
+			\param T translation vector (optional)
+		**/
+		void transformPoints(const PointCoordinateType R[9], const PointCoordinateType* T=0);
+
 		//! 3D Points database
 		GenericChunkedArray<3,PointCoordinateType>* m_points;
 
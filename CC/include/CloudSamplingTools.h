@@ -147,6 +147,46 @@ public:
 													DgmOctree* theOctree=0,
 													GenericProgressCallback* progressCb=0);
 
+	//! Resamples a point cloud (process based on inter point distance) - parallel version
+	/** Same result 'type' as resampleCloudSpatially (no point of the resulting cloud
+		has a neighbour nearer than minDistance) but the points are processed octree
+		cell by octree cell (at the finest level where cells are bigger than minDistance).
+		Cells are split in 27 'colour' classes (depending on their position modulo 3) so
+		that the cells of a same class never share a neighbour cell: they are processed
+		in parallel, one class after the other. Inside each cell, the points are visited
+		in a pseudo-random order depending only on the seed, so that the output is the
+		same whatever the number of threads.
+		\param theCloud the point cloud to resample
+		\param minDistance the distance under which a point in the resulting cloud cannot have any neighbour
+		\param seed seed of the points visiting order
+		\param theOctree associated octree if available
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return a reference cloud corresponding to the resampling 'selection'
+	**/
+	static ReferenceCloud* resampleCloudSpatiallyParallel(GenericIndexedCloudPersist* theCloud,
+															float minDistance,
+															unsigned seed=0,
+															DgmOctree* theOctree=0,
+															GenericProgressCallback* progressCb=0);
+
+	//! Statistical Outliers Removal (SOR) filter
+	/** For each point, the mean distance to its 'knn' nearest neighbours is computed
+		(in parallel, octree cell by octree cell). Then the points whose mean distance
+		is greater than 'average + nSigma * standard deviation' (over the whole cloud)
+		are considered as outliers (see also PCL's StatisticalOutlierRemoval filter).
+		\param theCloud the point cloud to filter
+		\param knn number of neighbours (clamped to the number of points minus one)
+		\param nSigma max distance (in standard deviations) above the average mean distance
+		\param theOctree associated octree if available
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return a reference cloud corresponding to the remaining points (i.e. not the outliers), or 0 if an error occurred (e.g. less than 2 points)
+	**/
+	static ReferenceCloud* sorFilter(GenericIndexedCloudPersist* theCloud,
+										unsigned knn = 6,
+										double nSigma = 1.0,
+										DgmOctree* theOctree = 0,
+										GenericProgressCallback* progressCb = 0);
+
 protected:
 
 	//! "Cellular" function to replace one set of points (contained in an octree cell) by a unique point
@@ -154,8 +194,12 @@ protected:
 		(it is of the form DgmOctree::localFunctionPtr). It replaces all
 		points in a cell by a unique one, according to different rules.
 		Method parameters (defined in "additionalParameters") are :
-		- (SimpleCloud*) point cloud to store new points
+		- (std::vector<CCVector3>*) output points (one slot per cell, indexed by the cell rank)
 		- (RESAMPLING_CELL_METHOD*) resampling method
+		- (DgmOctree::cellIndexesContainer*) cells indexes (see DgmOctree::getCellIndexes)
+		- (std::vector<uchar>*) whether each slot has been filled or not
+		As each cell only writes in its own slot, this function can be
+		applied to the cells in any order (and in parallel).
 	**/
 	static bool resampleCellAtLevel(const DgmOctree::octreeCell& cell,
                                     void** additionalParameters);
@@ -165,13 +209,29 @@ protected:
 		(it is of the form DgmOctree::localFunctionPtr). It chooses one point
 		from the set of points inside a cell, according to different rules.
 		Method parameters (defined in "additionalParameters") are :
-		- (ReferenceCloud*) reference point cloud to store selected points
+		- (std::vector<unsigned>*) selected point indexes (one slot per cell, indexed by
+		the cell rank). With RANDOM_POINT, each slot must initially contain a random value.
 		- (SUBSAMPLING_CELL_METHOD*) subampling method
+		- (DgmOctree::cellIndexesContainer*) cells indexes (see DgmOctree::getCellIndexes)
+		As each cell only writes in its own slot, this function can be
+		applied to the cells in any order (and in parallel).
 		\param cell structure describing the cell on which processing is applied
 		\param additionalParameters see method description
 	**/
 	static bool subsampleCellAtLevel(const DgmOctree::octreeCell& cell,
                                         void** additionalParameters);
+
+	//! "Cellular" function to compute the mean distance of each point to its nearest neighbours
+	/** This function is meant to be applied to all cells of the octree
+		(it is of the form DgmOctree::localFunctionPtr).
+		Method parameters (defined in "additionalParameters") are :
+		- (unsigned*) number of neighbours
+		- (std::vector<float>*) mean distance of each point (output - indexed by point index)
+		\param cell structure describing the cell on which processing is applied
+		\param additionalParameters see method description
+	**/
+	static bool applySORFilterAtLevel(const DgmOctree::octreeCell& cell,
+										void** additionalParameters);
 };
 
 }
@@ -379,6 +379,18 @@ public:
 			return a.theCode < b.theCode;
 		}
 
+		//! Code-based comparison operator (ties are broken by index)
+		/** Gives the same (deterministic) order as a stable sort of
+			elements initially ordered by index.
+			\param a first IndexAndCode structure
+			\param b second IndexAndCode structure
+			\return whether 'a' should be placed before 'b'
+		**/
+		static bool codeAndIndexComp(const IndexAndCode& a, const IndexAndCode& b) throw()
+		{
+			return a.theCode < b.theCode || (a.theCode == b.theCode && a.theIndex < b.theIndex);
+		}
+
 		//! Index-based comparison operator
 		/** \param a first IndexAndCode structure
 			\param b second IndexAndCode structure
@@ -405,14 +417,38 @@ public:
 	    OctreeCellCodeType truncatedCode;
 	    //! Cell index in octree structure (see m_thePointsAndTheirCellCodes)
 	    unsigned index;
-	    //! Set of points lying inside this cell
-        ReferenceCloud* points;
+	    //! Number of points lying inside this cell
+	    unsigned pointCount;
+	    //! Points lying inside this cell (indexes and codes)
+	    /** Zero-copy view on the octree structure: 'pointCount' elements
+	        starting at 'index' (see DgmOctree::pointsAndTheirCellCodes).
+	        Faster than going through the reference cloud (see getPoints).
+	    **/
+	    const IndexAndCode* pointsAndCodes;
+
+	    //! Returns the global index of the ith point of the cell (zero-copy)
+	    inline unsigned getPointGlobalIndex(unsigned i) const { assert(i < pointCount); return pointsAndCodes[i].theIndex; }
+
+	    //! Returns the set of points lying inside this cell
+	    /** The reference cloud is filled on demand: the points indexes are
+	        only copied (once per cell) if this method is called. Cell functions
+	        that only need the points indexes should use getPointGlobalIndex.
+	        \return the cell points (or 0 if not enough memory)
+	    **/
+	    ReferenceCloud* getPoints() const;
 
         //! Default constructor
         octreeCell(DgmOctree* parentOctree);
 
         //! Default destructor
         virtual ~octreeCell();
+
+	protected:
+
+	    //! Set of points lying inside this cell (see getPoints)
+        ReferenceCloud* m_points;
+	    //! Points currently copied in 'm_points' (see getPoints)
+	    mutable const IndexAndCode* m_pointsSource;
 	};
 
 	//! Generic form of a function that can be applied automatically to all cells of the octree
@@ -459,6 +495,17 @@ public:
 	**/
 	int build(const CCVector3& octreeMin, const CCVector3& octreeMax, const CCVector3* pointsMinFilter=0, const CCVector3* pointsMaxFilter=0, GenericProgressCallback* progressCb=0);
 
+	//! Enables or disables the multi-threaded build
+	/** When enabled (default), cell codes are computed in parallel and then
+		sorted with a parallel (LSD) radix sort. The resulting structure is
+		exactly the same as the one obtained with the single-threaded build.
+		Only effective if ENABLE_MT_OCTREE is defined (and for big enough clouds).
+	**/
+	inline void enableMultiThreadedBuild(bool state) { m_multiThreadedBuild = state; }
+
+	//! Returns whether the multi-threaded build is enabled
+	inline bool isMultiThreadedBuildEnabled() const { return m_multiThreadedBuild; }
+
 	/**** GETTERS ****/
 
 	//! Returns the number of points projected into the octree
@@ -635,6 +682,25 @@ public:
 	//DGM TODO: doc
 	int getPointsInSphericalNeighbourhood(const CCVector3& sphereCenter, PointCoordinateType radius, NeighboursSet& neighbours) const;
 
+	//! Finds the nearest point (for a given depth function) lying inside a convex volume
+	/** Typically used for CPU based picking: the volume is then the frustum of the
+		picking area, and the depth is the distance to the eye (or to the near plane).
+		The octree is scanned top-down: cells lying outside of the volume or farther
+		than the current nearest point are skipped, and the nearest cells are scanned
+		first.
+		\param planes equations of the planes delimiting the volume (as [Nx Ny Nz d]: a point P is inside if N.P+d >= 0 for all planes)
+		\param planeCount number of planes
+		\param depthEquation depth of a point P (as [Dx Dy Dz d]: depth = D.P+d)
+		\param[out] nearestPointIndex index of the (inside) point with the smallest depth
+		\param[out] nearestPointDepth depth of this point
+		\return whether a point has been found inside the volume
+	**/
+	bool findNearestPointInConvexVolume(const double planes[][4],
+										unsigned planeCount,
+										const double depthEquation[4],
+										unsigned& nearestPointIndex,
+										double& nearestPointDepth) const;
+
 	/***** CELLS POSITION HANDLING *****/
 
 	//! Generates the truncated cell code of a cell given its position at a given level of subdivision
@@ -841,6 +907,11 @@ public:
 		(if no points lies in it) or to 1 (if some points lie in it, e.g. if it is indeed a
 		cell of this octree). This version of the algorithm can be applied by considering only
 		a specified list of octree cells (ignoring the others).
+		The labelling works directly on the (sorted) cell codes: neighbours are deduced from
+		the codes themselves and merged with a concurrent union-find structure. Therefore the
+		memory consumption only depends on the number of cells (and not on the level).
+		Components are labelled (starting from 1) in the order of their first cell along Z,
+		then Y, then X.
 		\param cellCodes the cell codes to consider for the CC computation
 		\param level the level of subidivision at which to perform the algorithm
 		\param sixConnexity indicates if the CC's 3D connexity should be 6 (26 otherwise)
@@ -913,19 +984,25 @@ public:
 
 #ifdef ENABLE_MT_OCTREE
 	//! Multi-threaded version of executeFunctionForAllCellsAtLevel
-	/** Based on QtConcurrent::map system. Dispacthes automatically
-		computation on as much cores on the system.
+	/** Cells are dispatched on a (local) pool of threads with work stealing.
+		The biggest cells are processed first so that they don't delay the end
+		of the process. All the dispatch state is specific to each call (several
+		octrees can be processed at the same time). The progress callback is only
+		called by the calling thread.
+		\param maxThreadCount max number of threads (0 = as many as there are cores)
 		\return the number of processed cells (or 0 is something went wrong)
 	**/
 	unsigned executeFunctionForAllCellsAtLevel_MT(uchar level,
 													octreeCellFunc func,
 													void** additionalParameters,
 													GenericProgressCallback* progressCb=0,
-													const char* functionTitle=0);
+													const char* functionTitle=0,
+													int maxThreadCount=0);
 
-	//! Multi-threaded version of executeFunctionForAllCellsAtLevel
-	/** Based on QtConcurrent::map system. Dispacthes automatically
-		computation on as much cores on the system.
+	//! Multi-threaded version of executeFunctionForAllCellsAtStartingLevel
+	/** See DgmOctree::executeFunctionForAllCellsAtLevel_MT. Dense cells are
+		also split (at deeper levels) according to maxNumberOfPointsPerCell.
+		\param maxThreadCount max number of threads (0 = as many as there are cores)
 		\return the number of processed cells (or 0 is something went wrong)
 	**/
 	unsigned executeFunctionForAllCellsAtStartingLevel_MT(uchar level,
@@ -934,7 +1011,8 @@ public:
 														unsigned minNumberOfPointsPerCell,
                                                         unsigned maxNumberOfPointsPerCell,
                                                         GenericProgressCallback* progressCb=0,
-                                                        const char* functionTitle=0);
+                                                        const char* functionTitle=0,
+                                                        int maxThreadCount=0);
 #endif
 
 	//! Returns the associated cloud
@@ -1066,6 +1144,9 @@ protected:
 	//! Dump cloud
 	ReferenceCloud* m_dumpCloud;
 
+	//! Whether the multi-threaded build is enabled
+	bool m_multiThreadedBuild;
+
 	/******************************/
 	/**         METHODS          **/
 	/******************************/
@@ -1076,6 +1157,15 @@ protected:
 	**/
 	int genericBuild(GenericProgressCallback* progressCb=0);
 
+#ifdef ENABLE_MT_OCTREE
+	//! Multi-threaded projection of the points and sort of their cell codes (see genericBuild)
+	/** Fills m_thePointsAndTheirCellCodes and updates m_numberOfProjectedPoints.
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return false if not enough memory or if the process has been canceled
+	**/
+	bool computeAndSortCellCodes_MT(GenericProgressCallback* progressCb=0);
+#endif
+
 	//! Updates the tables containing octree limits and boundaries
 	void updateMinAndMaxTables();
 
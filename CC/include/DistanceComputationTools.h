@@ -37,9 +37,11 @@ class GenericCloud;
 class GenericIndexedCloud;
 class GenericIndexedCloudPersist;
 class ReferenceCloud;
+class ChunkedPointCloud;
 class GenericProgressCallback;
 class ChamferDistanceTransform;
 struct OctreeAndMeshIntersection;
+class TriangleBVH;
 
 //INTERNAL TESTS
 //#define DO_CLOUD2MESH_DISTANCE_TESTS
@@ -66,13 +68,14 @@ public:
 		uchar octreeLevel;
 
 		//! Maximum search distance (true distance won't be computed if greater)
-		/** Set to -1 to deactivate (default).
+		/** Set to -1 to deactivate (default). Points farther than this distance get
+			this value (cells with no reference point in range are skipped at once).
 			Not compatible with closest point set determination (see CPSet).
 		**/
 		ScalarType maxSearchDist;
 
 		//! Whether to use multi-thread or single thread mode
-		/** If maxSearchDist>=0, single thread mode is forced.
+		/** Results are the same in both modes (bounded search included).
 		**/
 		bool multiThread;
 
@@ -145,6 +148,21 @@ public:
                                         DgmOctree* compOctree=0,
                                         DgmOctree* refOctree=0);
 
+	//! Computes the "nearest neighbour distance" between each point of a cloud and a reference octree
+	/** Contrary to computeHausdorffDistance, the compared cloud doesn't need any octree: each point is
+		directly looked up in the reference octree. Therefore the reference octree can be built once
+		and for all if only the compared cloud moves (e.g. during ICP iterations).
+		\param comparedCloud the compared cloud (the distances are stored as its scalar values)
+		\param referenceOctree the octree of the reference cloud
+		\param CPSet the "Closest Point Set" (optional, will be resized to the compared cloud size)
+		\param octreeLevel the level of subdivision at which to start the search (0 = automatic)
+		\return success
+	**/
+	static bool computeNearestNeighbourDistances(GenericIndexedCloudPersist* comparedCloud,
+												const DgmOctree* referenceOctree,
+												ReferenceCloud* CPSet=0,
+												uchar octreeLevel=0);
+
 	//! Computes the distance between a point cloud and a mesh
 	/** The algorithm, inspired from METRO by Cignoni et al., is described
 		in Daniel Girardeau-Montaut's PhD manuscript (Chapter 2, section 2.2).
@@ -172,6 +190,29 @@ public:
                                                 GenericProgressCallback* progressCb=0,
                                                 DgmOctree* cloudOctree=0);
 
+	//! Computes the distance between each point of a cloud and a mesh (BVH based)
+	/** Alternative to computePointCloud2MeshDistance: the mesh triangles are indexed by a
+		bounding volume hierarchy (see TriangleBVH) instead of being projected in a 3D grid.
+		Distances are always exact (i.e. not squared and without Chamfer approximation).
+		\param pointCloud the compared cloud (the distances will be stored in its scalar field)
+		\param theMesh the reference mesh
+		\param maxSearchDist if greater than 0 (default value: '-1'), then the algorithm won't compute distances over this value (they will be set to maxSearchDist instead)
+		\param signedDistances specify whether to compute signed or positive distances
+		\param flipNormals if 'signedDistances' is true,  specify whether triangle normals should be computed in the 'direct' order (true) or 'indirect' (false)
+		\param multiThread specify whether to use multi-thread or single thread mode
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\param meshBVH the pre-computed hierarchy of the mesh (it is automatically computed if 0)
+		\return 0 if ok, a negative value otherwise
+	**/
+	static int computePointCloud2MeshDistanceWithBVH(GenericIndexedCloudPersist* pointCloud,
+													GenericIndexedMesh* theMesh,
+													ScalarType maxSearchDist=-1.0,
+													bool signedDistances=false,
+													bool flipNormals=false,
+													bool multiThread=true,
+													GenericProgressCallback* progressCb=0,
+													const TriangleBVH* meshBVH=0);
+
 	/*** Basic entity level ***/
 
 	//! Computes the distance between a point and a triangle
@@ -223,13 +264,24 @@ public:
 
 	//! Computes the mean distance between a cloud and a plane
 	/** Sums the distances between each point of the cloud and the plane, then computes the mean value.
-		WARNING: this method uses the cloud global iterator
+		WARNING: this method uses the cloud global iterator (except for
+		ChunkedPointCloud instances, automatically processed by the chunk-based
+		version below)
 		\param cloud a point cloud
 		\param planeEquation plane equation: [a,b,c,d] as 'ax+by+cz=d'
 		\return the mean distance (or NaN if an error occured)
 	**/
 	static ScalarType computeCloud2PlaneDistance(GenericCloud* cloud, const PointCoordinateType* planeEquation);
 
+	//! Computes the mean distance between a cloud and a plane (chunk-based version)
+	/** Same as the generic version but works directly on the cloud points chunks
+		(doesn't use the cloud global iterator, SSE kernel if available).
+		\param cloud a point cloud
+		\param planeEquation plane equation: [a,b,c,d] as 'ax+by+cz=d'
+		\return the mean distance (or NaN if an error occured)
+	**/
+	static ScalarType computeCloud2PlaneDistance(const ChunkedPointCloud* cloud, const PointCoordinateType* planeEquation);
+
 	//! Computes the Chamfer distances (approximated distances) between two point clouds
 	/** This methods uses a 3D grid to perfrom the Chamfer Distance propagation.
 		Therefore, the greater the octree level (used to determine the grid step) is, the finer
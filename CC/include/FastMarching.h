@@ -28,15 +28,14 @@
 
 //system
 #include <vector>
+#include <map>
+#include <assert.h>
 
 namespace CCLib
 {
 
 class DgmOctree;
 
-// Macro: cell position [i,j,k] to table (3D grid) index
-#define FM_pos2index(pos) unsigned(pos[0]-m_minFillIndexes[0])+unsigned(pos[1]-m_minFillIndexes[1])*decY+unsigned(pos[2]-m_minFillIndexes[2])*decZ+indexDec
-
 //! Direct neighbouring cells positions (6-connexity)
 const int neighboursPosShift[] = {0,-1,0,
 								1,0,0,
@@ -138,6 +137,9 @@ protected:
         //! Front arrival time
         float T;
 
+        //! Position in the TRIAL cells heap (only valid for TRIAL cells)
+        unsigned trialPos;
+
 		//! Returns infinite time value
 		inline static float T_INF() { return FLT_MAX; }
     };
@@ -149,6 +151,14 @@ protected:
 	**/
 	virtual int initGrid(DgmOctree* octree, uchar gridLevel);
 
+	//! Adds a (non empty) cell to the grid
+	/** The corresponding grid brick is allocated if necessary.
+		\param pos the cell position (absolute octree coordinates)
+		\param cell the cell
+		\return false if not enough memory
+	**/
+	bool addCell(const int pos[], Cell* cell);
+
 	//! Computes the front arrival time at a given cell
 	/** the cell is represented by its index in the cell list
 		\param index the cell index
@@ -173,27 +183,101 @@ protected:
 	**/
 	void initTrialCells();
 
-    //! Instantiates grid in memory
-    /** Grid is also filled with zeros.
-        \param size grid size
-        \return success
-    **/
-	virtual bool instantiateGrid(unsigned size);
+	//! Releases the grid (and its cells if the grid has been initialized)
+	void releaseGrid();
+
+	//! Returns the index of the cell at a given position
+	/** \param pos the cell position (absolute octree coordinates)
+		\return the cell index or 0 if the cell is outside of the allocated bricks
+	**/
+	unsigned pos2index(const int pos[]) const;
+
+	//! Returns the cell at a given index (or 0 if the cell is empty)
+	inline Cell* getCell(unsigned index) const
+	{
+		const Brick* brick = m_bricks[index >> BRICK_CELLS_SHIFT];
+		return (brick ? brick->cells[index & BRICK_CELLS_MASK] : 0);
+	}
+
+	//! Sets the cell at a given index
+	/** The corresponding brick must already exist (see addCell).
+	**/
+	inline void setCell(unsigned index, Cell* cell)
+	{
+		assert(m_bricks[index >> BRICK_CELLS_SHIFT]);
+		m_bricks[index >> BRICK_CELLS_SHIFT]->cells[index & BRICK_CELLS_MASK] = cell;
+	}
+
+	//! Returns the index of a cell shifted by a given number of cells
+	/** \param index the cell index
+		\param posShift shift along each dimension (between -BRICK_SIZE and BRICK_SIZE)
+		\return the shifted cell index or 0 if it lies in a brick that is not allocated
+	**/
+	inline unsigned getShiftedIndex(unsigned index, const int posShift[]) const
+	{
+		int x = int(index & BRICK_MASK) + posShift[0];
+		int y = int((index >> BRICK_SHIFT) & BRICK_MASK) + posShift[1];
+		int z = int((index >> (2*BRICK_SHIFT)) & BRICK_MASK) + posShift[2];
+		unsigned slot = (index >> BRICK_CELLS_SHIFT);
+
+		//do we leave the current brick?
+		int bx = (x < 0 ? 0 : (x < int(BRICK_SIZE) ? 1 : 2));
+		int by = (y < 0 ? 0 : (y < int(BRICK_SIZE) ? 1 : 2));
+		int bz = (z < 0 ? 0 : (z < int(BRICK_SIZE) ? 1 : 2));
+		if (bx != 1 || by != 1 || bz != 1)
+		{
+			slot = m_bricks[slot]->neighbours[bx+3*by+9*bz];
+			if (slot == 0)
+				return 0;
+		}
+
+		return (slot << BRICK_CELLS_SHIFT)
+				| (unsigned(x) & BRICK_MASK)
+				| ((unsigned(y) & BRICK_MASK) << BRICK_SHIFT)
+				| ((unsigned(z) & BRICK_MASK) << (2*BRICK_SHIFT));
+	}
+
+	//! Returns the index of a direct neighbour of a cell
+	/** \param index the cell index
+		\param n the neighbour number (see neighboursPosShift)
+		\return the neighbour cell index or 0 if it lies in a brick that is not allocated
+	**/
+	inline unsigned getNeighbourIndex(unsigned index, unsigned n) const
+	{
+		return getShiftedIndex(index,neighboursPosShift+3*n);
+	}
 
 	//! Add a cell to the TRIAL cells list
 	/** \param index index of the cell
 		\param T front arrival time at this cell
 	**/
-	virtual void addTrialCell(unsigned index, float T)=0;
+	virtual void addTrialCell(unsigned index, float T);
 
 	//! Returns the TRIAL cell with the smallest front arrival time
-	/** \return the index of the "first" TRIAL cell
+	/** The cell is removed from the TRIAL cells list.
+		\return the index of the "first" TRIAL cell
 	**/
-	virtual unsigned getNearestTrialCell()=0; //renvoie 0 si probleme
+	virtual unsigned getNearestTrialCell(); //renvoie 0 si probleme
+
+	//! Decreases the front arrival time of a TRIAL cell
+	/** \param index index of the cell
+		\param T new (smaller) front arrival time at this cell
+	**/
+	void decreaseTrialCellT(unsigned index, float T);
+
+	//! Moves a TRIAL cells heap element up to its right place
+	void trialHeapUp(unsigned pos);
+	//! Moves a TRIAL cells heap element down to its right place
+	void trialHeapDown(unsigned pos);
 
 	//! ACTIVE cells list
 	std::vector<unsigned> activeCells;
 
+	//! TRIAL cells list
+	/** Binary heap (the "first" cell has the smallest front arrival time).
+	**/
+	std::vector<unsigned> trialCells;
+
 	//! Specifiies whether structure is initialized or not
 	bool initialized;
 	//! Grid size along the X dimension
@@ -202,16 +286,52 @@ protected:
 	unsigned dy;
 	//! Grid size along the Z dimension
 	unsigned dz;
-	//! Shift for cell access acceleration (Y dimension)
-	unsigned decY;
-	//! Shift for cell access acceleration (Y dimension)
-	unsigned decZ;
-	//! First index of innerbound grid
-	unsigned indexDec;
-	//! Grid size
-	unsigned gridSize;
+
+	//! Grid bricks size along each dimension (log2)
+	static const unsigned BRICK_SHIFT = 4;
+	//! Grid bricks size along each dimension
+	static const unsigned BRICK_SIZE = (1 << BRICK_SHIFT);
+	//! Grid bricks local coordinates mask
+	static const unsigned BRICK_MASK = BRICK_SIZE-1;
+	//! Number of cells per brick (log2)
+	static const unsigned BRICK_CELLS_SHIFT = 3*BRICK_SHIFT;
+	//! Brick cells local index mask
+	static const unsigned BRICK_CELLS_MASK = (1 << BRICK_CELLS_SHIFT)-1;
+	//! Max number of bricks (slot 0 is never used)
+	static const unsigned MAX_BRICKS_COUNT = (1 << (32-BRICK_CELLS_SHIFT));
+
+	//! Grid brick (BRICK_SIZE^3 cells)
+	struct Brick
+	{
+		//! Cells (local index = x + y*BRICK_SIZE + z*BRICK_SIZE^2)
+		Cell* cells[BRICK_CELLS_MASK+1];
+		//! Slots of the 3x3x3 neighbouring bricks, including this one (0 = not allocated)
+		unsigned neighbours[27];
+	};
+
 	//! Grid used to process Fast Marching
-	Cell** theGrid;
+	/** The grid is sparse: it is split in cubical bricks of BRICK_SIZE^3 cells
+		which are only allocated if they contain at least one (non empty) cell.
+		A cell index is made of its brick slot (upper bits) and its local index
+		in the brick (lower bits). Therefore the grid size is only limited by
+		the number of non empty bricks (MAX_BRICKS_COUNT-1), not by its extents.
+		The first slot is always empty so that 0 is never a valid cell index.
+	**/
+	std::vector<Brick*> m_bricks;
+
+	//! Brick key (brick position in the grid)
+	typedef unsigned long long BrickKey;
+
+	//! Returns the key of the brick including a given cell (relative grid coordinates)
+	static inline BrickKey GetBrickKey(unsigned x, unsigned y, unsigned z)
+	{
+		return	  static_cast<BrickKey>(x >> BRICK_SHIFT)
+				| (static_cast<BrickKey>(y >> BRICK_SHIFT) << 21)
+				| (static_cast<BrickKey>(z >> BRICK_SHIFT) << 42);
+	}
+
+	//! Bricks slots (sparse map)
+	std::map<BrickKey,unsigned> m_brickSlots;
 
 	//! Associated octree
 	DgmOctree* m_octree;
@@ -222,8 +342,6 @@ protected:
 	//! Octree min fill indexes at 'm_gridLevel'
 	int m_minFillIndexes[3];
 
-	//! Neighbours coordinates shifts in grid
-	int neighboursIndexShift[CC_FM_NUMBER_OF_NEIGHBOURS];
 	//! Neighbours distance weight
 	float neighboursDistance[CC_FM_NUMBER_OF_NEIGHBOURS];
 
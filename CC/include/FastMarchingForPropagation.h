@@ -120,16 +120,10 @@ protected:
 	virtual float computeT(unsigned index);
 	virtual float computeTCoefApprox(Cell* currentCell, Cell* neighbourCell);
 	virtual int step();
-	virtual void addTrialCell(unsigned index, float T);
-	virtual unsigned getNearestTrialCell();
-	virtual bool instantiateGrid(unsigned size);
 
 	//! Compute the "biggest" (latest) front arrival time of the ACTIVE cells
 	void initLastT();
 
-	//! TRIAL cells list
-	std::vector<unsigned> trialCells;
-
 	//! Accceleration exageration factor
 	float jumpCoef;
 	//! Threshold for propagation stop
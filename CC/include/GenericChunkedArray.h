@@ -30,11 +30,13 @@ static const unsigned MAX_NUMBER_OF_ELEMENTS_PER_CHUNK = (1<<CHUNK_INDEX_BIT_DEC
 static const unsigned ELEMENT_INDEX_BIT_MASK = MAX_NUMBER_OF_ELEMENTS_PER_CHUNK-1;
 
 #include "CCShareable.h"
+#include "ChunkAllocator.h"
 
 //system
 #include <stdlib.h>
 #include <string.h>
 #include <vector>
+#include <algorithm>
 
 //! A generic array structure split in several small chunks to avoid the 'biggest contigous memory chunk' limit
 /** This very useful structure can be used to store n-uplets (n starting from 1) of scalar types (int, float, etc.)
@@ -80,12 +82,12 @@ public:
 	inline unsigned dim() const {return N;}
 
 	//! Returns memory (in bytes) currently used by this structure
-	inline unsigned memory() const
+	inline size_t memory() const
 	{
 		return sizeof(GenericChunkedArray) 
-				+ N*capacity()*sizeof(ElementType)
-				+ (unsigned)m_theChunks.capacity()*sizeof(ElementType*)
-				+ (unsigned)m_perChunkCount.capacity()*sizeof(unsigned);
+				+ static_cast<size_t>(N)*capacity()*sizeof(ElementType)
+				+ m_theChunks.capacity()*sizeof(ElementType*)
+				+ m_perChunkCount.capacity()*sizeof(unsigned);
 	}
 
 	//! Clears the array
@@ -97,7 +99,7 @@ public:
 		{
 			while (!m_theChunks.empty())
 			{
-				delete[] m_theChunks.back();
+				ChunkAllocator::Release(m_theChunks.back());
 				m_theChunks.pop_back();
 			}
 			m_perChunkCount.clear();
@@ -188,7 +190,10 @@ public:
 				newNumberOfElementsForThisChunk = freeSpaceInThisChunk;
 
 			//let's reallocate the chunk
-			void* newTable = realloc(m_theChunks.back(),(m_perChunkCount.back()+newNumberOfElementsForThisChunk)*N*sizeof(ElementType));
+			void* newTable = ChunkAllocator::Reallocate(m_theChunks.back(),
+													m_perChunkCount.back()*N*sizeof(ElementType),
+													(m_perChunkCount.back()+newNumberOfElementsForThisChunk)*N*sizeof(ElementType),
+													MAX_NUMBER_OF_ELEMENTS_PER_CHUNK*N*sizeof(ElementType));
 			//not enough memory?!
 			if (!newTable)
 			{
@@ -209,6 +214,26 @@ public:
 		return true;
 	}
 
+	//! Appends an already allocated (full) chunk
+	/** The array takes the ownership of the chunk (which must have been allocated
+		with ChunkAllocator, see ChunkAllocator::MapFileView for instance). This is
+		only possible if the last chunk (if any) is full. The new elements are
+		reserved but not 'inserted' (see GenericChunkedArray::resize).
+		\param chunk chunk of MAX_NUMBER_OF_ELEMENTS_PER_CHUNK elements
+		\return true if the method succeeds, false otherwise
+	**/
+	bool adoptChunk(ElementType* chunk)
+	{
+		if (!chunk || (!m_perChunkCount.empty() && m_perChunkCount.back() != MAX_NUMBER_OF_ELEMENTS_PER_CHUNK))
+			return false;
+
+		m_theChunks.push_back(chunk);
+		m_perChunkCount.push_back(MAX_NUMBER_OF_ELEMENTS_PER_CHUNK);
+		m_maxCount += MAX_NUMBER_OF_ELEMENTS_PER_CHUNK;
+
+		return true;
+	}
+
 	//! Resizes the array
 	/** The array is resized with the specified size. If the new size
 		is smaller, the overflooding elements will be deleted. If its greater,
@@ -258,7 +283,7 @@ public:
 				{
 					//simply remove the chunk
 					m_maxCount -= numberOfElementsForThisChunk;
-					delete m_theChunks.back();
+					ChunkAllocator::Release(m_theChunks.back());
 					m_theChunks.pop_back();
 					m_perChunkCount.pop_back();
 				}
@@ -268,8 +293,11 @@ public:
 					//we resize the chunk
 					numberOfElementsForThisChunk -= spaceToFree;
 					assert(numberOfElementsForThisChunk>0);
-					void* newTable = realloc(m_theChunks.back(),numberOfElementsForThisChunk*N*sizeof(ElementType));
-					//if 'realloc' failed?!
+					void* newTable = ChunkAllocator::Reallocate(m_theChunks.back(),
+																m_perChunkCount.back()*N*sizeof(ElementType),
+																numberOfElementsForThisChunk*N*sizeof(ElementType),
+																MAX_NUMBER_OF_ELEMENTS_PER_CHUNK*N*sizeof(ElementType));
+					//if the reallocation failed?!
 					if (!newTable)
 						return false;
 					m_theChunks.back() = (ElementType*)newTable;
@@ -397,16 +425,23 @@ public:
 		memcpy(m_minVal,getValue(0),sizeof(ElementType)*N);
 		memcpy(m_maxVal,m_minVal,sizeof(ElementType)*N);
 
-		//we update boundaries with all other values
-		for (unsigned i=1;i<m_count;++i)
+		//we update boundaries with all other values (chunk by chunk)
+		unsigned remaining = m_count;
+		for (unsigned c=0; c<m_theChunks.size() && remaining!=0; ++c)
 		{
-			const ElementType* val = getValue(i);
-			for (unsigned j=0;j<N;++j)
+			unsigned count = std::min(m_perChunkCount[c],remaining);
+			remaining -= count;
+
+			const ElementType* val = m_theChunks[c];
+			for (unsigned i=0;i<count;++i,val+=N)
 			{
-				if (val[j]<m_minVal[j])
-					m_minVal[j]=val[j];
-				else if (val[j]>m_maxVal[j])
-					m_maxVal[j]=val[j];
+				for (unsigned j=0;j<N;++j)
+				{
+					if (val[j]<m_minVal[j])
+						m_minVal[j]=val[j];
+					else if (val[j]>m_maxVal[j])
+						m_maxVal[j]=val[j];
+				}
 			}
 		}
 	}
@@ -439,7 +474,7 @@ public:
 	inline unsigned chunkSize(unsigned index) const { assert(index < m_theChunks.size()); return m_perChunkCount[index]; }
 
 	//! Returns the begining of a given chunk (pointer)
-	inline ElementType* chunkStartPtr(unsigned index) const { assert(index < m_theChunks.size()); return m_theChunks[index]; }
+	inline ElementType* chunkStartPtr(unsigned index) const { assert(index < m_theChunks.size()); ChunkAllocator::Touch(m_theChunks[index]); return m_theChunks[index]; }
 
 	//! Copy array data to another one
 	/** \param dest destination array (will be resize if necessary)
@@ -468,7 +503,7 @@ protected:
 	{
 		while (!m_theChunks.empty())
 		{
-			delete[] m_theChunks.back();
+			ChunkAllocator::Release(m_theChunks.back());
 			m_theChunks.pop_back();
 		}
 	}
@@ -532,12 +567,12 @@ public:
 	inline unsigned dim() const {return 1;}
 
 	//! Returns memory (in bytes) currently used by this structure
-	inline unsigned memory() const
+	inline size_t memory() const
 	{
 		return sizeof(GenericChunkedArray) 
-				+ capacity()*sizeof(ElementType)
-				+ (unsigned)m_theChunks.capacity()*sizeof(ElementType*)
-				+ (unsigned)m_perChunkCount.capacity()*sizeof(unsigned);
+				+ static_cast<size_t>(capacity())*sizeof(ElementType)
+				+ m_theChunks.capacity()*sizeof(ElementType*)
+				+ m_perChunkCount.capacity()*sizeof(unsigned);
 	}
 	//! Clears the array
 	/** \param releaseMemory whether memory should be released or not (for quicker "refill")
@@ -548,7 +583,7 @@ public:
 		{
 			while (!m_theChunks.empty())
 			{
-				delete[] m_theChunks.back();
+				ChunkAllocator::Release(m_theChunks.back());
 				m_theChunks.pop_back();
 			}
 			m_perChunkCount.clear();
@@ -637,7 +672,10 @@ public:
 				newNumberOfElementsForThisChunk = freeSpaceInThisChunk;
 
 			//let's reallocate the chunk
-			void* newTable = realloc(m_theChunks.back(),(m_perChunkCount.back()+newNumberOfElementsForThisChunk)*sizeof(ElementType));
+			void* newTable = ChunkAllocator::Reallocate(m_theChunks.back(),
+													m_perChunkCount.back()*sizeof(ElementType),
+													(m_perChunkCount.back()+newNumberOfElementsForThisChunk)*sizeof(ElementType),
+													MAX_NUMBER_OF_ELEMENTS_PER_CHUNK*sizeof(ElementType));
 			//not enough memory?!
 			if (!newTable)
 			{
@@ -658,6 +696,26 @@ public:
 		return true;
 	}
 
+	//! Appends an already allocated (full) chunk
+	/** The array takes the ownership of the chunk (which must have been allocated
+		with ChunkAllocator, see ChunkAllocator::MapFileView for instance). This is
+		only possible if the last chunk (if any) is full. The new elements are
+		reserved but not 'inserted' (see GenericChunkedArray::resize).
+		\param chunk chunk of MAX_NUMBER_OF_ELEMENTS_PER_CHUNK elements
+		\return true if the method succeeds, false otherwise
+	**/
+	bool adoptChunk(ElementType* chunk)
+	{
+		if (!chunk || (!m_perChunkCount.empty() && m_perChunkCount.back() != MAX_NUMBER_OF_ELEMENTS_PER_CHUNK))
+			return false;
+
+		m_theChunks.push_back(chunk);
+		m_perChunkCount.push_back(MAX_NUMBER_OF_ELEMENTS_PER_CHUNK);
+		m_maxCount += MAX_NUMBER_OF_ELEMENTS_PER_CHUNK;
+
+		return true;
+	}
+
 	//! Resizes the array
 	/** The array is resized with the specified size. If the new size
 		is smaller, the overflooding elements will be deleted. If its greater,
@@ -707,7 +765,7 @@ public:
 				{
 					//simply remove the chunk
 					m_maxCount -= numberOfElementsForThisChunk;
-					delete m_theChunks.back();
+					ChunkAllocator::Release(m_theChunks.back());
 					m_theChunks.pop_back();
 					m_perChunkCount.pop_back();
 				}
@@ -717,8 +775,11 @@ public:
 					//we resize the chunk
 					numberOfElementsForThisChunk -= spaceToFree;
 					assert(numberOfElementsForThisChunk>0);
-					void* newTable = realloc(m_theChunks.back(),numberOfElementsForThisChunk*sizeof(ElementType));
-					//if 'realloc' failed?!
+					void* newTable = ChunkAllocator::Reallocate(m_theChunks.back(),
+																m_perChunkCount.back()*sizeof(ElementType),
+																numberOfElementsForThisChunk*sizeof(ElementType),
+																MAX_NUMBER_OF_ELEMENTS_PER_CHUNK*sizeof(ElementType));
+					//if the reallocation failed?!
 					if (!newTable)
 						return false;
 					m_theChunks.back() = (ElementType*)newTable;
@@ -893,7 +954,7 @@ public:
 	inline unsigned chunkSize(unsigned index) const { assert(index < m_theChunks.size()); return m_perChunkCount[index]; }
 
 	//! Returns the begining of a given chunk (pointer)
-	inline ElementType* chunkStartPtr(unsigned index) const { assert(index < m_theChunks.size()); return m_theChunks[index]; }
+	inline ElementType* chunkStartPtr(unsigned index) const { assert(index < m_theChunks.size()); ChunkAllocator::Touch(m_theChunks[index]); return m_theChunks[index]; }
 
 	//! Copy array data to another one
 	/** \param dest destination array (will be resize if necessary)
@@ -922,7 +983,7 @@ protected:
 	{
 		while (!m_theChunks.empty())
 		{
-			delete[] m_theChunks.back();
+			ChunkAllocator::Release(m_theChunks.back());
 			m_theChunks.pop_back();
 		}
 	}
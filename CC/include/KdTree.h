@@ -36,6 +36,14 @@ namespace CCLib
 {
 
 //!A Kd Tree Class which implements functions related to point to point distance
+/** The tree is stored in a 'flat' way: its nodes are contiguous (depth-first
+	order) and the points are copied in tree order, so that the points of each
+	leaf ('bucket' of up to 8 points) are contiguous in memory. Each node is
+	split at the median of its largest dimension (std::nth_element) and its
+	subtrees are built in parallel if possible.
+	Once built, the tree is read-only: all queries can be called concurrently.
+	The 'batched' versions process a whole set of query points (in parallel).
+**/
 #ifdef CC_USE_AS_DLL
 #include "CloudCompareDll.h"
 
@@ -73,12 +81,12 @@ public:
     **/
     bool findNearestNeighbour(const PointCoordinateType *queryPoint,
                                 unsigned &nearestPointIndex,
-                                PointCoordinateType maxDist);
+                                PointCoordinateType maxDist) const;
 
 
     //! Optimized version of nearest point research which only check if there is a point p int the tree such that ||p-queryPoint||<=maxDist (see FindNearestNeighbour())
     bool findPointBelowDistance(const PointCoordinateType *queryPoint,
-									PointCoordinateType maxDist);
+									PointCoordinateType maxDist) const;
 
 
     //! Searches for the points that lie to a given distance (up to a tolerance) from a query point
@@ -92,41 +100,90 @@ public:
     unsigned findPointsLyingToDistance(const PointCoordinateType *queryPoint,
 										PointCoordinateType distance,
 										PointCoordinateType tolerance,
-										std::vector<unsigned> &points);
+										std::vector<unsigned> &points) const;
+
+    //! K nearest neighbours search
+    /** \param queryPoint query point coordinates
+        \param k number of neighbours
+        \param points [out] indexes of the (at most k) nearest points, sorted by increasing distance
+        \param squareDists [out] corresponding squared distances (optional)
+        \param maxDist distance above which the function doesn't consider points (-1 = no limit)
+        \return the number of neighbours found
+    **/
+    unsigned findKNearestNeighbours(const PointCoordinateType *queryPoint,
+									unsigned k,
+									std::vector<unsigned> &points,
+									std::vector<ScalarType>* squareDists = 0,
+									PointCoordinateType maxDist = -1) const;
+
+    //! Searches for the points inside a sphere
+    /** \param queryPoint sphere center
+        \param radius sphere radius
+        \param points [out] array of point indexes (appended)
+        \return the number of points inside the sphere
+    **/
+    unsigned findPointsInSphere(const PointCoordinateType *queryPoint,
+								PointCoordinateType radius,
+								std::vector<unsigned> &points) const;
+
+	/*** Batched queries ***/
+
+    //! Nearest neighbour search for a set of query points
+    /** \param queryCloud query points
+        \param nearestPointIndexes [out] index of the nearest point for each query point (-1 if none is below maxDist)
+        \param maxDist distance above which the function doesn't consider points (-1 = no limit)
+        \param squareDists [out] corresponding squared distances (optional - -1 if no point is found)
+        \param multiThread whether to use parallel processing or not
+        \return success
+    **/
+    bool findNearestNeighbours(GenericIndexedCloud* queryCloud,
+								std::vector<int>& nearestPointIndexes,
+								PointCoordinateType maxDist = -1,
+								std::vector<ScalarType>* squareDists = 0,
+								bool multiThread = true) const;
+
+    //! K nearest neighbours search for a set of query points
+    /** \param queryCloud query points
+        \param k number of neighbours (should be lower than the number of points in the tree)
+        \param neighbours [out] indexes of the k nearest points of each query point (i.e. k consecutive values per query point, sorted by increasing distance)
+        \param squareDists [out] corresponding squared distances (optional)
+        \param multiThread whether to use parallel processing or not
+        \return success
+    **/
+    bool findKNearestNeighbours(GenericIndexedCloud* queryCloud,
+								unsigned k,
+								std::vector<unsigned>& neighbours,
+								std::vector<ScalarType>* squareDists = 0,
+								bool multiThread = true) const;
+
+    //! Searches for the points inside a sphere around each query point
+    /** \param queryCloud query points (sphere centers)
+        \param radius spheres radius
+        \param neighbours [out] indexes of the points inside the sphere of each query point
+        \param multiThread whether to use parallel processing or not
+        \return success
+    **/
+    bool findPointsInSpheres(GenericIndexedCloud* queryCloud,
+								PointCoordinateType radius,
+								std::vector< std::vector<unsigned> >& neighbours,
+								bool multiThread = true) const;
 
 protected:
 
-    //! A KDTre cell struct
-    typedef struct kd_cell
+    //! A KDTree node
+    /** Inner nodes have two children: the first one is always the next node.
+    **/
+    struct KdNode
     {
-        //!Inside bounding box max point (the inside bounding box is the smallest cube containing all the points in the cell)
-        CCVector3 inbbmax;
-        //!Inside bounding box min point (the inside bounding box is the smallest cube containing all the points in the cell)
-        CCVector3 inbbmin;
-        //!Outside bounding box min point (the outside bounding box is the bigest cube contained inside the cutting planes that lead to the cell)
-        CCVector3 outbbmin;
-        //!Outside bounding box max point (the outside bounding box is the bigest cube contained inside the cutting planes that lead to the cell)
-        CCVector3 outbbmax;
-        //!mask to know if the outside box is bounded for a given dimmension
-        /**if boundsMask & (2^d) then outbbmin.u[d] is bounded (else the box is opened in outmin.u[d] - i.e. outbbmin.u[d] = -infinite)
-        if boundsmask & (2^(3+d)) then outbbmax.u[d] is bounded (else the box is opened in outmax.u[d] - i.e. outbbmax.u[d] = infinite)*/
-        unsigned char boundsMask;
-        //!Dimension (0, 1 or 2 for x, y or z) which is used to separate the two sons
-        unsigned cuttingDim;
-        //!Place where the space is cut into two sub-spaces (sons)
-        PointCoordinateType cuttingCoordinate;
-        //!Each point p which lie in leSon is such as p[cuttingDim] <= cuttingCoordinate
-        struct kd_cell* leSon;
-        //!Each point p which lie in gSon is such as p[cuttingDim] > cuttingCoordinate
-        struct kd_cell* gSon;
-        //!To go up in the tree
-        struct kd_cell* father;
-        //!Index of the first element that belongs to this cell
-        unsigned startingPointIndex;
-        //!Number of elements in this cell
-        unsigned nbPoints;
-    } KdCell;
-
+        //!Inside bounding box min point (the inside bounding box is the smallest box containing all the points in the node)
+        PointCoordinateType inbbmin[3];
+        //!Inside bounding box max point
+        PointCoordinateType inbbmax[3];
+        //!Index of the second child (inner nodes) or of the first point (leaves)
+        unsigned index;
+        //!Number of points (leaves only - 0 for inner nodes)
+        unsigned count;
+    };
 
     //! Structure to link a point and its index
     typedef struct
@@ -137,123 +194,66 @@ protected:
         CCVector3 point; //DGM (02/10/2011): has to be a copy now, as it is not compatible with parallel strategies or 'light' interaction with client db
     } PointAndIndex;
 
+    //! Sub-tree building job
+    struct BuildJob;
 
     /*** Protected attributes ***/
 
-    //! Tree root
-    KdCell *m_root;
-    //! Point m_indexes
+    //! Nodes (depth-first order - the first one is the root)
+    std::vector<KdNode> m_nodes;
+    //! Points (tree order)
+    std::vector<CCVector3> m_points;
+    //! Original index of each point (tree order)
     std::vector<unsigned> m_indexes;
-    //! Array
-    std::vector<PointAndIndex> m_list;
     //! Associated cloud
     GenericIndexedCloud *associatedCloud;
-    //! Number of cells
-    unsigned m_cellCount;
-
 
     /*** Protected methods ***/
 
     //! Builds a sub tree
-    /** \param first first index
-        \param last last index
-        \param father father cell
-        \param nbBuildCell nbBuildCell
-		\param progressCb the client method can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
-		\return sub tree (cell)
-    **/
-    KdCell* buildSubTree(unsigned first, unsigned last, KdCell *father, unsigned &nbBuildCell, GenericProgressCallback *progressCb = 0);
-
-    //! Deletes a sub tree
-    void deleteSubTree(KdCell *cell);
-
-
-    //! Computes a cell inside bounding box using the sons ones. The sons bounding boxes have to be up to date considering the points they contain.
-    void updateInsideBoundingBox(KdCell* cell);
-
-
-    //! Computes a cell outside bounding box using the father one and the cutting plane.
-    void updateOutsideBoundingBox(KdCell *cell);
-
-
-    //! Computes the distance between a point and a cell inside bounding box
-    /** \param queryPoint queryPoint coordinates
-        \param cell the cell from which we want to compute the distance
-        \return 0 if the point is inside the cell, the suare of the distance bewteen the two elements if the point is outside
-    **/
-    ScalarType pointToCellSquareDistance(const PointCoordinateType *queryPoint, KdCell *cell);
-
-
-    //! Computes the distance between a point and the outside bounding box of the cell in which it lies.
-    /** \param queryPoint the query point coordinates
-        \param cell the cell containting the query point
-        \return the distance between the point and the cell border. If this value is negative, it means that the cell has no border.
-    **/
-    ScalarType InsidePointToCellDistance(const PointCoordinateType *queryPoint, KdCell *cell);
-
-    //! Computes the distances (min & max) between a point and a cell inside bounding box
-    /** \param queryPoint the query point coordinates
-        \param cell the cell from which we want to compute the distance
-        \param min [out] the minimal distance between the query point and the inside bounding box of cell
-        \param max [out] the maximal distance between the query point and the inside bounding box of cell
-    **/
-    void pointToCellDistances(const PointCoordinateType *queryPoint, KdCell *cell, ScalarType &min, ScalarType &max);
-
-
-    //! Checks if there is a point in KdCell that is less than minDist-appart from the query point, starting from cell cell
-    /** \param queryPoint the query Point coordinates
-        \param maxSqrDist square of the maximal distance from querypoint
-        \param cell kdtree-cell from which to start the research
-        \return -1 if there is no nearer point from querypoint. The nearest point index found in cell if there is one that is at most maxdist appart from querypoint
+    /** The sub tree nodes are appended to 'nodes' (without any offset).
+        \param list points
+        \param first first point index
+        \param count number of points
+        \param nodes nodes container
+        \param jobs if not null, the sub trees below 'jobDepth' are not built but pushed in this container instead
+        \param jobDepth depth at which to stop (if jobs is not null)
     **/
-    int checkNearerPointInSubTree(const PointCoordinateType *queryPoint, ScalarType& maxSqrDist, KdCell *cell);
-
-
-    //! Checks if there is a point in KdCell that is less than minDist-appart from the query point, starting from cell cell
-    /** Optimiszed version of CheckNearerPointInSubTree since we don't want to find the nearest point, but only check if there is a point that is close enough
-        \param queryPoint the query Point coordinates
-        \param maxSqrDist square of the maximal distance from querypoint
-        \param cell kdtree-cell from which to start the research
-        \return true if there is a point in the subtree starting at cell that is close enough from the query point
+    static void BuildSubTree(std::vector<PointAndIndex>& list,
+								unsigned first,
+								unsigned count,
+								std::vector<KdNode>& nodes,
+								std::vector<BuildJob>* jobs = 0,
+								unsigned jobDepth = 0);
+
+    //! Builds the sub tree of a job
+    static void BuildJobSubTree(BuildJob& job);
+
+    //! Copies the top nodes and the jobs sub trees in depth-first order
+    static void MergeNodes(const std::vector<KdNode>& topNodes, unsigned topIndex, const std::vector<BuildJob>& jobs, std::vector<KdNode>& nodes);
+
+    //! Computes the squared distance between a point and a node inside bounding box (0 if the point is inside)
+    static inline PointCoordinateType PointToNodeSquareDistance(const PointCoordinateType *queryPoint, const KdNode& node);
+
+    //! Computes the squared distance between a point and the farthest corner of a node inside bounding box
+    static inline PointCoordinateType PointToNodeMaxSquareDistance(const PointCoordinateType *queryPoint, const KdNode& node);
+
+    //! Nearest neighbour search (internal version)
+    /** \param queryPoint query point
+        \param maxSquareDist [in/out] squared max search distance (as input) and squared distance to the nearest point (as output)
+        \param anyPoint stops as soon as one point is found below the max distance
+        \return tree position of the nearest point (or -1)
     **/
-    bool checkDistantPointInSubTree(const PointCoordinateType *queryPoint, ScalarType &maxSqrDist, KdCell *cell);
-
+    int nearestNeighbour(const PointCoordinateType *queryPoint, PointCoordinateType& maxSquareDist, bool anyPoint) const;
 
-    //! Recursive function which store every point lying to a given distance from the query point
-    /** \param queryPoint the query point coordinates
-        \param distance the wished distance from the query point
-        \param tolerance tolerance for resulting points : p is in resulting array if ||p-queryPoint||<=tolerance
-        \param cell current cell to explore (used for recursion)
-        \param[out] localArray output of the algorithm. Resulting points m_indexes in associatedCloud are stored in this array
+    //! K nearest neighbours search (internal version)
+    /** \param queryPoint query point
+        \param k number of neighbours
+        \param maxSquareDist squared max search distance
+        \param heap [out] (tree position, squared distance) of the neighbours, sorted by increasing distance
     **/
-    void distanceScanTree(const PointCoordinateType *queryPoint, 
-							ScalarType distance, 
-							ScalarType tolerance, 
-							KdCell *cell, 
-							std::vector<unsigned> &localArray);
-
-
-    /*** Comparison functions used by the sort function (Strict ordering must be used) ***/
-
-    //! Compares X coordinates of two points designated by their index
-    static bool ComparisonX(const PointAndIndex &a, const PointAndIndex &b)
-    {
-        return (a.point.x<b.point.x);
-    }
-
-    //! Compares Y coordinates of two points designated by their index
-    static bool ComparisonY(const PointAndIndex &a, const PointAndIndex &b)
-    {
-        return (a.point.y<b.point.y);
-    }
-
-    //! Compares Z coordinates of two points designated by their index
-    static bool ComparisonZ(const PointAndIndex &a, const PointAndIndex &b)
-    {
-        return (a.point.z<b.point.z);
-    }
+    void kNearestNeighbours(const PointCoordinateType *queryPoint, unsigned k, PointCoordinateType maxSquareDist, std::vector< std::pair<PointCoordinateType,unsigned> >& heap) const;
 };
-
 }
 
 #endif //KD_TREE_HEADER
@@ -21,6 +21,10 @@
 #include "CCToolbox.h"
 #include "CCTypes.h"
 #include "CCGeom.h"
+#include "GenericChunkedArray.h"
+
+//system
+#include <vector>
 
 namespace CCLib
 {
@@ -31,6 +35,8 @@ class GenericIndexedMesh;
 class GenericProgressCallback;
 class ReferenceCloud;
 class Polyline;
+class ChunkedPointCloud;
+class DgmOctree;
 
 //! Manual segmentation algorithms (inside/outside a polyline, etc.)
 
@@ -75,6 +81,51 @@ public:
 	**/
 	static bool isPointInsidePoly(const CCVector2& P, const Polyline* poly);
 
+	//! Tests if a point is inside a polyline (given by its vertices)
+	/** Same test as the Polyline based version.
+		\param P a 2D point
+		\param polyVertices the polyline vertices
+		\return true if P is inside the polyline
+	**/
+	static bool isPointInsidePoly(const CCVector2& P, const std::vector<CCVector2>& polyVertices);
+
+	//! Per-point visibility states (see CCConst.h)
+	typedef GenericChunkedArray<1,uchar> VisibilityTableType;
+
+	//! Segments a cloud with a 2D polyline drawn on screen (batch version)
+	/** Gives the same result as projecting each point with gluProject and
+		testing it with isPointInsidePoly, but much faster on big clouds:
+		- the polyline is rasterized once in a screen-space mask, so that the
+		  inside test is a simple lookup (the exact test is only used for the
+		  points falling in the pixels crossed by the polyline);
+		- points are projected by blocks of 4 (SSE) and the cloud chunks are
+		  processed in parallel;
+		- if an octree is provided, its cells that project entirely inside or
+		  outside of the polyline are classified at once (the cells are then
+		  processed in parallel instead of the chunks).
+		Only the points flagged as POINT_VISIBLE are tested. Those that are
+		rejected are flagged as POINT_HIDDEN.
+		\param cloud cloud to segment
+		\param visibility points visibility (same size as the cloud)
+		\param poly polyline (in pixels, relatively to 'polyOrigin')
+		\param keepInside whether the points inside (or outside) of the polyline should remain visible
+		\param modelViewMat model view matrix (OpenGL style, column major)
+		\param projectionMat projection matrix (OpenGL style, column major)
+		\param viewport viewport (OpenGL style: x, y, width, height)
+		\param polyOrigin position of the polyline origin on screen (in pixels)
+		\param octree the cloud octree (optional - must be up to date)
+		\return false if not enough memory (the visibility array is left untouched in this case)
+	**/
+	static bool segmentWithScreenPolyline(	ChunkedPointCloud* cloud,
+											VisibilityTableType* visibility,
+											const Polyline* poly,
+											bool keepInside,
+											const double* modelViewMat,
+											const double* projectionMat,
+											const int* viewport,
+											const CCVector2& polyOrigin,
+											const DgmOctree* octree=0);
+
 	//! Segments a mesh knowing which vertices should be kept or not
 	/** This method takes as input a set of vertex indexes and creates a new mesh
 		composed either of the triangles that have exactly those vertices as
@@ -0,0 +1,173 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef TRIANGLE_BVH_HEADER
+#define TRIANGLE_BVH_HEADER
+
+#ifdef _MSC_VER
+//To get rid of the really annoying warnings about template class exportation
+#pragma warning( disable: 4251 )
+#pragma warning( disable: 4530 )
+#endif
+
+#include "CCGeom.h"
+#include "SimpleTriangle.h"
+
+//system
+#include <vector>
+
+namespace CCLib
+{
+
+class GenericIndexedMesh;
+class GenericProgressCallback;
+
+//! Bounding Volume Hierarchy over the triangles of a mesh
+/** The hierarchy is built with the Surface Area Heuristic (SAH, binned version).
+	Leaves hold up to 4 triangles, stored as a 'packet' so that the 4 point-triangle
+	distances can be computed at once (with SSE instructions if available).
+	Once built, the structure is read-only: it can be queried concurrently (each
+	thread with its own NearestTriangleSearchStruct).
+**/
+#ifdef CC_USE_AS_DLL
+#include "CloudCompareDll.h"
+
+class CC_DLL_API TriangleBVH
+#else
+class TriangleBVH
+#endif
+{
+public:
+
+	//! Default constructor
+	TriangleBVH();
+
+	//! Destructor
+	virtual ~TriangleBVH();
+
+	//! Builds the hierarchy
+	/** \param mesh the mesh from which to build the hierarchy
+		\param progressCb the client method can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return success
+	**/
+	bool build(GenericIndexedMesh* mesh, GenericProgressCallback* progressCb = 0);
+
+	//! Clears the structure
+	void clear();
+
+	//! Returns the number of (indexed) triangles
+	unsigned size() const { return m_triangleCount; }
+
+	//! Nearest triangle search structure
+	/** Consecutive queries should be close to each other: the leaf of the last
+		nearest triangle is tested first (which gives a good initial bound).
+	**/
+	struct NearestTriangleSearchStruct
+	{
+		//! Query point
+		CCVector3 queryPoint;
+		//! Max search (squared) distance (set to -1 to deactivate)
+		ScalarType maxSearchSquareDist;
+
+		//! [out] Index of the nearest triangle (in the original mesh)
+		unsigned nearestTriangleIndex;
+		//! [out] (Approximate) squared distance to the nearest triangle
+		/** Computed with single precision (see DistanceComputationTools::computePoint2TriangleDistance
+			for an accurate one).
+		**/
+		ScalarType squareDist;
+
+		//! Leaf of the last nearest triangle (or -1)
+		int lastLeaf;
+		//! Traversal stack (to avoid reallocating it at each query)
+		std::vector<unsigned> stack;
+
+		//! Default constructor
+		NearestTriangleSearchStruct()
+			: maxSearchSquareDist(-1.0)
+			, nearestTriangleIndex(0)
+			, squareDist(-1.0)
+			, lastLeaf(-1)
+		{}
+	};
+
+	//! Searches for the nearest triangle of a given point
+	/** \param nTSS search parameters and result
+		\return whether a triangle has been found (below nTSS.maxSearchSquareDist if defined)
+	**/
+	bool findNearestTriangle(NearestTriangleSearchStruct& nTSS) const;
+
+	//! Returns a given triangle (by its index in the original mesh)
+	/** Warning: the triangle summits are only valid as long as the structure is not modified.
+	**/
+	SimpleRefTriangle getTriangle(unsigned triangleIndex) const;
+
+protected:
+
+	//! Hierarchy node
+	struct Node
+	{
+		//! Bounding box min corner
+		PointCoordinateType bbMin[3];
+		//! Bounding box max corner
+		PointCoordinateType bbMax[3];
+		//! Right child index (inner nodes - the left one is always the next node) or packet index (leaves)
+		unsigned index;
+		//! Number of triangles (0 for inner nodes)
+		unsigned count;
+	};
+
+	//! Packet of 4 triangles (leaf content)
+	/** 'Structure of arrays' layout. Missing triangles are replaced by copies of the
+		first one. Degenerate triangles have a null 'face' mask (only their edges are used).
+	**/
+	struct TrianglePacket
+	{
+		float ax[4],ay[4],az[4];		//A
+		float e0x[4],e0y[4],e0z[4];		//AB
+		float e1x[4],e1y[4],e1z[4];		//AC
+		float e2x[4],e2y[4],e2z[4];		//BC
+		float nx[4],ny[4],nz[4];		//unit normal
+		float invE0[4],invE1[4],invE2[4];	//inverse squared edges length (or 0)
+		float d00[4],d01[4],d11[4];		//AB.AB, AB.AC and AC.AC
+		float invDenom[4];				//1/(d00*d11-d01*d01)
+		float faceMask[4];				//all bits set for non degenerate triangles
+	};
+
+	//! Computes the squared distances between a point and the 4 triangles of a packet
+	static void ComputeSquareDistances(const TrianglePacket& packet, const CCVector3& P, float dist2[4]);
+
+	//! Tests the triangles of a leaf
+	inline void testLeaf(unsigned leafIndex, const CCVector3& P, float& minDist2, int& bestSlot, int& bestLeaf) const;
+
+	//! Nodes (depth-first order)
+	std::vector<Node> m_nodes;
+	//! Triangle packets
+	std::vector<TrianglePacket> m_packets;
+	//! Triangles summits (3 per packet 'slot')
+	std::vector<CCVector3> m_summits;
+	//! Original index of each packet 'slot'
+	std::vector<unsigned> m_slotToTriangle;
+	//! Packet 'slot' of each triangle (reverse of m_slotToTriangle)
+	std::vector<unsigned> m_triangleToSlot;
+	//! Number of triangles
+	unsigned m_triangleCount;
+};
+
+}
+
+#endif //TRIANGLE_BVH_HEADER
@@ -0,0 +1,673 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifdef _MSC_VER
+//To get rid of the really annoying warnings about template class exportation
+#pragma warning( disable: 4530 )
+#endif
+
+#include "ChunkAllocator.h"
+
+//system
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <map>
+#include <list>
+#include <vector>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
+
+QAtomicInt ChunkAllocator::s_hasMappedChunks(0);
+QAtomicPointer<const void> ChunkAllocator::s_lastTouchedChunk(0);
+
+//! Memory-mapped chunk descriptor
+struct MappedChunk
+{
+	//! Chunk types
+	enum Type {	SCRATCH,	/**< chunk backed by the scratch file (subject to the LRU budget) **/
+				FILE_VIEW,	/**< copy-on-write view of an existing file **/
+				ANONYMOUS	/**< detached file view (anonymous memory) **/
+	};
+
+	//! Chunk type
+	Type type;
+	//! Mapping size (in bytes)
+	size_t size;
+	//! Whether the chunk is currently considered as resident
+	bool resident;
+	//! Position in the LRU list (if resident)
+	std::list<const void*>::iterator lruIt;
+#ifdef _WIN32
+	//! Scratch file handle (one per chunk, deleted on close - SCRATCH only)
+	HANDLE file;
+	//! File mapping handle
+	HANDLE mapping;
+	//! Offset in the viewed file (FILE_VIEW only)
+	ULONGLONG viewOffset;
+#else
+	//! Offset in the (shared) scratch file (SCRATCH) or in the viewed file (FILE_VIEW)
+	off_t offset;
+#endif
+	//! Viewed file identifier (FILE_VIEW only)
+	/** See GetFileId.
+	**/
+	unsigned long long fileId[2];
+};
+
+//! Allocator state (all protected by s_mutex)
+static bool s_enabled = false;
+static size_t s_residentBudget = 0;
+static size_t s_minChunkSize = 0;
+static std::string s_scratchDir;
+static std::map<const void*,MappedChunk> s_mappedChunks;
+//! Resident chunks (most recently used first)
+static std::list<const void*> s_lru;
+static size_t s_residentSize = 0;
+//! Number of chunks backed by the scratch file
+static unsigned s_scratchChunksCount = 0;
+
+#ifdef _WIN32
+static CRITICAL_SECTION s_mutex;
+//! Initializes s_mutex at load time
+static struct MutexInitializer
+{
+	MutexInitializer() { InitializeCriticalSection(&s_mutex); }
+	~MutexInitializer() { DeleteCriticalSection(&s_mutex); }
+} s_mutexInitializer;
+#else
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+//! Scratch file (shared by all chunks, slots are recycled)
+static int s_scratchFile = -1;
+static off_t s_scratchFileSize = 0;
+//! Free slots in the scratch file (size --> offset)
+static std::multimap<size_t,off_t> s_freeSlots;
+#endif
+
+//! Scoped lock on the allocator state
+class AllocatorLock
+{
+public:
+	//! Default constructor
+	/** \param tryOnly if true, the lock is only acquired if it is immediately available (see isLocked)
+	**/
+	AllocatorLock(bool tryOnly = false)
+	{
+#ifdef _WIN32
+		if (tryOnly)
+			m_locked = (TryEnterCriticalSection(&s_mutex) != 0);
+		else
+			EnterCriticalSection(&s_mutex);
+#else
+		if (tryOnly)
+			m_locked = (pthread_mutex_trylock(&s_mutex) == 0);
+		else
+			pthread_mutex_lock(&s_mutex);
+#endif
+		if (!tryOnly)
+			m_locked = true;
+	}
+	~AllocatorLock()
+	{
+		if (!m_locked)
+			return;
+#ifdef _WIN32
+		LeaveCriticalSection(&s_mutex);
+#else
+		pthread_mutex_unlock(&s_mutex);
+#endif
+	}
+	//! Returns whether the lock has been acquired
+	bool isLocked() const { return m_locked; }
+
+protected:
+	bool m_locked;
+};
+
+//! Rounds a size up to the system page size
+static size_t RoundToPageSize(size_t size)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	size_t pageSize = (size_t)info.dwAllocationGranularity;
+#else
+	size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+	return ((size + pageSize - 1) / pageSize) * pageSize;
+}
+
+//! Retrieves a unique identifier for an opened file (device/volume + inode/file index)
+#ifdef _WIN32
+static bool GetFileId(HANDLE file, unsigned long long fileId[2])
+{
+	BY_HANDLE_FILE_INFORMATION info;
+	if (!GetFileInformationByHandle(file,&info))
+		return false;
+	fileId[0] = (unsigned long long)info.dwVolumeSerialNumber;
+	fileId[1] = ((unsigned long long)info.nFileIndexHigh << 32) | (unsigned long long)info.nFileIndexLow;
+	return true;
+}
+#else
+static bool GetFileId(int fileDescriptor, unsigned long long fileId[2])
+{
+	struct stat info;
+	if (fstat(fileDescriptor,&info) != 0)
+		return false;
+	fileId[0] = (unsigned long long)info.st_dev;
+	fileId[1] = (unsigned long long)info.st_ino;
+	return true;
+}
+#endif
+
+//! Releases a chunk from memory (its content is kept in the scratch file)
+static void Evict(const void* chunk, MappedChunk& desc)
+{
+	assert(desc.resident);
+	void* ptr = const_cast<void*>(chunk);
+#ifdef _WIN32
+	FlushViewOfFile(ptr,desc.size);
+	//unlocking pages that are not locked removes them from the working set
+	VirtualUnlock(ptr,desc.size);
+#else
+	//write dirty pages back to the scratch file so that they can be dropped
+	msync(ptr,desc.size,MS_SYNC);
+	madvise(ptr,desc.size,MADV_DONTNEED);
+#ifdef POSIX_FADV_DONTNEED
+	posix_fadvise(s_scratchFile,desc.offset,(off_t)desc.size,POSIX_FADV_DONTNEED);
+#endif
+#endif
+	s_lru.erase(desc.lruIt);
+	s_residentSize -= desc.size;
+	desc.resident = false;
+}
+
+//! Applies the LRU budget (the most recently used chunk is always kept)
+static void ApplyBudget()
+{
+	if (s_residentBudget == 0)
+		return;
+
+	while (s_residentSize > s_residentBudget && s_lru.size() > 1)
+	{
+		const void* victim = s_lru.back();
+		std::map<const void*,MappedChunk>::iterator it = s_mappedChunks.find(victim);
+		assert(it != s_mappedChunks.end());
+		Evict(victim,it->second);
+	}
+}
+
+//! Makes a chunk the most recently used one
+static void MarkAsUsed(const void* chunk, MappedChunk& desc)
+{
+	//only chunks backed by the scratch file can be evicted
+	if (desc.type != MappedChunk::SCRATCH)
+		return;
+
+	if (desc.resident)
+	{
+		//move it to the front
+		if (desc.lruIt != s_lru.begin())
+			s_lru.splice(s_lru.begin(),s_lru,desc.lruIt);
+	}
+	else
+	{
+		s_lru.push_front(chunk);
+		desc.lruIt = s_lru.begin();
+		desc.resident = true;
+		s_residentSize += desc.size;
+		ApplyBudget();
+	}
+}
+
+//! Maps a new chunk (must be called with the lock)
+static void* MapNewChunk(size_t size)
+{
+	size = RoundToPageSize(size);
+
+	MappedChunk desc;
+	desc.type = MappedChunk::SCRATCH;
+	desc.size = size;
+	desc.resident = false;
+	void* ptr = 0;
+
+#ifdef _WIN32
+	char tempDir[MAX_PATH];
+	if (s_scratchDir.empty())
+	{
+		if (GetTempPathA(MAX_PATH,tempDir) == 0)
+			return 0;
+	}
+	else
+	{
+		strncpy(tempDir,s_scratchDir.c_str(),MAX_PATH-1);
+		tempDir[MAX_PATH-1] = 0;
+	}
+	char tempFile[MAX_PATH];
+	if (GetTempFileNameA(tempDir,"ccc",0,tempFile) == 0)
+		return 0;
+
+	desc.file = CreateFileA(tempFile,GENERIC_READ|GENERIC_WRITE,0,0,CREATE_ALWAYS,FILE_ATTRIBUTE_TEMPORARY|FILE_FLAG_DELETE_ON_CLOSE,0);
+	if (desc.file == INVALID_HANDLE_VALUE)
+		return 0;
+
+	ULARGE_INTEGER mappingSize;
+	mappingSize.QuadPart = (ULONGLONG)size;
+	desc.mapping = CreateFileMappingA(desc.file,0,PAGE_READWRITE,mappingSize.HighPart,mappingSize.LowPart,0);
+	if (desc.mapping)
+		ptr = MapViewOfFile(desc.mapping,FILE_MAP_ALL_ACCESS,0,0,size);
+	if (!ptr)
+	{
+		if (desc.mapping)
+			CloseHandle(desc.mapping);
+		CloseHandle(desc.file);
+		return 0;
+	}
+#else
+	//open the scratch file if necessary
+	if (s_scratchFile < 0)
+	{
+		std::string path = s_scratchDir;
+		if (path.empty())
+		{
+			const char* tmpDir = getenv("TMPDIR");
+			path = (tmpDir ? tmpDir : "/tmp");
+		}
+		path += "/cc_chunks_XXXXXX";
+
+		std::vector<char> buffer(path.begin(),path.end());
+		buffer.push_back(0);
+		s_scratchFile = mkstemp(&(buffer[0]));
+		if (s_scratchFile < 0)
+			return 0;
+		//the file will be automatically deleted when closed
+		unlink(&(buffer[0]));
+		s_scratchFileSize = 0;
+	}
+
+	//recycle a free slot if possible
+	std::multimap<size_t,off_t>::iterator slot = s_freeSlots.find(size);
+	bool newSlot = (slot == s_freeSlots.end());
+	if (newSlot)
+	{
+		desc.offset = s_scratchFileSize;
+		if (ftruncate(s_scratchFile,s_scratchFileSize+(off_t)size) != 0)
+			return 0;
+	}
+	else
+	{
+		desc.offset = slot->second;
+	}
+
+	ptr = mmap(0,size,PROT_READ|PROT_WRITE,MAP_SHARED,s_scratchFile,desc.offset);
+	if (ptr == MAP_FAILED)
+	{
+		if (newSlot)
+			ftruncate(s_scratchFile,s_scratchFileSize);
+		return 0;
+	}
+
+	if (newSlot)
+		s_scratchFileSize += (off_t)size;
+	else
+		s_freeSlots.erase(slot);
+#endif
+
+	std::map<const void*,MappedChunk>::iterator it = s_mappedChunks.insert(std::make_pair((const void*)ptr,desc)).first;
+	++s_scratchChunksCount;
+	MarkAsUsed(ptr,it->second);
+
+	return ptr;
+}
+
+//! Unmaps a chunk (must be called with the lock)
+static void UnmapChunk(std::map<const void*,MappedChunk>::iterator it)
+{
+	void* ptr = const_cast<void*>(it->first);
+	MappedChunk& desc = it->second;
+
+	if (desc.resident)
+	{
+		s_lru.erase(desc.lruIt);
+		s_residentSize -= desc.size;
+	}
+
+	switch (desc.type)
+	{
+	case MappedChunk::SCRATCH:
+#ifdef _WIN32
+		UnmapViewOfFile(ptr);
+		CloseHandle(desc.mapping);
+		CloseHandle(desc.file); //the file is deleted at this point
+#else
+#ifdef MADV_REMOVE
+		//free the corresponding disk space
+		madvise(ptr,desc.size,MADV_REMOVE);
+#endif
+		munmap(ptr,desc.size);
+		s_freeSlots.insert(std::make_pair(desc.size,desc.offset));
+#endif
+		assert(s_scratchChunksCount != 0);
+		--s_scratchChunksCount;
+		break;
+
+	case MappedChunk::FILE_VIEW:
+#ifdef _WIN32
+		UnmapViewOfFile(ptr);
+		CloseHandle(desc.mapping);
+#else
+		munmap(ptr,desc.size);
+#endif
+		break;
+
+	case MappedChunk::ANONYMOUS:
+#ifdef _WIN32
+		VirtualFree(ptr,0,MEM_RELEASE);
+#else
+		munmap(ptr,desc.size);
+#endif
+		break;
+	}
+
+	s_mappedChunks.erase(it);
+
+#ifndef _WIN32
+	//no more chunk in the scratch file: we can close it
+	if (s_scratchChunksCount == 0 && !s_enabled && s_scratchFile >= 0)
+	{
+		close(s_scratchFile);
+		s_scratchFile = -1;
+		s_scratchFileSize = 0;
+		s_freeSlots.clear();
+	}
+#endif
+}
+
+bool ChunkAllocator::EnableFileMapping(const char* scratchDir/*=0*/, size_t residentBudget/*=0*/, size_t minChunkSize/*=(1<<18)*/)
+{
+	AllocatorLock lock;
+
+#ifndef _WIN32
+	//we keep using the current scratch file if chunks are still mapped
+	if (s_scratchFile < 0)
+#endif
+	{
+		s_scratchDir = (scratchDir ? scratchDir : "");
+	}
+	s_residentBudget = residentBudget;
+	s_minChunkSize = minChunkSize;
+	s_enabled = true;
+
+	ApplyBudget();
+	UpdateLastTouchedChunk();
+
+	return true;
+}
+
+void ChunkAllocator::DisableFileMapping()
+{
+	AllocatorLock lock;
+	s_enabled = false;
+}
+
+bool ChunkAllocator::IsFileMappingEnabled()
+{
+	AllocatorLock lock;
+	return s_enabled;
+}
+
+void ChunkAllocator::SetResidentBudget(size_t residentBudget)
+{
+	AllocatorLock lock;
+	s_residentBudget = residentBudget;
+	ApplyBudget();
+	UpdateLastTouchedChunk();
+}
+
+unsigned ChunkAllocator::MappedChunksCount()
+{
+	AllocatorLock lock;
+	return (unsigned)s_mappedChunks.size();
+}
+
+void* ChunkAllocator::Reallocate(void* chunk, size_t currentSize, size_t newSize, size_t maxSize)
+{
+	assert(newSize <= maxSize);
+
+	if (s_enabled || s_hasMappedChunks)
+	{
+		AllocatorLock lock;
+
+		//already mapped chunk?
+		if (chunk && s_hasMappedChunks)
+		{
+			std::map<const void*,MappedChunk>::iterator it = s_mappedChunks.find(chunk);
+			if (it != s_mappedChunks.end())
+			{
+				//the whole chunk capacity is already mapped
+				if (newSize <= it->second.size)
+				{
+					MarkAsUsed(chunk,it->second);
+					UpdateLastTouchedChunk();
+					return chunk;
+				}
+				assert(false);
+				return 0;
+			}
+		}
+
+		//big enough to be mapped?
+		if (s_enabled && newSize >= s_minChunkSize)
+		{
+			void* newChunk = MapNewChunk(maxSize);
+			if (newChunk)
+			{
+				s_hasMappedChunks.fetchAndStoreOrdered(1);
+				UpdateLastTouchedChunk();
+				if (chunk)
+				{
+					memcpy(newChunk,chunk,currentSize < newSize ? currentSize : newSize);
+					free(chunk);
+				}
+				return newChunk;
+			}
+			//otherwise we fall back to the standard allocation
+		}
+	}
+
+	return realloc(chunk,newSize);
+}
+
+void ChunkAllocator::Release(void* chunk)
+{
+	if (!chunk)
+		return;
+
+	if (s_hasMappedChunks)
+	{
+		AllocatorLock lock;
+		std::map<const void*,MappedChunk>::iterator it = s_mappedChunks.find(chunk);
+		if (it != s_mappedChunks.end())
+		{
+			UnmapChunk(it);
+			s_hasMappedChunks.fetchAndStoreOrdered(s_mappedChunks.empty() ? 0 : 1);
+			UpdateLastTouchedChunk();
+			return;
+		}
+	}
+
+	free(chunk);
+}
+
+void ChunkAllocator::UpdateLastTouchedChunk()
+{
+	s_lastTouchedChunk.fetchAndStoreOrdered(s_lru.empty() ? 0 : s_lru.front());
+}
+
+void ChunkAllocator::TouchMapped(const void* chunk)
+{
+	//we don't want to wait for another thread (the LRU is only a hint)
+	AllocatorLock lock(true);
+	if (!lock.isLocked())
+		return;
+
+	std::map<const void*,MappedChunk>::iterator it = s_mappedChunks.find(chunk);
+	if (it != s_mappedChunks.end())
+	{
+		MarkAsUsed(chunk,it->second);
+		UpdateLastTouchedChunk();
+	}
+}
+
+void* ChunkAllocator::MapFileView(int fileDescriptor, unsigned long long offset, size_t size)
+{
+	if (fileDescriptor < 0 || size == 0)
+		return 0;
+
+	MappedChunk desc;
+	desc.type = MappedChunk::FILE_VIEW;
+	desc.size = size;
+	desc.resident = false;
+	void* ptr = 0;
+
+#ifdef _WIN32
+	HANDLE file = (HANDLE)_get_osfhandle(fileDescriptor);
+	if (file == INVALID_HANDLE_VALUE || !GetFileId(file,desc.fileId))
+		return 0;
+	desc.file = 0;
+	desc.mapping = CreateFileMappingA(file,0,PAGE_WRITECOPY,0,0,0);
+	if (!desc.mapping)
+		return 0;
+	desc.viewOffset = (ULONGLONG)offset;
+	ULARGE_INTEGER _offset;
+	_offset.QuadPart = desc.viewOffset;
+	ptr = MapViewOfFile(desc.mapping,FILE_MAP_COPY,_offset.HighPart,_offset.LowPart,size);
+	if (!ptr)
+	{
+		CloseHandle(desc.mapping);
+		return 0;
+	}
+#else
+	if (!GetFileId(fileDescriptor,desc.fileId))
+		return 0;
+	desc.offset = (off_t)offset;
+	if ((unsigned long long)desc.offset != offset)
+		return 0;
+	ptr = mmap(0,size,PROT_READ|PROT_WRITE,MAP_PRIVATE,fileDescriptor,desc.offset);
+	if (ptr == MAP_FAILED)
+		return 0;
+#endif
+
+	AllocatorLock lock;
+	s_mappedChunks.insert(std::make_pair((const void*)ptr,desc));
+	s_hasMappedChunks.fetchAndStoreOrdered(1);
+
+	return ptr;
+}
+
+bool ChunkAllocator::DetachFileViews(const char* filename)
+{
+	if (!filename)
+		return false;
+
+	//retrieve the file identifier (if the file doesn't exist, it can't be mapped!)
+	unsigned long long fileId[2];
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename,0,FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,0,OPEN_EXISTING,FILE_FLAG_BACKUP_SEMANTICS,0);
+	if (file == INVALID_HANDLE_VALUE)
+		return true;
+	bool validId = GetFileId(file,fileId);
+	CloseHandle(file);
+#else
+	int file = open(filename,O_RDONLY);
+	if (file < 0)
+		return true;
+	bool validId = GetFileId(file,fileId);
+	close(file);
+#endif
+	if (!validId)
+		return false;
+
+	AllocatorLock lock;
+
+	bool success = true;
+	for (std::map<const void*,MappedChunk>::iterator it = s_mappedChunks.begin(); it != s_mappedChunks.end(); ++it)
+	{
+		MappedChunk& desc = it->second;
+		if (desc.type != MappedChunk::FILE_VIEW || desc.fileId[0] != fileId[0] || desc.fileId[1] != fileId[1])
+			continue;
+
+		void* ptr = const_cast<void*>(it->first);
+		void* buffer = malloc(desc.size);
+		if (!buffer)
+		{
+			success = false;
+			continue;
+		}
+		memcpy(buffer,ptr,desc.size);
+
+#ifdef _WIN32
+		//we must release the view before allocating memory at the same address
+		UnmapViewOfFile(ptr);
+		void* newPtr = VirtualAlloc(ptr,desc.size,MEM_RESERVE|MEM_COMMIT,PAGE_READWRITE);
+		if (newPtr != ptr)
+		{
+			if (newPtr)
+				VirtualFree(newPtr,0,MEM_RELEASE);
+			//we restore the original view (so that the chunk remains valid)
+			ULARGE_INTEGER _offset;
+			_offset.QuadPart = desc.viewOffset;
+			newPtr = MapViewOfFileEx(desc.mapping,FILE_MAP_COPY,_offset.HighPart,_offset.LowPart,desc.size,ptr);
+			//the address range has been taken in the meantime?!
+			assert(newPtr == ptr);
+			if (newPtr == ptr)
+				memcpy(ptr,buffer,desc.size); //restore the modified (copy-on-write) pages as well
+			free(buffer);
+			success = false;
+			continue;
+		}
+		CloseHandle(desc.mapping);
+		desc.mapping = 0;
+#else
+		//replace the view by anonymous memory (at the same address)
+		//(with MAP_FIXED the original view is only replaced if the call succeeds)
+		void* newPtr = mmap(ptr,desc.size,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED,-1,0);
+		if (newPtr != ptr)
+		{
+			free(buffer);
+			success = false;
+			continue;
+		}
+#endif
+		memcpy(ptr,buffer,desc.size);
+		free(buffer);
+		desc.type = MappedChunk::ANONYMOUS;
+	}
+
+	return success;
+}
@@ -19,6 +19,7 @@
 
 //local
 #include "ScalarField.h"
+#include "SSEHelper.h"
 
 //system
 #include <string.h>
@@ -71,7 +72,64 @@ void ChunkedPointCloud::getBoundingBox(PointCoordinateType bbMin[], PointCoordin
 {
 	if (!m_validBB)
 	{
-		m_points->computeMinAndMax();
+#ifdef CC_USE_SSE_KERNELS
+		unsigned count = size();
+		if (count != 0)
+		{
+			//accumulators (with "rotated" components, see SSEHelper.h)
+			const PointCoordinateType* P0 = point(0)->u;
+			__m128 minA,minB,minC;
+			SSE_SetRotated(P0[0],P0[1],P0[2],minA,minB,minC);
+			__m128 maxA = minA, maxB = minB, maxC = minC;
+			CCVector3 bbMinS(P0), bbMaxS(P0);
+
+			for (unsigned ci=0; ci<pointsChunksCount(); ++ci)
+			{
+				unsigned chunkCount = pointsChunkSize(ci);
+				const PointCoordinateType* P = pointsChunkStartPtr(ci);
+
+				unsigned i=0;
+				for (; i+4<=chunkCount; i+=4, P+=12)
+				{
+					__m128 a,b,c;
+					SSE_Load4Points(P,a,b,c);
+					minA = _mm_min_ps(minA,a); maxA = _mm_max_ps(maxA,a);
+					minB = _mm_min_ps(minB,b); maxB = _mm_max_ps(maxB,b);
+					minC = _mm_min_ps(minC,c); maxC = _mm_max_ps(maxC,c);
+				}
+				//last points
+				for (; i<chunkCount; ++i, P+=3)
+				{
+					for (unsigned j=0; j<3; ++j)
+					{
+						if (P[j] < bbMinS.u[j])
+							bbMinS.u[j] = P[j];
+						else if (P[j] > bbMaxS.u[j])
+							bbMaxS.u[j] = P[j];
+					}
+				}
+			}
+
+			//'de-interleaving' the accumulators gives all the X, Y and Z candidates
+			__m128 x,y,z;
+			float m[4];
+			SSE_Deinterleave(minA,minB,minC,x,y,z);
+			_mm_storeu_ps(m,_mm_min_ps(x,_mm_shuffle_ps(x,x,_MM_SHUFFLE(1,0,3,2)))); bbMinS.x = std::min(bbMinS.x,std::min(m[0],m[1]));
+			_mm_storeu_ps(m,_mm_min_ps(y,_mm_shuffle_ps(y,y,_MM_SHUFFLE(1,0,3,2)))); bbMinS.y = std::min(bbMinS.y,std::min(m[0],m[1]));
+			_mm_storeu_ps(m,_mm_min_ps(z,_mm_shuffle_ps(z,z,_MM_SHUFFLE(1,0,3,2)))); bbMinS.z = std::min(bbMinS.z,std::min(m[0],m[1]));
+			SSE_Deinterleave(maxA,maxB,maxC,x,y,z);
+			_mm_storeu_ps(m,_mm_max_ps(x,_mm_shuffle_ps(x,x,_MM_SHUFFLE(1,0,3,2)))); bbMaxS.x = std::max(bbMaxS.x,std::max(m[0],m[1]));
+			_mm_storeu_ps(m,_mm_max_ps(y,_mm_shuffle_ps(y,y,_MM_SHUFFLE(1,0,3,2)))); bbMaxS.y = std::max(bbMaxS.y,std::max(m[0],m[1]));
+			_mm_storeu_ps(m,_mm_max_ps(z,_mm_shuffle_ps(z,z,_MM_SHUFFLE(1,0,3,2)))); bbMaxS.z = std::max(bbMaxS.z,std::max(m[0],m[1]));
+
+			m_points->setMin(bbMinS.u);
+			m_points->setMax(bbMaxS.u);
+		}
+		else
+#endif
+		{
+			m_points->computeMinAndMax();
+		}
 		m_validBB = true;
 	}
 
@@ -147,23 +205,143 @@ void ChunkedPointCloud::addPoint(const CCVector3 &P)
 
 void ChunkedPointCloud::applyTransformation(PointProjectionTools::Transformation& trans)
 {
-	unsigned i,count=size();
+	bool withTranslation = (trans.T.norm() > ZERO_TOLERANCE);
 
     if (trans.R.isValid())
     {
-		for (i=0;i<count;++i)
-			trans.R.apply(m_points->getValue(i));
+		assert(trans.R.size() == 3);
+		PointCoordinateType R[9];
+		for (unsigned l=0;l<3;++l)
+			for (unsigned c=0;c<3;++c)
+				R[l*3+c] = trans.R.getValue(l,c);
+
+		transformPoints(R, withTranslation ? trans.T.u : 0);
         m_validBB = false;
     }
-
-    if (trans.T.norm() > ZERO_TOLERANCE)
+	else if (withTranslation)
     {
-		for (i=0;i<count;++i)
-			*point(i) += trans.T;
+		translatePoints(trans.T);
         m_validBB = false;
     }
 }
 
+void ChunkedPointCloud::translatePoints(const CCVector3& T)
+{
+#ifdef CC_USE_SSE_KERNELS
+	__m128 tA,tB,tC;
+	SSE_SetRotated(T.x,T.y,T.z,tA,tB,tC);
+#endif
+
+	for (unsigned ci=0; ci<pointsChunksCount(); ++ci)
+	{
+		unsigned count = pointsChunkSize(ci);
+		PointCoordinateType* P = m_points->chunkStartPtr(ci);
+
+		unsigned i=0;
+#ifdef CC_USE_SSE_KERNELS
+		for (; i+4<=count; i+=4, P+=12)
+		{
+			__m128 a,b,c;
+			SSE_Load4Points(P,a,b,c);
+			SSE_Store4Points(P,_mm_add_ps(a,tA),_mm_add_ps(b,tB),_mm_add_ps(c,tC));
+		}
+#endif
+		for (; i<count; ++i, P+=3)
+		{
+			P[0] += T.x;
+			P[1] += T.y;
+			P[2] += T.z;
+		}
+	}
+}
+
+void ChunkedPointCloud::scalePoints(PointCoordinateType fx, PointCoordinateType fy, PointCoordinateType fz)
+{
+#ifdef CC_USE_SSE_KERNELS
+	__m128 fA,fB,fC;
+	SSE_SetRotated(fx,fy,fz,fA,fB,fC);
+#endif
+
+	for (unsigned ci=0; ci<pointsChunksCount(); ++ci)
+	{
+		unsigned count = pointsChunkSize(ci);
+		PointCoordinateType* P = m_points->chunkStartPtr(ci);
+
+		unsigned i=0;
+#ifdef CC_USE_SSE_KERNELS
+		for (; i+4<=count; i+=4, P+=12)
+		{
+			__m128 a,b,c;
+			SSE_Load4Points(P,a,b,c);
+			SSE_Store4Points(P,_mm_mul_ps(a,fA),_mm_mul_ps(b,fB),_mm_mul_ps(c,fC));
+		}
+#endif
+		for (; i<count; ++i, P+=3)
+		{
+			P[0] *= fx;
+			P[1] *= fy;
+			P[2] *= fz;
+		}
+	}
+}
+
+void ChunkedPointCloud::transformPoints(const PointCoordinateType R[9], const PointCoordinateType* T/*=0*/)
+{
+#ifdef CC_USE_SSE_KERNELS
+	__m128 r[9];
+	for (unsigned k=0;k<9;++k)
+		r[k] = _mm_set1_ps(R[k]);
+	__m128 t[3];
+	if (T)
+	{
+		for (unsigned k=0;k<3;++k)
+			t[k] = _mm_set1_ps(T[k]);
+	}
+#endif
+
+	for (unsigned ci=0; ci<pointsChunksCount(); ++ci)
+	{
+		unsigned count = pointsChunkSize(ci);
+		PointCoordinateType* P = m_points->chunkStartPtr(ci);
+
+		unsigned i=0;
+#ifdef CC_USE_SSE_KERNELS
+		for (; i+4<=count; i+=4, P+=12)
+		{
+			__m128 a,b,c,x,y,z;
+			SSE_Load4Points(P,a,b,c);
+			SSE_Deinterleave(a,b,c,x,y,z);
+			__m128 x2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[0],x),_mm_mul_ps(r[1],y)),_mm_mul_ps(r[2],z));
+			__m128 y2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[3],x),_mm_mul_ps(r[4],y)),_mm_mul_ps(r[5],z));
+			__m128 z2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[6],x),_mm_mul_ps(r[7],y)),_mm_mul_ps(r[8],z));
+			if (T)
+			{
+				x2 = _mm_add_ps(x2,t[0]);
+				y2 = _mm_add_ps(y2,t[1]);
+				z2 = _mm_add_ps(z2,t[2]);
+			}
+			SSE_Interleave(x2,y2,z2,a,b,c);
+			SSE_Store4Points(P,a,b,c);
+		}
+#endif
+		for (; i<count; ++i, P+=3)
+		{
+			PointCoordinateType x = P[0];
+			PointCoordinateType y = P[1];
+			PointCoordinateType z = P[2];
+			P[0] = R[0]*x + R[1]*y + R[2]*z;
+			P[1] = R[3]*x + R[4]*y + R[5]*z;
+			P[2] = R[6]*x + R[7]*y + R[8]*z;
+			if (T)
+			{
+				P[0] += T[0];
+				P[1] += T[1];
+				P[2] += T[2];
+			}
+		}
+	}
+}
+
 /***********************/
 /***                 ***/
 /***  SCALAR FIELDS  ***/
@@ -28,6 +28,13 @@
 
 //system
 #include <assert.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#ifdef ENABLE_MT_OCTREE
+#include <QtCore/QtCore>
+#endif
 
 using namespace CCLib;
 
@@ -69,36 +76,63 @@ SimpleCloud* CloudSamplingTools::resampleCloudWithOctreeAtLevel(GenericIndexedCl
 		}
 	}
 
-	SimpleCloud* cloud = new SimpleCloud();
-
 	unsigned nCells = theOctree->getCellNumber(octreeLevel);
-	if (!cloud->reserve(nCells))
+
+	//each cell writes its point in its own slot (indexed by the cell rank)
+	//so that cells can be processed in any order (and in parallel)
+	DgmOctree::cellIndexesContainer cellIndexes;
+	std::vector<CCVector3> slots;
+	std::vector<uchar> validSlots;
+	try
+	{
+		slots.resize(nCells);
+		validSlots.resize(nCells,0);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		if (!_theOctree)
+			delete theOctree;
+		return 0;
+	}
+	if (!theOctree->getCellIndexes(octreeLevel,cellIndexes))
 	{
 		if (!_theOctree)
 			delete theOctree;
-		delete cloud;
 		return 0;
 	}
 
 	//structure contenant les parametres additionnels
-	void* additionalParameters[2];
-	additionalParameters[0] = (void*)cloud;
+	void* additionalParameters[4];
+	additionalParameters[0] = (void*)&slots;
 	additionalParameters[1] = (void*)&resamplingMethod;
+	additionalParameters[2] = (void*)&cellIndexes;
+	additionalParameters[3] = (void*)&validSlots;
 
-	//The process is so simple that MT is slower!
-	//#ifdef ENABLE_MT_OCTREE
-	//theOctree->executeFunctionForAllCellsAtLevel_MT(octreeLevel,
-	//#else
+	SimpleCloud* cloud = 0;
+
+#ifdef ENABLE_MT_OCTREE
+	if (theOctree->executeFunctionForAllCellsAtLevel_MT(octreeLevel,
+#else
 	if (theOctree->executeFunctionForAllCellsAtLevel(octreeLevel,
+#endif
 													&resampleCellAtLevel,
 													additionalParameters,
 													progressCb,
-													"Cloud Resampling") == 0)
+													"Cloud Resampling") != 0)
 	{
-		//something went wrong
-		delete cloud;
-		cloud=0;
-
+		//compaction (in the cells order, as the sequential version)
+		cloud = new SimpleCloud();
+		if (cloud->reserve(nCells))
+		{
+			for (unsigned i=0; i<nCells; ++i)
+				if (validSlots[i])
+					cloud->addPoint(slots[i]);
+		}
+		else
+		{
+			delete cloud;
+			cloud=0;
+		}
 	}
 
 	if (!_theOctree)
@@ -145,35 +179,65 @@ ReferenceCloud* CloudSamplingTools::subsampleCloudWithOctreeAtLevel(GenericIndex
 		}
 	}
 
-	ReferenceCloud* cloud = new ReferenceCloud(theCloud);
-
 	unsigned nCells = theOctree->getCellNumber(octreeLevel);
-	if (!cloud->reserve(nCells))
+
+	//each cell writes its point index in its own slot (indexed by the cell rank)
+	//so that cells can be processed in any order (and in parallel)
+	DgmOctree::cellIndexesContainer cellIndexes;
+	std::vector<unsigned> slots;
+	try
+	{
+		slots.resize(nCells,0);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		if (!_theOctree)
+			delete theOctree;
+		return 0;
+	}
+	if (!theOctree->getCellIndexes(octreeLevel,cellIndexes))
 	{
 		if (!_theOctree)
 			delete theOctree;
-		delete cloud;
 		return 0;
 	}
 
+	//random values are drawn beforehand (in the cells order, as the sequential
+	//version does) as 'rand' is neither thread-safe nor reproducible otherwise
+	if (subsamplingMethod == RANDOM_POINT)
+		for (unsigned i=0; i<nCells; ++i)
+			slots[i] = (unsigned)rand();
+
 	//structure contenant les parametres additionnels
-	void* additionalParameters[2];
-	additionalParameters[0] = (void*)cloud;
+	void* additionalParameters[3];
+	additionalParameters[0] = (void*)&slots;
 	additionalParameters[1] = (void*)&subsamplingMethod;
+	additionalParameters[2] = (void*)&cellIndexes;
 
-	//The process is so simple that MT is slower!
-	//#ifdef ENABLE_MT_OCTREE
-	//theOctree->executeFunctionForAllCellsAtLevel_MT(octreeLevel,
-	//#else
+	ReferenceCloud* cloud = 0;
+
+#ifdef ENABLE_MT_OCTREE
+	if (theOctree->executeFunctionForAllCellsAtLevel_MT(octreeLevel,
+#else
 	if (theOctree->executeFunctionForAllCellsAtLevel(octreeLevel,
+#endif
 													&subsampleCellAtLevel,
 													additionalParameters,
 													progressCb,
-													"Cloud Subsampling") == 0)
+													"Cloud Subsampling") != 0)
 	{
-		//something went wrong
-		delete cloud;
-		cloud=0;
+		//compaction (in the cells order, as the sequential version)
+		cloud = new ReferenceCloud(theCloud);
+		if (cloud->reserve(nCells))
+		{
+			for (unsigned i=0; i<nCells; ++i)
+				cloud->addPointIndex(slots[i]);
+		}
+		else
+		{
+			delete cloud;
+			cloud=0;
+		}
 	}
 
 	if (!_theOctree)
@@ -384,22 +448,515 @@ ReferenceCloud* CloudSamplingTools::resampleCloudSpatially(GenericIndexedCloudPe
     return sampledCloud;
 }
 
+//! Point states during parallel spatial resampling
+enum SPATIAL_RESAMPLING_POINT_STATE { SPATIAL_POINT_UNPROCESSED = 0, SPATIAL_POINT_SELECTED = 1, SPATIAL_POINT_REMOVED = 2 };
+
+//! Octree cell (parallel spatial resampling)
+struct spatialResamplingCell
+{
+	//! First point (index in the octree 'pointsAndTheirCellCodes' container)
+	unsigned first;
+	//! Number of points
+	unsigned count;
+	//! Cell position
+	int pos[3];
+};
+
+//! Number of cells processed by each parallel spatial resampling job
+static const unsigned c_spatialResamplingJobSize = 64;
+
+struct spatialResamplingJob
+{
+	const DgmOctree* octree;
+	uchar level;
+	PointCoordinateType minDistance;
+	unsigned seed;
+	//! All the cells (sorted by code)
+	const std::vector<spatialResamplingCell>* cells;
+	//! Truncated codes of all the cells (sorted)
+	const DgmOctree::cellCodesContainer* cellCodes;
+	GenericChunkedArray<1,uchar>* states;
+	//! Cells to process (indexes in 'cells')
+	const unsigned* cellIndexes;
+	unsigned count;
+	NormalizedProgress* nProgress;
+	volatile bool* success;
+};
+
+static void ResampleCellsSpatially(spatialResamplingJob& job)
+{
+	//skip job if process is aborted
+	if (!*job.success)
+		return;
+
+	const DgmOctree::cellsContainer& pointsAndCodes = job.octree->pointsAndTheirCellCodes();
+	GenericIndexedCloudPersist* cloud = job.octree->associatedCloud();
+	PointCoordinateType minSquareDist = job.minDistance*job.minDistance;
+	const int maxPos = (1 << job.level)-1;
+
+	//unprocessed points of the cell and of its neighbours (the cell ones come first)
+	std::vector<unsigned> candidates;
+	std::vector<CCVector3> candidatePoints;
+	std::vector<unsigned> order;
+
+	try
+	{
+		for (unsigned c=0; c<job.count; ++c)
+		{
+			const spatialResamplingCell& cell = (*job.cells)[job.cellIndexes[c]];
+
+			candidates.clear();
+			candidatePoints.clear();
+			for (int n=-1; n<27; ++n)
+			{
+				const spatialResamplingCell* nCell = &cell;
+				if (n >= 0)
+				{
+					if (n == 13) //the cell itself
+						continue;
+					int pos[3] = {	cell.pos[0]+(n%3)-1,
+									cell.pos[1]+((n/3)%3)-1,
+									cell.pos[2]+(n/9)-1 };
+					if (pos[0]<0 || pos[0]>maxPos || pos[1]<0 || pos[1]>maxPos || pos[2]<0 || pos[2]>maxPos)
+						continue;
+					DgmOctree::OctreeCellCodeType code = job.octree->generateTruncatedCellCode(pos,job.level);
+					DgmOctree::cellCodesContainer::const_iterator it = std::lower_bound(job.cellCodes->begin(),job.cellCodes->end(),code);
+					if (it == job.cellCodes->end() || *it != code)
+						continue;
+					nCell = &(*job.cells)[it-job.cellCodes->begin()];
+				}
+
+				for (unsigned i=nCell->first; i<nCell->first+nCell->count; ++i)
+				{
+					unsigned index = pointsAndCodes[i].theIndex;
+					if (job.states->getValue(index) == SPATIAL_POINT_UNPROCESSED)
+					{
+						candidates.push_back(index);
+						candidatePoints.push_back(*cloud->getPointPersistentPtr(index));
+					}
+				}
+
+				if (n < 0)
+				{
+					//pseudo-random visiting order of the cell points (only depends on the seed and the cell)
+					unsigned cellCount = (unsigned)candidates.size();
+					order.resize(cellCount);
+					for (unsigned i=0; i<cellCount; ++i)
+						order[i] = i;
+					unsigned rnd = job.seed ^ (job.cellIndexes[c]*2654435761u);
+					for (unsigned i=cellCount; i>1; --i)
+					{
+						rnd = rnd*1664525u + 1013904223u;
+						std::swap(order[i-1],order[(rnd>>8) % i]);
+					}
+				}
+			}
+
+			//each unprocessed point of the cell is selected and 'removes' its (unprocessed) neighbours
+			for (size_t k=0; k<order.size(); ++k)
+			{
+				unsigned i = order[k];
+				if (job.states->getValue(candidates[i]) != SPATIAL_POINT_UNPROCESSED)
+					continue;
+				job.states->setValue(candidates[i],SPATIAL_POINT_SELECTED);
+
+				const CCVector3& P = candidatePoints[i];
+				for (size_t j=0; j<candidates.size(); ++j)
+				{
+					if (j != i
+						&& (P-candidatePoints[j]).norm2() <= minSquareDist
+						&& job.states->getValue(candidates[j]) == SPATIAL_POINT_UNPROCESSED)
+					{
+						job.states->setValue(candidates[j],SPATIAL_POINT_REMOVED);
+					}
+				}
+			}
+
+			if (job.nProgress && !job.nProgress->oneStep())
+			{
+				*job.success = false;
+				return;
+			}
+		}
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		*job.success = false;
+	}
+}
+
+ReferenceCloud* CloudSamplingTools::resampleCloudSpatiallyParallel(GenericIndexedCloudPersist* theCloud,
+																	float minDistance,
+																	unsigned seed/*=0*/,
+																	DgmOctree* theOctree/*=0*/,
+																	GenericProgressCallback* progressCb/*=0*/)
+{
+	assert(theCloud);
+	unsigned cloudSize = theCloud->size();
+
+	DgmOctree *_theOctree=theOctree;
+	if (!_theOctree)
+	{
+		_theOctree = new DgmOctree(theCloud);
+		if (_theOctree->build()<(int)cloudSize)
+		{
+			delete _theOctree;
+			return 0;
+		}
+	}
+
+	//we use the finest level at which cells are bigger than the min distance
+	//(so that the neighbours of a point are always in the 27 cells around it)
+	uchar level = 1;
+	for (uchar l=DgmOctree::MAX_OCTREE_LEVEL; l>1; --l)
+	{
+		if (_theOctree->getCellSize(l) >= minDistance)
+		{
+			level = l;
+			break;
+		}
+	}
+
+	ReferenceCloud* sampledCloud = 0;
+	GenericChunkedArray<1,uchar>* states = new GenericChunkedArray<1,uchar>();
+	NormalizedProgress* nProgress = 0;
+
+	//cells description (and their 'colour')
+	std::vector<spatialResamplingCell> cells;
+	DgmOctree::cellCodesContainer cellCodes;
+	std::vector<unsigned> colourCells[27];
+	try
+	{
+		DgmOctree::cellIndexesContainer cellIndexes;
+		if (!_theOctree->getCellIndexes(level,cellIndexes))
+			throw std::bad_alloc();
+
+		const DgmOctree::cellsContainer& pointsAndCodes = _theOctree->pointsAndTheirCellCodes();
+		unsigned cellCount = (unsigned)cellIndexes.size();
+		unsigned pointCount = _theOctree->getNumberOfProjectedPoints();
+		uchar bitDec = GET_BIT_SHIFT(level);
+
+		cells.resize(cellCount);
+		cellCodes.resize(cellCount);
+		for (unsigned i=0; i<cellCount; ++i)
+		{
+			spatialResamplingCell& cell = cells[i];
+			cell.first = cellIndexes[i];
+			cell.count = (i+1<cellCount ? cellIndexes[i+1] : pointCount)-cell.first;
+			cellCodes[i] = (pointsAndCodes[cell.first].theCode >> bitDec);
+			_theOctree->getCellPos(cellCodes[i],level,cell.pos,true);
+
+			colourCells[(cell.pos[0]%3)+3*(cell.pos[1]%3)+9*(cell.pos[2]%3)].push_back(i);
+		}
+
+		if (!states->resize(cloudSize,true,SPATIAL_POINT_UNPROCESSED))
+			throw std::bad_alloc();
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		states->release();
+		if (!theOctree)
+			delete _theOctree;
+		return 0;
+	}
+
+	if (progressCb)
+	{
+		progressCb->setInfo("Spatial resampling");
+		nProgress = new NormalizedProgress(progressCb,(unsigned)cells.size());
+		progressCb->reset();
+		progressCb->start();
+	}
+
+	volatile bool success = true;
+
+	spatialResamplingJob job;
+	job.octree = _theOctree;
+	job.level = level;
+	job.minDistance = minDistance;
+	job.seed = seed;
+	job.cells = &cells;
+	job.cellCodes = &cellCodes;
+	job.states = states;
+	job.cellIndexes = 0;
+	job.count = 0;
+	job.nProgress = nProgress;
+	job.success = &success;
+
+	//the cells of a same colour are processed in parallel (they don't share any neighbour)
+	for (unsigned colour=0; colour<27 && success; ++colour)
+	{
+		const std::vector<unsigned>& cellsToProcess = colourCells[colour];
+		unsigned count = (unsigned)cellsToProcess.size();
+		if (count == 0)
+			continue;
+
+		unsigned jobCount = (count+c_spatialResamplingJobSize-1)/c_spatialResamplingJobSize;
+		std::vector<spatialResamplingJob> jobs;
+		try
+		{
+			jobs.resize(jobCount,job);
+		}
+		catch (.../*const std::bad_alloc&*/) //out of memory
+		{
+			success = false;
+			break;
+		}
+		for (unsigned j=0; j<jobCount; ++j)
+		{
+			jobs[j].cellIndexes = &(cellsToProcess[0]) + j*c_spatialResamplingJobSize;
+			jobs[j].count = std::min(c_spatialResamplingJobSize,count-j*c_spatialResamplingJobSize);
+		}
+
+#ifdef ENABLE_MT_OCTREE
+		QtConcurrent::blockingMap(jobs, ResampleCellsSpatially);
+#else
+		for (unsigned j=0; j<jobCount; ++j)
+			ResampleCellsSpatially(jobs[j]);
+#endif
+	}
+
+	if (success)
+	{
+		unsigned selectedCount = 0;
+		for (unsigned i=0; i<cloudSize; ++i)
+			if (states->getValue(i) == SPATIAL_POINT_SELECTED)
+				++selectedCount;
+
+		sampledCloud = new ReferenceCloud(theCloud);
+		if (sampledCloud->reserve(selectedCount))
+		{
+			for (unsigned i=0; i<cloudSize; ++i)
+				if (states->getValue(i) == SPATIAL_POINT_SELECTED)
+					sampledCloud->addPointIndex(i); //can't fail (see above)
+		}
+		else //not enough memory
+		{
+			delete sampledCloud;
+			sampledCloud = 0;
+		}
+	}
+
+	if (nProgress)
+	{
+		delete nProgress;
+		nProgress = 0;
+	}
+
+	if (!theOctree)
+		delete _theOctree;
+
+	states->release();
+
+	return sampledCloud;
+}
+
+ReferenceCloud* CloudSamplingTools::sorFilter(GenericIndexedCloudPersist* theCloud,
+												unsigned knn/*=6*/,
+												double nSigma/*=1.0*/,
+												DgmOctree* theOctree/*=0*/,
+												GenericProgressCallback* progressCb/*=0*/)
+{
+	assert(theCloud);
+	unsigned cloudSize = theCloud->size();
+	if (knn == 0 || cloudSize == 0)
+		return 0;
+
+	DgmOctree* _theOctree = theOctree;
+	if (!_theOctree)
+	{
+		_theOctree = new DgmOctree(theCloud);
+		if (_theOctree->build(progressCb) < 1)
+		{
+			delete _theOctree;
+			return 0;
+		}
+	}
+
+	//a point can't have more neighbours than the other points in the octree
+	//(otherwise the nearest neighbours search would never end!)
+	unsigned projectedCount = _theOctree->getNumberOfProjectedPoints();
+	if (projectedCount < 2)
+	{
+		if (!theOctree)
+			delete _theOctree;
+		return 0;
+	}
+	if (knn > projectedCount-1)
+		knn = projectedCount-1;
+
+	//mean distance of each point to its neighbours
+	std::vector<float> meanDistances;
+	try
+	{
+		meanDistances.resize(cloudSize,-1.0f);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		if (!theOctree)
+			delete _theOctree;
+		return 0;
+	}
+
+	//each point is its own nearest neighbour (see applySORFilterAtLevel)
+	uchar level = std::max<uchar>(_theOctree->findBestLevelForAGivenPopulationPerCell(knn+1),1);
+
+	void* additionalParameters[2];
+	additionalParameters[0] = (void*)&knn;
+	additionalParameters[1] = (void*)&meanDistances;
+
+	unsigned processedCells =
+#ifdef ENABLE_MT_OCTREE
+		_theOctree->executeFunctionForAllCellsAtLevel_MT(level,
+#else
+		_theOctree->executeFunctionForAllCellsAtLevel(level,
+#endif
+													&applySORFilterAtLevel,
+													additionalParameters,
+													progressCb,
+													"SOR filter");
+
+	if (!theOctree)
+		delete _theOctree;
+	_theOctree = 0;
+
+	if (processedCells == 0)
+		return 0;
+
+	//average and standard deviation of the mean distances
+	double sum = 0.0;
+	unsigned count = 0;
+	for (unsigned i=0; i<cloudSize; ++i)
+	{
+		if (meanDistances[i] >= 0.0f)
+		{
+			sum += meanDistances[i];
+			++count;
+		}
+	}
+	if (count == 0)
+		return 0;
+	double avgDist = sum/(double)count;
+
+	double sum2 = 0.0;
+	for (unsigned i=0; i<cloudSize; ++i)
+	{
+		if (meanDistances[i] >= 0.0f)
+		{
+			double d = (double)meanDistances[i]-avgDist;
+			sum2 += d*d;
+		}
+	}
+	double stdDev = sqrt(sum2/(double)count);
+	double maxDist = avgDist + nSigma*stdDev;
+
+	//points without any neighbour are considered as outliers
+	ReferenceCloud* filteredCloud = new ReferenceCloud(theCloud);
+	if (!filteredCloud->reserve(count))
+	{
+		delete filteredCloud;
+		return 0;
+	}
+	for (unsigned i=0; i<cloudSize; ++i)
+		if (meanDistances[i] >= 0.0f && (double)meanDistances[i] <= maxDist)
+			filteredCloud->addPointIndex(i); //can't fail (see above)
+
+	return filteredCloud;
+}
+
+bool CloudSamplingTools::applySORFilterAtLevel(const DgmOctree::octreeCell& cell, void** additionalParameters)
+{
+	unsigned knn						= *((unsigned*)additionalParameters[0]);
+	std::vector<float>& meanDistances	= *((std::vector<float>*)additionalParameters[1]);
+
+	//number of points in the current cell
+	unsigned n = cell.pointCount;
+	//associated cloud
+	GenericIndexedCloudPersist* cloud = cell.parentOctree->associatedCloud();
+
+	//each point is its own nearest neighbour
+	DgmOctree::NearestNeighboursSearchStruct nNSS;
+	nNSS.level												= cell.level;
+	nNSS.minNumberOfNeighbors								= knn+1;
+	nNSS.truncatedCellCode									= cell.truncatedCode;
+	cell.parentOctree->getCellPos(cell.truncatedCode,cell.level,nNSS.cellPos,true);
+	cell.parentOctree->computeCellCenter(nNSS.cellPos,cell.level,nNSS.cellCenter);
+
+	//we already know the points of the first cell (this is the one we are currently processing!)
+	{
+		try
+		{
+			nNSS.pointsInNeighbourhood.resize(n);
+		}
+		catch (.../*const std::bad_alloc&*/) //out of memory
+		{
+			return false;
+		}
+
+		DgmOctree::NeighboursSet::iterator it = nNSS.pointsInNeighbourhood.begin();
+		for (unsigned j=0; j<n; ++j,++it)
+		{
+			it->point = cloud->getPointPersistentPtr(cell.getPointGlobalIndex(j));
+			it->pointIndex = cell.getPointGlobalIndex(j);
+		}
+		nNSS.alreadyVisitedNeighbourhoodSize = 1;
+	}
+
+	for (unsigned i=0; i<n; ++i)
+	{
+		cloud->getPoint(cell.getPointGlobalIndex(i),nNSS.queryPoint);
+
+		unsigned k = cell.parentOctree->findNearestNeighborsStartingFromCell(nNSS);
+		if (k > knn+1)
+			k = knn+1;
+
+		//the first neighbour is the point itself
+		if (k > 1)
+		{
+			double sumDist = 0.0;
+			for (unsigned j=1; j<k; ++j)
+				sumDist += sqrt(nNSS.pointsInNeighbourhood[j].squareDist);
+			meanDistances[cell.getPointGlobalIndex(i)] = (float)(sumDist/(double)(k-1));
+		}
+	}
+
+	return true;
+}
+
+//! Returns the rank of a cell (from the index of its first point)
+static inline unsigned GetCellRank(const DgmOctree::cellIndexesContainer& cellIndexes, unsigned firstPointIndex)
+{
+	DgmOctree::cellIndexesContainer::const_iterator it = std::lower_bound(cellIndexes.begin(),cellIndexes.end(),firstPointIndex);
+	assert(it != cellIndexes.end() && *it == firstPointIndex);
+	return (unsigned)(it-cellIndexes.begin());
+}
+
 bool CloudSamplingTools::resampleCellAtLevel(const DgmOctree::octreeCell& cell, void** additionalParameters)
 {
-	SimpleCloud* cloud						= (SimpleCloud*)additionalParameters[0];
-	RESAMPLING_CELL_METHOD resamplingMethod	= *((RESAMPLING_CELL_METHOD*)additionalParameters[1]);
+	std::vector<CCVector3>& slots						= *((std::vector<CCVector3>*)additionalParameters[0]);
+	RESAMPLING_CELL_METHOD resamplingMethod				= *((RESAMPLING_CELL_METHOD*)additionalParameters[1]);
+	const DgmOctree::cellIndexesContainer& cellIndexes	= *((DgmOctree::cellIndexesContainer*)additionalParameters[2]);
+	std::vector<uchar>& validSlots						= *((std::vector<uchar>*)additionalParameters[3]);
+
+	unsigned rank = GetCellRank(cellIndexes,cell.index);
 
 	if (resamplingMethod == CELL_GRAVITY_CENTER)
 	{
-		const CCVector3* P = Neighbourhood(cell.points).getGravityCenter();
+		ReferenceCloud* cellPoints = cell.getPoints();
+		if (!cellPoints) //not enough memory
+			return false;
+
+		const CCVector3* P = Neighbourhood(cellPoints).getGravityCenter();
 		if (P)
-			cloud->addPoint(*P);
+		{
+			slots[rank] = *P;
+			validSlots[rank] = 1;
+		}
 	}
 	else //if (resamplingMethod == CELL_CENTER)
 	{
-		PointCoordinateType center[3];
-		cell.parentOctree->computeCellCenter(cell.truncatedCode,cell.level,center,true);
-        cloud->addPoint(center);
+		cell.parentOctree->computeCellCenter(cell.truncatedCode,cell.level,slots[rank].u,true);
+		validSlots[rank] = 1;
 	}
 
 	return true;
@@ -407,15 +964,20 @@ bool CloudSamplingTools::resampleCellAtLevel(const DgmOctree::octreeCell& cell,
 
 bool CloudSamplingTools::subsampleCellAtLevel(const DgmOctree::octreeCell& cell, void** additionalParameters)
 {
-	ReferenceCloud* cloud					    = (ReferenceCloud*)additionalParameters[0];
-	SUBSAMPLING_CELL_METHOD subsamplingMethod	= *((SUBSAMPLING_CELL_METHOD*)additionalParameters[1]);
+	std::vector<unsigned>& slots						= *((std::vector<unsigned>*)additionalParameters[0]);
+	SUBSAMPLING_CELL_METHOD subsamplingMethod			= *((SUBSAMPLING_CELL_METHOD*)additionalParameters[1]);
+	const DgmOctree::cellIndexesContainer& cellIndexes	= *((DgmOctree::cellIndexesContainer*)additionalParameters[2]);
+
+	unsigned rank = GetCellRank(cellIndexes,cell.index);
 
 	unsigned selectedPointIndex=0;
-	unsigned pointsCount = cell.points->size();
+	unsigned pointsCount = cell.pointCount;
+	GenericIndexedCloudPersist* cloud = cell.parentOctree->associatedCloud();
 
 	if (subsamplingMethod == RANDOM_POINT)
 	{
-	    selectedPointIndex = ((unsigned)rand()) % pointsCount;
+		//random value drawn beforehand (see subsampleCloudWithOctreeAtLevel)
+	    selectedPointIndex = slots[rank] % pointsCount;
 	}
 	else // if (subsamplingMethod == NEAREST_POINT_TO_CELL_CENTER)
 	{
@@ -423,11 +985,11 @@ bool CloudSamplingTools::subsampleCellAtLevel(const DgmOctree::octreeCell& cell,
 		cell.parentOctree->computeCellCenter(cell.truncatedCode,cell.level,center,true);
 
 		ScalarType dist,minDist;
-		minDist = CCVector3::vdistance2(cell.points->getPoint(0)->u,center);
+		minDist = CCVector3::vdistance2(cloud->getPoint(cell.getPointGlobalIndex(0))->u,center);
 
 		for (unsigned i=1;i<pointsCount;++i)
 		{
-			dist = CCVector3::vdistance2(cell.points->getPoint(i)->u,center);
+			dist = CCVector3::vdistance2(cloud->getPoint(cell.getPointGlobalIndex(i))->u,center);
 			if (dist<minDist)
 			{
 				selectedPointIndex = i;
@@ -436,5 +998,7 @@ bool CloudSamplingTools::subsampleCellAtLevel(const DgmOctree::octreeCell& cell,
         }
     }
 
-	return cloud->addPointIndex(cell.points->getPointGlobalIndex(selectedPointIndex));
+	slots[rank] = cell.getPointGlobalIndex(selectedPointIndex);
+
+	return true;
 }
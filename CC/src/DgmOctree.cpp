@@ -26,6 +26,8 @@
 
 //system
 #include <algorithm>
+#include <limits>
+#include <math.h>
 #include <string.h>
 #include <assert.h>
 
@@ -146,6 +148,7 @@ void getPointsInTreeCell(octreeTreeCell* cell, CCLib::DgmOctree::NeighboursSet&
 using namespace CCLib;
 
 DgmOctree::DgmOctree(GenericIndexedCloudPersist* aCloud)
+	: m_multiThreadedBuild(true)
 {
     assert(aCloud);
 
@@ -206,6 +209,259 @@ int DgmOctree::build(const CCVector3& octreeMin, const CCVector3& octreeMax, con
     return genericBuild(progressCb);
 }
 
+#ifdef ENABLE_MT_OCTREE
+
+#include <QtCore/QtCore>
+
+/*** MULTI-THREADED BUILD ***/
+
+//! Minimum number of points to use the multi-threaded build (otherwise the overhead is not worth it)
+#define MIN_POINTS_FOR_MT_BUILD 65536
+
+//! Number of points processed by each thread between two progress notifications (multi-threaded build)
+#define MT_BUILD_BLOCK_SIZE (1<<20)
+
+//! Number of bits sorted at each pass of the radix sort
+#define RADIX_SORT_BITS 8
+//! Number of buckets per pass of the radix sort
+#define RADIX_SORT_BUCKETS (1<<RADIX_SORT_BITS)
+
+//! Job description for the multi-threaded build (one contiguous range per thread)
+struct octreeBuildJob
+{
+	//! Associated octree
+	const DgmOctree* octree;
+	//! Associated cloud
+	GenericIndexedCloudPersist* cloud;
+	//! Points filter (min. corner)
+	CCVector3 pointsMin;
+	//! Points filter (max. corner)
+	CCVector3 pointsMax;
+	//! First element of the range
+	unsigned first;
+	//! Last element of the range (excluded)
+	unsigned last;
+	//! Number of projected points (for the code generation step)
+	unsigned count;
+	//! Source elements (for the sort step)
+	const DgmOctree::IndexAndCode* src;
+	//! Destination elements
+	DgmOctree::IndexAndCode* dst;
+	//! Binary shift of the current radix sort pass
+	unsigned shift;
+	//! Digits histogram (then scatter positions) for the current radix sort pass
+	unsigned buckets[RADIX_SORT_BUCKETS];
+};
+
+//! Computes the cell codes of a range of points (multi-threaded build)
+/** Projected points are stored contiguously starting at 'job.first'.
+**/
+static void ComputeCellCodes_MT(octreeBuildJob& job)
+{
+	const int maxLength = DgmOctree::MAX_OCTREE_LENGTH;
+	int cellPos[3];
+
+	DgmOctree::IndexAndCode* it = job.dst + job.first;
+	for (unsigned i=job.first; i<job.last; ++i)
+	{
+		const CCVector3* P = job.cloud->getPointPersistentPtr(i);
+
+		if ((P->x >= job.pointsMin[0]) && (P->x <= job.pointsMax[0])
+			&& (P->y >= job.pointsMin[1]) && (P->y <= job.pointsMax[1])
+			&& (P->z >= job.pointsMin[2]) && (P->z <= job.pointsMax[2]))
+		{
+			job.octree->getTheCellPosWhichIncludesThePoint(P,cellPos);
+
+			//clipping (see DgmOctree::genericBuild)
+			for (int k=0; k<3; ++k)
+			{
+				if (cellPos[k]<0)
+					cellPos[k]=0;
+				else if (cellPos[k]>maxLength)
+					cellPos[k]=maxLength;
+			}
+
+			it->theIndex = i;
+			it->theCode = job.octree->generateTruncatedCellCode(cellPos,DgmOctree::MAX_OCTREE_LEVEL);
+			++it;
+		}
+	}
+
+	job.count = (unsigned)(it - (job.dst + job.first));
+}
+
+//! Computes the digits histogram of a range of elements (radix sort - step 1)
+static void ComputeRadixHistogram_MT(octreeBuildJob& job)
+{
+	memset(job.buckets,0,sizeof(unsigned)*RADIX_SORT_BUCKETS);
+	for (unsigned i=job.first; i<job.last; ++i)
+		++job.buckets[(unsigned)(job.src[i].theCode >> job.shift) & (RADIX_SORT_BUCKETS-1)];
+}
+
+//! Scatters a range of elements at their sorted position (radix sort - step 2)
+/** 'job.buckets' must contain the output position of the first element of each digit.
+	As the ranges are processed in order, the sort is stable.
+**/
+static void ScatterRadixDigits_MT(octreeBuildJob& job)
+{
+	for (unsigned i=job.first; i<job.last; ++i)
+	{
+		unsigned& pos = job.buckets[(unsigned)(job.src[i].theCode >> job.shift) & (RADIX_SORT_BUCKETS-1)];
+		job.dst[pos++] = job.src[i];
+	}
+}
+
+//! Splits [offset,offset+count[ in (at most) 'jobCount' contiguous ranges
+static void SplitBuildJobs(std::vector<octreeBuildJob>& jobs, unsigned count, unsigned offset = 0)
+{
+	unsigned jobCount = (unsigned)jobs.size();
+	unsigned rangeSize = count/jobCount + (count % jobCount ? 1 : 0);
+	for (unsigned j=0; j<jobCount; ++j)
+	{
+		jobs[j].first = offset + std::min(j*rangeSize,count);
+		jobs[j].last = offset + std::min(j*rangeSize+rangeSize,count);
+	}
+}
+
+bool DgmOctree::computeAndSortCellCodes_MT(GenericProgressCallback* progressCb)
+{
+	unsigned n = m_theAssociatedCloud->size();
+	assert(m_thePointsAndTheirCellCodes.size() == n);
+
+	unsigned threadCount = (unsigned)std::max(QThread::idealThreadCount(),1);
+	std::vector<octreeBuildJob> jobs;
+	try
+	{
+		jobs.resize(threadCount);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return false;
+	}
+
+	/*** step 1: cell codes ***/
+
+	for (unsigned j=0; j<threadCount; ++j)
+	{
+		jobs[j].octree = this;
+		jobs[j].cloud = m_theAssociatedCloud;
+		jobs[j].pointsMin = m_pointsMin;
+		jobs[j].pointsMax = m_pointsMax;
+		jobs[j].count = 0;
+		jobs[j].src = 0;
+		jobs[j].dst = &(m_thePointsAndTheirCellCodes[0]);
+		jobs[j].shift = 0;
+	}
+	//the points are processed by blocks so that we can notify the progress and
+	//check for cancellation (only from the calling thread) in the meantime
+	m_numberOfProjectedPoints = 0;
+	const unsigned blockSize = threadCount * MT_BUILD_BLOCK_SIZE;
+	for (unsigned blockStart=0; blockStart<n; )
+	{
+		unsigned count = std::min(blockSize,n-blockStart);
+		SplitBuildJobs(jobs,count,blockStart);
+
+		QtConcurrent::blockingMap(jobs, ComputeCellCodes_MT);
+
+		//we gather the projected points (in order)
+		for (unsigned j=0; j<threadCount; ++j)
+		{
+			if (jobs[j].count && m_numberOfProjectedPoints != jobs[j].first)
+				std::copy(m_thePointsAndTheirCellCodes.begin()+jobs[j].first,m_thePointsAndTheirCellCodes.begin()+(jobs[j].first+jobs[j].count),m_thePointsAndTheirCellCodes.begin()+m_numberOfProjectedPoints); //forward copy (destination is before source)
+			m_numberOfProjectedPoints += jobs[j].count;
+		}
+
+		blockStart += count;
+		if (progressCb)
+		{
+			progressCb->update(90.0f * (float)blockStart / (float)n);
+			if (progressCb->isCancelRequested())
+				return false;
+		}
+	}
+
+	if (m_numberOfProjectedPoints<n)
+		m_thePointsAndTheirCellCodes.resize(m_numberOfProjectedPoints); //smaller --> should always be ok
+
+	if (progressCb)
+	{
+		progressCb->update(90.0f);
+		progressCb->setInfo("Sorting cells...");
+	}
+
+	if (m_numberOfProjectedPoints < 2)
+		return true;
+
+	/*** step 2: parallel LSD radix sort (stable, so points in each cell remain sorted by index) ***/
+
+	cellsContainer buffer;
+	try
+	{
+		buffer.resize(m_numberOfProjectedPoints);
+	}
+	catch (.../*const std::bad_alloc&*/) //not enough memory for the radix sort
+	{
+		//we use the standard way (same result, but slower)
+		std::sort(m_thePointsAndTheirCellCodes.begin(),m_thePointsAndTheirCellCodes.end(),IndexAndCode::codeAndIndexComp);
+		return true;
+	}
+
+	SplitBuildJobs(jobs,m_numberOfProjectedPoints);
+
+	IndexAndCode* src = &(m_thePointsAndTheirCellCodes[0]);
+	IndexAndCode* dst = &(buffer[0]);
+
+	for (unsigned shift=0; shift<3*MAX_OCTREE_LEVEL; shift+=RADIX_SORT_BITS)
+	{
+		if (progressCb && progressCb->isCancelRequested())
+			return false;
+
+		for (unsigned j=0; j<threadCount; ++j)
+		{
+			jobs[j].src = src;
+			jobs[j].dst = dst;
+			jobs[j].shift = shift;
+		}
+
+		QtConcurrent::blockingMap(jobs, ComputeRadixHistogram_MT);
+
+		//convert histograms to output positions (digit first, then job)
+		unsigned pos = 0;
+		bool trivialPass = false;
+		for (unsigned d=0; d<RADIX_SORT_BUCKETS; ++d)
+		{
+			unsigned digitCount = 0;
+			for (unsigned j=0; j<threadCount; ++j)
+			{
+				unsigned count = jobs[j].buckets[d];
+				jobs[j].buckets[d] = pos + digitCount;
+				digitCount += count;
+			}
+			//all elements share the same digit: nothing to do for this pass
+			if (digitCount == m_numberOfProjectedPoints)
+			{
+				trivialPass = true;
+				break;
+			}
+			pos += digitCount;
+		}
+		if (trivialPass)
+			continue;
+
+		QtConcurrent::blockingMap(jobs, ScatterRadixDigits_MT);
+
+		std::swap(src,dst);
+	}
+
+	//if the sorted elements are in the temporary buffer, we swap the containers
+	if (src != &(m_thePointsAndTheirCellCodes[0]))
+		m_thePointsAndTheirCellCodes.swap(buffer);
+
+	return true;
+}
+
+#endif
+
 int DgmOctree::genericBuild(GenericProgressCallback* progressCb)
 {
     unsigned n = m_theAssociatedCloud->size();
@@ -240,68 +496,87 @@ int DgmOctree::genericBuild(GenericProgressCallback* progressCb)
         progressCb->start();
     }
 
-    int cellPos[3];
-
-    //for all points
-    cellsContainer::iterator it = m_thePointsAndTheirCellCodes.begin();
-    m_numberOfProjectedPoints=0;
-    for (unsigned i=0; i<n; i++)
-    {
-        const CCVector3* P = m_theAssociatedCloud->getPoint(i);
-
-        //on verifie que le point fait partie de la bounding box de l'octree
-        if ((P->x >= m_pointsMin[0]) && (P->x <= m_pointsMax[0])
-                && (P->y >= m_pointsMin[1]) && (P->y <= m_pointsMax[1])
-                && (P->z >= m_pointsMin[2]) && (P->z <= m_pointsMax[2]))
-        {
-            //on calcule la position de la cellule qui englobe le point (niveau maximal de l'octree)
-            getTheCellPosWhichIncludesThePoint(P,cellPos);
-
-			//Clipping below shouldn't be necessary in the general case
-			//(as the default octree box is slighlty larger than the cloud's
-			//one), but we never know...
-
-			//clipping X
-            if (cellPos[0]<0)
-                cellPos[0]=0;
-            else if (cellPos[0]>MAX_OCTREE_LENGTH)
-                cellPos[0]=MAX_OCTREE_LENGTH;
-            //clipping Y
-            if (cellPos[1]<0)
-                cellPos[1]=0;
-            else if (cellPos[1]>MAX_OCTREE_LENGTH)
-                cellPos[1]=MAX_OCTREE_LENGTH;
-            //clipping Z
-            if (cellPos[2]<0)
-                cellPos[2]=0;
-            else if (cellPos[2]>MAX_OCTREE_LENGTH)
-                cellPos[2]=MAX_OCTREE_LENGTH;
-
-            it->theIndex = i;
-            it->theCode = generateTruncatedCellCode(cellPos,MAX_OCTREE_LEVEL);
-
-            ++it;
-            ++m_numberOfProjectedPoints;
-        }
-
-		if (nprogress && !nprogress->oneStep())
+#ifdef ENABLE_MT_OCTREE
+	if (m_multiThreadedBuild && n >= MIN_POINTS_FOR_MT_BUILD)
+	{
+		if (!computeAndSortCellCodes_MT(progressCb))
 		{
 			m_thePointsAndTheirCellCodes.clear();
 			m_numberOfProjectedPoints=0;
-			progressCb->stop();
-			delete nprogress;
-			return 0;
+			bool canceled = (progressCb && progressCb->isCancelRequested());
+			if (progressCb)
+				progressCb->stop();
+			if (nprogress)
+				delete nprogress;
+			return (canceled ? 0 : -1);
 		}
-    }
+	}
+	else
+#endif
+	{
+		int cellPos[3];
 
-    if (m_numberOfProjectedPoints<n)
-        m_thePointsAndTheirCellCodes.resize(m_numberOfProjectedPoints); //smaller --> should always be ok
+		//for all points
+		cellsContainer::iterator it = m_thePointsAndTheirCellCodes.begin();
+		m_numberOfProjectedPoints=0;
+		for (unsigned i=0; i<n; i++)
+		{
+			const CCVector3* P = m_theAssociatedCloud->getPoint(i);
 
-	if (progressCb)
-		progressCb->setInfo("Sorting cells...");
+			//on verifie que le point fait partie de la bounding box de l'octree
+			if ((P->x >= m_pointsMin[0]) && (P->x <= m_pointsMax[0])
+					&& (P->y >= m_pointsMin[1]) && (P->y <= m_pointsMax[1])
+					&& (P->z >= m_pointsMin[2]) && (P->z <= m_pointsMax[2]))
+			{
+				//on calcule la position de la cellule qui englobe le point (niveau maximal de l'octree)
+				getTheCellPosWhichIncludesThePoint(P,cellPos);
+
+				//Clipping below shouldn't be necessary in the general case
+				//(as the default octree box is slighlty larger than the cloud's
+				//one), but we never know...
+
+				//clipping X
+				if (cellPos[0]<0)
+					cellPos[0]=0;
+				else if (cellPos[0]>MAX_OCTREE_LENGTH)
+					cellPos[0]=MAX_OCTREE_LENGTH;
+				//clipping Y
+				if (cellPos[1]<0)
+					cellPos[1]=0;
+				else if (cellPos[1]>MAX_OCTREE_LENGTH)
+					cellPos[1]=MAX_OCTREE_LENGTH;
+				//clipping Z
+				if (cellPos[2]<0)
+					cellPos[2]=0;
+				else if (cellPos[2]>MAX_OCTREE_LENGTH)
+					cellPos[2]=MAX_OCTREE_LENGTH;
+
+				it->theIndex = i;
+				it->theCode = generateTruncatedCellCode(cellPos,MAX_OCTREE_LEVEL);
+
+				++it;
+				++m_numberOfProjectedPoints;
+			}
+
+			if (nprogress && !nprogress->oneStep())
+			{
+				m_thePointsAndTheirCellCodes.clear();
+				m_numberOfProjectedPoints=0;
+				progressCb->stop();
+				delete nprogress;
+				return 0;
+			}
+		}
 
-    //on trie les paires "point-cellule" en fonction du code
-	std::sort(m_thePointsAndTheirCellCodes.begin(),m_thePointsAndTheirCellCodes.end(),IndexAndCode::codeComp); //ascending cell code order
+		if (m_numberOfProjectedPoints<n)
+			m_thePointsAndTheirCellCodes.resize(m_numberOfProjectedPoints); //smaller --> should always be ok
+
+		if (progressCb)
+			progressCb->setInfo("Sorting cells...");
+
+		//on trie les paires "point-cellule" en fonction du code
+		std::sort(m_thePointsAndTheirCellCodes.begin(),m_thePointsAndTheirCellCodes.end(),IndexAndCode::codeAndIndexComp); //ascending cell code order (then index order)
+	}
 
     //update the pre-computed 'number of cells per level of subidivision' array
     updateCellCountTable();
@@ -793,9 +1068,9 @@ unsigned DgmOctree::getCellIndex(OctreeCellCodeType truncatedCellCode, uchar bit
 
         if (middleCode < truncatedCellCode)
         {
-			//no more cell inbetween?
+			//no more cell inbetween? (the last one may still be the good one)
             if (middle==begin)
-                return m_numberOfProjectedPoints;
+                return (endCode == truncatedCellCode ? end : m_numberOfProjectedPoints);
 
 			begin = middle;
 			beginCode = middleCode;
@@ -857,9 +1132,9 @@ unsigned DgmOctree::getCellIndex(OctreeCellCodeType truncatedCellCode, uchar bit
 
         if (middleCode < truncatedCellCode)
         {
-			//no more cell inbetween?
+			//no more cell inbetween? (the last one may still be the good one)
             if (middle==begin)
-                return m_numberOfProjectedPoints;
+                return ((m_thePointsAndTheirCellCodes[end].theCode >> bitDec) == truncatedCellCode ? end : m_numberOfProjectedPoints);
 			begin = middle;
         }
         else if (middleCode > truncatedCellCode)
@@ -2359,6 +2634,192 @@ int DgmOctree::getPointsInSphericalNeighbourhood(const CCVector3& sphereCenter,
 	return (int)n;
 }
 
+//! Cell to be scanned (see DgmOctree::findNearestPointInConvexVolume)
+struct ConvexVolumeCell
+{
+	//! Index of the first point of the cell
+	unsigned first;
+	//! Index of the last point of the cell (excluded)
+	unsigned last;
+	//! Truncated cell code
+	DgmOctree::OctreeCellCodeType code;
+	//! Subdivision level
+	uchar level;
+	//! Whether the cell is totally inside the volume
+	bool inside;
+	//! Minimal depth of the cell
+	double minDepth;
+};
+
+//! Minimal number of points in a cell to subdivide it (see DgmOctree::findNearestPointInConvexVolume)
+static const unsigned MIN_POINTS_TO_SUBDIVIDE_CELL = 16;
+
+bool DgmOctree::findNearestPointInConvexVolume(	const double planes[][4],
+												unsigned planeCount,
+												const double depthEquation[4],
+												unsigned& nearestPointIndex,
+												double& nearestPointDepth) const
+{
+	if (m_numberOfProjectedPoints == 0)
+		return false;
+
+	bool found = false;
+	double bestDepth = 0.0;
+
+	//cells to scan (the last one is the nearest)
+	std::vector<ConvexVolumeCell> cells;
+	try
+	{
+		cells.reserve(8*MAX_OCTREE_LEVEL);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return false;
+	}
+
+	//root cell
+	{
+		ConvexVolumeCell root;
+		root.first = 0;
+		root.last = m_numberOfProjectedPoints;
+		root.code = 0;
+		root.level = 0;
+		root.inside = false;
+		root.minDepth = -std::numeric_limits<double>::max();
+		cells.push_back(root);
+	}
+
+	ConvexVolumeCell children[8];
+
+	while (!cells.empty())
+	{
+		ConvexVolumeCell cell = cells.back();
+		cells.pop_back();
+
+		//farther than the current nearest point?
+		if (found && cell.minDepth >= bestDepth)
+			continue;
+
+		//small (or deepest) cell: we test its points
+		if (cell.level == MAX_OCTREE_LEVEL || cell.last-cell.first <= MIN_POINTS_TO_SUBDIVIDE_CELL)
+		{
+			for (unsigned i=cell.first; i<cell.last; ++i)
+			{
+				unsigned pointIndex = m_thePointsAndTheirCellCodes[i].theIndex;
+				const CCVector3* P = m_theAssociatedCloud->getPointPersistentPtr(pointIndex);
+				double X = static_cast<double>(P->x);
+				double Y = static_cast<double>(P->y);
+				double Z = static_cast<double>(P->z);
+
+				double depth = depthEquation[0]*X + depthEquation[1]*Y + depthEquation[2]*Z + depthEquation[3];
+				if (found && depth >= bestDepth)
+					continue;
+
+				if (!cell.inside)
+				{
+					unsigned j=0;
+					for (; j<planeCount; ++j)
+						if (planes[j][0]*X + planes[j][1]*Y + planes[j][2]*Z + planes[j][3] < 0.0)
+							break;
+					if (j < planeCount) //outside
+						continue;
+				}
+
+				nearestPointIndex = pointIndex;
+				bestDepth = depth;
+				found = true;
+			}
+			continue;
+		}
+
+		//otherwise we look at its children (they are contiguous and sorted)
+		uchar childLevel = cell.level+1;
+		uchar bitDec = GET_BIT_SHIFT(childLevel);
+		const PointCoordinateType& cs = getCellSize(childLevel);
+		//small margin to be robust to the rounding errors of the points projection
+		double halfSize = static_cast<double>(cs)*(0.5+1.0e-4);
+
+		unsigned childCount = 0;
+		unsigned first = cell.first;
+		for (unsigned c=0; c<8 && first<cell.last; ++c)
+		{
+			OctreeCellCodeType childCode = ((cell.code << 3) | static_cast<OctreeCellCodeType>(c));
+			OctreeCellCodeType nextCode = ((childCode+1) << bitDec);
+
+			//first point of the next child
+			unsigned last = first;
+			if (m_thePointsAndTheirCellCodes[first].theCode < nextCode)
+			{
+				unsigned lo = first+1;
+				unsigned hi = cell.last;
+				while (lo < hi)
+				{
+					unsigned mid = lo + ((hi-lo)>>1);
+					if (m_thePointsAndTheirCellCodes[mid].theCode < nextCode)
+						lo = mid+1;
+					else
+						hi = mid;
+				}
+				last = lo;
+			}
+			if (last == first) //empty child
+				continue;
+
+			ConvexVolumeCell& child = children[childCount];
+			child.first = first;
+			child.last = last;
+			child.code = childCode;
+			child.level = childLevel;
+			first = last;
+
+			//child position with respect to the volume
+			PointCoordinateType center[3];
+			computeCellCenter(childCode,childLevel,center,true);
+			double C[3] = {static_cast<double>(center[0]),static_cast<double>(center[1]),static_cast<double>(center[2])};
+
+			child.inside = cell.inside;
+			bool outside = false;
+			if (!child.inside)
+			{
+				child.inside = true;
+				for (unsigned j=0; j<planeCount; ++j)
+				{
+					double d = planes[j][0]*C[0] + planes[j][1]*C[1] + planes[j][2]*C[2] + planes[j][3];
+					double r = halfSize * (fabs(planes[j][0]) + fabs(planes[j][1]) + fabs(planes[j][2]));
+					if (d + r < 0.0)
+					{
+						outside = true;
+						break;
+					}
+					if (d - r < 0.0)
+						child.inside = false;
+				}
+			}
+			if (outside)
+				continue;
+
+			child.minDepth = depthEquation[0]*C[0] + depthEquation[1]*C[1] + depthEquation[2]*C[2] + depthEquation[3]
+							- halfSize * (fabs(depthEquation[0]) + fabs(depthEquation[1]) + fabs(depthEquation[2]));
+			if (found && child.minDepth >= bestDepth)
+				continue;
+
+			++childCount;
+		}
+
+		//we push the nearest children last (so that they are scanned first)
+		for (unsigned a=1; a<childCount; ++a)
+			for (unsigned b=a; b>0 && children[b-1].minDepth < children[b].minDepth; --b)
+				std::swap(children[b-1],children[b]);
+		for (unsigned a=0; a<childCount; ++a)
+			cells.push_back(children[a]);
+	}
+
+	if (found)
+		nearestPointDepth = bestDepth;
+
+	return found;
+}
+
 #ifdef COMPUTE_NN_SEARCH_STATISTICS
 static double s_skippedPoints = 0.0;
 static double s_testedPoints = 0.0;
@@ -2853,413 +3314,440 @@ uchar DgmOctree::findBestLevelForAGivenCellNumber(unsigned indicativeNumberOfCel
     return bestLevel;
 }
 
-int DgmOctree::extractCCs(uchar level, bool sixConnexity, GenericProgressCallback* progressCb) const
+/*** Connected components labelling (on sorted cell codes) ***/
+
+#ifdef ENABLE_MT_OCTREE
+//! Union-find parent type (concurrent version)
+typedef QAtomicInt ccParentType;
+//! Compare-and-swap on a union-find parent (concurrent version)
+static inline bool ParentCAS(ccParentType& parent, int expectedValue, int newValue)
 {
-    std::vector<OctreeCellCodeType> cellCodes;
-    getCellCodes(level,cellCodes);
-    return extractCCs(cellCodes, level, sixConnexity, progressCb);
+	return parent.testAndSetOrdered(expectedValue,newValue);
 }
-
-int DgmOctree::extractCCs(const cellCodesContainer& cellCodes, uchar level, bool sixConnexity, GenericProgressCallback* progressCb) const
+#else
+//! Union-find parent type (sequential version)
+typedef int ccParentType;
+//! Compare-and-swap on a union-find parent (sequential version)
+static inline bool ParentCAS(ccParentType& parent, int expectedValue, int newValue)
 {
-    size_t numberOfCells = cellCodes.size();
-	if (numberOfCells == 0) //no cells!
-        return -1;
+	if (parent != expectedValue)
+		return false;
+	parent = newValue;
+	return true;
+}
+#endif
 
-	//filled octree cells
-	std::vector<IndexAndCode> ccCells;
-	try
+//! Returns the root of a cell in the union-find forest (with path halving)
+/** Safe to call concurrently: path halving only replaces a parent by one
+	of its ancestors, and is simply skipped if another thread got there first.
+**/
+static unsigned FindCellRoot(ccParentType* parents, unsigned i)
+{
+	while (true)
 	{
-		ccCells.resize(numberOfCells);
+		unsigned p = static_cast<unsigned>(static_cast<int>(parents[i]));
+		if (p == i)
+			return i;
+		unsigned gp = static_cast<unsigned>(static_cast<int>(parents[p]));
+		if (gp != p)
+			ParentCAS(parents[i],static_cast<int>(p),static_cast<int>(gp));
+		i = gp;
 	}
-	catch (std::bad_alloc)
+}
+
+//! Merges the components of two cells (lock-free)
+/** The root with the largest index is always linked to the other one, so
+	that no cycle can appear. The link only succeeds if the former is still
+	a root (otherwise we simply try again with the new roots).
+**/
+static void UniteCells(ccParentType* parents, unsigned a, unsigned b)
+{
+	while (true)
 	{
-		//not enough memory
-		return -2;
+		a = FindCellRoot(parents,a);
+		b = FindCellRoot(parents,b);
+		if (a == b)
+			return;
+		if (a < b)
+			std::swap(a,b);
+		if (ParentCAS(parents[a],static_cast<int>(a),static_cast<int>(b)))
+			return;
 	}
+}
 
-    //we compute the position of each cell (grid coordinates)
-    int indexMin[3],indexMax[3];
-	{
-		//binary shift for cell code truncation
-		uchar bitDec = GET_BIT_SHIFT(level);
+//! Connected components labelling job (range of cells)
+struct ccLabellingJob
+{
+	//! Cells (sorted by truncated code)
+	const DgmOctree::IndexAndCode* cells;
+	//! Union-find forest (one parent per cell)
+	ccParentType* parents;
+	//! Subdivision level
+	uchar level;
+	//! Whether to use 6-connexity (26 otherwise)
+	bool sixConnexity;
+	//! First cell index
+	unsigned first;
+	//! Last cell index (excluded)
+	unsigned last;
+};
 
-		for (size_t i=0; i<numberOfCells; i++)
-		{
-			ccCells[i].theCode = (cellCodes[i] >> bitDec);
+//! Returns whether two cells have the same code (see std::unique)
+static bool SameCellCode(const DgmOctree::IndexAndCode& a, const DgmOctree::IndexAndCode& b)
+{
+	return a.theCode == b.theCode;
+}
 
-			int pos[3];
-			getCellPos(ccCells[i].theCode,level,pos,true);
+//! Looks for a given (truncated) cell code in [0,end[
+/** The search starts from a hint (typically the result of the previous
+	search for the same neighbour shift): as the codes of the neighbours of
+	consecutive cells are nearly sorted as well, we gallop from it before
+	performing a binary search.
+	\param cells cells (sorted by code)
+	\param end end of the search range
+	\param code code to look for
+	\param hint starting position (updated with the lower bound of 'code')
+	\return the cell index or 'end' if the code couldn't be found
+**/
+static unsigned FindCell(const DgmOctree::IndexAndCode* cells, unsigned end, DgmOctree::OctreeCellCodeType code, unsigned& hint)
+{
+	if (end == 0)
+		return end;
 
-			//we look for the actual min and max dimensions of the input cells set
-			//(which may not be the whole set of octree cells!)
-			if (i != 0)
-			{
-				for (unsigned char k=0; k<3; k++)
-				{
-					if (pos[k] < indexMin[k])
-						indexMin[k] = pos[k];
-					else if (pos[k] > indexMax[k])
-						indexMax[k] = pos[k];
-				}
-			}
-			else
+	unsigned lo = 0;
+	unsigned hi = end;
+	unsigned start = std::min(hint,end-1);
+	if (cells[start].theCode < code)
+	{
+		//gallop forward
+		lo = start+1;
+		for (unsigned step=1; lo+step<end; step<<=1)
+		{
+			if (cells[lo+step-1].theCode >= code)
 			{
-				indexMin[0] = indexMax[0] = pos[0];
-				indexMin[1] = indexMax[1] = pos[1];
-				indexMin[2] = indexMax[2] = pos[2];
+				hi = lo+step-1;
+				break;
 			}
-
-			//Warning: the cells will have to be sorted inside a slice afterwards!
-			ccCells[i].theIndex = (	static_cast<unsigned>(pos[0])				)
-								+ (	static_cast<unsigned>(pos[1]) << level		)
-								+ (	static_cast<unsigned>(pos[2]) << (2*level)	);
+			lo += step;
 		}
 	}
-
-    //we deduce the size of the grid that totally include input cells
-    int gridSize[3];
+	else
 	{
-		for (unsigned char k=0; k<3; k++)
+		//gallop backward
+		hi = start;
+		for (unsigned step=1; step<=hi; step<<=1)
 		{
-			gridSize[k] = indexMax[k] - indexMin[k] + 1;
+			if (cells[hi-step].theCode < code)
+			{
+				lo = hi-step+1;
+				break;
+			}
+			hi -= step;
 		}
+		++hi; //'start' is still a candidate
+		if (hi > end)
+			hi = end;
 	}
 
-    //we sort the cells
-    std::sort(ccCells.begin(),ccCells.end(),IndexAndCode::indexComp); //ascending index code order
-
-    const int& di = gridSize[0];
-    const int& dj = gridSize[1];
-    const int& step = gridSize[2];
-
-    //instrumentation pour la recherche des 4 ou 8 voisins en 2D (donc en 3D --> 6 ou 26 voisins)
-    uchar neighborsInCurrentSlice=0, neighborsInPrecedingSlice=0;
-    int currentSliceNeighborsShifts[4], precedingSliceNeighborsShifts[9]; //maximum size to simplify code...
-
-	if (sixConnexity) //6-connexity
-    {
-        neighborsInCurrentSlice = 2;
-        currentSliceNeighborsShifts[0] = -(di+2);
-        currentSliceNeighborsShifts[1] = -1;
-
-        neighborsInPrecedingSlice = 1;
-        precedingSliceNeighborsShifts[0] = 0;
-    }
-    else //26-connexity
-    {
-        neighborsInCurrentSlice = 4;
-        currentSliceNeighborsShifts[0] = -1-(di+2);
-        currentSliceNeighborsShifts[1] = -(di+2);
-        currentSliceNeighborsShifts[2] = 1-(di+2);
-        currentSliceNeighborsShifts[3] = -1;
-
-        neighborsInPrecedingSlice = 9;
-        precedingSliceNeighborsShifts[0] = -1-(di+2);
-        precedingSliceNeighborsShifts[1] = -(di+2);
-        precedingSliceNeighborsShifts[2] = 1-(di+2);
-        precedingSliceNeighborsShifts[3] = -1;
-        precedingSliceNeighborsShifts[4] = 0;
-        precedingSliceNeighborsShifts[5] = 1;
-        precedingSliceNeighborsShifts[6] = -1+(di+2);
-        precedingSliceNeighborsShifts[7] = (di+2);
-        precedingSliceNeighborsShifts[8] = 1+(di+2);
-    }
-
-	//shared structures (to avoid repeated allocations)
-    std::vector<int> neighboursVal, neighboursMin;
-	try
-	{
-		neighboursVal.reserve(neighborsInCurrentSlice+neighborsInPrecedingSlice);
-		neighboursMin.reserve(neighborsInCurrentSlice+neighborsInPrecedingSlice);
-	}
-	catch(std::bad_alloc)
+	//binary search (lower bound) in [lo,hi[
+	while (lo < hi)
 	{
-		//not enough memory
-		return -2;
+		unsigned mid = lo + ((hi-lo)>>1);
+		if (cells[mid].theCode < code)
+			lo = mid+1;
+		else
+			hi = mid;
 	}
 
-    //temporary virtual 'slices'
-    int sliceSize = (di+2)*(dj+2); //add a margin to avoid "boundary effects"
-    int *slice = new int[sliceSize];
-    if (!slice) //Not enough memory
-        return -2;
-
-    int *oldSlice = new int[sliceSize];
-    if (!oldSlice) //Not enough memory
-    {
-        delete[] slice;
-        return -2;
-    }
-
-    //equivalence table between 'on the fly' labels
-    int* equivalentLabels = new int[numberOfCells+2];
-    if (!equivalentLabels) //Not enough memory
-    {
-        delete[] slice;
-        delete[] oldSlice;
-        return -2;
-    }
-    memset(equivalentLabels,0,sizeof(int)*(numberOfCells+2));
-
-    //equivalence between a cell index and its label
-    int* cellIndexToLabel = new int[numberOfCells];
-    if (!cellIndexToLabel) //Not enough memory
-    {
-        delete[] slice;
-        delete[] oldSlice;
-        delete[] equivalentLabels;
-        return -2;
-    }
-    memset(cellIndexToLabel,0,sizeof(int)*numberOfCells);
-
-    //progress notification
-	NormalizedProgress* nprogress = 0;
-    if (progressCb)
-    {
-        progressCb->reset();
-		nprogress = new NormalizedProgress(progressCb,step);
-        progressCb->setMethodTitle("Components Labeling");
-        char buffer[256];
-		sprintf(buffer,"Box: [%i*%i*%i]",gridSize[0],gridSize[1],gridSize[2]);
-        progressCb->setInfo(buffer);
-        progressCb->start();
-    }
-
-    //preceding slice is empty by default
-    memset(oldSlice,0,sizeof(int)*sliceSize);
-
-    //current label
-    size_t currentLabel = 1;
+	hint = lo;
+	return (lo < end && cells[lo].theCode == code ? lo : end);
+}
 
-    //on parcours chaque tranche
+//! Unites each cell of a job with its (already visited) neighbours
+/** Neighbours codes are directly deduced from the cell code: the bits of each
+	dimension are isolated with a mask, and incremented/decremented as a
+	'dilated' integer. Cell codes are monotonic along each dimension: we only
+	have to look for the neighbours with a smaller code (i.e. before the
+	current cell).
+**/
+static void LabelCells(ccLabellingJob& job)
+{
+	//bit mask of each dimension (x: bits 0,3,6,... / y: bits 1,4,7,... / z: bits 2,5,8,...)
+	DgmOctree::OctreeCellCodeType dimMasks[3] = {0,0,0};
+	for (uchar k=0; k<job.level; ++k)
+		dimMasks[0] |= (static_cast<DgmOctree::OctreeCellCodeType>(1) << (3*k));
+	dimMasks[1] = (dimMasks[0] << 1);
+	dimMasks[2] = (dimMasks[0] << 2);
+
+	//one search hint per neighbour
+	unsigned hints[27];
+	for (unsigned n=0; n<27; ++n)
+		hints[n] = job.first;
+
+	for (unsigned i=job.first; i<job.last; ++i)
 	{
-		unsigned counter = 0;
-		const unsigned gridCoordMask = (1 << level)-1;
-		std::vector<IndexAndCode>::const_iterator _ccCells = ccCells.begin();
+		DgmOctree::OctreeCellCodeType code = job.cells[i].theCode;
 
-		for (int k = indexMin[2]; k < indexMin[2]+step; k++)
+		//bits of the previous/current/next cell along each dimension
+		DgmOctree::OctreeCellCodeType dimBits[3][3];
+		bool dimValid[3][3];
+		for (unsigned d=0; d<3; ++d)
 		{
-			//on initialise la tranche "courante"
-			memset(slice,0,sizeof(int)*sliceSize);
+			const DgmOctree::OctreeCellCodeType& mask = dimMasks[d];
+			DgmOctree::OctreeCellCodeType bits = (code & mask);
+			dimBits[d][0] = ((bits - 1) & mask);
+			dimValid[d][0] = (bits != 0);
+			dimBits[d][1] = bits;
+			dimValid[d][1] = true;
+			dimBits[d][2] = (((bits | ~mask) + 1) & mask);
+			dimValid[d][2] = (bits != mask);
+		}
 
-			//pour chaque cellule de la tranche
-			while (counter<numberOfCells && (int)(_ccCells->theIndex >> (level<<1)) == k)
+		unsigned n = 0;
+		for (unsigned k=0; k<3; ++k)
+		{
+			for (unsigned j=0; j<3; ++j)
 			{
-				int iind = int(_ccCells->theIndex & gridCoordMask);
-				int jind = int((_ccCells->theIndex >> level) & gridCoordMask);
-				int cellIndex = (iind-indexMin[0]+1) + (jind-indexMin[1]+1)*(di+2);
-				++_ccCells;
-
-				//on regarde si la cellule a des voisins
-				//dans la tranche
-				int* _slice = slice + cellIndex;
+				for (unsigned l=0; l<3; ++l,++n)
 				{
-					for (uchar n=0; n<neighborsInCurrentSlice; n++)
-					{
-						assert(cellIndex+currentSliceNeighborsShifts[n]<sliceSize);
-						const int& neighborLabel = _slice[currentSliceNeighborsShifts[n]];
-						if (neighborLabel>1)
-							neighboursVal.push_back(neighborLabel);
-					}
+					if (!dimValid[0][l] || !dimValid[1][j] || !dimValid[2][k])
+						continue;
+					if (job.sixConnexity && (l != 1) + (j != 1) + (k != 1) != 1)
+						continue;
+
+					DgmOctree::OctreeCellCodeType neighbourCode = (dimBits[0][l] | dimBits[1][j] | dimBits[2][k]);
+					if (neighbourCode >= code) //includes the cell itself
+						continue;
+
+					unsigned c = FindCell(job.cells,i,neighbourCode,hints[n]);
+					if (c < i)
+						UniteCells(job.parents,i,c);
 				}
+			}
+		}
+	}
+}
 
-				//et dans la tranche precedente
-				int* _oldSlice = oldSlice + cellIndex;
-				{
-					for (uchar n=0; n<neighborsInPrecedingSlice; n++)
-					{
-						assert(cellIndex+precedingSliceNeighborsShifts[n]<sliceSize);
-						const int& neighborLabel = _oldSlice[precedingSliceNeighborsShifts[n]];
-						if (neighborLabel>1)
-							neighboursVal.push_back(neighborLabel);
-					}
-				}
+#ifdef ENABLE_MT_OCTREE
+//! Wrapper for QtConcurrent::blockingMap
+static void LabelCells_MT(ccLabellingJob& job)
+{
+	LabelCells(job);
+}
+#endif
 
-				//number of neighbors for current cell
-				uchar p = (uchar)neighboursVal.size();
+int DgmOctree::extractCCs(uchar level, bool sixConnexity, GenericProgressCallback* progressCb) const
+{
+    std::vector<OctreeCellCodeType> cellCodes;
+    getCellCodes(level,cellCodes);
+    return extractCCs(cellCodes, level, sixConnexity, progressCb);
+}
 
-				if (p==0) //no neighbor
-				{
-					*_slice = (int)(++currentLabel); //we create a new label
-				}
-				else if (p==1) //1 neighbor
-				{
-					*_slice = neighboursVal.back(); //we'll use its label
-					neighboursVal.pop_back();
-				}
-				else //more than 1 neighbor?
-				{
-					//we get the smallest label
-					std::sort(neighboursVal.begin(),neighboursVal.end());
-					int smallestLabel = neighboursVal[0];
+int DgmOctree::extractCCs(const cellCodesContainer& cellCodes, uchar level, bool sixConnexity, GenericProgressCallback* progressCb) const
+{
+	size_t numberOfCells = cellCodes.size();
+	if (numberOfCells == 0) //no cells!
+		return -1;
+	//the union-find forest relies on 32 bits (signed) indexes
+	if (numberOfCells >= (static_cast<size_t>(1) << 31))
+		return -2;
 
-					//s'ils ne sont pas tous pareils
-					if (smallestLabel != neighboursVal.back())
-					{
-						int lastLabel = 0;
-						neighboursMin.clear();
-						//we get the smallest equivalent label for each neighbor's branch
-						{
-							for (uchar n=0; n<p; n++)
-							{
-								// ... on part de son indice de CC
-								int label = neighboursVal[n];
-								//s'il n'est pas egal a celui du voisin d'avant
-								if (label != lastLabel)
-								{
-									//on met a jour la notion "d'avant"
-									assert(label<(int)numberOfCells+2);
-									lastLabel = label;
-
-									//on cherche a quoi il est vraiment equivalent
-									while (equivalentLabels[label] > 1)
-									{
-										label = equivalentLabels[label];
-										assert(label<(int)numberOfCells+2);
-									}
-
-									neighboursMin.push_back(label);
-								}
-							}
-						}
+	//binary shift for cell code truncation
+	uchar bitDec = GET_BIT_SHIFT(level);
 
-						//get the smallest one
-						std::sort(neighboursMin.begin(),neighboursMin.end());
-						smallestLabel = neighboursMin[0];
+	//filled octree cells (sorted by truncated code)
+	std::vector<IndexAndCode> ccCells;
+	ccParentType* parents = 0;
+	try
+	{
+		ccCells.resize(numberOfCells);
+		for (size_t i=0; i<numberOfCells; ++i)
+		{
+			ccCells[i].theCode = (cellCodes[i] >> bitDec);
+			ccCells[i].theIndex = static_cast<unsigned>(i);
+		}
 
-						//update the equivalence table by the way
-						//for all other branches
-						lastLabel = smallestLabel;
-						{
-							for (uchar n=1; n<neighboursMin.size(); n++)
-							{
-								int label = neighboursMin[n];
-								assert(label<(int)numberOfCells+2);
-								//we don't process it if it's the same label as the precedent neighbor
-								if (label != lastLabel)
-								{
-									equivalentLabels[label] = smallestLabel;
-									lastLabel = label;
-								}
-							}
-						}
-					}
+		//codes coming from the octree itself are already sorted
+		bool sorted = true;
+		for (size_t i=1; i<numberOfCells && sorted; ++i)
+			sorted = (ccCells[i-1].theCode < ccCells[i].theCode);
+		if (!sorted)
+		{
+			std::sort(ccCells.begin(),ccCells.end(),IndexAndCode::codeComp);
+			ccCells.erase(std::unique(ccCells.begin(),ccCells.end(),SameCellCode),ccCells.end());
+			numberOfCells = ccCells.size();
+		}
 
-					//update current cell label
-					*_slice = smallestLabel;
-					neighboursVal.clear();
-				}
+		parents = new ccParentType[numberOfCells];
+	}
+	catch (.../*const std::bad_alloc&*/)
+	{
+		//not enough memory
+		return -2;
+	}
 
-				cellIndexToLabel[counter++] = *_slice;
-			}
+	for (size_t i=0; i<numberOfCells; ++i)
+		parents[i] = static_cast<int>(i);
 
-			if (counter==numberOfCells)
-				break;
+	//labelling jobs (small ones, so that we can update the progress bar between two waves)
+	static const unsigned s_cellsPerJob = 65536;
+	unsigned jobCount = static_cast<unsigned>((numberOfCells + s_cellsPerJob - 1) / s_cellsPerJob);
+	std::vector<ccLabellingJob> jobs;
+	try
+	{
+		jobs.resize(jobCount);
+	}
+	catch (.../*const std::bad_alloc&*/)
+	{
+		delete[] parents;
+		return -2;
+	}
+	for (unsigned j=0; j<jobCount; ++j)
+	{
+		ccLabellingJob& job = jobs[j];
+		job.cells = &(ccCells[0]);
+		job.parents = parents;
+		job.level = level;
+		job.sixConnexity = sixConnexity;
+		job.first = j*s_cellsPerJob;
+		job.last = std::min(job.first+s_cellsPerJob,static_cast<unsigned>(numberOfCells));
+	}
 
-			std::swap(slice,oldSlice);
+	//progress notification
+	NormalizedProgress* nprogress = 0;
+	if (progressCb)
+	{
+		progressCb->reset();
+		nprogress = new NormalizedProgress(progressCb,jobCount);
+		progressCb->setMethodTitle("Components Labeling");
+		char buffer[256];
+		sprintf(buffer,"Cells: %u",static_cast<unsigned>(numberOfCells));
+		progressCb->setInfo(buffer);
+		progressCb->start();
+	}
 
+	//union-find on the cells
+	{
+#ifdef ENABLE_MT_OCTREE
+		unsigned waveSize = 4*static_cast<unsigned>(std::max(QThread::idealThreadCount(),1));
+#else
+		unsigned waveSize = 1;
+#endif
+		for (unsigned j=0; j<jobCount; j+=waveSize)
+		{
+			unsigned waveEnd = std::min(j+waveSize,jobCount);
+#ifdef ENABLE_MT_OCTREE
+			QtConcurrent::blockingMap(jobs.begin()+j, jobs.begin()+waveEnd, LabelCells_MT);
+#else
+			for (unsigned w=j; w<waveEnd; ++w)
+				LabelCells(jobs[w]);
+#endif
 			if (nprogress)
-				nprogress->oneStep();
+				for (unsigned w=j; w<waveEnd; ++w)
+					nprogress->oneStep();
 		}
 	}
 
-    //on libere un peu la memoire
-    delete[] slice;
-    delete[] oldSlice;
-
-    if (progressCb)
+	if (progressCb)
 	{
 		progressCb->stop();
-        if (nprogress)
+		if (nprogress)
 			delete nprogress;
 		nprogress=0;
 	}
 
-    if (currentLabel<2) //No CC found !!!
-    {
-        delete[] cellIndexToLabel;
-        delete[] equivalentLabels;
-        return -3;
-    }
-
-    //path compression (http://en.wikipedia.org/wiki/Union_find)
-    assert(currentLabel<numberOfCells+2);
+	//we label the components in the order of their first cell in the (z,y,x) grid order
+	//(so as to keep the same labels as the original 'slice-based' implementation)
+	std::vector<unsigned> cellRoots;
+	std::vector<IndexAndCode> components;
+	try
 	{
-		for (size_t i=2; i<=currentLabel; i++)
+		cellRoots.resize(numberOfCells);
+		for (size_t i=0; i<numberOfCells; ++i)
 		{
-			int label = equivalentLabels[i];
-			assert(label<(int)numberOfCells+2);
-			while (equivalentLabels[label] > 1) //il faut donc que equivalentLabels[0]==0 !!!
-			{
-				label = equivalentLabels[label];
-				assert(label<(int)numberOfCells+2);
-			}
-			equivalentLabels[i] = label;
+			unsigned root = FindCellRoot(parents,static_cast<unsigned>(i));
+			cellRoots[i] = root;
+			if (root == i)
+				components.push_back(IndexAndCode(root,0));
 		}
 	}
-
-    //update leafs
+	catch (.../*const std::bad_alloc&*/)
 	{
-		for (size_t i=0; i<numberOfCells; i++)
-		{
-			int label = cellIndexToLabel[i];
-			assert(label<(int)numberOfCells+2);
-			if (equivalentLabels[label]>1)
-				cellIndexToLabel[i] = equivalentLabels[label];
-		}
+		delete[] parents;
+		return -2;
 	}
+	delete[] parents;
+	parents = 0;
 
-    //hack: we use "equivalentLabels" to count how many components will have to be created
-	int numberOfComponents = 0;
+	if (components.empty()) //No CC found !!!
+		return -3;
+
+	//minimal (z,y,x) key of each component
 	{
-		memset(equivalentLabels,0,(numberOfCells+2)*sizeof(int));
+		//temporary association: root --> component index
+		std::vector<unsigned> rootToComponent;
+		try
+		{
+			rootToComponent.resize(numberOfCells,0);
+		}
+		catch (.../*const std::bad_alloc&*/)
+		{
+			return -2;
+		}
+		for (size_t c=0; c<components.size(); ++c)
+		{
+			rootToComponent[components[c].theIndex] = static_cast<unsigned>(c);
+			components[c].theCode = ~static_cast<OctreeCellCodeType>(0);
+		}
 
-		for (size_t i=0; i<numberOfCells; i++)
+		for (size_t i=0; i<numberOfCells; ++i)
 		{
-			assert(cellIndexToLabel[i]>1 && cellIndexToLabel[i]<(int)numberOfCells+2);
-			equivalentLabels[cellIndexToLabel[i]]=1;
+			int pos[3];
+			getCellPos(ccCells[i].theCode,level,pos,true);
+			OctreeCellCodeType key =	(	static_cast<OctreeCellCodeType>(pos[0])				)
+									+	(	static_cast<OctreeCellCodeType>(pos[1]) << level	)
+									+	(	static_cast<OctreeCellCodeType>(pos[2]) << (2*level));
+
+			OctreeCellCodeType& minKey = components[rootToComponent[cellRoots[i]]].theCode;
+			if (key < minKey)
+				minKey = key;
 		}
 
-		//we create (following) indexes for each components
-		for (size_t i=2; i<numberOfCells+2; i++)
-			if (equivalentLabels[i]==1)
-				equivalentLabels[i]=++numberOfComponents; //labels start at '1'
+		std::sort(components.begin(),components.end(),IndexAndCode::codeComp);
+
+		//we replace each cell root by its final label (labels start at '1')
+		for (size_t c=0; c<components.size(); ++c)
+			rootToComponent[components[c].theIndex] = static_cast<unsigned>(c+1);
+		for (size_t i=0; i<numberOfCells; ++i)
+			cellRoots[i] = rootToComponent[cellRoots[i]];
 	}
-    assert(equivalentLabels[0]==0);
-    assert(equivalentLabels[1]==0);
 
-    //we flag each component's points with its label
+	//we flag each component's points with its label
 	{
 		if (progressCb)
 		{
 			progressCb->reset();
-			nprogress = new NormalizedProgress(progressCb,(unsigned)numberOfCells);
+			nprogress = new NormalizedProgress(progressCb,m_numberOfProjectedPoints);
 			char buffer[256];
-			sprintf(buffer,"Components: %i",numberOfComponents);
+			sprintf(buffer,"Components: %u",static_cast<unsigned>(components.size()));
 			progressCb->setMethodTitle("Connected Components Extraction");
 			progressCb->setInfo(buffer);
 			progressCb->start();
 		}
 
-		for (size_t i=0; i<numberOfCells; i++)
+		//both the points and the cells are sorted by code: we simply walk along them
+		size_t c = 0;
+		cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin();
+		for (unsigned i=0; i<m_numberOfProjectedPoints; ++i,++p)
 		{
-			assert(cellIndexToLabel[i]<(int)numberOfCells+2);
+			OctreeCellCodeType truncatedCode = (p->theCode >> bitDec);
+			while (c < numberOfCells && ccCells[c].theCode < truncatedCode)
+				++c;
+			if (c == numberOfCells)
+				break;
 
-			const int& label = equivalentLabels[cellIndexToLabel[i]];
-			assert(label>0);
-			ReferenceCloud* Y = getPointsInCell(ccCells[i].theCode,level,true);
-			assert(Y);
-			if (Y)
-			{
-				Y->placeIteratorAtBegining();
-				ScalarType d = static_cast<ScalarType>(label);
-				for (unsigned j=0; j<Y->size(); ++j)
-				{
-					Y->setCurrentPointScalarValue(d);
-					Y->forwardIterator();
-				}
-			}
+			if (ccCells[c].theCode == truncatedCode)
+				m_theAssociatedCloud->setPointScalarValue(p->theIndex,static_cast<ScalarType>(cellRoots[c]));
 
 			if (nprogress)
 				nprogress->oneStep();
@@ -3274,12 +3762,7 @@ int DgmOctree::extractCCs(const cellCodesContainer& cellCodes, uchar level, bool
 		}
 	}
 
-	if (cellIndexToLabel)
-		delete[] cellIndexToLabel;
-	if (equivalentLabels)
-		delete[] equivalentLabels;
-
-    return 0;
+	return 0;
 }
 
 #ifdef ENABLE_SANKARANARAYANAN_NN_SEARCH
@@ -3634,16 +4117,39 @@ DgmOctree::octreeCell::octreeCell(DgmOctree* _parentOctree)
     , level(0)
     , truncatedCode(0)
     , index(0)
-    , points(0)
+    , pointCount(0)
+    , pointsAndCodes(0)
+    , m_points(0)
+    , m_pointsSource(0)
 {
     assert(parentOctree && parentOctree->m_theAssociatedCloud);
-    points = new ReferenceCloud(parentOctree->m_theAssociatedCloud);
+    m_points = new ReferenceCloud(parentOctree->m_theAssociatedCloud);
 }
 
 DgmOctree::octreeCell::~octreeCell()
 {
-    if (points)
-        delete points;
+    if (m_points)
+        delete m_points;
+}
+
+ReferenceCloud* DgmOctree::octreeCell::getPoints() const
+{
+	assert(pointsAndCodes || pointCount == 0);
+
+	//already filled for this cell?
+	if (m_pointsSource == pointsAndCodes && m_points->size() == pointCount)
+		return m_points;
+
+	m_points->clear(false);
+	m_pointsSource = 0;
+	if (!m_points->reserve(pointCount)) //not enough memory
+		return 0;
+
+	for (unsigned i=0; i<pointCount; ++i)
+		m_points->addPointIndex(pointsAndCodes[i].theIndex); //can't fail (see above)
+	m_pointsSource = pointsAndCodes;
+
+	return m_points;
 }
 
 unsigned DgmOctree::executeFunctionForAllCellsAtLevel(uchar level,
@@ -3655,13 +4161,8 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel(uchar level,
     if (m_thePointsAndTheirCellCodes.empty())
         return 0;
 
-	//we get the maximum cell population for this level
-	unsigned maxCellPopulation=m_maxCellPopulation[level];
-
     //cell descriptor (initialize it with first cell/point)
     octreeCell cell(this);
-	if (!cell.points->reserve(maxCellPopulation)) //not enough memory
-		return 0;
 	cell.level=level;
     cell.index = 0;
 
@@ -3673,7 +4174,7 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel(uchar level,
 
 	//init with first cell
     cell.truncatedCode = (p->theCode >> bitDec);
-	cell.points->addPointIndex(p->theIndex); //can't fail (see above)
+	cell.pointCount = 1;
 	++p;
 
 	//number of cells for this level
@@ -3710,14 +4211,15 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel(uchar level,
         if (nextCode != cell.truncatedCode)
         {
             //if not, we call the user function on the precedent cell
+			cell.pointsAndCodes = &(m_thePointsAndTheirCellCodes[cell.index]);
             result = (*func)(cell,additionalParameters);
 
 			if (!result)
 				break;
 
 			//and we start a new cell
-            cell.index+=cell.points->size();
-            cell.points->clear(false);
+            cell.index+=cell.pointCount;
+            cell.pointCount = 0;
 			cell.truncatedCode = nextCode;
 
 			if (nprogress && !nprogress->oneStep())
@@ -3728,12 +4230,15 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel(uchar level,
 			}
         }
 
-        cell.points->addPointIndex(p->theIndex); //can't fail (see above)
+        ++cell.pointCount;
     }
 
     //don't forget last cell!
 	if (result)
+	{
+		cell.pointsAndCodes = &(m_thePointsAndTheirCellCodes[cell.index]);
 		result = (*func)(cell,additionalParameters);
+	}
 
 #ifdef COMPUTE_NN_SEARCH_STATISTICS
 	FILE* fp=fopen("octree_log.txt","at");
@@ -3772,13 +4277,8 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel(uchar startingLeve
     if (m_thePointsAndTheirCellCodes.empty())
         return 0;
 
-	//we get the maximum cell population for this level
-	unsigned maxCellPopulation=m_maxCellPopulation[startingLevel];
-
 	//cell descriptor
     octreeCell cell(this);
-	if (!cell.points->reserve(maxCellPopulation)) //not enough memory
-		return 0;
 	cell.level = startingLevel;
 	cell.index = 0;
 
@@ -3971,16 +4471,10 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel(uchar startingLeve
         }
 
 		//we can now really 'add' the points to the cell descriptor
-        cell.points->clear(false);
-		//DGM: already done earlier
-		/*if (!cell.points->reserve(elements)) //not enough memory
-		{
-			result=false;
-			break;
-		}
-		//*/
-		for (unsigned i=0;i<elements;++i)
-			cell.points->addPointIndex((startingElement++)->theIndex);
+		//(the reference cloud is only filled on demand, see octreeCell::getPoints)
+		cell.pointCount = elements;
+		cell.pointsAndCodes = &(*startingElement);
+		startingElement += elements;
 
 		//call user method on current cell
 		result = (*func)(cell,additionalParameters);
@@ -4019,10 +4513,12 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel(uchar startingLeve
 #ifdef ENABLE_MT_OCTREE
 
 #include <QtCore/QtCore>
-#include <QtGui/QApplication>
 
 /*** MULTI THREADING WRAPPER ***/
 
+//! Progress refresh period (in ms) for multi-threaded processes
+#define MT_PROGRESS_REFRESH_PERIOD 100
+
 struct octreeCellDesc
 {
 	DgmOctree::OctreeCellCodeType truncatedCode;
@@ -4030,63 +4526,292 @@ struct octreeCellDesc
 	uchar level;
 };
 
-static DgmOctree* s_octree_MT = 0;
-static DgmOctree::octreeCellFunc s_func_MT = 0;
-static void** s_userParams_MT = 0;
-static NormalizedProgress* s_normProgressCb_MT = 0;
-static bool s_cellFunc_MT_success = true;
+//! Contiguous range of cells processed by a worker (can be stolen by others)
+struct octreeCellQueue_MT
+{
+	//! Mutex protecting the range
+	QMutex mutex;
+	//! First cell (index in the dispatch order)
+	unsigned begin;
+	//! Last cell (excluded)
+	unsigned end;
+
+	octreeCellQueue_MT() : begin(0), end(0) {}
+};
 
-void LaunchOctreeCellFunc_MT(const octreeCellDesc& desc)
+//! Multi-threaded cells dispatch context
+/** Specific to each call of DgmOctree::executeFunctionForAllCellsAtLevel_MT
+	or DgmOctree::executeFunctionForAllCellsAtStartingLevel_MT (so that several
+	octrees can be processed at the same time).
+**/
+struct octreeCellDispatchContext_MT
 {
-	//skip cell if process is aborted/has failed
-	if (!s_cellFunc_MT_success)
-		return;
+	//! Associated octree
+	DgmOctree* octree;
+	//! Function to apply to each cell
+	DgmOctree::octreeCellFunc func;
+	//! Function parameters
+	void** userParams;
+	//! Cells descriptors
+	const std::vector<octreeCellDesc>* cells;
+	//! Order in which cells are dispatched (big cells first, then the others in octree order)
+	std::vector<unsigned> order;
+	//! Number of big cells (at the beginning of 'order')
+	unsigned bigCellsCount;
+	//! Next big cell to process (shared by all workers)
+	QAtomicInt nextBigCell;
+	//! Workers queues
+	octreeCellQueue_MT* queues;
+	//! Number of workers
+	unsigned queuesCount;
+	//! Number of processed cells
+	QAtomicInt processedCells;
+	//! Whether the process should stop (error or cancel requested)
+	QAtomicInt stop;
+
+	octreeCellDispatchContext_MT()
+		: octree(0)
+		, func(0)
+		, userParams(0)
+		, cells(0)
+		, bigCellsCount(0)
+		, nextBigCell(0)
+		, queues(0)
+		, queuesCount(0)
+		, processedCells(0)
+		, stop(0)
+	{
+	}
 
-	if (s_normProgressCb_MT)
+	~octreeCellDispatchContext_MT()
 	{
-		QApplication::processEvents(); //let the application breath!
-		if (!s_normProgressCb_MT->oneStep())
+		if (queues)
+			delete[] queues;
+	}
+
+	//! Returns the next cell to be processed by a given worker
+	/** Big cells are processed first. Then each worker processes its own
+		range of cells. Once its range is empty, it steals half of the
+		remaining range of another worker.
+		\param queueIndex worker index
+		\param cellIndex cell index (output)
+		\return false if there's no more cell to process
+	**/
+	bool nextCell(unsigned queueIndex, unsigned& cellIndex)
+	{
+		if (bigCellsCount != 0)
+		{
+			int bigIndex = nextBigCell.fetchAndAddOrdered(1);
+			if (bigIndex < (int)bigCellsCount)
+			{
+				cellIndex = order[bigIndex];
+				return true;
+			}
+		}
+
+		octreeCellQueue_MT& ownQueue = queues[queueIndex];
 		{
-			s_cellFunc_MT_success = false;
-            return;
+			QMutexLocker locker(&ownQueue.mutex);
+			if (ownQueue.begin < ownQueue.end)
+			{
+				cellIndex = order[ownQueue.begin++];
+				return true;
+			}
 		}
+
+		//work stealing
+		for (unsigned i=1; i<queuesCount; ++i)
+		{
+			octreeCellQueue_MT& victim = queues[(queueIndex+i) % queuesCount];
+			unsigned begin=0,end=0;
+			{
+				QMutexLocker locker(&victim.mutex);
+				if (victim.begin < victim.end)
+				{
+					unsigned remaining = victim.end-victim.begin;
+					begin = victim.end - (remaining+1)/2;
+					end = victim.end;
+					victim.end = begin;
+				}
+			}
+
+			if (begin < end)
+			{
+				cellIndex = order[begin];
+				if (begin+1 < end)
+				{
+					QMutexLocker locker(&ownQueue.mutex);
+					ownQueue.begin = begin+1;
+					ownQueue.end = end;
+				}
+				return true;
+			}
+		}
+
+		return false;
 	}
+};
+
+//! Applies the cell function to a given cell
+/** The cell descriptor (and its reference cloud) belongs to the calling worker
+	and is reused for all the cells it processes.
+**/
+static bool LaunchOctreeCellFunc_MT(octreeCellDispatchContext_MT& context, const octreeCellDesc& desc, DgmOctree::octreeCell& cell)
+{
+	const DgmOctree::cellsContainer& pointsAndCodes = context.octree->pointsAndTheirCellCodes();
+
+	cell.level = desc.level;
+	cell.index = desc.i1;
+	cell.truncatedCode = desc.truncatedCode;
+	cell.pointCount = desc.i2-desc.i1+1;
+	cell.pointsAndCodes = &(pointsAndCodes[desc.i1]);
+
+	return (*context.func)(cell,context.userParams);
+}
+
+//! Worker for multi-threaded cells dispatch
+class octreeCellWorker_MT : public QRunnable
+{
+public:
 
-	const DgmOctree::cellsContainer& pointsAndCodes = s_octree_MT->pointsAndTheirCellCodes();
+	octreeCellWorker_MT(octreeCellDispatchContext_MT* context, unsigned queueIndex)
+		: m_context(context)
+		, m_queueIndex(queueIndex)
+	{
+	}
 
-    //cell descriptor
-    DgmOctree::octreeCell* cell = new DgmOctree::octreeCell(s_octree_MT);
-	cell->level = desc.level;
-	cell->index = desc.i1;
-	cell->truncatedCode = desc.truncatedCode;
-	if (cell->points->reserve(desc.i2-desc.i1+1))
+	virtual void run()
 	{
-		for (unsigned i=desc.i1; i<=desc.i2; ++i)
-			cell->points->addPointIndex(pointsAndCodes[i].theIndex);
+		//one cell descriptor per worker (for the whole traversal)
+		DgmOctree::octreeCell cell(m_context->octree);
 
-		s_cellFunc_MT_success &= (*s_func_MT)(*cell,s_userParams_MT);
+		unsigned cellIndex;
+		while (!m_context->stop && m_context->nextCell(m_queueIndex,cellIndex))
+		{
+			if (!LaunchOctreeCellFunc_MT(*m_context,(*m_context->cells)[cellIndex],cell))
+				m_context->stop.fetchAndStoreOrdered(1);
+			m_context->processedCells.fetchAndAddOrdered(1);
+		}
+	}
+
+protected:
+
+	octreeCellDispatchContext_MT* m_context;
+	unsigned m_queueIndex;
+};
+
+//! Applies a cell function to a set of cells (multi-threaded)
+/** Progress notification and cancel requests are only handled by the calling
+	thread (workers never call the callback).
+	\return success
+**/
+static bool DispatchCells_MT(DgmOctree* octree,
+							const std::vector<octreeCellDesc>& cells,
+							DgmOctree::octreeCellFunc func,
+							void** additionalParameters,
+							int maxThreadCount,
+							GenericProgressCallback* progressCb)
+{
+	if (cells.empty())
+		return true;
+
+	octreeCellDispatchContext_MT context;
+	context.octree = octree;
+	context.func = func;
+	context.userParams = additionalParameters;
+	context.cells = &cells;
+
+	unsigned cellCount = (unsigned)cells.size();
+	unsigned threadCount = (unsigned)(maxThreadCount > 0 ? maxThreadCount : std::max(QThread::idealThreadCount(),1));
+	if (threadCount > cellCount)
+		threadCount = cellCount;
+
+	//big cells (that would serialize the end of the process) are dispatched first
+	try
+	{
+		context.order.reserve(cellCount);
+		unsigned bigCellPop = std::max<unsigned>(octree->getNumberOfProjectedPoints()/(8*threadCount),1024);
+		std::vector<DgmOctree::IndexAndCode> bigCells;
+		for (unsigned i=0; i<cellCount; ++i)
+		{
+			unsigned pop = cells[i].i2-cells[i].i1+1;
+			if (pop >= bigCellPop)
+				bigCells.push_back(DgmOctree::IndexAndCode(i,~pop)); //bitwise 'not' to sort by decreasing population
+		}
+		std::sort(bigCells.begin(),bigCells.end(),DgmOctree::IndexAndCode::codeAndIndexComp);
+		for (unsigned i=0; i<bigCells.size(); ++i)
+			context.order.push_back(bigCells[i].theIndex);
+		context.bigCellsCount = (unsigned)bigCells.size();
+
+		for (unsigned i=0; i<cellCount; ++i)
+			if (cells[i].i2-cells[i].i1+1 < bigCellPop)
+				context.order.push_back(i);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return false;
+	}
+	assert(context.order.size() == cellCount);
+
+	//the remaining cells are split in contiguous ranges (one per worker)
+	context.queues = new octreeCellQueue_MT[threadCount];
+	context.queuesCount = threadCount;
+	{
+		unsigned remainingCount = cellCount-context.bigCellsCount;
+		unsigned rangeSize = remainingCount/threadCount + (remainingCount % threadCount ? 1 : 0);
+		for (unsigned i=0; i<threadCount; ++i)
+		{
+			context.queues[i].begin = std::min(context.bigCellsCount+i*rangeSize,cellCount);
+			context.queues[i].end = std::min(context.queues[i].begin+rangeSize,cellCount);
+		}
+	}
+
+	//local thread pool (so that several dispatches can run at the same time)
+	QThreadPool pool;
+	pool.setMaxThreadCount(threadCount);
+	for (unsigned i=0; i<threadCount; ++i)
+		pool.start(new octreeCellWorker_MT(&context,i));
+
+	if (progressCb)
+	{
+		//only the calling thread notifies the progress
+		float lastPercent = -1.0f;
+		bool done = false;
+		while (!done)
+		{
+			done = pool.waitForDone(MT_PROGRESS_REFRESH_PERIOD);
+
+			float percent = 100.0f * (float)(int)context.processedCells / (float)cellCount;
+			if (percent != lastPercent)
+			{
+				progressCb->update(percent);
+				lastPercent = percent;
+			}
+			if (!done && progressCb->isCancelRequested())
+				context.stop.fetchAndStoreOrdered(1);
+		}
 	}
 	else
 	{
-		s_cellFunc_MT_success = false;
+		pool.waitForDone();
 	}
 
-	delete cell;
-	cell=0;
+	return !context.stop;
 }
 
 unsigned DgmOctree::executeFunctionForAllCellsAtLevel_MT(uchar level,
         octreeCellFunc func,
         void** additionalParameters,
         GenericProgressCallback* progressCb,
-        const char* functionTitle)
+        const char* functionTitle,
+        int maxThreadCount)
 {
     if (m_thePointsAndTheirCellCodes.empty())
         return 0;
 
 	const unsigned cellsNumber = getCellNumber(level);
 
-	//cells that will be processed by QtConcurrent::map
+	//cells that will be processed by the workers
 	std::vector<octreeCellDesc> cells;
 	cells.reserve(cellsNumber);
 	if (cells.capacity() < cellsNumber) //not enough memory
@@ -4124,15 +4849,6 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel_MT(uchar level,
     //don't forget the last cell!
 	cells.push_back(cellDesc);
 
-	//static wrap
-	s_octree_MT = this;
-	s_func_MT = func;
-	s_userParams_MT = additionalParameters;
-	s_cellFunc_MT_success = true;
-	if (s_normProgressCb_MT)
-		delete s_normProgressCb_MT;
-	s_normProgressCb_MT = 0;
-
     //progress notification
     if (progressCb)
     {
@@ -4142,7 +4858,6 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel_MT(uchar level,
         char buffer[512];
 		sprintf(buffer,"Octree level %i\nCells: %i\nMean population: %3.2f (+/-%3.2f)\nMax population: %d",level,cells.size(),m_averageCellPopulation[level],m_stdDevCellPopulation[level],m_maxCellPopulation[level]);
         progressCb->setInfo(buffer);
-		s_normProgressCb_MT = new NormalizedProgress(progressCb,(unsigned)cells.size());
         progressCb->start();
     }
 
@@ -4153,7 +4868,7 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel_MT(uchar level,
 	s_binarySearchCount = 0.0;
 #endif
 
-	QtConcurrent::blockingMap(cells, LaunchOctreeCellFunc_MT);
+	bool success = DispatchCells_MT(this,cells,func,additionalParameters,maxThreadCount,progressCb);
 
 #ifdef COMPUTE_NN_SEARCH_STATISTICS
 	FILE* fp=fopen("octree_log.txt","at");
@@ -4170,20 +4885,11 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel_MT(uchar level,
 	}
 #endif
 
-	s_octree_MT = 0;
-	s_func_MT = 0;
-	s_userParams_MT = 0;
-
 	if (progressCb)
-	{
         progressCb->stop();
-		if (s_normProgressCb_MT)
-			delete s_normProgressCb_MT;
-		s_normProgressCb_MT=0;
-	}
 
 	//if something went wrong, we clear everything and return 0!
-	if (!s_cellFunc_MT_success)
+	if (!success)
 		cells.clear();
 
     return (unsigned)cells.size();
@@ -4196,14 +4902,15 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel_MT(uchar startingL
         unsigned minNumberOfPointsPerCell,
         unsigned maxNumberOfPointsPerCell,
         GenericProgressCallback* progressCb,
-        const char* functionTitle)
+        const char* functionTitle,
+        int maxThreadCount)
 {
     if (m_thePointsAndTheirCellCodes.empty())
         return 0;
 
 	const unsigned cellsNumber = getCellNumber(startingLevel);
 
-	//cells that will be processed by QtConcurrent::map
+	//cells that will be processed by the workers
 	std::vector<octreeCellDesc> cells;
 	cells.reserve(cellsNumber); //at least!
 	if (cells.capacity() < cellsNumber) //not enough memory?
@@ -4393,15 +5100,6 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel_MT(uchar startingL
 	double mean = popSum/(double)cells.size();
 	double stddev = sqrt(popSum2-mean*mean)/(double)cells.size();
 
-	//static wrap
-	s_octree_MT = this;
-	s_func_MT = func;
-	s_userParams_MT = additionalParameters;
-	s_cellFunc_MT_success = true;
-	if (s_normProgressCb_MT)
-		delete s_normProgressCb_MT;
-	s_normProgressCb_MT = 0;
-
     //progress notification
     if (progressCb)
     {
@@ -4411,9 +5109,6 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel_MT(uchar startingL
         char buffer[1024];
 		sprintf(buffer,"Octree levels %i - %i\nCells: %i\nMean population: %3.2f (+/-%3.2f)\nMax population: %d",startingLevel,MAX_OCTREE_LEVEL,cells.size(),mean,stddev,maxPop);
         progressCb->setInfo(buffer);
-		if (s_normProgressCb_MT)
-			delete s_normProgressCb_MT;
-		s_normProgressCb_MT = new NormalizedProgress(progressCb,(unsigned)cells.size());
         progressCb->start();
     }
 
@@ -4424,7 +5119,7 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel_MT(uchar startingL
 	s_binarySearchCount = 0.0;
 #endif
 
-	QtConcurrent::blockingMap(cells, LaunchOctreeCellFunc_MT);
+	bool success = DispatchCells_MT(this,cells,func,additionalParameters,maxThreadCount,progressCb);
 
 #ifdef COMPUTE_NN_SEARCH_STATISTICS
 	FILE* fp=fopen("octree_log.txt","at");
@@ -4441,20 +5136,11 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel_MT(uchar startingL
 	}
 #endif
 
-	s_octree_MT = 0;
-	s_func_MT = 0;
-	s_userParams_MT = 0;
-
 	if (progressCb)
-	{
         progressCb->stop();
-		if (s_normProgressCb_MT)
-			delete s_normProgressCb_MT;
-		s_normProgressCb_MT=0;
-	}
 
 	//if something went wrong, we clear everything and return 0!
-	if (!s_cellFunc_MT_success)
+	if (!success)
 		cells.clear();
 
     return (unsigned)cells.size();
@@ -33,7 +33,10 @@
 #include "CCMiscTools.h"
 #include "LocalModel.h"
 #include "SimpleTriangle.h"
+#include "TriangleBVH.h"
 #include "ScalarField.h"
+#include "ChunkedPointCloud.h"
+#include "SSEHelper.h"
 
 //system
 #include <assert.h>
@@ -151,6 +154,84 @@ namespace CCLib
 	};
 }
 
+//! Coarse octree cells having at least one reference point in their neighbourhood
+/** Used for the early termination of the bounded search: the cells are big enough
+	(i.e. bigger than the max search distance) so that a compared cell whose 'parent'
+	is not flagged has no reference point in range at all.
+**/
+struct SearchRangeMask
+{
+	//! Level of the coarse cells (0 = not used)
+	uchar level;
+	//! Flag per coarse cell (indexed by truncated cell code)
+	std::vector<bool> inRange;
+
+	SearchRangeMask() : level(0) {}
+
+	//! Builds the mask
+	bool init(const DgmOctree* referenceOctree, uchar cellLevel, ScalarType maxSearchDist)
+	{
+		//the coarse level is limited so as to keep the mask reasonably small
+		static const uchar c_maxMaskLevel = 8;
+
+		level = std::min(cellLevel,c_maxMaskLevel);
+		while (level > 0 && referenceOctree->getCellSize(level) < maxSearchDist)
+			--level;
+		if (level == 0)
+			return false;
+
+		DgmOctree::cellCodesContainer codes;
+		try
+		{
+			referenceOctree->getCellCodes(level,codes,true);
+			inRange.resize((size_t)1 << (3*level),false);
+		}
+		catch (.../*const std::bad_alloc&*/) //out of memory
+		{
+			level = 0;
+			return false;
+		}
+
+		//we flag each non empty cell and its 26 neighbours
+		const int maxPos = (1 << level);
+		for (DgmOctree::cellCodesContainer::const_iterator it=codes.begin(); it!=codes.end(); ++it)
+		{
+			int cellPos[3];
+			referenceOctree->getCellPos(*it,level,cellPos,true);
+			int pos[3];
+			for (pos[0]=std::max(cellPos[0]-1,0); pos[0]<=std::min(cellPos[0]+1,maxPos-1); ++pos[0])
+				for (pos[1]=std::max(cellPos[1]-1,0); pos[1]<=std::min(cellPos[1]+1,maxPos-1); ++pos[1])
+					for (pos[2]=std::max(cellPos[2]-1,0); pos[2]<=std::min(cellPos[2]+1,maxPos-1); ++pos[2])
+						inRange[referenceOctree->generateTruncatedCellCode(pos,level)] = true;
+		}
+
+		return true;
+	}
+
+	//! Returns whether a (compared) cell may have reference points in range
+	inline bool mayBeInRange(const DgmOctree::octreeCell& cell) const
+	{
+		return (level == 0 || inRange[cell.truncatedCode >> (3*(cell.level-level))]);
+	}
+};
+
+//! Sets all the points of an out of range cell to the max search distance (bounded search)
+static void SetCellOutOfRange(const DgmOctree::octreeCell& cell, const GenericIndexedCloudPersist* referenceCloud, ScalarType maxSearchSquareDist)
+{
+	ScalarType maxSearchDist = sqrt(maxSearchSquareDist);
+
+	GenericIndexedCloudPersist* cloud = cell.parentOctree->associatedCloud();
+
+	CCVector3 P;
+	unsigned pointCount = cell.pointCount;
+	for (unsigned i=0; i<pointCount; ++i)
+	{
+		unsigned pointIndex = cell.getPointGlobalIndex(i);
+		cloud->getPoint(pointIndex,P);
+		cloud->setPointScalarValue(pointIndex,referenceCloud->testVisibility(P) == POINT_VISIBLE ? maxSearchDist : NAN_VALUE);
+	}
+}
+
 int DistanceComputationTools::computeHausdorffDistance(GenericIndexedCloudPersist* comparedCloud,
 														GenericIndexedCloudPersist* referenceCloud,
 														Cloud2CloudDistanceComputationParams& params,
@@ -190,11 +271,17 @@ int DistanceComputationTools::computeHausdorffDistance(GenericIndexedCloudPersis
 		}
 	}
 
+	//bounded search: cells with no reference point in range are processed at once
+	SearchRangeMask rangeMask;
+	if (maxSearchSquareDist > 0)
+		rangeMask.init(referenceOctree,params.octreeLevel,params.maxSearchDist);
+
 	//structure contenant les parametres additionnels
-	void* additionalParameters[4] = {(void*)referenceCloud,
+	void* additionalParameters[5] = {(void*)referenceCloud,
 									 (void*)referenceOctree,
 									 (void*)&params,
-									 (void*)&maxSearchSquareDist
+									 (void*)&maxSearchSquareDist,
+									 (void*)&rangeMask
 	};
 
 	int result = 0;
@@ -233,6 +320,134 @@ int DistanceComputationTools::computeHausdorffDistance(GenericIndexedCloudPersis
 	return result;
 }
 
+//! Nearest neighbour distances computation job (see computeNearestNeighbourDistances)
+struct nnDistancesJob
+{
+	GenericIndexedCloudPersist* comparedCloud;
+	const DgmOctree* referenceOctree;
+	ReferenceCloud* CPSet;
+	uchar level;
+	//! Query points (sorted by cell code)
+	const DgmOctree::IndexAndCode* queries;
+	unsigned count;
+};
+
+static void ComputeNearestNeighbourDistances(nnDistancesJob& job)
+{
+	const DgmOctree* octree = job.referenceOctree;
+
+	DgmOctree::NearestNeighboursSearchStruct nNSS;
+	nNSS.level = job.level;
+	nNSS.maxSearchSquareDist = -1.0;
+
+	int lastCellPos[3] = {0,0,0};
+	for (unsigned k=0; k<job.count; ++k)
+	{
+		unsigned i = job.queries[k].theIndex;
+		job.comparedCloud->getPoint(i,nNSS.queryPoint);
+
+		//the search state is kept as long as the query points lie in the same cell
+		bool inbounds = false;
+		octree->getTheCellPosWhichIncludesThePoint(&nNSS.queryPoint,nNSS.cellPos,nNSS.level,inbounds);
+		if (k == 0 || memcmp(nNSS.cellPos,lastCellPos,sizeof(int)*3) != 0)
+		{
+			memcpy(lastCellPos,nNSS.cellPos,sizeof(int)*3);
+			octree->computeCellCenter(nNSS.cellPos,nNSS.level,nNSS.cellCenter);
+			nNSS.truncatedCellCode = job.queries[k].theCode;
+			nNSS.alreadyVisitedNeighbourhoodSize = 0;
+			nNSS.minimalCellsSetToVisit.clear();
+		}
+
+		ScalarType squareDist = octree->findTheNearestNeighborStartingFromCell(nNSS);
+		job.comparedCloud->setPointScalarValue(i,squareDist >= 0 ? sqrt(squareDist) : NAN_VALUE);
+		if (job.CPSet)
+			job.CPSet->setPointIndex(i,nNSS.theNearestPointIndex);
+	}
+}
+
+#ifdef ENABLE_CLOUD2MESH_DIST_MT
+#include <QtCore/QtCore>
+#endif
+
+bool DistanceComputationTools::computeNearestNeighbourDistances(GenericIndexedCloudPersist* comparedCloud,
+																const DgmOctree* referenceOctree,
+																ReferenceCloud* CPSet/*=0*/,
+																uchar octreeLevel/*=0*/)
+{
+	assert(comparedCloud && referenceOctree);
+
+	unsigned n = comparedCloud->size();
+	if (referenceOctree->getNumberOfProjectedPoints() == 0)
+		return false;
+
+	//a few points per cell is a good trade-off between the number of visited cells and the number of tested points
+	if (octreeLevel == 0)
+		octreeLevel = referenceOctree->findBestLevelForAGivenPopulationPerCell(10);
+
+	if (!comparedCloud->enableScalarField())
+		return false;
+	if (CPSet && !CPSet->resize(n))
+		return false;
+	if (n == 0)
+		return true;
+
+	//we sort the query points by cell (so that consecutive queries can share the same search state)
+	std::vector<DgmOctree::IndexAndCode> queries;
+	try
+	{
+		queries.resize(n);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return false;
+	}
+	for (unsigned i=0; i<n; ++i)
+	{
+		CCVector3 P;
+		comparedCloud->getPoint(i,P);
+		int cellPos[3];
+		bool inbounds = false;
+		referenceOctree->getTheCellPosWhichIncludesThePoint(&P,cellPos,octreeLevel,inbounds);
+		queries[i].theIndex = i;
+		queries[i].theCode = (inbounds ? referenceOctree->generateTruncatedCellCode(cellPos,octreeLevel) : DgmOctree::INVALID_CELL_CODE);
+	}
+	std::sort(queries.begin(),queries.end(),DgmOctree::IndexAndCode::codeComp);
+
+	nnDistancesJob job;
+	job.comparedCloud = comparedCloud;
+	job.referenceOctree = referenceOctree;
+	job.CPSet = CPSet;
+	job.level = octreeLevel;
+	job.queries = &(queries[0]);
+	job.count = n;
+
+#ifdef ENABLE_CLOUD2MESH_DIST_MT
+	//the (sorted) query points are split in contiguous ranges processed in parallel
+	unsigned jobCount = 4*(unsigned)std::max(QThread::idealThreadCount(),1);
+	std::vector<nnDistancesJob> jobs;
+	try
+	{
+		jobs.resize(jobCount,job);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return false;
+	}
+	unsigned step = (n+jobCount-1)/jobCount;
+	for (unsigned j=0; j<jobCount; ++j)
+	{
+		unsigned first = std::min(j*step,n);
+		jobs[j].queries = &(queries[0]) + first;
+		jobs[j].count = std::min(step,n-first);
+	}
+	QtConcurrent::blockingMap(jobs, ComputeNearestNeighbourDistances);
+#else
+	ComputeNearestNeighbourDistances(job);
+#endif
+
+	return true;
+}
+
 bool DistanceComputationTools::synchronizeOctrees(GenericIndexedCloudPersist* comparedCloud, GenericIndexedCloudPersist* referenceCloud, DgmOctree* &comparedOctree, DgmOctree* &referenceOctree, GenericProgressCallback* progressCb)
 {
     assert(comparedCloud && referenceCloud);
@@ -326,6 +541,7 @@ bool DistanceComputationTools::synchronizeOctrees(GenericIndexedCloudPersist* co
 // [1] -> (Octree*): reference cloud octree
 // [2] -> (Cloud2CloudDistanceComputationParams*): parameters
 // [3] -> (ScalarType*): max search distance (squared)
+// [4] -> (SearchRangeMask*): coarse cells in range (bounded search)
 bool DistanceComputationTools::computeCellHausdorffDistance(const DgmOctree::octreeCell& cell, void** additionalParameters)
 {
 	//additional parameters
@@ -333,6 +549,14 @@ bool DistanceComputationTools::computeCellHausdorffDistance(const DgmOctree::oct
 	const DgmOctree* referenceOctree					= (DgmOctree*)additionalParameters[1];
 	Cloud2CloudDistanceComputationParams* params		= (Cloud2CloudDistanceComputationParams*)additionalParameters[2];
 	const ScalarType* maxSearchSquareDist		        = (ScalarType*)additionalParameters[3];
+	const SearchRangeMask* rangeMask					= (SearchRangeMask*)additionalParameters[4];
+
+	//bounded search: the whole cell may be out of range
+	if (!rangeMask->mayBeInRange(cell))
+	{
+		SetCellOutOfRange(cell,referenceCloud,*maxSearchSquareDist);
+		return true;
+	}
 
 	//structure for the nearest neighbor seach
 	DgmOctree::NearestNeighboursSearchStruct nPSS;
@@ -348,10 +572,11 @@ bool DistanceComputationTools::computeCellHausdorffDistance(const DgmOctree::oct
 	referenceOctree->computeCellCenter(nPSS.cellPos,cell.level,nPSS.cellCenter);
 
 	//for each point of the current cell (compared octree) we look its nearest neighbour in the reference cloud
-	unsigned pointCount = cell.points->size();
+	unsigned pointCount = cell.pointCount;
+	GenericIndexedCloudPersist* cloud = cell.parentOctree->associatedCloud();
 	for (unsigned i=0;i<pointCount;i++)
 	{
-		cell.points->getPoint(i,nPSS.queryPoint);
+		cloud->getPoint(cell.getPointGlobalIndex(i),nPSS.queryPoint);
 
 		if (params->CPSet || referenceCloud->testVisibility(nPSS.queryPoint) == POINT_VISIBLE) //to build the closest point set up we must process the point whatever its visibility is!
 		{
@@ -361,14 +586,14 @@ bool DistanceComputationTools::computeCellHausdorffDistance(const DgmOctree::oct
 			else if (nPSS.maxSearchSquareDist > 0)
 				dist = sqrt(nPSS.maxSearchSquareDist);
 
-			cell.points->setPointScalarValue(i,dist);
+			cloud->setPointScalarValue(cell.getPointGlobalIndex(i),dist);
 
 			if (params->CPSet)
-				params->CPSet->setPointIndex(cell.points->getPointGlobalIndex(i),nPSS.theNearestPointIndex);
+				params->CPSet->setPointIndex(cell.getPointGlobalIndex(i),nPSS.theNearestPointIndex);
 		}
 		else
 		{
-			cell.points->setPointScalarValue(i,NAN_VALUE);
+			cloud->setPointScalarValue(cell.getPointGlobalIndex(i),NAN_VALUE);
 		}
 	}
 
@@ -380,6 +605,7 @@ bool DistanceComputationTools::computeCellHausdorffDistance(const DgmOctree::oct
 // [1] -> (Octree*): reference cloud octree
 // [2] -> (Cloud2CloudDistanceComputationParams*): parameters
 // [3] -> (ScalarType*): max search distance (squared)
+// [4] -> (SearchRangeMask*): coarse cells in range (bounded search)
 bool DistanceComputationTools::computeCellHausdorffDistanceWithLocalModel(const DgmOctree::octreeCell& cell,
                                                                           void** additionalParameters)
 {
@@ -388,6 +614,14 @@ bool DistanceComputationTools::computeCellHausdorffDistanceWithLocalModel(const
 	const DgmOctree* referenceOctree				= (DgmOctree*)additionalParameters[1];
 	Cloud2CloudDistanceComputationParams* params	= (Cloud2CloudDistanceComputationParams*)additionalParameters[2];
 	const ScalarType* maxSearchSquareDist			= (ScalarType*)additionalParameters[3];
+	const SearchRangeMask* rangeMask				= (SearchRangeMask*)additionalParameters[4];
+
+	//bounded search: the whole cell may be out of range
+	if (!rangeMask->mayBeInRange(cell))
+	{
+		SetCellOutOfRange(cell,referenceCloud,*maxSearchSquareDist);
+		return true;
+	}
 
 	assert(params && params->localModel != NO_MODEL);
 
@@ -428,13 +662,14 @@ bool DistanceComputationTools::computeCellHausdorffDistanceWithLocalModel(const
 	std::vector<LocalModel*> models;
 
 	//for each point of the current cell (compared octree) we look its nearest neighbour in the reference cloud
-	unsigned pointCount=cell.points->size();
+	unsigned pointCount=cell.pointCount;
+	GenericIndexedCloudPersist* cloud = cell.parentOctree->associatedCloud();
 	for (unsigned i=0;i<pointCount;++i)
 	{
 		//distance of the current point
 		ScalarType distPt = NAN_VALUE;
 
-		cell.points->getPoint(i,nNSS.queryPoint);
+		cloud->getPoint(cell.getPointGlobalIndex(i),nNSS.queryPoint);
 		if (params->CPSet || referenceCloud->testVisibility(nNSS.queryPoint) == POINT_VISIBLE) //to build the closest point set up we must process the point whatever its visibility is!
 		{
 			//first, we look for the nearest point to "_queryPoint" in the reference cloud
@@ -544,10 +779,10 @@ bool DistanceComputationTools::computeCellHausdorffDistanceWithLocalModel(const
 			}
 
 			if (params->CPSet)
-				params->CPSet->setPointIndex(cell.points->getPointGlobalIndex(i),nNSS.theNearestPointIndex);
+				params->CPSet->setPointIndex(cell.getPointGlobalIndex(i),nNSS.theNearestPointIndex);
 		}
 	
-		cell.points->setPointScalarValue(i,distPt);
+		cloud->setPointScalarValue(cell.getPointGlobalIndex(i),distPt);
 	}
 
 	//clear all models for this cell
@@ -1950,6 +2185,159 @@ int DistanceComputationTools::computePointCloud2MeshDistance(GenericIndexedCloud
 	return 0;
 }
 
+//! Number of points processed by each 'cloud-to-BVH' job
+static const unsigned c_bvhDistancesJobSize = 4096;
+
+struct bvhDistancesJob
+{
+	GenericIndexedCloudPersist* cloud;
+	const TriangleBVH* bvh;
+	ScalarType maxSearchDist;
+	bool signedDistances;
+	ScalarType normalSign;
+	NormalizedProgress* nProgress;
+	volatile bool* success;
+	//! Range of points
+	unsigned first;
+	unsigned count;
+};
+
+static void ComputeBVHDistances(bvhDistancesJob& job)
+{
+	//skip job if process is aborted
+	if (!*job.success)
+		return;
+
+	bool boundedSearch = (job.maxSearchDist >= 0);
+
+	TriangleBVH::NearestTriangleSearchStruct nTSS;
+	nTSS.maxSearchSquareDist = (boundedSearch ? job.maxSearchDist*job.maxSearchDist : -1.0);
+
+	for (unsigned i=job.first; i<job.first+job.count; ++i)
+	{
+		job.cloud->getPoint(i,nTSS.queryPoint);
+
+		ScalarType dist = (boundedSearch ? job.maxSearchDist : NAN_VALUE);
+		if (job.bvh->findNearestTriangle(nTSS))
+		{
+			//the BVH works with single precision: we compute the exact distance to the nearest triangle
+			SimpleRefTriangle T = job.bvh->getTriangle(nTSS.nearestTriangleIndex);
+			ScalarType d = DistanceComputationTools::computePoint2TriangleDistance(&nTSS.queryPoint,&T,job.signedDistances);
+			d = (job.signedDistances ? job.normalSign*d : sqrt(d));
+			if (!boundedSearch || fabs(d) <= job.maxSearchDist)
+				dist = d;
+		}
+		job.cloud->setPointScalarValue(i,dist);
+	}
+
+	if (job.nProgress && !job.nProgress->oneStep())
+		*job.success = false;
+}
+
+int DistanceComputationTools::computePointCloud2MeshDistanceWithBVH(GenericIndexedCloudPersist* pointCloud,
+																	GenericIndexedMesh* theMesh,
+																	ScalarType maxSearchDist/*=-1.0*/,
+																	bool signedDistances/*=false*/,
+																	bool flipNormals/*=false*/,
+																	bool multiThread/*=true*/,
+																	GenericProgressCallback* progressCb/*=0*/,
+																	const TriangleBVH* meshBVH/*=0*/)
+{
+	assert(pointCloud && theMesh);
+
+	unsigned n = pointCloud->size();
+	if (n==0 || theMesh->size()==0)
+		return -2;
+
+	//we build the hierarchy if necessary
+	TriangleBVH* localBVH = 0;
+	if (!meshBVH)
+	{
+		localBVH = new TriangleBVH();
+		if (!localBVH->build(theMesh,progressCb))
+		{
+			delete localBVH;
+			return -3;
+		}
+		meshBVH = localBVH;
+	}
+
+	if (!pointCloud->enableScalarField())
+	{
+		if (localBVH)
+			delete localBVH;
+		return -4;
+	}
+
+	volatile bool success = true;
+
+	bvhDistancesJob job;
+	job.cloud = pointCloud;
+	job.bvh = meshBVH;
+	job.maxSearchDist = maxSearchDist;
+	job.signedDistances = signedDistances;
+	job.normalSign = (ScalarType)(flipNormals ? -1.0 : 1.0);
+	job.nProgress = 0;
+	job.success = &success;
+	job.first = 0;
+	job.count = 0;
+
+	//the points are processed by contiguous ranges (consecutive points are generally close to each other)
+	unsigned jobCount = (n+c_bvhDistancesJobSize-1)/c_bvhDistancesJobSize;
+	std::vector<bvhDistancesJob> jobs;
+	try
+	{
+		jobs.resize(jobCount,job);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		if (localBVH)
+			delete localBVH;
+		return -5;
+	}
+
+	//Progress callback
+	NormalizedProgress* nProgress = 0;
+	if (progressCb)
+	{
+		nProgress = new NormalizedProgress(progressCb,jobCount);
+		char buffer[256];
+		sprintf(buffer,"Points=%i / Triangles=%i",n,meshBVH->size());
+		progressCb->reset();
+		progressCb->setInfo(buffer);
+		progressCb->setMethodTitle(signedDistances ? "Compute signed distances" : "Compute distances");
+		progressCb->start();
+	}
+
+	for (unsigned j=0; j<jobCount; ++j)
+	{
+		jobs[j].first = j*c_bvhDistancesJobSize;
+		jobs[j].count = std::min(c_bvhDistancesJobSize,n-jobs[j].first);
+		jobs[j].nProgress = nProgress;
+	}
+
+#ifdef ENABLE_CLOUD2MESH_DIST_MT
+	if (multiThread)
+	{
+		QtConcurrent::blockingMap(jobs, ComputeBVHDistances);
+	}
+	else
+#endif
+	{
+		for (unsigned j=0; j<jobCount; ++j)
+			ComputeBVHDistances(jobs[j]);
+	}
+
+	if (nProgress)
+		delete nProgress;
+	nProgress=0;
+
+	if (localBVH)
+		delete localBVH;
+
+	return (success ? 0 : -7);
+}
+
 /******* Calcul de distance entre un point et un triangle *****/
 // Inspired from Magic Software, Inc.
 // http://www.magic-software.com
@@ -2188,6 +2576,11 @@ ScalarType DistanceComputationTools::computeCloud2PlaneDistance(GenericCloud* cl
 {
     assert(cloud && planeEquation);
 
+	//faster chunk-based version
+	const ChunkedPointCloud* chunkedCloud = dynamic_cast<const ChunkedPointCloud*>(cloud);
+	if (chunkedCloud)
+		return computeCloud2PlaneDistance(chunkedCloud,planeEquation);
+
 	//nombre de points
 	unsigned n = cloud->size();
 	//distance d'un point a un plan : d = fabs(a0*x+a1*y+a2*z-a3) / sqrt(a0\B2+a1\B2+a2\B2) <-- "norm"
@@ -2209,6 +2602,60 @@ ScalarType DistanceComputationTools::computeCloud2PlaneDistance(GenericCloud* cl
 	return (ScalarType)(dSum/(norm*(double)n));
 }
 
+ScalarType DistanceComputationTools::computeCloud2PlaneDistance(const ChunkedPointCloud* cloud, const PointCoordinateType* planeEquation)
+{
+    assert(cloud && planeEquation);
+
+	unsigned n = cloud->size();
+	double norm = CCVector3::vnorm(planeEquation);
+
+	if (norm == 0.0 || n == 0)
+        return NAN_VALUE;
+
+	double dSum = 0.0;
+
+#ifdef CC_USE_SSE_KERNELS
+	const __m128 a = _mm_set1_ps(planeEquation[0]);
+	const __m128 b = _mm_set1_ps(planeEquation[1]);
+	const __m128 c = _mm_set1_ps(planeEquation[2]);
+	const __m128 d = _mm_set1_ps(planeEquation[3]);
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	//double precision accumulators (2 x 2 lanes)
+	__m128d sum01 = _mm_setzero_pd();
+	__m128d sum23 = _mm_setzero_pd();
+#endif
+
+	for (unsigned ci=0; ci<cloud->pointsChunksCount(); ++ci)
+	{
+		unsigned count = cloud->pointsChunkSize(ci);
+		const PointCoordinateType* P = cloud->pointsChunkStartPtr(ci);
+
+		unsigned i=0;
+#ifdef CC_USE_SSE_KERNELS
+		for (; i+4<=count; i+=4, P+=12)
+		{
+			__m128 pa,pb,pc,x,y,z;
+			SSE_Load4Points(P,pa,pb,pc);
+			SSE_Deinterleave(pa,pb,pc,x,y,z);
+			__m128 dist = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x,a),_mm_mul_ps(y,b)),_mm_mul_ps(z,c)),d);
+			dist = _mm_and_ps(dist,absMask);
+			sum01 = _mm_add_pd(sum01,_mm_cvtps_pd(dist));
+			sum23 = _mm_add_pd(sum23,_mm_cvtps_pd(_mm_movehl_ps(dist,dist)));
+		}
+#endif
+		for (; i<count; ++i, P+=3)
+			dSum += (double)fabs(CCVector3::vdot(P,planeEquation)-planeEquation[3]);
+	}
+
+#ifdef CC_USE_SSE_KERNELS
+	double s[2];
+	_mm_storeu_pd(s,_mm_add_pd(sum01,sum23));
+	dSum += s[0]+s[1];
+#endif
+
+	return (ScalarType)(dSum/(norm*(double)n));
+}
+
 bool DistanceComputationTools::computeGeodesicDistances(GenericIndexedCloudPersist* cloud, unsigned seedPointIndex, uchar octreeLevel, GenericProgressCallback* progressCb)
 {
     assert(cloud);
@@ -31,11 +31,6 @@ FastMarching::FastMarching()
 	, dx(0)
 	, dy(0)
 	, dz(0)
-	, decY(0)
-	, decZ(0)
-	, indexDec(0)
-	, gridSize(0)
-	, theGrid(0)
 	, m_octree(0)
 	, m_gridLevel(0)
 	, m_cellSize(1.0f)
@@ -45,21 +40,29 @@ FastMarching::FastMarching()
 
 FastMarching::~FastMarching()
 {
-	if (theGrid)
+	releaseGrid();
+}
+
+void FastMarching::releaseGrid()
+{
+	for (size_t i=0; i<m_bricks.size(); ++i)
 	{
+		Brick* brick = m_bricks[i];
+		if (!brick)
+			continue;
+
 		if (initialized)
 		{
-			Cell** _theGrid = theGrid;
-			for (unsigned i=0;i<gridSize;++i)
-			{
-				if (*_theGrid)
-					delete (*_theGrid);
-				++_theGrid;
-			}
+			for (unsigned j=0; j<=BRICK_CELLS_MASK; ++j)
+				if (brick->cells[j])
+					delete brick->cells[j];
 		}
 
-		delete[] theGrid;
+		delete brick;
 	}
+	m_bricks.clear();
+	m_brickSlots.clear();
+	initialized = false;
 }
 
 float FastMarching::getTime(int pos[], bool absoluteCoordinates)
@@ -67,13 +70,20 @@ float FastMarching::getTime(int pos[], bool absoluteCoordinates)
 	unsigned index=0;
 
 	if (absoluteCoordinates)
-		index = FM_pos2index(pos);
+	{
+		index = pos2index(pos);
+	}
 	else
-		index = unsigned(pos[0]+1)+unsigned(pos[1]+1)*decY+unsigned(pos[2]+1)*decZ;
+	{
+		int absPos[3] = {	pos[0]+m_minFillIndexes[0],
+							pos[1]+m_minFillIndexes[1],
+							pos[2]+m_minFillIndexes[2] };
+		index = pos2index(absPos);
+	}
 
-	assert(theGrid[index]);
+	assert(getCell(index));
 
-	return theGrid[index]->T;
+	return getCell(index)->T;
 }
 
 int FastMarching::initGrid(DgmOctree* octree, uchar gridLevel)
@@ -95,50 +105,134 @@ int FastMarching::initGrid(DgmOctree* octree, uchar gridLevel)
 	dy = maxFillIndexes[1]-minFillIndexes[1]+1;
 	dz = maxFillIndexes[2]-minFillIndexes[2]+1;
 
-	decY = dx+2;
-	decZ = decY*(dy+2);
-	gridSize = decZ*(dz+2);
-	indexDec = 1+decY+decZ;
-
 	for (unsigned i=0; i<CC_FM_NUMBER_OF_NEIGHBOURS; ++i)
 	{
-		neighboursIndexShift[i] = neighboursPosShift[i*3]+
-									neighboursPosShift[i*3+1]*int(decY)+
-									neighboursPosShift[i*3+2]*int(decZ);
-
 		neighboursDistance[i] = sqrt(float(neighboursPosShift[i*3]*neighboursPosShift[i*3]+
 									neighboursPosShift[i*3+1]*neighboursPosShift[i*3+1]+
 									neighboursPosShift[i*3+2]*neighboursPosShift[i*3+2]))*m_cellSize;
 	}
 
 	activeCells.clear();
+	trialCells.clear();
 
-	if (!instantiateGrid(gridSize))
-        return -3;
+	//the bricks are allocated on demand (see addCell)
+	releaseGrid();
+	try
+	{
+		//the first slot is never used (0 is not a valid cell index)
+		m_bricks.push_back(0);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return -3;
+	}
 
 	return 0;
 }
 
-bool FastMarching::instantiateGrid(unsigned size)
+unsigned FastMarching::pos2index(const int pos[]) const
 {
-    assert(theGrid==0);
+	//relative position (negative values will be rejected as well)
+	unsigned x = unsigned(pos[0]-m_minFillIndexes[0]);
+	unsigned y = unsigned(pos[1]-m_minFillIndexes[1]);
+	unsigned z = unsigned(pos[2]-m_minFillIndexes[2]);
+	if (x >= dx || y >= dy || z >= dz)
+		return 0;
+
+	std::map<BrickKey,unsigned>::const_iterator it = m_brickSlots.find(GetBrickKey(x,y,z));
+	if (it == m_brickSlots.end())
+		return 0;
+
+	return (it->second << BRICK_CELLS_SHIFT)
+			| (x & BRICK_MASK)
+			| ((y & BRICK_MASK) << BRICK_SHIFT)
+			| ((z & BRICK_MASK) << (2*BRICK_SHIFT));
+}
 
-	theGrid = new Cell*[size];
-	if (!theGrid)
-        return false;
+bool FastMarching::addCell(const int pos[], Cell* cell)
+{
+	unsigned x = unsigned(pos[0]-m_minFillIndexes[0]);
+	unsigned y = unsigned(pos[1]-m_minFillIndexes[1]);
+	unsigned z = unsigned(pos[2]-m_minFillIndexes[2]);
+	assert(x < dx && y < dy && z < dz);
+
+	BrickKey key = GetBrickKey(x,y,z);
+	std::map<BrickKey,unsigned>::const_iterator it = m_brickSlots.find(key);
+	unsigned slot = 0;
+	if (it != m_brickSlots.end())
+	{
+		slot = it->second;
+	}
+	else
+	{
+		//too many bricks?
+		if (m_bricks.size() >= MAX_BRICKS_COUNT)
+			return false;
+
+		Brick* brick = 0;
+		try
+		{
+			brick = new Brick;
+		}
+		catch (.../*const std::bad_alloc&*/) //out of memory
+		{
+			return false;
+		}
+		memset(brick->cells,0,sizeof(brick->cells));
+
+		slot = (unsigned)m_bricks.size();
+		try
+		{
+			m_bricks.push_back(brick);
+			m_brickSlots[key] = slot;
+		}
+		catch (.../*const std::bad_alloc&*/) //out of memory
+		{
+			m_bricks.resize(slot);
+			delete brick;
+			return false;
+		}
+
+		//we link the brick with its (already allocated) neighbours
+		int bPos[3] = { int(x >> BRICK_SHIFT), int(y >> BRICK_SHIFT), int(z >> BRICK_SHIFT) };
+		for (int k=0; k<27; ++k)
+		{
+			int nPos[3] = { bPos[0]+(k%3)-1, bPos[1]+((k/3)%3)-1, bPos[2]+(k/9)-1 };
+			unsigned nSlot = 0;
+			if (k == 13)
+			{
+				nSlot = slot;
+			}
+			else if (nPos[0] >= 0 && nPos[1] >= 0 && nPos[2] >= 0)
+			{
+				it = m_brickSlots.find(GetBrickKey(	unsigned(nPos[0]) << BRICK_SHIFT,
+													unsigned(nPos[1]) << BRICK_SHIFT,
+													unsigned(nPos[2]) << BRICK_SHIFT));
+				if (it != m_brickSlots.end())
+				{
+					nSlot = it->second;
+					//this brick is the opposite neighbour of the other one
+					m_bricks[nSlot]->neighbours[26-k] = slot;
+				}
+			}
+			brick->neighbours[k] = nSlot;
+		}
+	}
 
-	memset(theGrid,0,size*sizeof(Cell*));
+	unsigned index = (slot << BRICK_CELLS_SHIFT)
+						| (x & BRICK_MASK)
+						| ((y & BRICK_MASK) << BRICK_SHIFT)
+						| ((z & BRICK_MASK) << (2*BRICK_SHIFT));
+	setCell(index,cell);
 
 	return true;
 }
 
 void FastMarching::setSeedCell(int pos[])
 {
-	unsigned index = FM_pos2index(pos);
-
-	assert(index<gridSize);
+	unsigned index = pos2index(pos);
 
-	Cell* aCell = theGrid[index];
+	Cell* aCell = getCell(index);
 	assert(aCell);
 
 	if (aCell && aCell->state != Cell::ACTIVE_CELL)
@@ -153,20 +247,20 @@ void FastMarching::setSeedCell(int pos[])
 void FastMarching::initTrialCells()
 {
 	Cell *aCell,*nCell;
-	int i,j,index,nIndex;
+	unsigned i,j,index,nIndex;
 
-	for (j=0;j<(int)activeCells.size();++j)
+	for (j=0;j<activeCells.size();++j)
 	{
 		index = activeCells[j];
-		aCell = theGrid[index];
+		aCell = getCell(index);
 
 		assert(aCell != 0);
 
 		for (i=0;i<CC_FM_NUMBER_OF_NEIGHBOURS;++i)
 		{
-			nIndex = index + neighboursIndexShift[i];
+			nIndex = getNeighbourIndex(index,i);
 			//pointeur vers la cellule voisine
-			nCell = theGrid[nIndex];
+			nCell = getCell(nIndex);
 
 			//si elle est definie
 			if (nCell)
@@ -183,3 +277,101 @@ void FastMarching::initTrialCells()
 		}
 	}
 }
+
+void FastMarching::addTrialCell(unsigned index, float T)
+{
+	Cell* aCell = getCell(index);
+	assert(aCell);
+
+	aCell->T = T;
+	aCell->trialPos = (unsigned)trialCells.size();
+	trialCells.push_back(index);
+
+	trialHeapUp(aCell->trialPos);
+}
+
+unsigned FastMarching::getNearestTrialCell() //renvoie 0 si probleme
+{
+	if (trialCells.empty())
+		return 0;
+
+	unsigned minTCellIndex = trialCells.front();
+
+	//the last cell replaces the first one
+	trialCells.front() = trialCells.back();
+	trialCells.pop_back();
+	if (!trialCells.empty())
+	{
+		getCell(trialCells.front())->trialPos = 0;
+		trialHeapDown(0);
+	}
+
+	return minTCellIndex;
+}
+
+void FastMarching::decreaseTrialCellT(unsigned index, float T)
+{
+	Cell* aCell = getCell(index);
+	assert(aCell && aCell->state == Cell::TRIAL_CELL);
+	assert(T <= aCell->T);
+
+	aCell->T = T;
+	trialHeapUp(aCell->trialPos);
+}
+
+void FastMarching::trialHeapUp(unsigned pos)
+{
+	unsigned index = trialCells[pos];
+	Cell* aCell = getCell(index);
+
+	while (pos > 0)
+	{
+		unsigned parentPos = (pos-1)/2;
+		Cell* parentCell = getCell(trialCells[parentPos]);
+		if (parentCell->T <= aCell->T)
+			break;
+
+		trialCells[pos] = trialCells[parentPos];
+		parentCell->trialPos = pos;
+		pos = parentPos;
+	}
+
+	trialCells[pos] = index;
+	aCell->trialPos = pos;
+}
+
+void FastMarching::trialHeapDown(unsigned pos)
+{
+	unsigned count = (unsigned)trialCells.size();
+	unsigned index = trialCells[pos];
+	Cell* aCell = getCell(index);
+
+	while (true)
+	{
+		unsigned childPos = 2*pos+1;
+		if (childPos >= count)
+			break;
+
+		//smallest child
+		Cell* childCell = getCell(trialCells[childPos]);
+		if (childPos+1 < count)
+		{
+			Cell* childCell2 = getCell(trialCells[childPos+1]);
+			if (childCell2->T < childCell->T)
+			{
+				++childPos;
+				childCell = childCell2;
+			}
+		}
+
+		if (aCell->T <= childCell->T)
+			break;
+
+		trialCells[pos] = trialCells[childPos];
+		childCell->trialPos = pos;
+		pos = childPos;
+	}
+
+	trialCells[pos] = index;
+	aCell->trialPos = pos;
+}
@@ -37,20 +37,6 @@ FastMarchingForPropagation::FastMarchingForPropagation()
 {
 }
 
-bool FastMarchingForPropagation::instantiateGrid(unsigned size)
-{
-    assert(theGrid==0);
-
-	PropagationCell** _theGrid = new PropagationCell*[size];
-	if (!_theGrid)
-        return false;
-	memset(_theGrid,0,size*sizeof(PropagationCell*));
-
-	theGrid = (Cell**)_theGrid;
-
-	return true;
-}
-
 int FastMarchingForPropagation::init(GenericCloud* theCloud,
 										DgmOctree* theOctree,
 										uchar level,
@@ -70,9 +56,6 @@ int FastMarchingForPropagation::init(GenericCloud* theCloud,
 		int cellPos[3];
 		theOctree->getCellPos(cellCodes.back(),level,cellPos,true);
 
-		//on renseigne la grille
-		unsigned gridPos = FM_pos2index(cellPos);
-
 		PropagationCell* aCell = new PropagationCell;
 		aCell->state = Cell::FAR_CELL;
 		aCell->T = Cell::T_INF();
@@ -83,7 +66,13 @@ int FastMarchingForPropagation::init(GenericCloud* theCloud,
 
 		//Yk->clear(); //inutile
 
-		theGrid[gridPos] = (Cell*)aCell;
+		//on renseigne la grille
+		if (!addCell(cellPos,aCell))
+		{
+			//not enough memory
+			delete aCell;
+			return -4;
+		}
 
 		cellCodes.pop_back();
 	}
@@ -106,12 +95,13 @@ int FastMarchingForPropagation::step()
 		return 0;
 	}
 
-	Cell* minTCell =  theGrid[minTCellIndex];
+	Cell* minTCell =  getCell(minTCellIndex);
 	assert(minTCell != 0);
 
 	if (minTCell->T-lastT > detectionThreshold*m_cellSize)
 	{
-		//endPropagation();
+		//the cell goes back in the TRIAL cells list (so that it is properly reset by endPropagation)
+		addTrialCell(minTCellIndex,minTCell->T);
 		return 0;
 	}
 
@@ -130,9 +120,9 @@ int FastMarchingForPropagation::step()
 		Cell* nCell;
 		for (int i=0;i<CC_FM_NUMBER_OF_NEIGHBOURS;++i)
 		{
-			nIndex = minTCellIndex + neighboursIndexShift[i];
+			nIndex = getNeighbourIndex(minTCellIndex,i);
 			//pointeur vers la cellule voisine
-			nCell = theGrid[nIndex];
+			nCell = getCell(nIndex);
 
 			//si elle est definie
 			if (nCell)
@@ -153,33 +143,41 @@ int FastMarchingForPropagation::step()
 					float t_new = computeT(nIndex);
 
 					if (t_new<t_old)
-						nCell->T = t_new;
+						decreaseTrialCellT(nIndex,t_new);
 				}
 			}
 		}
 	}
+	else
+	{
+		//this cell is not reachable yet: it has been removed from the TRIAL
+		//cells list, so it can't keep the TRIAL state (its heap position is
+		//obsolete). As a FAR cell it will be added again if one of its
+		//neighbours becomes ACTIVE.
+		minTCell->state = Cell::FAR_CELL;
+	}
 
 	return 1;
 }
 
 float FastMarchingForPropagation::computeT(unsigned index)
 {
-	double Tij = ((PropagationCell*)theGrid[index])->T;
-	double Fij = ((PropagationCell*)theGrid[index])->f; //weight
+	double Tij = ((PropagationCell*)getCell(index))->T;
+	double Fij = ((PropagationCell*)getCell(index))->f; //weight
 
 	PropagationCell *nCell = 0;
 
-	nCell = (PropagationCell*)theGrid[index+neighboursIndexShift[3]];
+	nCell = (PropagationCell*)getCell(getNeighbourIndex(index,3));
 	double Txm = (nCell ? nCell->T + neighboursDistance[3]*(exp(jumpCoef*(nCell->f-Fij))-1.0): Cell::T_INF());
-	nCell = (PropagationCell*)theGrid[index+neighboursIndexShift[1]];
+	nCell = (PropagationCell*)getCell(getNeighbourIndex(index,1));
 	double Txp = (nCell ? nCell->T + neighboursDistance[1]*(exp(jumpCoef*(nCell->f-Fij))-1.0) : Cell::T_INF());
-	nCell = (PropagationCell*)theGrid[index+neighboursIndexShift[0]];
+	nCell = (PropagationCell*)getCell(getNeighbourIndex(index,0));
 	double Tym = (nCell ? nCell->T + neighboursDistance[0]*(exp(jumpCoef*(nCell->f-Fij))-1.0) : Cell::T_INF());
-	nCell = (PropagationCell*)theGrid[index+neighboursIndexShift[2]];
+	nCell = (PropagationCell*)getCell(getNeighbourIndex(index,2));
 	double Typ = (nCell ? nCell->T + neighboursDistance[2]*(exp(jumpCoef*(nCell->f-Fij))-1.0) : Cell::T_INF());
-	nCell = (PropagationCell*)theGrid[index+neighboursIndexShift[4]];
+	nCell = (PropagationCell*)getCell(getNeighbourIndex(index,4));
 	double Tzm = (nCell ? nCell->T + neighboursDistance[4]*(exp(jumpCoef*(nCell->f-Fij))-1.0) : Cell::T_INF());
-	nCell = (PropagationCell*)theGrid[index+neighboursIndexShift[5]];
+	nCell = (PropagationCell*)getCell(getNeighbourIndex(index,5));
 	double Tzp = (nCell ? nCell->T + neighboursDistance[5]*(exp(jumpCoef*(nCell->f-Fij))-1.0) : Cell::T_INF());
 
 	//if (Gij-Gxm < 0) front must propagate faster, i.e. exp(jumpCoef*ANS)>1.0 --> jumpCoef>0
@@ -224,8 +222,8 @@ float FastMarchingForPropagation::computeT(unsigned index)
 
 		for(int n=0; n<CC_FM_NUMBER_OF_NEIGHBOURS; n++)
 		{
-			int candidateIndex = index + neighboursIndexShift[n];
-			PropagationCell* cCell = (PropagationCell*)theGrid[candidateIndex];
+			unsigned candidateIndex = getNeighbourIndex(index,n);
+			PropagationCell* cCell = (PropagationCell*)getCell(candidateIndex);
 			if (cCell)
 			{
 				if( (cCell->state==Cell::TRIAL_CELL) || (cCell->state==Cell::ACTIVE_CELL) )
@@ -262,7 +260,7 @@ void FastMarchingForPropagation::initLastT()
 	lastT = 0.0;
 	for (unsigned i=0; i<activeCells.size(); i++)
 	{
-		aCell = theGrid[activeCells[i]];
+		aCell = getCell(activeCells[i]);
 		lastT=std::max(lastT,aCell->T);
 	}
 }
@@ -297,7 +295,7 @@ ReferenceCloud* FastMarchingForPropagation::extractPropagatedPoints()
 
 	for (unsigned i=0; i<activeCells.size(); ++i)
 	{
-		PropagationCell* aCell = (PropagationCell*)theGrid[activeCells[i]];
+		PropagationCell* aCell = (PropagationCell*)getCell(activeCells[i]);
 		ReferenceCloud* Yk = m_octree->getPointsInCell(aCell->cellCode,m_gridLevel,true);
 
 		if (!Zk->reserve(Yk->size())) //not enough memory
@@ -329,7 +327,7 @@ bool FastMarchingForPropagation::setPropagationTimingsAsDistances()
 
 	for (unsigned i=0;i<activeCells.size();++i)
 	{
-		PropagationCell* aCell = (PropagationCell*)theGrid[activeCells[i]];
+		PropagationCell* aCell = (PropagationCell*)getCell(activeCells[i]);
 		ReferenceCloud* Yk = m_octree->getPointsInCell(aCell->cellCode,m_gridLevel,true);
 
 		Yk->placeIteratorAtBegining();
@@ -349,16 +347,16 @@ void FastMarchingForPropagation::endPropagation()
 {
 	while (!activeCells.empty())
 	{
-		PropagationCell* aCell = (PropagationCell*)theGrid[activeCells.back()];
+		PropagationCell* aCell = (PropagationCell*)getCell(activeCells.back());
 		delete aCell;
-		theGrid[activeCells.back()]=0;
+		setCell(activeCells.back(),0);
 
 		activeCells.pop_back();
 	}
 
 	while (!trialCells.empty())
 	{
-		Cell* aCell = theGrid[trialCells.back()];
+		Cell* aCell = getCell(trialCells.back());
 		assert(aCell != 0);
 
 		aCell->state = Cell::FAR_CELL;
@@ -371,47 +369,6 @@ void FastMarchingForPropagation::endPropagation()
 }
 
 
-//rajouter un element a la structure "untidy priority queue"
-void FastMarchingForPropagation::addTrialCell(unsigned index, float T)
-{
-	trialCells.push_back(index);
-}
-
-//recuperer le premier element de la structure "untidy priority queue"
-unsigned FastMarchingForPropagation::getNearestTrialCell() //renvoie 0 si probleme
-{
-	if (trialCells.empty()) return 0;
-
-	//on trouve la cellule de "TRIAL" qui a le T minimum
-	std::vector<unsigned>::const_iterator p = trialCells.begin();
-
-	int i=0,k=0;
-	unsigned minTCellIndex = *p;
-	Cell* minTCell = theGrid[minTCellIndex];
-	assert(minTCell != 0);
-	++p;
-	++i;
-
-	while (p != trialCells.end())
-	{
-		assert(theGrid[*p] != 0);
-		if (theGrid[*p]->T <minTCell->T)
-		{
-			minTCellIndex = *p;
-			minTCell = theGrid[minTCellIndex];
-			k=i;
-		}
-		++p;
-		++i;
-	}
-
-	//on l'enleve de la liste
-	trialCells[k]=trialCells[trialCells.size()-1];
-	trialCells.pop_back();
-
-	return minTCellIndex;
-}
-
 float FastMarchingForPropagation::computeTCoefApprox(Cell* currentCell, Cell* neighbourCell)
 {
 	return exp(jumpCoef*(((PropagationCell*)currentCell)->f-((PropagationCell*)neighbourCell)->f));
@@ -422,68 +379,44 @@ void FastMarchingForPropagation::findPeaks()
 {
 	if (!initialized) return;
 
-	//on remplit la grille
-	unsigned i,j,k;
 	int n;
 
-	int neighbours3DIndexShift[CC_FM_NUMBER_OF_3D_NEIGHBOURS];
-	//calculs de decalages pour voisnages
-	for (n=0;n<CC_FM_NUMBER_OF_3D_NEIGHBOURS;++n)
+	//we only visit the allocated bricks of the (sparse) grid
+	for (size_t slot=1; slot<m_bricks.size(); ++slot)
 	{
-		neighbours3DIndexShift[n] = neighbours3DPosShift[n*3]+
-									neighbours3DPosShift[n*3+1]*int(decY)+
-									neighbours3DPosShift[n*3+2]*int(decZ);
-	}
+		const Brick* brick = m_bricks[slot];
+		assert(brick);
 
-	//on fait bien attention a ne pas initialiser les cellules sur les bords
-	int pos[3];
-	unsigned index;
-	for (k=0;k<dz;++k)
-	{
-		pos[2] = k;
-		for (j=0;j<dy;++j)
+		for (unsigned c=0; c<=BRICK_CELLS_MASK; ++c)
 		{
-			pos[1] = j;
-			for (i=0;i<dx;++i)
-			{
-				pos[0] = i;
+			PropagationCell* theCell = (PropagationCell*)brick->cells[c];
+			if (!theCell)
+				continue;
+
+			unsigned index = ((unsigned)slot << BRICK_CELLS_SHIFT) | c;
 
-				index = unsigned(pos[0]+1)+unsigned(pos[1]+1)*decY+unsigned(pos[2]+1)*decZ;
-				PropagationCell* theCell = (PropagationCell*)theGrid[index];
+			bool isMin=true;
+			bool isMax=true;
 
-				bool isMin=true;
-				bool isMax=true;
+			for (n=0;n<CC_FM_NUMBER_OF_3D_NEIGHBOURS;++n)
+			{
+				PropagationCell* nCell = (PropagationCell*)getCell(getShiftedIndex(index,neighbours3DPosShift+3*n));
+				if (nCell)
+				{
+					if (nCell->f > theCell->f)
+						isMax = false;
+					else if (nCell->f < theCell->f)
+						isMin = false;
+				}
+			}
 
-				if (theCell)
+			if (isMin != isMax)
+			{
+				if (isMax)
 				{
-					//theCell->state = ACTIVE_CELL;
-
-					for (n=0;n<CC_FM_NUMBER_OF_3D_NEIGHBOURS;++n)
-					{
-						PropagationCell* nCell = (PropagationCell*)theGrid[index+neighbours3DIndexShift[n]];
-						if (nCell)
-						{
-							if (nCell->f > theCell->f)
-								isMax = false;
-							else if (nCell->f < theCell->f)
-								isMin = false;
-						}
-						//theGrid[index];
-					}
-
-					if (isMin != isMax)
-					{
-						/*if (isMin) theCell->T = 1.0;
-						else theCell->T = 2.0;*/
-
-						if (isMax)
-						{
-							theCell->state = Cell::ACTIVE_CELL;
-							theCell->T = 0.0;
-							activeCells.push_back(index);
-						}
-					}
-					//else theCell->T=0.0;
+					theCell->state = Cell::ACTIVE_CELL;
+					theCell->T = 0.0;
+					activeCells.push_back(index);
 				}
 			}
 		}
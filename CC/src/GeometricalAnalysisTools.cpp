@@ -107,7 +107,8 @@ bool GeometricalAnalysisTools::computeCellCurvatureAtLevel(const DgmOctree::octr
 	cell.parentOctree->computeCellCenter(nNSS.cellPos,cell.level,nNSS.cellCenter);
 	//*/
 
-	unsigned n = cell.points->size(); //number of points in the current cell
+	GenericIndexedCloudPersist* cloud = cell.parentOctree->associatedCloud();
+	unsigned n = cell.pointCount; //number of points in the current cell
 
 	//we already know some of the neighbours: the points in the current cell!
 	{
@@ -123,8 +124,8 @@ bool GeometricalAnalysisTools::computeCellCurvatureAtLevel(const DgmOctree::octr
 		DgmOctree::NeighboursSet::iterator it = nNSS.pointsInNeighbourhood.begin();
 		for (unsigned i=0; i<n; ++i,++it)
 		{
-			it->point = cell.points->getPointPersistentPtr(i);
-			it->pointIndex = cell.points->getPointGlobalIndex(i);
+			it->pointIndex = cell.getPointGlobalIndex(i);
+			it->point = cloud->getPointPersistentPtr(it->pointIndex);
 		}
 	}
 	nNSS.alreadyVisitedNeighbourhoodSize = 1;
@@ -134,7 +135,9 @@ bool GeometricalAnalysisTools::computeCellCurvatureAtLevel(const DgmOctree::octr
 	{
 		ScalarType curv = NAN_VALUE;
 
-		cell.points->getPoint(i,nNSS.queryPoint);
+		//current point index
+		unsigned index = cell.getPointGlobalIndex(i);
+		nNSS.queryPoint = *cloud->getPointPersistentPtr(index);
 
 		//look for neighbors in a sphere
 		unsigned neighborCount = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS,radius,false);
@@ -146,8 +149,6 @@ bool GeometricalAnalysisTools::computeCellCurvatureAtLevel(const DgmOctree::octr
 		if (neighborCount>10)
 #endif
 		{
-		    //current point index
-			unsigned index = cell.points->getPointGlobalIndex(i);
 		    //current point index in neighbourhood (to compute curvature at thre right position!)
             unsigned indexInNeighbourhood = 0;
 
@@ -171,7 +172,7 @@ bool GeometricalAnalysisTools::computeCellCurvatureAtLevel(const DgmOctree::octr
 #endif
 		}
 
-		cell.points->setPointScalarValue(i,curv);
+		cloud->setPointScalarValue(index,curv);
 	}
 
 	return true;
@@ -237,10 +238,12 @@ bool GeometricalAnalysisTools::computePointsDensityInACellAtLevel(const DgmOctre
 	cell.parentOctree->getCellPos(cell.truncatedCode,cell.level,nNSS.cellPos,true);
 	cell.parentOctree->computeCellCenter(nNSS.cellPos,cell.level,nNSS.cellCenter);
 
-	unsigned n=cell.points->size();
+	GenericIndexedCloudPersist* cloud = cell.parentOctree->associatedCloud();
+	unsigned n=cell.pointCount;
 	for (unsigned i=0; i<n; ++i)
 	{
-		cell.points->getPoint(i,nNSS.queryPoint);
+		unsigned index = cell.getPointGlobalIndex(i);
+		nNSS.queryPoint = *cloud->getPointPersistentPtr(index);
 
         //the first point is always the point itself!
 		if (cell.parentOctree->findNearestNeighborsStartingFromCell(nNSS)>1)
@@ -249,12 +252,12 @@ bool GeometricalAnalysisTools::computePointsDensityInACellAtLevel(const DgmOctre
 			//So, the local density is ~1/V!
             ScalarType R2 = nNSS.pointsInNeighbourhood[1].squareDist; //R2 in fact
             ScalarType V = R2*sqrt(R2)*c_sphereVolumeCoef; //R^3 * (4*pi/3)
-			cell.points->setPointScalarValue(i,(ScalarType)1.0/std::max(V,(ScalarType)ZERO_TOLERANCE));
+			cloud->setPointScalarValue(index,(ScalarType)1.0/std::max(V,(ScalarType)ZERO_TOLERANCE));
 		}
 		else
 		{
 			//shoudln't happen! Appart if the cloud has only one point...
-            cell.points->setPointScalarValue(i,NAN_VALUE);
+            cloud->setPointScalarValue(index,NAN_VALUE);
 		}
 	}
 
@@ -328,7 +331,8 @@ bool GeometricalAnalysisTools::computePointsRoughnessInACellAtLevel(const DgmOct
 	cell.parentOctree->getCellPos(cell.truncatedCode,cell.level,nNSS.cellPos,true);
 	cell.parentOctree->computeCellCenter(nNSS.cellPos,cell.level,nNSS.cellCenter);
 
-	unsigned n = cell.points->size(); //number of points in the current cell
+	GenericIndexedCloudPersist* cloud = cell.parentOctree->associatedCloud();
+	unsigned n = cell.pointCount; //number of points in the current cell
 	
 	//we already know some of the neighbours: the points in the current cell!
 	/*{
@@ -345,8 +349,8 @@ bool GeometricalAnalysisTools::computePointsRoughnessInACellAtLevel(const DgmOct
 
 		for (unsigned i=0;i<n;++i,++it)
 		{
-			it->pointIndex = cell.points->getPointGlobalIndex(i);
-			it->point = cell.points->getAssociatedCloud()->getPointPersistentPtr(it->pointIndex);
+			it->pointIndex = cell.getPointGlobalIndex(i);
+			it->point = cell.parentOctree->associatedCloud()->getPointPersistentPtr(it->pointIndex);
 			//it->squareDist = 
 		}
 		nNSS.alreadyVisitedNeighbourhoodSize = 1;
@@ -357,7 +361,8 @@ bool GeometricalAnalysisTools::computePointsRoughnessInACellAtLevel(const DgmOct
 	for (unsigned i=0;i<n;++i)
 	{
         ScalarType d = NAN_VALUE;
-		cell.points->getPoint(i,nNSS.queryPoint);
+		unsigned index = cell.getPointGlobalIndex(i);
+		nNSS.queryPoint = *cloud->getPointPersistentPtr(index);
 
 		//look for neighbors in a sphere
 		unsigned neighborCount = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS,radius,false);
@@ -371,7 +376,7 @@ bool GeometricalAnalysisTools::computePointsRoughnessInACellAtLevel(const DgmOct
                 d = DistanceComputationTools::computePoint2PlaneDistance(&nNSS.queryPoint,lsq);
 		}
 
-        cell.points->setPointScalarValue(i,d);
+        cloud->setPointScalarValue(index,d);
 	}
 
 	return true;
@@ -17,530 +17,764 @@
 
 #include "KdTree.h"
 
+//for ENABLE_MT_OCTREE
+#include "DgmOctree.h"
+
 //system
 #include <algorithm>
+#include <assert.h>
+#include <string.h>
+#include <float.h>
+
+#ifdef ENABLE_MT_OCTREE
+#include <QtCore/QtCore>
+#endif
 
 using namespace CCLib;
 
+//! Max number of points per leaf
+static const unsigned c_maxPointsPerLeaf = 8;
+//! Max depth of the tree (the nodes are split at the median: 64 levels are more than enough)
+static const unsigned c_maxDepth = 64;
+//! Number of query points processed by each 'batched query' job
+static const unsigned c_queryJobSize = 4096;
+
+//! Marks the top nodes which sub tree is built by a job
+static const unsigned c_jobNodeFlag = (unsigned)(-1);
+
+struct KDTree::BuildJob
+{
+    //! Points
+    std::vector<PointAndIndex>* list;
+    //! Range of points
+    unsigned first;
+    unsigned count;
+    //! Sub tree nodes (local indexes)
+    std::vector<KdNode> nodes;
+    //! Progress notification
+    NormalizedProgress* nProgress;
+    //! Whether the sub tree could be built
+    bool success;
+};
+
 KDTree::KDTree()
-	: m_root(0)
-	, associatedCloud(0)
-	, m_cellCount(0)
+	: associatedCloud(0)
 {
 }
 
 KDTree::~KDTree()
 {
-    deleteSubTree(m_root);
+}
+
+//! Comparison functors used to split the nodes
+struct PointAndIndexLess
+{
+    unsigned dim;
+    template<class T> bool operator()(const T& a, const T& b) const { return a.point.u[dim] < b.point.u[dim]; }
+};
+
+void KDTree::BuildSubTree(std::vector<PointAndIndex>& list,
+                            unsigned first,
+                            unsigned count,
+                            std::vector<KdNode>& nodes,
+                            std::vector<BuildJob>* jobs/*=0*/,
+                            unsigned jobDepth/*=0*/)
+{
+    assert(count != 0);
+
+    unsigned nodeIndex = (unsigned)nodes.size();
+    nodes.push_back(KdNode());
+
+    //inside bounding box
+    KdNode& node = nodes.back();
+    {
+        const CCVector3& P = list[first].point;
+        for (unsigned d=0; d<3; ++d)
+            node.inbbmin[d] = node.inbbmax[d] = P.u[d];
+        for (unsigned i=first+1; i<first+count; ++i)
+        {
+            const CCVector3& Q = list[i].point;
+            for (unsigned d=0; d<3; ++d)
+            {
+                if (Q.u[d] < node.inbbmin[d])
+                    node.inbbmin[d] = Q.u[d];
+                else if (Q.u[d] > node.inbbmax[d])
+                    node.inbbmax[d] = Q.u[d];
+            }
+        }
+    }
+
+    //leaf
+    if (count <= c_maxPointsPerLeaf)
+    {
+        node.index = first;
+        node.count = count;
+        return;
+    }
+
+    //the sub tree will be built by a job
+    if (jobs && jobDepth == 0)
+    {
+        node.index = (unsigned)jobs->size();
+        node.count = c_jobNodeFlag;
+        BuildJob job;
+        job.list = &list;
+        job.first = first;
+        job.count = count;
+        job.nProgress = 0;
+        job.success = false;
+        jobs->push_back(job);
+        return;
+    }
+
+    //we split the node at the median of its largest dimension
+    PointAndIndexLess comp;
+    comp.dim = 0;
+    {
+        PointCoordinateType maxExtent = node.inbbmax[0]-node.inbbmin[0];
+        for (unsigned d=1; d<3; ++d)
+        {
+            if (node.inbbmax[d]-node.inbbmin[d] > maxExtent)
+            {
+                maxExtent = node.inbbmax[d]-node.inbbmin[d];
+                comp.dim = d;
+            }
+        }
+    }
+    node.count = 0;
+
+    unsigned leftCount = count/2;
+    std::nth_element(list.begin()+first, list.begin()+(first+leftCount), list.begin()+(first+count), comp);
+
+    //warning: 'node' is invalidated as soon as 'nodes' grows
+    BuildSubTree(list, first, leftCount, nodes, jobs, jobDepth > 0 ? jobDepth-1 : 0);
+    nodes[nodeIndex].index = (unsigned)nodes.size();
+    BuildSubTree(list, first+leftCount, count-leftCount, nodes, jobs, jobDepth > 0 ? jobDepth-1 : 0);
+}
+
+void KDTree::BuildJobSubTree(BuildJob& job)
+{
+    try
+    {
+        //2 nodes per leaf (roughly)
+        job.nodes.reserve(2*(job.count/(c_maxPointsPerLeaf/2)+1));
+        BuildSubTree(*job.list, job.first, job.count, job.nodes);
+        job.success = true;
+    }
+    catch (.../*const std::bad_alloc&*/) //out of memory
+    {
+        job.nodes.clear();
+        job.success = false;
+    }
+
+    if (job.nProgress)
+        job.nProgress->oneStep();
 }
 
 bool KDTree::buildFromCloud(GenericIndexedCloud *cloud, GenericProgressCallback *progressCb)
 {
-    unsigned i, cloudsize=cloud->size();
+    unsigned cloudsize = cloud->size();
 
+    m_nodes.clear();
+    m_points.clear();
     m_indexes.clear();
-    m_cellCount = 0;
 	associatedCloud = 0;
 
     if(cloudsize == 0)
         return false;
 
+    std::vector<PointAndIndex> list;
 	try
 	{
-		m_list.resize(cloudsize);
+		list.resize(cloudsize);
 	}
 	catch (.../*const std::bad_alloc&*/) //out of memory
 	{
 		return false;
 	}
 
-	associatedCloud = cloud;
+	for(unsigned i=0; i<cloudsize; i++)
+    {
+        list[i].index = i;
+        cloud->getPoint(i,list[i].point);
+    }
 
-	for(i=0; i<cloudsize; i++)
+    //the top levels are built sequentially, the sub trees below are built by (parallel) jobs
+#ifdef ENABLE_MT_OCTREE
+    unsigned jobCount = 4*(unsigned)std::max(QThread::idealThreadCount(),1);
+#else
+    unsigned jobCount = 8;
+#endif
+    unsigned jobDepth = 0;
+    while ((1u<<jobDepth) < jobCount)
+        ++jobDepth;
+
+    std::vector<KdNode> topNodes;
+    std::vector<BuildJob> jobs;
+    try
     {
-        m_list[i].index = i;
-        cloud->getPoint(i,m_list[i].point);
+        BuildSubTree(list, 0, cloudsize, topNodes, &jobs, jobDepth);
+    }
+    catch (.../*const std::bad_alloc&*/) //out of memory
+    {
+        return false;
     }
 
+    NormalizedProgress* nProgress = 0;
     if(progressCb)
     {
+        nProgress = new NormalizedProgress(progressCb,(unsigned)jobs.size());
         progressCb->reset();
         progressCb->setInfo("Building KD-tree");
         progressCb->start();
     }
+    for (size_t j=0; j<jobs.size(); ++j)
+        jobs[j].nProgress = nProgress;
 
-    m_root = buildSubTree(0, cloudsize-1, (KdCell*)0, m_cellCount, progressCb);
+#ifdef ENABLE_MT_OCTREE
+    QtConcurrent::blockingMap(jobs, BuildJobSubTree);
+#else
+    for (size_t j=0; j<jobs.size(); ++j)
+        BuildJobSubTree(jobs[j]);
+#endif
 
     if(progressCb)
         progressCb->stop();
+    if (nProgress)
+        delete nProgress;
+    nProgress=0;
 
-    //if the tree building has failed (memory issues)
-    if(!m_root)
+    try
     {
-        associatedCloud = 0;
-        m_cellCount = 0;
-        return false;
-    }
+        size_t nodeCount = topNodes.size();
+        for (size_t j=0; j<jobs.size(); ++j)
+        {
+            //if the tree building has failed (memory issues)
+            if (!jobs[j].success)
+                return false;
+            nodeCount += jobs[j].nodes.size();
+        }
 
-	try
-	{
-		m_indexes.resize(cloudsize);
-	}
-	catch (.../*const std::bad_alloc&*/) //out of memory
-	{
-        associatedCloud = 0;
-        m_cellCount = 0;
+        m_nodes.reserve(nodeCount);
+        MergeNodes(topNodes, 0, jobs, m_nodes);
+
+        m_points.resize(cloudsize);
+        m_indexes.resize(cloudsize);
+    }
+    catch (.../*const std::bad_alloc&*/) //out of memory
+    {
+        m_nodes.clear();
+        m_points.clear();
+        m_indexes.clear();
         return false;
     }
-    for(i=0; i<cloudsize; i++)
-        m_indexes[i]=m_list[i].index;
-    m_list.clear();
-
-    return true;
-}
 
+    for(unsigned i=0; i<cloudsize; i++)
+    {
+        m_points[i] = list[i].point;
+        m_indexes[i] = list[i].index;
+    }
 
-void KDTree::deleteSubTree(KdCell *cell)
-{
-    if(!cell)
-        return;
+	associatedCloud = cloud;
 
-    deleteSubTree(cell->leSon);
-    deleteSubTree(cell->gSon);
-    delete cell;
-	assert(m_cellCount>0);
-    m_cellCount--;
+    return true;
 }
 
-KDTree::KdCell* KDTree::buildSubTree(unsigned first, unsigned last, KdCell* father, unsigned &nbBuildCell, GenericProgressCallback *progressCb)
+void KDTree::MergeNodes(const std::vector<KdNode>& topNodes,
+                        unsigned topIndex,
+                        const std::vector<BuildJob>& jobs,
+                        std::vector<KdNode>& nodes)
 {
-    KdCell* cell = new KdCell;
-    if (!cell)
-        return 0;
-    m_cellCount++;
-
-    unsigned dim = (father == 0 ? 0 : ((father->cuttingDim+1) % 3));
-
-    //Compute outside bounding box (have to be done before building the current cell sons)
-    cell->father = father;
-    cell->startingPointIndex = first;
-    cell->nbPoints = last-first+1;
-    cell->cuttingDim = dim;
-    updateOutsideBoundingBox(cell);
-    if(progressCb)
-        progressCb->update((float)m_cellCount*100.0f/(float)(m_list.size()*2-1));
+    const KdNode& topNode = topNodes[topIndex];
 
-    //If there is only one point to insert, build a leaf
-    if(first == last)
+    if (topNode.count == c_jobNodeFlag)
     {
-        cell->cuttingDim = 0;
-        cell->leSon = 0;
-        cell->gSon = 0;
+        //we append the job nodes (with an offset on the inner nodes second child index)
+        const std::vector<KdNode>& jobNodes = jobs[topNode.index].nodes;
+        unsigned offset = (unsigned)nodes.size();
+        for (size_t i=0; i<jobNodes.size(); ++i)
+        {
+            nodes.push_back(jobNodes[i]);
+            if (jobNodes[i].count == 0)
+                nodes.back().index += offset;
+        }
     }
     else
     {
-        //sort the remaining points considering dimension dim
-        if(dim == 0)
-            sort(m_list.begin()+first, m_list.begin()+(last+1), ComparisonX);
-        else if(dim == 1)
-            sort(m_list.begin()+first, m_list.begin()+(last+1), ComparisonY);
-        else if(dim == 2)
-            sort(m_list.begin()+first, m_list.begin()+(last+1), ComparisonZ);
-        //find the median point in the sorted tab
-        unsigned split = (first+last)/2;
-        const CCVector3& p = m_list[split].point;
-        cell->cuttingCoordinate = p.u[dim];
-        //recursively build the other two sub trees
-        //trap the memory issues. At this point, none of the cell sons can be set to 0. Otherwise there has been memory allocation failure.
-        cell->leSon = cell->gSon = 0;
-        cell->leSon = buildSubTree(first, split, cell, nbBuildCell, progressCb);
-        if(cell->leSon == 0)
+        unsigned nodeIndex = (unsigned)nodes.size();
+        nodes.push_back(topNode);
+        if (topNode.count == 0)
         {
-            deleteSubTree(cell);
-            //the tree beyond the current cell will be deleted when noticing that this cell is set to 0
-            return 0;
+            MergeNodes(topNodes, topIndex+1, jobs, nodes);
+            nodes[nodeIndex].index = (unsigned)nodes.size();
+            MergeNodes(topNodes, topNode.index, jobs, nodes);
         }
-        cell->gSon = buildSubTree(split+1, last, cell, nbBuildCell, progressCb);
-        if(cell->gSon == 0)
-        {
-            deleteSubTree(cell);
-            //the tree beyond the current cell will be deleted when noticing that this cell is set to 0
-            return 0;
-        }
-
     }
-    //Compute inside bounding box (have to be done once sons have been built)
-    updateInsideBoundingBox(cell);
+}
 
-    return cell;
+PointCoordinateType KDTree::PointToNodeSquareDistance(const PointCoordinateType *queryPoint, const KdNode& node)
+{
+    PointCoordinateType dist2 = 0;
+    for (unsigned d=0; d<3; ++d)
+    {
+        PointCoordinateType delta = 0;
+        if (queryPoint[d] < node.inbbmin[d])
+            delta = node.inbbmin[d]-queryPoint[d];
+        else if (queryPoint[d] > node.inbbmax[d])
+            delta = queryPoint[d]-node.inbbmax[d];
+        dist2 += delta*delta;
+    }
+    return dist2;
 }
 
+PointCoordinateType KDTree::PointToNodeMaxSquareDistance(const PointCoordinateType *queryPoint, const KdNode& node)
+{
+    PointCoordinateType dist2 = 0;
+    for (unsigned d=0; d<3; ++d)
+    {
+        PointCoordinateType delta = std::max(queryPoint[d]-node.inbbmin[d], node.inbbmax[d]-queryPoint[d]);
+        dist2 += delta*delta;
+    }
+    return dist2;
+}
 
-bool KDTree::findNearestNeighbour(const PointCoordinateType *queryPoint,
-									unsigned &nearestPointIndex,
-									PointCoordinateType maxDist)
+int KDTree::nearestNeighbour(const PointCoordinateType *queryPoint, PointCoordinateType& maxSquareDist, bool anyPoint) const
 {
-    KdCell *cellPtr, *prevPtr, *brotherPtr;
-    unsigned i;
-    int a;
-    PointCoordinateType sqrdist;
-    bool found = false;
+    if (m_nodes.empty())
+        return -1;
 
-    if(m_root == 0)
-        return false;
+    //explicit stack of (node, squared distance to the node)
+    std::pair<unsigned,PointCoordinateType> stack[c_maxDepth];
+    unsigned stackSize = 0;
 
-    cellPtr = m_root;
-    maxDist *= maxDist;
-    //Go down the tree to find which cell contains the query point (at most log2(N) tests where N is the total number of points in the cloud)
-    while(!(cellPtr->leSon == 0 && cellPtr->gSon == 0))
-    {
-        if(queryPoint[cellPtr->cuttingDim]<=cellPtr->cuttingCoordinate)
-            cellPtr = cellPtr->leSon;
-        else
-            cellPtr = cellPtr->gSon;
-    }
+    int nearestPos = -1;
+    unsigned nodeIndex = 0;
+    if (PointToNodeSquareDistance(queryPoint,m_nodes[0]) > maxSquareDist)
+        return -1;
 
-    //Once we found the cell containing the query point, the nearest neighbour has great chances to lie in this cell
-    for(i=0; i<cellPtr->nbPoints; i++)
+    while (true)
     {
-        const CCVector3 *p = associatedCloud->getPoint(m_indexes[cellPtr->startingPointIndex+i]);
-        sqrdist = CCVector3::vdistance2(p->u, queryPoint);
-        if(sqrdist<maxDist)
+        const KdNode& node = m_nodes[nodeIndex];
+        if (node.count != 0)
         {
-            maxDist = sqrdist;
-            nearestPointIndex = m_indexes[cellPtr->startingPointIndex+i];
-            found = true;
+            //leaf
+            for (unsigned i=node.index; i<node.index+node.count; ++i)
+            {
+                PointCoordinateType dist2 = CCVector3::vdistance2(m_points[i].u,queryPoint);
+                if (dist2 <= maxSquareDist)
+                {
+                    maxSquareDist = dist2;
+                    nearestPos = (int)i;
+                    if (anyPoint)
+                        return nearestPos;
+                }
+            }
         }
-    }
-
-    //Go up in the tree to check that neighbours cells do not contain a nearer point than the one we found
-    while(cellPtr != 0)
-    {
-        prevPtr = cellPtr;
-        cellPtr = cellPtr->father;
-        if(cellPtr != 0)
+        else
         {
-            sqrdist = InsidePointToCellDistance(queryPoint, cellPtr);
-            if(sqrdist>=0. && sqrdist*sqrdist<maxDist)
+            //we visit the nearest child first
+            unsigned child1 = nodeIndex+1;
+            unsigned child2 = node.index;
+            PointCoordinateType dist1 = PointToNodeSquareDistance(queryPoint,m_nodes[child1]);
+            PointCoordinateType dist2 = PointToNodeSquareDistance(queryPoint,m_nodes[child2]);
+            if (dist2 < dist1)
+            {
+                std::swap(child1,child2);
+                std::swap(dist1,dist2);
+            }
+            if (dist1 <= maxSquareDist)
             {
-                if(cellPtr->leSon == prevPtr)
-                    brotherPtr = cellPtr->gSon;
-                else
-                    brotherPtr = cellPtr->leSon;
-                a = checkNearerPointInSubTree(queryPoint, maxDist, brotherPtr);
-                if(a >= 0)
+                if (dist2 <= maxSquareDist)
                 {
-                    nearestPointIndex = a;
-                    found = true;
+                    assert(stackSize < c_maxDepth);
+                    stack[stackSize++] = std::pair<unsigned,PointCoordinateType>(child2,dist2);
                 }
+                nodeIndex = child1;
+                continue;
             }
-            else
-                cellPtr = 0;
         }
+
+        //next node to visit (the max distance may have decreased since it has been pushed)
+        while (stackSize != 0 && stack[stackSize-1].second > maxSquareDist)
+            --stackSize;
+        if (stackSize == 0)
+            break;
+        nodeIndex = stack[--stackSize].first;
     }
 
-    return found;
+    return nearestPos;
 }
 
-
-bool KDTree::findPointBelowDistance(
-    const PointCoordinateType *queryPoint,
-    PointCoordinateType maxDist)
+void KDTree::kNearestNeighbours(const PointCoordinateType *queryPoint,
+                                unsigned k,
+                                PointCoordinateType maxSquareDist,
+                                std::vector< std::pair<PointCoordinateType,unsigned> >& heap) const
 {
-    KdCell *cellPtr, *prevPtr, *brotherPtr;
-    unsigned i;
-    PointCoordinateType sqrdist;
+    heap.clear();
+    if (m_nodes.empty() || k == 0)
+        return;
 
-    if(m_root == 0)
-        return false;
+    //max-heap of the k nearest points found so far
+    heap.reserve(k);
 
-    cellPtr = m_root;
-    maxDist *= maxDist;
-    //Go down the tree to find which cell contains the query point (at most log2(N) tests where N is the total number of points in the cloud)
-    while(!(cellPtr->leSon == 0 && cellPtr->gSon == 0))
-    {
-        if(queryPoint[cellPtr->cuttingDim]<=cellPtr->cuttingCoordinate)
-            cellPtr = cellPtr->leSon;
-        else
-            cellPtr = cellPtr->gSon;
-    }
+    std::pair<unsigned,PointCoordinateType> stack[c_maxDepth];
+    unsigned stackSize = 0;
 
-    //Once we found the cell containing the query point, there are great chance to find a point if it exists
-    for(i=0; i<cellPtr->nbPoints; i++)
-    {
-		const CCVector3 *p = associatedCloud->getPoint(m_indexes[cellPtr->startingPointIndex+i]);
-        sqrdist = CCVector3::vdistance2(p->u, queryPoint);
-        if(sqrdist<maxDist)
-            return true;
-    }
+    unsigned nodeIndex = 0;
+    if (PointToNodeSquareDistance(queryPoint,m_nodes[0]) > maxSquareDist)
+        return;
 
-    //Go up in the tree to check that neighbours cells do not contain a point
-    while(cellPtr != 0)
+    while (true)
     {
-        prevPtr = cellPtr;
-        cellPtr = cellPtr->father;
-        if(cellPtr != 0)
+        const KdNode& node = m_nodes[nodeIndex];
+        if (node.count != 0)
         {
-            sqrdist = InsidePointToCellDistance(queryPoint, cellPtr);
-            if(sqrdist>=0. && sqrdist*sqrdist<maxDist)
+            for (unsigned i=node.index; i<node.index+node.count; ++i)
             {
-                if(cellPtr->leSon == prevPtr)
-                    brotherPtr = cellPtr->gSon;
-                else
-                    brotherPtr = cellPtr->leSon;
-                if(checkDistantPointInSubTree(queryPoint, maxDist, brotherPtr))
-                    return true;
+                PointCoordinateType dist2 = CCVector3::vdistance2(m_points[i].u,queryPoint);
+                if (dist2 <= maxSquareDist)
+                {
+                    if (heap.size() == k)
+                    {
+                        std::pop_heap(heap.begin(),heap.end());
+                        heap.pop_back();
+                    }
+                    heap.push_back(std::pair<PointCoordinateType,unsigned>(dist2,i));
+                    std::push_heap(heap.begin(),heap.end());
+                    //once we have k points, the search radius is the distance to the farthest one
+                    if (heap.size() == k)
+                        maxSquareDist = heap.front().first;
+                }
             }
-            else
-                cellPtr = 0;
         }
+        else
+        {
+            unsigned child1 = nodeIndex+1;
+            unsigned child2 = node.index;
+            PointCoordinateType dist1 = PointToNodeSquareDistance(queryPoint,m_nodes[child1]);
+            PointCoordinateType dist2 = PointToNodeSquareDistance(queryPoint,m_nodes[child2]);
+            if (dist2 < dist1)
+            {
+                std::swap(child1,child2);
+                std::swap(dist1,dist2);
+            }
+            if (dist1 <= maxSquareDist)
+            {
+                if (dist2 <= maxSquareDist)
+                {
+                    assert(stackSize < c_maxDepth);
+                    stack[stackSize++] = std::pair<unsigned,PointCoordinateType>(child2,dist2);
+                }
+                nodeIndex = child1;
+                continue;
+            }
+        }
+
+        while (stackSize != 0 && stack[stackSize-1].second > maxSquareDist)
+            --stackSize;
+        if (stackSize == 0)
+            break;
+        nodeIndex = stack[--stackSize].first;
     }
 
-    return false;
+    std::sort_heap(heap.begin(),heap.end());
 }
 
-unsigned KDTree::findPointsLyingToDistance(const PointCoordinateType *queryPoint,
-											PointCoordinateType distance,
-											PointCoordinateType tolerance,
-											std::vector<unsigned> &points)
+bool KDTree::findNearestNeighbour(const PointCoordinateType *queryPoint,
+									unsigned &nearestPointIndex,
+									PointCoordinateType maxDist) const
 {
-    if(m_root == 0)
-        return 0;
-
-    distanceScanTree(queryPoint, distance, tolerance, m_root, points);
+    PointCoordinateType maxSquareDist = maxDist*maxDist;
+    int pos = nearestNeighbour(queryPoint,maxSquareDist,false);
+    if (pos < 0)
+        return false;
 
-    return (unsigned)points.size();
+    nearestPointIndex = m_indexes[pos];
+    return true;
 }
 
-
-void KDTree::updateInsideBoundingBox(KdCell* cell)
+bool KDTree::findPointBelowDistance(const PointCoordinateType *queryPoint,
+                                    PointCoordinateType maxDist) const
 {
-    if((cell->leSon!=0) && (cell->gSon!=0))
-    {
-        cell->inbbmax.x = std::max(cell->leSon->inbbmax.x, cell->gSon->inbbmax.x);
-        cell->inbbmax.y = std::max(cell->leSon->inbbmax.y, cell->gSon->inbbmax.y);
-        cell->inbbmax.z = std::max(cell->leSon->inbbmax.z, cell->gSon->inbbmax.z);
-        cell->inbbmin.x = std::min(cell->leSon->inbbmin.x, cell->gSon->inbbmin.x);
-        cell->inbbmin.y = std::min(cell->leSon->inbbmin.y, cell->gSon->inbbmin.y);
-        cell->inbbmin.z = std::min(cell->leSon->inbbmin.z, cell->gSon->inbbmin.z);
-    }
-    else
-    {
-        CCVector3& p = m_list[cell->startingPointIndex].point;
-        cell->inbbmin = cell->inbbmax = p;
-        for(unsigned i=1; i<cell->nbPoints; i++)
-        {
-            p = m_list[i+cell->startingPointIndex].point;
-            cell->inbbmax.x = std::max(cell->inbbmax.x, p.x);
-            cell->inbbmax.y = std::max(cell->inbbmax.y, p.y);
-            cell->inbbmax.z = std::max(cell->inbbmax.z, p.z);
-            cell->inbbmin.x = std::min(cell->inbbmin.x, p.x);
-            cell->inbbmin.y = std::min(cell->inbbmin.y, p.y);
-            cell->inbbmin.z = std::min(cell->inbbmin.z, p.z);
-        }
-    }
+    PointCoordinateType maxSquareDist = maxDist*maxDist;
+    return (nearestNeighbour(queryPoint,maxSquareDist,true) >= 0);
 }
 
-
-void KDTree::updateOutsideBoundingBox(KdCell *cell)
+unsigned KDTree::findPointsLyingToDistance(const PointCoordinateType *queryPoint,
+                                            PointCoordinateType distance,
+                                            PointCoordinateType tolerance,
+                                            std::vector<unsigned> &points) const
 {
-    if(cell->father == 0)
-    {
-        cell->boundsMask = 0;
-    }
-    else
+    if (m_nodes.empty())
+        return (unsigned)points.size();
+
+    PointCoordinateType minDist = std::max(distance-tolerance,(PointCoordinateType)0);
+    PointCoordinateType maxDist = distance+tolerance;
+    PointCoordinateType minSquareDist = minDist*minDist;
+    PointCoordinateType maxSquareDist = maxDist*maxDist;
+
+    unsigned stack[c_maxDepth];
+    unsigned stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize != 0)
     {
-        unsigned char bound = 1;
-        cell->boundsMask = cell->father->boundsMask;
-        cell->outbbmax = cell->father->outbbmax;
-        cell->outbbmin = cell->father->outbbmin;
-        const CCVector3& p = m_list[cell->startingPointIndex].point;
-        //Check if this cell is its father leSon (if...) or gSon (else...)
-        if(p.u[cell->father->cuttingDim] <= cell->father->cuttingCoordinate)
+        const KdNode& node = m_nodes[stack[--stackSize]];
+
+        //the node intersects the 'shell'?
+        if (PointToNodeSquareDistance(queryPoint,node) > maxSquareDist || PointToNodeMaxSquareDistance(queryPoint,node) < minSquareDist)
+            continue;
+
+        if (node.count != 0)
         {
-            //Bounding box max point is linked to the bits [3..5] in the bounds mask
-            bound = bound<<(3+cell->father->cuttingDim);
-            cell->boundsMask = cell->boundsMask | bound;
-            cell->outbbmax.u[cell->father->cuttingDim] = cell->father->cuttingCoordinate;
+            for (unsigned i=node.index; i<node.index+node.count; ++i)
+            {
+                PointCoordinateType dist2 = CCVector3::vdistance2(m_points[i].u,queryPoint);
+                if (dist2 >= minSquareDist && dist2 <= maxSquareDist)
+                    points.push_back(m_indexes[i]);
+            }
         }
         else
         {
-            //Bounding box min point is linked to the bits[0..2] in the bounds mask
-            bound = bound<<(cell->father->cuttingDim);
-            cell->boundsMask = cell->boundsMask | bound;
-            cell->outbbmin.u[cell->father->cuttingDim] = cell->father->cuttingCoordinate;
+            assert(stackSize+2 <= c_maxDepth);
+            stack[stackSize++] = node.index;
+            stack[stackSize++] = (unsigned)(&node-&m_nodes[0])+1;
         }
     }
-}
-
-
-ScalarType KDTree::pointToCellSquareDistance(const PointCoordinateType *queryPoint, KdCell *cell)
-{
-    ScalarType dx, dy, dz;
 
-    //Each d(x)(y)(z) represents the distance to the nearest bounding box plane (if the point is outside)
-    if(cell->inbbmin.x<=queryPoint[0] && queryPoint[0]<=cell->inbbmax.x)
-        dx = 0.;
-    else
-        dx = std::min(fabs(queryPoint[0]-cell->inbbmin.x), fabs(queryPoint[0]-cell->inbbmax.x));
-    if(cell->inbbmin.y<=queryPoint[1] && queryPoint[1]<=cell->inbbmax.y)
-        dy = 0.;
-    else
-        dy = std::min(fabs(queryPoint[1]-cell->inbbmin.y), fabs(queryPoint[1]-cell->inbbmax.y));
-    if(cell->inbbmin.z<=queryPoint[2] && queryPoint[2]<=cell->inbbmax.z)
-        dz = 0.;
-    else
-        dz = std::min(fabs(queryPoint[2]-cell->inbbmin.z), fabs(queryPoint[2]-cell->inbbmax.z));
-
-    return (dx*dx)+(dy*dy)+(dz*dz);
+    return (unsigned)points.size();
 }
 
-
-void KDTree::pointToCellDistances(const PointCoordinateType *queryPoint, KdCell *cell, ScalarType& min, ScalarType &max)
+unsigned KDTree::findKNearestNeighbours(const PointCoordinateType *queryPoint,
+                                        unsigned k,
+                                        std::vector<unsigned> &points,
+                                        std::vector<ScalarType>* squareDists/*=0*/,
+                                        PointCoordinateType maxDist/*=-1*/) const
 {
-    ScalarType dx, dy, dz;
+    std::vector< std::pair<PointCoordinateType,unsigned> > heap;
+    kNearestNeighbours(queryPoint,k,maxDist >= 0 ? maxDist*maxDist : FLT_MAX,heap);
+
+    unsigned count = (unsigned)heap.size();
+    points.resize(count);
+    if (squareDists)
+        squareDists->resize(count);
+    for (unsigned i=0; i<count; ++i)
+    {
+        points[i] = m_indexes[heap[i].second];
+        if (squareDists)
+            (*squareDists)[i] = (ScalarType)heap[i].first;
+    }
 
-    min = sqrt(pointToCellSquareDistance(queryPoint, cell));
-    dx = std::max(fabs(queryPoint[0]-cell->inbbmin.x), fabs(queryPoint[0]-cell->inbbmax.x));
-    dy = std::max(fabs(queryPoint[1]-cell->inbbmin.y), fabs(queryPoint[1]-cell->inbbmax.y));
-    dz = std::max(fabs(queryPoint[2]-cell->inbbmin.z), fabs(queryPoint[2]-cell->inbbmax.z));
-    max = sqrt((dx*dx)+(dy*dy)+(dz*dz));
+    return count;
 }
 
-
-ScalarType KDTree::InsidePointToCellDistance(const PointCoordinateType *queryPoint, KdCell *cell)
+unsigned KDTree::findPointsInSphere(const PointCoordinateType *queryPoint,
+                                    PointCoordinateType radius,
+                                    std::vector<unsigned> &points) const
 {
-    ScalarType dx, dy, dz, max;
-
-    dx = dy = dz = -1;
-
-    if((cell->boundsMask&1) && (cell->boundsMask&8))
-        dx = std::min(fabs(queryPoint[0]-cell->outbbmin.x), fabs(queryPoint[0]-cell->outbbmax.x));
-    else if(cell->boundsMask&1)
-        dx = fabs(queryPoint[0]-cell->outbbmin.x);
-    else if(cell->boundsMask&8)
-        dx = fabs(queryPoint[0]-cell->outbbmax.x);
-
-    if((cell->boundsMask&2) && (cell->boundsMask&16))
-        dy = std::min(fabs(queryPoint[1]-cell->outbbmin.y), fabs(queryPoint[1]-cell->outbbmax.y));
-    else if(cell->boundsMask&2)
-        dy = fabs(queryPoint[1]-cell->outbbmin.y);
-    else if(cell->boundsMask&16)
-        dy = fabs(queryPoint[1]-cell->outbbmax.y);
-
-    if((cell->boundsMask&4) && (cell->boundsMask&32))
-        dz = std::min(fabs(queryPoint[2]-cell->outbbmin.z), fabs(queryPoint[2]-cell->outbbmax.z));
-    else if(cell->boundsMask&4)
-        dz = fabs(queryPoint[2]-cell->outbbmin.z);
-    else if(cell->boundsMask&32)
-        dz = fabs(queryPoint[2]-cell->outbbmax.z);
-
-    if(dx < 0. && dy < 0. && dz < 0.)
-        return -1.;
-
-    max = std::max(dx, std::max(dy, dz));
-    if(dx < 0.)
-        dx = max;
-    if(dy < 0.)
-        dy = max;
-    if(dz < 0.)
-        dz = max;
-
-    return std::min(dx, std::min(dy, dz));
+    //a sphere is a 'shell' with a null inner radius
+    return findPointsLyingToDistance(queryPoint,0,radius,points);
 }
 
+/*** Batched queries ***/
 
-int KDTree::checkNearerPointInSubTree(const PointCoordinateType *queryPoint, ScalarType &maxSqrDist, KdCell *cell)
+struct kdTreeQueryJob
 {
-    if(pointToCellSquareDistance(queryPoint, cell)>=maxSqrDist)
-        return -1;
+    const KDTree* tree;
+    GenericIndexedCloud* queryCloud;
+    //! Range of query points
+    unsigned first;
+    unsigned count;
+    //! Number of neighbours (0 = sphere search)
+    unsigned k;
+    //! Max distance (or sphere radius)
+    PointCoordinateType maxDist;
+    //! Outputs
+    int* nearestPointIndexes;
+    unsigned* neighbours;
+    ScalarType* squareDists;
+    std::vector<unsigned>* sphereNeighbours;
+    bool* success;
+};
+
+static void ProcessKDTreeQueries(kdTreeQueryJob& job)
+{
+    std::vector<unsigned> points;
+    std::vector<ScalarType> squareDists;
+    CCVector3 P;
 
-    if(cell->leSon == 0 && cell->gSon == 0)
+    try
     {
-        int a = -1;
-        for(unsigned i=0; i<cell->nbPoints; i++)
+        for (unsigned i=job.first; i<job.first+job.count; ++i)
         {
-            const CCVector3 *p = associatedCloud->getPoint(m_indexes[cell->startingPointIndex+i]);
-            ScalarType dist = CCVector3::vdistance2(p->u, queryPoint);
-            if(dist<maxSqrDist)
+            job.queryCloud->getPoint(i,P);
+
+            if (job.sphereNeighbours)
+            {
+                job.sphereNeighbours[i].clear();
+                job.tree->findPointsInSphere(P.u,job.maxDist,job.sphereNeighbours[i]);
+            }
+            else if (job.nearestPointIndexes)
+            {
+                unsigned count = job.tree->findKNearestNeighbours(P.u,1,points,job.squareDists ? &squareDists : 0,job.maxDist);
+                job.nearestPointIndexes[i] = (count != 0 ? (int)points[0] : -1);
+                if (job.squareDists)
+                    job.squareDists[i] = (count != 0 ? squareDists[0] : (ScalarType)(-1.0));
+            }
+            else
             {
-                a = m_indexes[cell->startingPointIndex+i];
-                maxSqrDist = dist;
+                unsigned count = job.tree->findKNearestNeighbours(P.u,job.k,points,job.squareDists ? &squareDists : 0);
+                assert(count == job.k);
+                //64 bits offset: the output buffers may hold more than 2^32 values
+                size_t offset = static_cast<size_t>(i)*job.k;
+                for (unsigned j=0; j<count; ++j)
+                {
+                    job.neighbours[offset+j] = points[j];
+                    if (job.squareDists)
+                        job.squareDists[offset+j] = squareDists[j];
+                }
             }
         }
+    }
+    catch (.../*const std::bad_alloc&*/) //out of memory
+    {
+        *job.success = false;
+    }
+}
+
+//! Processes a set of queries by blocks of c_queryJobSize points
+static bool RunKDTreeQueries(const kdTreeQueryJob& job, unsigned queryCount, bool multiThread)
+{
+    bool success = true;
 
-        return a;
+    unsigned jobCount = (queryCount+c_queryJobSize-1)/c_queryJobSize;
+    std::vector<kdTreeQueryJob> jobs;
+    try
+    {
+        jobs.resize(jobCount,job);
+    }
+    catch (.../*const std::bad_alloc&*/) //out of memory
+    {
+        return false;
+    }
+    for (unsigned j=0; j<jobCount; ++j)
+    {
+        jobs[j].first = j*c_queryJobSize;
+        jobs[j].count = std::min(c_queryJobSize,queryCount-jobs[j].first);
+        jobs[j].success = &success;
     }
 
-	int b = checkNearerPointInSubTree(queryPoint,  maxSqrDist, cell->gSon);
-	if (b >= 0)
-		return b;
+#ifdef ENABLE_MT_OCTREE
+    if (multiThread)
+    {
+        QtConcurrent::blockingMap(jobs, ProcessKDTreeQueries);
+    }
+    else
+#endif
+    {
+        for (unsigned j=0; j<jobCount; ++j)
+            ProcessKDTreeQueries(jobs[j]);
+    }
 
-	return checkNearerPointInSubTree(queryPoint,  maxSqrDist, cell->leSon);
+    return success;
 }
 
+bool KDTree::findNearestNeighbours(GenericIndexedCloud* queryCloud,
+                                    std::vector<int>& nearestPointIndexes,
+                                    PointCoordinateType maxDist/*=-1*/,
+                                    std::vector<ScalarType>* squareDists/*=0*/,
+                                    bool multiThread/*=true*/) const
+{
+    assert(queryCloud);
+
+    unsigned count = queryCloud->size();
+    try
+    {
+        nearestPointIndexes.resize(count);
+        if (squareDists)
+            squareDists->resize(count);
+    }
+    catch (.../*const std::bad_alloc&*/) //out of memory
+    {
+        return false;
+    }
+    if (count == 0)
+        return true;
+
+    kdTreeQueryJob job;
+    memset(&job,0,sizeof(kdTreeQueryJob));
+    job.tree = this;
+    job.queryCloud = queryCloud;
+    job.k = 1;
+    job.maxDist = maxDist;
+    job.nearestPointIndexes = &(nearestPointIndexes[0]);
+    job.squareDists = (squareDists ? &((*squareDists)[0]) : 0);
+
+    return RunKDTreeQueries(job,count,multiThread);
+}
 
-bool KDTree::checkDistantPointInSubTree(const PointCoordinateType *queryPoint, ScalarType &maxSqrDist, KdCell *cell)
+bool KDTree::findKNearestNeighbours(GenericIndexedCloud* queryCloud,
+                                    unsigned k,
+                                    std::vector<unsigned>& neighbours,
+                                    std::vector<ScalarType>* squareDists/*=0*/,
+                                    bool multiThread/*=true*/) const
 {
-    if(pointToCellSquareDistance(queryPoint, cell)>=maxSqrDist)
+    assert(queryCloud);
+
+    if (k == 0 || k > (unsigned)m_points.size())
         return false;
 
-    if(cell->leSon == 0 && cell->gSon == 0)
+    unsigned count = queryCloud->size();
+    try
+    {
+        neighbours.resize((size_t)count*k);
+        if (squareDists)
+            squareDists->resize((size_t)count*k);
+    }
+    catch (.../*const std::bad_alloc&*/) //out of memory
     {
-        for(unsigned i=0; i<cell->nbPoints; i++)
-        {
-            const CCVector3 *p = associatedCloud->getPoint(m_indexes[cell->startingPointIndex+i]);
-            ScalarType dist = CCVector3::vdistance2(p->u, queryPoint);
-            if(dist<maxSqrDist)
-                return true;
-        }
         return false;
     }
-
-    if(checkDistantPointInSubTree(queryPoint,  maxSqrDist, cell->leSon))
-        return true;
-    if(checkDistantPointInSubTree(queryPoint,  maxSqrDist, cell->gSon))
+    if (count == 0)
         return true;
 
-    return false;
-}
+    kdTreeQueryJob job;
+    memset(&job,0,sizeof(kdTreeQueryJob));
+    job.tree = this;
+    job.queryCloud = queryCloud;
+    job.k = k;
+    job.maxDist = -1;
+    job.neighbours = &(neighbours[0]);
+    job.squareDists = (squareDists ? &((*squareDists)[0]) : 0);
 
+    return RunKDTreeQueries(job,count,multiThread);
+}
 
-void KDTree::distanceScanTree(
-    const PointCoordinateType *queryPoint,
-    ScalarType distance,
-    ScalarType tolerance,
-    KdCell *cell,
-    std::vector<unsigned> &localArray)
+bool KDTree::findPointsInSpheres(GenericIndexedCloud* queryCloud,
+                                    PointCoordinateType radius,
+                                    std::vector< std::vector<unsigned> >& neighbours,
+                                    bool multiThread/*=true*/) const
 {
-    ScalarType min, max;
+    assert(queryCloud);
 
-    pointToCellDistances(queryPoint, cell, min, max);
-
-    if((min<=distance+tolerance) && (max>=distance-tolerance))
+    unsigned count = queryCloud->size();
+    try
     {
-        if((cell->leSon!=0) && (cell->gSon!=0))
-        {
-            //This case shall allways happen (the other case is for leaves that contain more than one point - bucket KDtree)
-            if(cell->nbPoints == 1)
-            {
-                localArray.push_back(m_indexes[cell->startingPointIndex]);
-            }
-            else
-            {
-                for(unsigned i=0; i<cell->nbPoints; i++)
-                {
-                    const CCVector3 *p = associatedCloud->getPoint(m_indexes[i+cell->startingPointIndex]);
-                    ScalarType dist = CCVector3::vdistance(queryPoint, p->u);
-                    if((distance-tolerance<=dist) && (dist<=distance+tolerance))
-                        localArray.push_back(m_indexes[cell->startingPointIndex+i]);
-                }
-            }
-        }
-        else
-        {
-            distanceScanTree(queryPoint, distance, tolerance, cell->leSon, localArray);
-            distanceScanTree(queryPoint, distance, tolerance, cell->gSon, localArray);
-        }
+        neighbours.resize(count);
+    }
+    catch (.../*const std::bad_alloc&*/) //out of memory
+    {
+        return false;
     }
+    if (count == 0)
+        return true;
+
+    kdTreeQueryJob job;
+    memset(&job,0,sizeof(kdTreeQueryJob));
+    job.tree = this;
+    job.queryCloud = queryCloud;
+    job.maxDist = radius;
+    job.sphereNeighbours = &(neighbours[0]);
+
+    return RunKDTreeQueries(job,count,multiThread);
 }
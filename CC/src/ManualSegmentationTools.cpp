@@ -26,10 +26,20 @@
 #include "GenericIndexedMesh.h"
 #include "SimpleMesh.h"
 #include "Polyline.h"
+#include "ChunkedPointCloud.h"
+#include "DgmOctree.h"
+#include "CCConst.h"
+#include "SSEHelper.h"
 
 //system
 #include <string.h>
 #include <assert.h>
+#include <math.h>
+#include <algorithm>
+
+#ifdef ENABLE_MT_OCTREE
+#include <QtCore/QtCore>
+#endif
 
 using namespace CCLib;
 
@@ -106,6 +116,665 @@ bool ManualSegmentationTools::isPointInsidePoly(const CCVector2& P, const Polyli
 	return inside;
 }
 
+bool ManualSegmentationTools::isPointInsidePoly(const CCVector2& P, const std::vector<CCVector2>& polyVertices)
+{
+	size_t vertCount = polyVertices.size();
+	if (vertCount<2)
+		return false;
+
+	bool inside = false;
+
+	for (size_t i=1; i<=vertCount; ++i)
+	{
+		const CCVector2& A = polyVertices[i-1];
+		const CCVector2& B = polyVertices[i%vertCount];
+
+		//Point Inclusion in Polygon Test (inspired from W. Randolph Franklin - WRF)
+		if (((B.y<=P.y) && (P.y<A.y)) ||
+             ((A.y<=P.y) && (P.y<B.y)))
+		{
+			PointCoordinateType ABy = A.y-B.y;
+			PointCoordinateType t = (P.x-B.x)*ABy-(A.x-B.x)*(P.y-B.y);
+			if (ABy<0)
+				t=-t;
+			if (t<0)
+				inside = !inside;
+		}
+	}
+
+	return inside;
+}
+
+//Screen mask pixel states (see segmentWithScreenPolyline)
+static const uchar MASK_OUTSIDE	= 0;
+static const uchar MASK_INSIDE	= 1;
+static const uchar MASK_BORDER	= 2; //too close to the polyline: the exact test is required
+
+//! Distance to the polyline (in pixels) below which the exact test is used
+/** Covers the difference between the (single precision) batch projection
+	and the double precision one (gluProject).
+**/
+static const double c_maskBorderMargin = 0.25;
+
+//! Max number of pixels of the screen mask (otherwise the polyline is not a 'screen' one!)
+static const size_t c_maskMaxPixelCount = (1<<26);
+
+//! Indicative number of points per octree cell for the pre-classification
+static const unsigned c_segmentationPointsPerCell = 256;
+
+//! Context shared by the screen segmentation jobs (see segmentWithScreenPolyline)
+struct ScreenSegmentationContext
+{
+	//! Mask origin (in the polyline coordinate system)
+	int maskX, maskY;
+	//! Mask dimensions (in pixels)
+	int maskWidth, maskHeight;
+	//! Mask pixels (MASK_OUTSIDE, MASK_INSIDE or MASK_BORDER)
+	std::vector<uchar> mask;
+	//! Summed area tables of the non 'outside' and non 'inside' pixels (for the octree cells classification)
+	std::vector<unsigned> notOutsideSAT, notInsideSAT;
+
+	//! Polyline vertices
+	std::vector<CCVector2> polyVertices;
+	//! Whether the points inside the polyline should be kept
+	bool keepInside;
+
+	//! OpenGL matrices (for the exact projection, see gluProject)
+	const double* modelViewMat;
+	const double* projectionMat;
+	const int* viewport;
+	//! Polyline origin on screen
+	double originX, originY;
+
+	//! Projection origin (coordinates are expressed relatively to it before the single precision projection)
+	CCVector3 center;
+	//! Rows of the 'mask' projection matrix: (mask X, mask Y, W) = rows * (P-center,1)
+	double rows[3][4];
+	//! Single precision version of 'rows'
+	float rowsf[3][4];
+
+	//! Octree (optional)
+	const DgmOctree* octree;
+	//! Octree level used for the pre-classification
+	uchar level;
+	//! Octree cells (indexes of the first point of each cell)
+	std::vector<unsigned> cellIndexes;
+
+	//! Cloud
+	const ChunkedPointCloud* cloud;
+	//! Points visibility
+	ManualSegmentationTools::VisibilityTableType* visibility;
+
+	//! Projects a point on screen (same computation as gluProject)
+	bool projectExact(const CCVector3& P, CCVector2& P2D) const
+	{
+		double in[4] = { P.x, P.y, P.z, 1.0 };
+		double out[4];
+		for (unsigned i=0; i<4; ++i)
+			out[i] = modelViewMat[i]*in[0] + modelViewMat[4+i]*in[1] + modelViewMat[8+i]*in[2] + modelViewMat[12+i]*in[3];
+		for (unsigned i=0; i<4; ++i)
+			in[i] = projectionMat[i]*out[0] + projectionMat[4+i]*out[1] + projectionMat[8+i]*out[2] + projectionMat[12+i]*out[3];
+		if (in[3] == 0.0)
+			return false;
+		in[0] /= in[3];
+		in[1] /= in[3];
+
+		double xp = viewport[0] + (1.0+in[0]) * viewport[2] / 2.0;
+		double yp = viewport[1] + (1.0+in[1]) * viewport[3] / 2.0;
+		P2D = CCVector2(static_cast<PointCoordinateType>(xp-originX), static_cast<PointCoordinateType>(yp-originY));
+
+		return true;
+	}
+
+	//! Returns the mask state corresponding to a point (single precision projection)
+	inline uchar classify(const PointCoordinateType* P) const
+	{
+		float x = P[0]-center.x;
+		float y = P[1]-center.y;
+		float z = P[2]-center.z;
+		float w = rowsf[2][0]*x + rowsf[2][1]*y + rowsf[2][2]*z + rowsf[2][3];
+		if (!(w > 0))
+			return MASK_BORDER; //behind the camera (or degenerate): exact test
+		float fx = (rowsf[0][0]*x + rowsf[0][1]*y + rowsf[0][2]*z + rowsf[0][3]) / w;
+		float fy = (rowsf[1][0]*x + rowsf[1][1]*y + rowsf[1][2]*z + rowsf[1][3]) / w;
+		if (fx >= 0 && fx < maskWidth && fy >= 0 && fy < maskHeight) //also rejects NaN values
+			return mask[static_cast<int>(fy)*maskWidth + static_cast<int>(fx)];
+		return MASK_OUTSIDE;
+	}
+
+#ifdef CC_USE_SSE_KERNELS
+	//! Returns the mask states corresponding to 4 points (de-interleaved)
+	inline void classify4(__m128 x, __m128 y, __m128 z, uchar states[4]) const
+	{
+		x = _mm_sub_ps(x,_mm_set1_ps(center.x));
+		y = _mm_sub_ps(y,_mm_set1_ps(center.y));
+		z = _mm_sub_ps(z,_mm_set1_ps(center.z));
+
+		__m128 r[3];
+		for (unsigned i=0; i<3; ++i)
+			r[i] = _mm_add_ps(	_mm_add_ps(_mm_mul_ps(x,_mm_set1_ps(rowsf[i][0])),_mm_mul_ps(y,_mm_set1_ps(rowsf[i][1]))),
+								_mm_add_ps(_mm_mul_ps(z,_mm_set1_ps(rowsf[i][2])),_mm_set1_ps(rowsf[i][3])) );
+
+		const __m128 zero = _mm_setzero_ps();
+		int behind = _mm_movemask_ps(_mm_cmpngt_ps(r[2],zero));
+		__m128 fx = _mm_div_ps(r[0],r[2]);
+		__m128 fy = _mm_div_ps(r[1],r[2]);
+		__m128 inMask = _mm_and_ps(	_mm_and_ps(_mm_cmpge_ps(fx,zero),_mm_cmplt_ps(fx,_mm_set1_ps(static_cast<float>(maskWidth)))),
+									_mm_and_ps(_mm_cmpge_ps(fy,zero),_mm_cmplt_ps(fy,_mm_set1_ps(static_cast<float>(maskHeight)))) );
+		int inside = _mm_movemask_ps(inMask);
+
+		int ix[4],iy[4];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(ix),_mm_cvttps_epi32(fx));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(iy),_mm_cvttps_epi32(fy));
+
+		for (unsigned j=0; j<4; ++j)
+		{
+			if (behind & (1<<j))
+				states[j] = MASK_BORDER;
+			else if (inside & (1<<j))
+				states[j] = mask[iy[j]*maskWidth + ix[j]];
+			else
+				states[j] = MASK_OUTSIDE;
+		}
+	}
+#endif
+
+	//! Returns the new visibility of a visible point
+	inline uchar getVisibility(uchar state, const CCVector3& P) const
+	{
+		bool inside = (state == MASK_INSIDE);
+		if (state == MASK_BORDER)
+		{
+			CCVector2 P2D;
+			inside = (projectExact(P,P2D) && ManualSegmentationTools::isPointInsidePoly(P2D,polyVertices));
+		}
+		return (keepInside != inside ? POINT_HIDDEN : POINT_VISIBLE);
+	}
+
+	//! Returns the number of pixels in a mask rectangle (bounds included) from a summed area table
+	inline unsigned countPixels(const std::vector<unsigned>& sat, int x0, int y0, int x1, int y1) const
+	{
+		int w = maskWidth+1;
+		return sat[(y1+1)*w+(x1+1)] - sat[y0*w+(x1+1)] - sat[(y1+1)*w+x0] + sat[y0*w+x0];
+	}
+
+	//! Returns the mask state of a whole octree cell (MASK_BORDER if the cell points must be tested individually)
+	uchar classifyCell(DgmOctree::OctreeCellCodeType code) const
+	{
+		PointCoordinateType cellMin[3],cellMax[3];
+		octree->computeCellLimits(code,level,cellMin,cellMax,false);
+
+		//projection of the 8 cell corners (the points projections lie in their bounding box)
+		double xMin=0,xMax=0,yMin=0,yMax=0;
+		for (unsigned k=0; k<8; ++k)
+		{
+			double c[3] = {	static_cast<double>((k & 1) ? cellMax[0] : cellMin[0]) - center.x,
+							static_cast<double>((k & 2) ? cellMax[1] : cellMin[1]) - center.y,
+							static_cast<double>((k & 4) ? cellMax[2] : cellMin[2]) - center.z };
+			double w = rows[2][0]*c[0] + rows[2][1]*c[1] + rows[2][2]*c[2] + rows[2][3];
+			if (!(w > 0))
+				return MASK_BORDER; //the cell crosses the camera plane
+			double x = (rows[0][0]*c[0] + rows[0][1]*c[1] + rows[0][2]*c[2] + rows[0][3]) / w;
+			double y = (rows[1][0]*c[0] + rows[1][1]*c[1] + rows[1][2]*c[2] + rows[1][3]) / w;
+			if (k == 0)
+			{
+				xMin = xMax = x;
+				yMin = yMax = y;
+			}
+			else
+			{
+				xMin = std::min(xMin,x); xMax = std::max(xMax,x);
+				yMin = std::min(yMin,y); yMax = std::max(yMax,y);
+			}
+		}
+
+		//one pixel of margin (rounding errors)
+		if (!(xMax+1.0 >= 0.0 && yMax+1.0 >= 0.0 && xMin-1.0 < maskWidth && yMin-1.0 < maskHeight))
+			return (xMin == xMin && yMin == yMin ? MASK_OUTSIDE : MASK_BORDER); //NaN values are tested the exact way
+
+		int x0 = static_cast<int>(floor(xMin-1.0));
+		int y0 = static_cast<int>(floor(yMin-1.0));
+		int x1 = static_cast<int>(floor(xMax+1.0));
+		int y1 = static_cast<int>(floor(yMax+1.0));
+		bool fullyInMask = (x0 >= 0 && y0 >= 0 && x1 < maskWidth && y1 < maskHeight);
+		x0 = std::max(x0,0);
+		y0 = std::max(y0,0);
+		x1 = std::min(x1,maskWidth-1);
+		y1 = std::min(y1,maskHeight-1);
+
+		if (countPixels(notOutsideSAT,x0,y0,x1,y1) == 0)
+			return MASK_OUTSIDE;
+		if (fullyInMask && countPixels(notInsideSAT,x0,y0,x1,y1) == 0)
+			return MASK_INSIDE;
+
+		return MASK_BORDER;
+	}
+};
+
+//! Rasterizes the polyline in the screen mask
+static bool RasterizeScreenPolyline(ScreenSegmentationContext& context)
+{
+	const std::vector<CCVector2>& vertices = context.polyVertices;
+	size_t vertCount = vertices.size();
+	assert(vertCount >= 2);
+
+	double xMin = vertices[0].x, xMax = xMin, yMin = vertices[0].y, yMax = yMin;
+	for (size_t i=1; i<vertCount; ++i)
+	{
+		xMin = std::min(xMin,static_cast<double>(vertices[i].x)); xMax = std::max(xMax,static_cast<double>(vertices[i].x));
+		yMin = std::min(yMin,static_cast<double>(vertices[i].y)); yMax = std::max(yMax,static_cast<double>(vertices[i].y));
+	}
+	if (!(xMax-xMin < static_cast<double>(c_maskMaxPixelCount) && yMax-yMin < static_cast<double>(c_maskMaxPixelCount)))
+		return false; //also rejects NaN values
+
+	//the mask covers the polyline bounding box (+ margin): outside of it, everything is 'outside'
+	context.maskX = static_cast<int>(floor(xMin-c_maskBorderMargin))-1;
+	context.maskY = static_cast<int>(floor(yMin-c_maskBorderMargin))-1;
+	context.maskWidth = static_cast<int>(floor(xMax+c_maskBorderMargin))+2-context.maskX;
+	context.maskHeight = static_cast<int>(floor(yMax+c_maskBorderMargin))+2-context.maskY;
+	if (static_cast<size_t>(context.maskWidth) * static_cast<size_t>(context.maskHeight) > c_maskMaxPixelCount)
+		return false;
+
+	const int w = context.maskWidth;
+	const int h = context.maskHeight;
+	std::vector<double> crossings;
+	try
+	{
+		context.mask.resize(static_cast<size_t>(w)*h,MASK_OUTSIDE);
+		crossings.reserve(vertCount);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return false;
+	}
+
+	//1st step: pixels (+ margin) crossed by an edge
+	for (size_t i=1; i<=vertCount; ++i)
+	{
+		double ax = vertices[i-1].x - context.maskX, ay = vertices[i-1].y - context.maskY;
+		double bx = vertices[i%vertCount].x - context.maskX, by = vertices[i%vertCount].y - context.maskY;
+		if (ay > by)
+		{
+			std::swap(ax,bx);
+			std::swap(ay,by);
+		}
+
+		int rowStart = std::max(static_cast<int>(floor(ay-c_maskBorderMargin)),0);
+		int rowStop = std::min(static_cast<int>(floor(by+c_maskBorderMargin)),h-1);
+		for (int row=rowStart; row<=rowStop; ++row)
+		{
+			//part of the edge in the (enlarged) row
+			double y0 = std::max(row-c_maskBorderMargin,ay);
+			double y1 = std::min(row+1+c_maskBorderMargin,by);
+			double x0 = ax, x1 = bx;
+			if (by-ay > 0)
+			{
+				y0 = std::min(y0,by);
+				y1 = std::max(y1,ay);
+				x0 = ax + (bx-ax)*(y0-ay)/(by-ay);
+				x1 = ax + (bx-ax)*(y1-ay)/(by-ay);
+			}
+			if (x0 > x1)
+				std::swap(x0,x1);
+
+			int colStart = std::max(static_cast<int>(floor(x0-c_maskBorderMargin)),0);
+			int colStop = std::min(static_cast<int>(floor(x1+c_maskBorderMargin)),w-1);
+			if (colStart <= colStop)
+				memset(&(context.mask[static_cast<size_t>(row)*w+colStart]),MASK_BORDER,colStop-colStart+1);
+		}
+	}
+
+	//2nd step: scanline filling (same crossing rule as isPointInsidePoly, at the pixels centers)
+	for (int row=0; row<h; ++row)
+	{
+		double yc = row + 0.5;
+
+		crossings.clear();
+		for (size_t i=1; i<=vertCount; ++i)
+		{
+			double ax = vertices[i-1].x - context.maskX, ay = vertices[i-1].y - context.maskY;
+			double bx = vertices[i%vertCount].x - context.maskX, by = vertices[i%vertCount].y - context.maskY;
+			if ((by <= yc && yc < ay) || (ay <= yc && yc < by))
+				crossings.push_back(bx + (ax-bx)*(yc-by)/(ay-by));
+		}
+		std::sort(crossings.begin(),crossings.end());
+
+		uchar* rowPixels = &(context.mask[static_cast<size_t>(row)*w]);
+		for (size_t k=0; k+1<crossings.size(); k+=2)
+		{
+			//pixels with their center in ]c(2k),c(2k+1)[
+			int colStart = std::max(static_cast<int>(ceil(crossings[k]-0.5)),0);
+			int colStop = std::min(static_cast<int>(floor(crossings[k+1]-0.5)),w-1);
+			for (int col=colStart; col<=colStop; ++col)
+				if (rowPixels[col] == MASK_OUTSIDE)
+					rowPixels[col] = MASK_INSIDE;
+		}
+	}
+
+	return true;
+}
+
+//! Builds the summed area tables of the screen mask (see ScreenSegmentationContext::classifyCell)
+static bool ComputeScreenMaskSATs(ScreenSegmentationContext& context)
+{
+	const int w = context.maskWidth;
+	const int h = context.maskHeight;
+	try
+	{
+		context.notOutsideSAT.resize(static_cast<size_t>(w+1)*(h+1),0);
+		context.notInsideSAT.resize(static_cast<size_t>(w+1)*(h+1),0);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		context.notOutsideSAT.clear();
+		context.notInsideSAT.clear();
+		return false;
+	}
+
+	for (int row=0; row<h; ++row)
+	{
+		const uchar* rowPixels = &(context.mask[static_cast<size_t>(row)*w]);
+		unsigned* satOut = &(context.notOutsideSAT[static_cast<size_t>(row+1)*(w+1)]);
+		unsigned* satIn = &(context.notInsideSAT[static_cast<size_t>(row+1)*(w+1)]);
+		unsigned rowOut = 0, rowIn = 0;
+		for (int col=0; col<w; ++col)
+		{
+			rowOut += (rowPixels[col] != MASK_OUTSIDE ? 1 : 0);
+			rowIn += (rowPixels[col] != MASK_INSIDE ? 1 : 0);
+			satOut[col+1] = satOut[col+1-(w+1)] + rowOut;
+			satIn[col+1] = satIn[col+1-(w+1)] + rowIn;
+		}
+	}
+
+	return true;
+}
+
+//! Screen segmentation job (either a set of contiguous points or a set of octree cells)
+struct ScreenSegmentationJob
+{
+	const ScreenSegmentationContext* context;
+
+	//contiguous points (chunk mode)
+	const PointCoordinateType* points;
+	uchar* visibility;
+	unsigned count;
+
+	//octree cells (octree mode)
+	unsigned firstCell;
+	unsigned cellCount;
+};
+
+//! Segments a set of contiguous points (chunk mode)
+static void SegmentScreenPoints(ScreenSegmentationJob& job)
+{
+	const ScreenSegmentationContext& context = *job.context;
+	const PointCoordinateType* P = job.points;
+	uchar* visibility = job.visibility;
+
+	unsigned i = 0;
+#ifdef CC_USE_SSE_KERNELS
+	for (; i+4<=job.count; i+=4, P+=12, visibility+=4)
+	{
+		//already hidden points are ignored
+		if (	visibility[0] != POINT_VISIBLE && visibility[1] != POINT_VISIBLE
+			&&	visibility[2] != POINT_VISIBLE && visibility[3] != POINT_VISIBLE)
+			continue;
+
+		__m128 a,b,c,x,y,z;
+		SSE_Load4Points(P,a,b,c);
+		SSE_Deinterleave(a,b,c,x,y,z);
+
+		uchar states[4];
+		context.classify4(x,y,z,states);
+		for (unsigned j=0; j<4; ++j)
+			if (visibility[j] == POINT_VISIBLE)
+				visibility[j] = context.getVisibility(states[j],*reinterpret_cast<const CCVector3*>(P+3*j));
+	}
+#endif
+	for (; i<job.count; ++i, P+=3, ++visibility)
+		if (*visibility == POINT_VISIBLE)
+			*visibility = context.getVisibility(context.classify(P),*reinterpret_cast<const CCVector3*>(P));
+}
+
+//! Segments a set of octree cells (octree mode)
+static void SegmentScreenCells(ScreenSegmentationJob& job)
+{
+	const ScreenSegmentationContext& context = *job.context;
+	const DgmOctree::cellsContainer& codes = context.octree->pointsAndTheirCellCodes();
+	ManualSegmentationTools::VisibilityTableType* visibility = context.visibility;
+
+	for (unsigned c=job.firstCell; c<job.firstCell+job.cellCount; ++c)
+	{
+		unsigned start = context.cellIndexes[c];
+		unsigned stop = (c+1 < context.cellIndexes.size() ? context.cellIndexes[c+1] : static_cast<unsigned>(codes.size()));
+
+		uchar state = context.classifyCell(codes[start].theCode);
+		if (state != MASK_BORDER)
+		{
+			//the whole cell is inside or outside
+			bool inside = (state == MASK_INSIDE);
+			if (context.keepInside != inside)
+			{
+				for (unsigned i=start; i<stop; ++i)
+					if (visibility->getValue(codes[i].theIndex) == POINT_VISIBLE)
+						visibility->setValue(codes[i].theIndex,POINT_HIDDEN);
+			}
+			//else: the visible points remain visible
+			continue;
+		}
+
+		//we must test each point
+		unsigned i = start;
+#ifdef CC_USE_SSE_KERNELS
+		for (; i+4<=stop; i+=4)
+		{
+			const CCVector3* P[4];
+			for (unsigned j=0; j<4; ++j)
+				P[j] = context.cloud->getPoint(codes[i+j].theIndex);
+
+			//warning: _mm_set_ps takes its arguments in reverse order
+			__m128 x = _mm_set_ps(P[3]->x,P[2]->x,P[1]->x,P[0]->x);
+			__m128 y = _mm_set_ps(P[3]->y,P[2]->y,P[1]->y,P[0]->y);
+			__m128 z = _mm_set_ps(P[3]->z,P[2]->z,P[1]->z,P[0]->z);
+
+			uchar states[4];
+			context.classify4(x,y,z,states);
+			for (unsigned j=0; j<4; ++j)
+			{
+				unsigned index = codes[i+j].theIndex;
+				if (visibility->getValue(index) == POINT_VISIBLE)
+					visibility->setValue(index,context.getVisibility(states[j],*P[j]));
+			}
+		}
+#endif
+		for (; i<stop; ++i)
+		{
+			unsigned index = codes[i].theIndex;
+			if (visibility->getValue(index) == POINT_VISIBLE)
+			{
+				const CCVector3* P = context.cloud->getPoint(index);
+				visibility->setValue(index,context.getVisibility(context.classify(P->u),*P));
+			}
+		}
+	}
+}
+
+bool ManualSegmentationTools::segmentWithScreenPolyline(ChunkedPointCloud* cloud,
+														VisibilityTableType* visibility,
+														const Polyline* poly,
+														bool keepInside,
+														const double* modelViewMat,
+														const double* projectionMat,
+														const int* viewport,
+														const CCVector2& polyOrigin,
+														const DgmOctree* octree/*=0*/)
+{
+	assert(cloud && visibility && poly && modelViewMat && projectionMat && viewport);
+
+	unsigned pointCount = cloud->size();
+	if (visibility->currentSize() < pointCount)
+	{
+		assert(false);
+		return false;
+	}
+	if (pointCount == 0)
+		return true;
+
+	ScreenSegmentationContext context;
+	context.keepInside = keepInside;
+	context.modelViewMat = modelViewMat;
+	context.projectionMat = projectionMat;
+	context.viewport = viewport;
+	context.originX = polyOrigin.x;
+	context.originY = polyOrigin.y;
+	context.octree = 0;
+	context.level = 0;
+	context.cloud = cloud;
+	context.visibility = visibility;
+
+	//polyline vertices
+	unsigned vertCount = poly->size();
+	try
+	{
+		context.polyVertices.resize(vertCount);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return false;
+	}
+	for (unsigned i=0; i<vertCount; ++i)
+	{
+		CCVector3 V;
+		poly->getPoint(i,V);
+		context.polyVertices[i] = CCVector2(V.x,V.y);
+	}
+
+	if (vertCount < 2)
+	{
+		//nothing can be inside
+		if (keepInside)
+		{
+			for (unsigned i=0; i<pointCount; ++i)
+				if (visibility->getValue(i) == POINT_VISIBLE)
+					visibility->setValue(i,POINT_HIDDEN);
+		}
+		return true;
+	}
+
+	if (!RasterizeScreenPolyline(context))
+		return false;
+
+	//projection origin (to preserve the single precision accuracy)
+	{
+		PointCoordinateType bbMin[3],bbMax[3];
+		cloud->getBoundingBox(bbMin,bbMax);
+		context.center = (CCVector3(bbMin)+CCVector3(bbMax))/2;
+	}
+
+	//'mask' projection matrix
+	{
+		//mvp = projection * model view (column major)
+		double mvp[16];
+		for (unsigned i=0; i<4; ++i)
+			for (unsigned j=0; j<4; ++j)
+				mvp[j*4+i] =	projectionMat[i]*modelViewMat[j*4] + projectionMat[4+i]*modelViewMat[j*4+1]
+							+	projectionMat[8+i]*modelViewMat[j*4+2] + projectionMat[12+i]*modelViewMat[j*4+3];
+
+		//screen X = vp[0] + (1+x/w)*vp[2]/2 - originX - maskX (same thing for Y)
+		double halfW = viewport[2]/2.0;
+		double halfH = viewport[3]/2.0;
+		double shiftX = viewport[0] + halfW - context.originX - context.maskX;
+		double shiftY = viewport[1] + halfH - context.originY - context.maskY;
+		for (unsigned j=0; j<4; ++j)
+		{
+			context.rows[0][j] = halfW*mvp[j*4] + shiftX*mvp[j*4+3];
+			context.rows[1][j] = halfH*mvp[j*4+1] + shiftY*mvp[j*4+3];
+			context.rows[2][j] = mvp[j*4+3];
+		}
+		//points will be expressed relatively to the projection origin
+		for (unsigned i=0; i<3; ++i)
+		{
+			context.rows[i][3] += context.rows[i][0]*context.center.x + context.rows[i][1]*context.center.y + context.rows[i][2]*context.center.z;
+			for (unsigned j=0; j<4; ++j)
+				context.rowsf[i][j] = static_cast<float>(context.rows[i][j]);
+		}
+	}
+
+	//octree pre-classification
+	if (octree && octree->getNumberOfProjectedPoints() == pointCount && ComputeScreenMaskSATs(context))
+	{
+		context.octree = octree;
+		context.level = octree->findBestLevelForAGivenPopulationPerCell(c_segmentationPointsPerCell);
+		if (!octree->getCellIndexes(context.level,context.cellIndexes))
+			context.octree = 0;
+	}
+
+	std::vector<ScreenSegmentationJob> jobs;
+	ScreenSegmentationJob defaultJob;
+	memset(&defaultJob,0,sizeof(ScreenSegmentationJob));
+	defaultJob.context = &context;
+
+	if (context.octree)
+	{
+		//ranges of cells with approximately the same number of points
+		unsigned cellCount = static_cast<unsigned>(context.cellIndexes.size());
+		unsigned jobSize = MAX_NUMBER_OF_ELEMENTS_PER_CHUNK;
+#ifdef ENABLE_MT_OCTREE
+		jobSize = std::max<unsigned>(jobSize,pointCount/(4*std::max(QThread::idealThreadCount(),1)));
+#endif
+		try
+		{
+			for (unsigned c=0; c<cellCount; )
+			{
+				ScreenSegmentationJob job = defaultJob;
+				job.firstCell = c;
+				unsigned limit = context.cellIndexes[c] + jobSize;
+				while (c < cellCount && context.cellIndexes[c] < limit)
+					++c;
+				job.cellCount = c-job.firstCell;
+				jobs.push_back(job);
+			}
+		}
+		catch (.../*const std::bad_alloc&*/) //out of memory
+		{
+			return false;
+		}
+	}
+	else
+	{
+		//one job per chunk (the visibility array has the same chunks as the points)
+		unsigned chunks = cloud->pointsChunksCount();
+		try
+		{
+			jobs.resize(chunks,defaultJob);
+		}
+		catch (.../*const std::bad_alloc&*/) //out of memory
+		{
+			return false;
+		}
+		for (unsigned k=0; k<chunks; ++k)
+		{
+			assert(visibility->chunkSize(k) >= cloud->pointsChunkSize(k));
+			jobs[k].points = cloud->pointsChunkStartPtr(k);
+			jobs[k].visibility = visibility->chunkStartPtr(k);
+			jobs[k].count = cloud->pointsChunkSize(k);
+		}
+	}
+
+#ifdef ENABLE_MT_OCTREE
+	QtConcurrent::blockingMap(jobs, context.octree ? SegmentScreenCells : SegmentScreenPoints);
+#else
+	for (size_t i=0; i<jobs.size(); ++i)
+	{
+		if (context.octree)
+			SegmentScreenCells(jobs[i]);
+		else
+			SegmentScreenPoints(jobs[i]);
+	}
+#endif
+
+	return true;
+}
 
 ReferenceCloud* ManualSegmentationTools::segment(GenericIndexedCloudPersist* aCloud, ScalarType minDist, ScalarType maxDist)
 {
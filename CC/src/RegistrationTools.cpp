@@ -137,6 +137,22 @@ ICPRegistrationTools::CC_ICP_RESULT ICPRegistrationTools::RegisterClouds(Generic
 		}
 	}
 
+	//the model never moves: we build its octree once and for all
+	//(the data points are directly looked up in it at each iteration)
+	DgmOctree* modelOctree = new DgmOctree(modelCloud);
+	if (modelOctree->build(progressCb) <= 0)
+	{
+		delete modelOctree;
+		delete dataCloud;
+		if (_dataWeights && _dataWeights!=dataWeights)
+			_dataWeights->release();
+		if (modelCloud && modelCloud != _modelCloud)
+			delete modelCloud;
+		if (_modelWeights && _modelWeights!=modelWeights)
+			_modelWeights->release();
+		return ICP_ERROR_NOT_ENOUGH_MEMORY;
+	}
+
 	//Closest Point Set (see ICP algorithm)
 	ReferenceCloud* CPSet = new ReferenceCloud(modelCloud);
 	ScalarField* CPSetWeights = _modelWeights ? new ScalarField("CPSetWeights") : 0;
@@ -148,9 +164,7 @@ ICPRegistrationTools::CC_ICP_RESULT ICPRegistrationTools::RegisterClouds(Generic
 
     //we compute the initial distance between the two clouds (and the CPSet by the way)
     dataCloud->forEach(ScalarFieldTools::SetScalarValueToNaN);
-	DistanceComputationTools::Cloud2CloudDistanceComputationParams params;
-	params.CPSet = CPSet;
-	if (DistanceComputationTools::computeHausdorffDistance(dataCloud,modelCloud,params,progressCb)>=0)
+	if (DistanceComputationTools::computeNearestNeighbourDistances(dataCloud,modelOctree,CPSet))
 	{
 		//12/11/2008 - A.BEY: ICP guarantees only the decrease of the squared distances sum (not the distances sum)
 		error = ScalarFieldTools::computeMeanSquareScalarValue(dataCloud); //we only have positive SF values as we use the Hausdorff distance!
@@ -336,8 +350,7 @@ ICPRegistrationTools::CC_ICP_RESULT ICPRegistrationTools::RegisterClouds(Generic
 			}
 
 			//compute (new) distances to model
-			params.CPSet = CPSet;
-			if (DistanceComputationTools::computeHausdorffDistance(dataCloud,modelCloud,params)<0)
+			if (!DistanceComputationTools::computeNearestNeighbourDistances(dataCloud,modelOctree,CPSet))
 			{
                 //an error occured during distances computation...
 				result = ICP_ERROR_REGISTRATION_STEP;
@@ -399,6 +412,8 @@ ICPRegistrationTools::CC_ICP_RESULT ICPRegistrationTools::RegisterClouds(Generic
 	CPSet=0;
 	if (CPSetWeights)
 		CPSetWeights->release();
+	delete modelOctree;
+	modelOctree=0;
 
 	//release memory
 	if (modelCloud && modelCloud != _modelCloud)
@@ -1004,16 +1019,19 @@ int FPCSRegistrationTools::FindCongruentBases(KDTree* tree,
 			match.reserve(count);
 			if (match.capacity() < count)  //not enough memory
 				return -5;
-		
+
+			//all the queries are processed at once (in parallel)
+			std::vector<int> nearestPoints;
+			if (!intermediateTree.findNearestNeighbours(&tmpCloud2, nearestPoints, delta))
+				return -5;
+
 			for(unsigned i=0; i<count; i++)
 			{
-				const CCVector3 *q0 = tmpCloud2.getPoint(i);
-				unsigned a;
-				if(intermediateTree.findNearestNeighbour(q0->u, a, delta))
+				if(nearestPoints[i] >= 0)
 				{
 					IndexPair idxPair;
 					idxPair.first = i;
-					idxPair.second = a;
+					idxPair.second = (unsigned)nearestPoints[i];
 					match.push_back(idxPair);
 				}
 			}
@@ -0,0 +1,90 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_SSE_HELPER_HEADER
+#define CC_SSE_HELPER_HEADER
+
+//Internal helpers for the SSE kernels working directly on point chunks
+//(see ChunkedPointCloud). Points are stored interleaved (x0 y0 z0 x1 y1 ...)
+//so that 4 consecutive points fit exactly in 3 SSE registers:
+//
+//	a = [x0 y0 z0 x1]	b = [y1 z1 x2 y2]	c = [z2 x3 y3 z3]
+//
+//Kernels either work directly on this layout with "rotated" constants
+//(i.e. [x y z x],[y z x y],[z x y z]) or de-interleave the 3 registers.
+
+//See CC_USE_SSE_KERNELS in CCTypes.h
+#include "CCTypes.h"
+
+#ifdef CC_USE_SSE_KERNELS
+
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+//! Loads 4 consecutive (interleaved) points
+static inline void SSE_Load4Points(const float* p, __m128& a, __m128& b, __m128& c)
+{
+	//chunks are not necessarily 16 bytes aligned
+	a = _mm_loadu_ps(p);
+	b = _mm_loadu_ps(p+4);
+	c = _mm_loadu_ps(p+8);
+}
+
+//! Stores 4 consecutive (interleaved) points
+static inline void SSE_Store4Points(float* p, const __m128& a, const __m128& b, const __m128& c)
+{
+	_mm_storeu_ps(p,a);
+	_mm_storeu_ps(p+4,b);
+	_mm_storeu_ps(p+8,c);
+}
+
+//! Builds the 3 "rotated" registers corresponding to a constant vector (u,v,w)
+static inline void SSE_SetRotated(float u, float v, float w, __m128& a, __m128& b, __m128& c)
+{
+	//warning: _mm_set_ps takes its arguments in reverse order
+	a = _mm_set_ps(u,w,v,u); //[u v w u]
+	b = _mm_set_ps(v,u,w,v); //[v w u v]
+	c = _mm_set_ps(w,v,u,w); //[w u v w]
+}
+
+//! De-interleaves 4 points: a,b,c --> [x0 x1 x2 x3],[y0 y1 y2 y3],[z0 z1 z2 z3]
+static inline void SSE_Deinterleave(const __m128& a, const __m128& b, const __m128& c, __m128& x, __m128& y, __m128& z)
+{
+	__m128 t0 = _mm_shuffle_ps(a,b,_MM_SHUFFLE(1,0,2,1)); //[y0 z0 y1 z1]
+	__m128 t1 = _mm_shuffle_ps(b,c,_MM_SHUFFLE(2,1,3,2)); //[x2 y2 x3 y3]
+	x = _mm_shuffle_ps(a,t1,_MM_SHUFFLE(2,0,3,0));
+	y = _mm_shuffle_ps(t0,t1,_MM_SHUFFLE(3,1,2,0));
+	z = _mm_shuffle_ps(t0,c,_MM_SHUFFLE(3,0,3,1));
+}
+
+//! Interleaves 4 points: [x0 x1 x2 x3],[y0 y1 y2 y3],[z0 z1 z2 z3] --> a,b,c (inverse of SSE_Deinterleave)
+static inline void SSE_Interleave(const __m128& x, const __m128& y, const __m128& z, __m128& a, __m128& b, __m128& c)
+{
+	__m128 xy = _mm_unpacklo_ps(x,y);						//[x0 y0 x1 y1]
+	__m128 zx = _mm_shuffle_ps(z,x,_MM_SHUFFLE(1,1,0,0));	//[z0 z0 x1 x1]
+	a = _mm_shuffle_ps(xy,zx,_MM_SHUFFLE(2,0,1,0));
+	__m128 yz = _mm_shuffle_ps(y,z,_MM_SHUFFLE(1,1,1,1));	//[y1 y1 z1 z1]
+	__m128 xy2 = _mm_shuffle_ps(x,y,_MM_SHUFFLE(2,2,2,2));	//[x2 x2 y2 y2]
+	b = _mm_shuffle_ps(yz,xy2,_MM_SHUFFLE(2,0,2,0));
+	__m128 zx3 = _mm_shuffle_ps(z,x,_MM_SHUFFLE(3,3,2,2));	//[z2 z2 x3 x3]
+	__m128 yz3 = _mm_shuffle_ps(y,z,_MM_SHUFFLE(3,3,3,3));	//[y3 y3 z3 z3]
+	c = _mm_shuffle_ps(zx3,yz3,_MM_SHUFFLE(2,0,2,0));
+}
+
+#endif //CC_USE_SSE_KERNELS
+
+#endif //CC_SSE_HELPER_HEADER
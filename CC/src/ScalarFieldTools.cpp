@@ -129,7 +129,9 @@ bool ScalarFieldTools::computeMeanGradientOnPatch(const DgmOctree::octreeCell& c
 	ScalarField* theGradientNorms							= (ScalarField*)additionalParameters[2];
 
 	//nombre de points dans la cellule courante
-	unsigned n = cell.points->size();
+	unsigned n = cell.pointCount;
+	//et le nuage associe
+	GenericIndexedCloudPersist* cloud = cell.parentOctree->associatedCloud();
 
 	//structures pour la recherche de voisinages SPECIFIQUES
 	DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
@@ -153,23 +155,21 @@ bool ScalarFieldTools::computeMeanGradientOnPatch(const DgmOctree::octreeCell& c
 		DgmOctree::NeighboursSet::iterator it = nNSS.pointsInNeighbourhood.begin();
 		for (unsigned j=0;j<n;++j,++it)
 		{
-			it->point = cell.points->getPointPersistentPtr(j);
-			it->pointIndex = cell.points->getPointGlobalIndex(j);
+			it->point = cloud->getPointPersistentPtr(cell.getPointGlobalIndex(j));
+			it->pointIndex = cell.getPointGlobalIndex(j);
 		}
 		nNSS.alreadyVisitedNeighbourhoodSize = 1;
 	}
 
-	const GenericIndexedCloudPersist* cloud = cell.points->getAssociatedCloud();
-
 	for (unsigned i=0;i<n;++i)
 	{
 		ScalarType gN = NAN_VALUE;
 
-		ScalarType d1 = cell.points->getPointScalarValue(i);
+		ScalarType d1 = cloud->getPointScalarValue(cell.getPointGlobalIndex(i));
 
         if (ScalarField::ValidValue(d1))
 		{
-			 cell.points->getPoint(i,nNSS.queryPoint);
+			 cloud->getPoint(cell.getPointGlobalIndex(i),nNSS.queryPoint);
 
 			//on extrait un voisinage autour du point
 			int k = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS,radius,true);
@@ -211,10 +211,10 @@ bool ScalarFieldTools::computeMeanGradientOnPatch(const DgmOctree::octreeCell& c
 
 		if (theGradientNorms)
 			//mode champ scalaire "IN" et "OUT" identique
-			theGradientNorms->setValue(cell.points->getPointGlobalIndex(i),gN);
+			theGradientNorms->setValue(cell.getPointGlobalIndex(i),gN);
 		else
 			//mode champs scalaires "IN" et "OUT" differents
-			cell.points->setPointScalarValue(i,gN);
+			cloud->setPointScalarValue(cell.getPointGlobalIndex(i),gN);
 	}
 
 	return true;
@@ -302,7 +302,9 @@ bool ScalarFieldTools::computeCellGaussianFilter(const DgmOctree::octreeCell& ce
     float sigmaSF2 = 2.0f*sigmaSF*sigmaSF;
 
 	//number of points inside the current cell
-	unsigned n = cell.points->size();
+	unsigned n = cell.pointCount;
+	//associated cloud
+	GenericIndexedCloudPersist* cloud = cell.parentOctree->associatedCloud();
 
 	//structures pour la recherche de voisinages SPECIFIQUES
 	DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
@@ -326,21 +328,19 @@ bool ScalarFieldTools::computeCellGaussianFilter(const DgmOctree::octreeCell& ce
 	{
 		for (unsigned i=0;i<n;++i,++it)
 		{
-			it->point = cell.points->getPointPersistentPtr(i);
-			it->pointIndex = cell.points->getPointGlobalIndex(i);
+			it->point = cloud->getPointPersistentPtr(cell.getPointGlobalIndex(i));
+			it->pointIndex = cell.getPointGlobalIndex(i);
 		}
 	}
 	nNSS.alreadyVisitedNeighbourhoodSize = 1;
 
-	const GenericIndexedCloudPersist* cloud = cell.points->getAssociatedCloud();
-
     //Pure Gaussian Filtering
     if (sigmaSF == -1)
     {
         for (unsigned i=0;i<n;++i) //for each point in cell
         {
             //we get the points inside a spherical neighbourhood (radius: '3*sigma')
-            cell.points->getPoint(i,nNSS.queryPoint);
+            cloud->getPoint(cell.getPointGlobalIndex(i),nNSS.queryPoint);
             unsigned k = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS,radius,false);
 
             //each point adds a contribution weighted by its distance to the sphere center
@@ -361,7 +361,7 @@ bool ScalarFieldTools::computeCellGaussianFilter(const DgmOctree::octreeCell& ce
 
 			ScalarType newValue = (wSum > 0.0 ? (ScalarType)(meanValue / wSum) : NAN_VALUE);
 
-            cell.points->setPointScalarValue(i,newValue);
+            cloud->setPointScalarValue(cell.getPointGlobalIndex(i),newValue);
         }
     }
     //Bilateral Filtering using the second sigma parameters on values (when given)
@@ -369,10 +369,10 @@ bool ScalarFieldTools::computeCellGaussianFilter(const DgmOctree::octreeCell& ce
     {
         for (unsigned i=0;i<n;++i) //for each point in cell
         {
-            ScalarType queryValue = cell.points->getPointScalarValue(i); //scalar of the query point
+            ScalarType queryValue = cloud->getPointScalarValue(cell.getPointGlobalIndex(i)); //scalar of the query point
 
             //we get the points inside a spherical neighbourhood (radius: '3*sigma')
-            cell.points->getPoint(i,nNSS.queryPoint);
+            cloud->getPoint(cell.getPointGlobalIndex(i),nNSS.queryPoint);
             unsigned k = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS,radius,false);
 
             //each point adds a contribution weighted by its distance to the sphere center
@@ -392,7 +392,7 @@ bool ScalarFieldTools::computeCellGaussianFilter(const DgmOctree::octreeCell& ce
                 }
             }
 
-            cell.points->setPointScalarValue(i,wSum > 0.0 ? (ScalarType)(meanValue / wSum) : NAN_VALUE);
+            cloud->setPointScalarValue(cell.getPointGlobalIndex(i),wSum > 0.0 ? (ScalarType)(meanValue / wSum) : NAN_VALUE);
         }
     }
 
@@ -332,7 +332,9 @@ bool StatisticalTestingTools::computeLocalChi2DistAtLevel(const DgmOctree::octre
 	unsigned* histoValues				= (unsigned*)additionalParameters[3];
 
 	//number of points in the current cell
-	unsigned n = cell.points->size();
+	unsigned n = cell.pointCount;
+	//associated cloud
+	GenericIndexedCloudPersist* cloud = cell.parentOctree->associatedCloud();
 
 	DgmOctree::NearestNeighboursSearchStruct nNSS;
 	nNSS.level												= cell.level;
@@ -355,16 +357,16 @@ bool StatisticalTestingTools::computeLocalChi2DistAtLevel(const DgmOctree::octre
 		DgmOctree::NeighboursSet::iterator it = nNSS.pointsInNeighbourhood.begin();
 		for (unsigned j=0;j<n;++j,++it)
 		{
-			it->point = cell.points->getPointPersistentPtr(j);
-			it->pointIndex = cell.points->getPointGlobalIndex(j);
+			it->point = cloud->getPointPersistentPtr(cell.getPointGlobalIndex(j));
+			it->pointIndex = cell.getPointGlobalIndex(j);
 		}
 		nNSS.alreadyVisitedNeighbourhoodSize = 1;
 	}
 
 	for (unsigned i=0;i<n;++i)
 	{
-		cell.points->getPoint(i,nNSS.queryPoint);
-		ScalarType D = cell.points->getPointScalarValue(i);
+		cloud->getPoint(cell.getPointGlobalIndex(i),nNSS.queryPoint);
+		ScalarType D = cloud->getPointScalarValue(cell.getPointGlobalIndex(i));
 
 		if (ScalarField::ValidValue(D))
 		{
@@ -386,7 +388,7 @@ bool StatisticalTestingTools::computeLocalChi2DistAtLevel(const DgmOctree::octre
 		}
 
 		//We assume that "IN" and "OUT" scalar fields are different!
-		cell.points->setPointScalarValue(i,D);
+		cloud->setPointScalarValue(cell.getPointGlobalIndex(i),D);
 	}
 
 	return true;
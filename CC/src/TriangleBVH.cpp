@@ -0,0 +1,603 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "TriangleBVH.h"
+
+#include "GenericIndexedMesh.h"
+#include "GenericTriangle.h"
+#include "GenericProgressCallback.h"
+#include "SSEHelper.h"
+
+//system
+#include <algorithm>
+#include <float.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+
+using namespace CCLib;
+
+//! Max number of triangles per leaf (= packet size)
+static const unsigned c_maxTrianglesPerLeaf = 4;
+//! Number of bins for the SAH evaluation
+static const unsigned c_sahBinCount = 16;
+
+//! Triangle information used during the build process
+struct BuildTriangle
+{
+	CCVector3 bbMin;
+	CCVector3 bbMax;
+	CCVector3 centroid;
+};
+
+//! Build task (range of triangles)
+struct BuildTask
+{
+	unsigned begin;
+	unsigned end;
+	//! Node that will point to this one as its right child (or -1)
+	int parent;
+};
+
+//! Returns the half surface of a box
+static inline PointCoordinateType HalfArea(const CCVector3& bbMin, const CCVector3& bbMax)
+{
+	CCVector3 d = bbMax - bbMin;
+	return d.x*d.y + d.y*d.z + d.z*d.x;
+}
+
+//! Extends a box with another one
+static inline void Extend(CCVector3& bbMin, CCVector3& bbMax, const CCVector3& otherMin, const CCVector3& otherMax)
+{
+	for (unsigned k=0; k<3; ++k)
+	{
+		if (otherMin.u[k] < bbMin.u[k])
+			bbMin.u[k] = otherMin.u[k];
+		if (otherMax.u[k] > bbMax.u[k])
+			bbMax.u[k] = otherMax.u[k];
+	}
+}
+
+//! Functor to partition triangles with respect to a SAH split
+struct SAHSplitTest
+{
+	const BuildTriangle* triangles;
+	unsigned axis;
+	PointCoordinateType minCoord;
+	PointCoordinateType binScale;
+	unsigned splitBin;
+
+	inline unsigned bin(unsigned triIndex) const
+	{
+		unsigned b = static_cast<unsigned>((triangles[triIndex].centroid.u[axis]-minCoord)*binScale);
+		return std::min(b,c_sahBinCount-1);
+	}
+
+	inline bool operator()(unsigned triIndex) const { return bin(triIndex) <= splitBin; }
+};
+
+//! Returns the squared distance between a point and a node bounding box
+static inline float BoxSquareDist(const PointCoordinateType* bbMin, const PointCoordinateType* bbMax, const CCVector3& P)
+{
+	float d2 = 0;
+	for (unsigned k=0; k<3; ++k)
+	{
+		float d = std::max(std::max(bbMin[k]-P.u[k],P.u[k]-bbMax[k]),0.0f);
+		d2 += d*d;
+	}
+	return d2;
+}
+
+TriangleBVH::TriangleBVH()
+	: m_triangleCount(0)
+{
+}
+
+TriangleBVH::~TriangleBVH()
+{
+	clear();
+}
+
+void TriangleBVH::clear()
+{
+	m_nodes.clear();
+	m_packets.clear();
+	m_summits.clear();
+	m_slotToTriangle.clear();
+	m_triangleToSlot.clear();
+	m_triangleCount = 0;
+}
+
+bool TriangleBVH::build(GenericIndexedMesh* mesh, GenericProgressCallback* progressCb/*=0*/)
+{
+	assert(mesh);
+	clear();
+
+	unsigned n = mesh->size();
+	if (n == 0)
+		return false;
+
+	NormalizedProgress* nProgress = 0;
+	if (progressCb)
+	{
+		nProgress = new NormalizedProgress(progressCb,n);
+		char buffer[256];
+		sprintf(buffer,"Triangles=%i",n);
+		progressCb->reset();
+		progressCb->setInfo(buffer);
+		progressCb->setMethodTitle("Build BVH");
+		progressCb->start();
+	}
+
+	bool success = true;
+	try
+	{
+		//we copy the triangles summits (and compute their bounding boxes)
+		std::vector<CCVector3> summits(3*n);
+		std::vector<BuildTriangle> triangles(n);
+		std::vector<unsigned> order(n);
+
+		mesh->placeIteratorAtBegining();
+		for (unsigned i=0; i<n; ++i)
+		{
+			const GenericTriangle* T = mesh->_getNextTriangle();
+			const CCVector3* S[3] = { T->_getA(), T->_getB(), T->_getC() };
+			BuildTriangle& bt = triangles[i];
+			bt.bbMin = bt.bbMax = *S[0];
+			for (unsigned j=0; j<3; ++j)
+			{
+				summits[3*i+j] = *S[j];
+				Extend(bt.bbMin,bt.bbMax,*S[j],*S[j]);
+			}
+			bt.centroid = (*S[0] + *S[1] + *S[2]) / (PointCoordinateType)3.0;
+			order[i] = i;
+
+			if (nProgress && !nProgress->oneStep())
+			{
+				success = false;
+				break;
+			}
+		}
+
+		if (success)
+		{
+			m_triangleToSlot.resize(n);
+			m_nodes.reserve(2*((n+c_maxTrianglesPerLeaf-1)/c_maxTrianglesPerLeaf));
+
+			std::vector<BuildTask> tasks;
+			BuildTask root = { 0, n, -1 };
+			tasks.push_back(root);
+
+			while (!tasks.empty())
+			{
+				BuildTask task = tasks.back();
+				tasks.pop_back();
+
+				unsigned nodeIndex = static_cast<unsigned>(m_nodes.size());
+				m_nodes.resize(nodeIndex+1);
+				if (task.parent >= 0)
+					m_nodes[task.parent].index = nodeIndex;
+
+				//node and centroids bounding boxes
+				CCVector3 bbMin = triangles[order[task.begin]].bbMin;
+				CCVector3 bbMax = triangles[order[task.begin]].bbMax;
+				CCVector3 cbMin = triangles[order[task.begin]].centroid;
+				CCVector3 cbMax = cbMin;
+				for (unsigned i=task.begin+1; i<task.end; ++i)
+				{
+					const BuildTriangle& bt = triangles[order[i]];
+					Extend(bbMin,bbMax,bt.bbMin,bt.bbMax);
+					Extend(cbMin,cbMax,bt.centroid,bt.centroid);
+				}
+				Node& node = m_nodes[nodeIndex];
+				memcpy(node.bbMin,bbMin.u,sizeof(PointCoordinateType)*3);
+				memcpy(node.bbMax,bbMax.u,sizeof(PointCoordinateType)*3);
+
+				unsigned count = task.end-task.begin;
+				if (count <= c_maxTrianglesPerLeaf)
+				{
+					//leaf: we build the corresponding packet
+					unsigned packetIndex = static_cast<unsigned>(m_packets.size());
+					node.index = packetIndex;
+					node.count = count;
+
+					m_packets.resize(packetIndex+1);
+					TrianglePacket& packet = m_packets.back();
+					for (unsigned l=0; l<c_maxTrianglesPerLeaf; ++l)
+					{
+						unsigned triIndex = order[task.begin + (l < count ? l : 0)];
+						if (l < count)
+							m_triangleToSlot[triIndex] = packetIndex*c_maxTrianglesPerLeaf+l;
+						m_slotToTriangle.push_back(triIndex);
+
+						const CCVector3& A = summits[3*triIndex];
+						const CCVector3& B = summits[3*triIndex+1];
+						const CCVector3& C = summits[3*triIndex+2];
+						m_summits.push_back(A);
+						m_summits.push_back(B);
+						m_summits.push_back(C);
+
+						//we use double precision for the pre-computed values
+						Vector3Tpl<double> e0((double)B.x-A.x,(double)B.y-A.y,(double)B.z-A.z);
+						Vector3Tpl<double> e1((double)C.x-A.x,(double)C.y-A.y,(double)C.z-A.z);
+						Vector3Tpl<double> e2((double)C.x-B.x,(double)C.y-B.y,(double)C.z-B.z);
+						Vector3Tpl<double> N = e0.cross(e1);
+						double d00 = e0.dot(e0);
+						double d01 = e0.dot(e1);
+						double d11 = e1.dot(e1);
+						double e2Norm2 = e2.dot(e2);
+						double denom = d00*d11 - d01*d01;
+						double normN = N.norm();
+						bool degenerate = (normN < FLT_EPSILON*(d00+d11) || denom <= 0);
+						if (!degenerate)
+							N /= normN;
+
+						packet.ax[l] = A.x; packet.ay[l] = A.y; packet.az[l] = A.z;
+						packet.e0x[l] = (float)e0.x; packet.e0y[l] = (float)e0.y; packet.e0z[l] = (float)e0.z;
+						packet.e1x[l] = (float)e1.x; packet.e1y[l] = (float)e1.y; packet.e1z[l] = (float)e1.z;
+						packet.e2x[l] = (float)e2.x; packet.e2y[l] = (float)e2.y; packet.e2z[l] = (float)e2.z;
+						packet.nx[l] = (degenerate ? 0 : (float)N.x);
+						packet.ny[l] = (degenerate ? 0 : (float)N.y);
+						packet.nz[l] = (degenerate ? 0 : (float)N.z);
+						packet.invE0[l] = (d00 > 0 ? (float)(1.0/d00) : 0);
+						packet.invE1[l] = (d11 > 0 ? (float)(1.0/d11) : 0);
+						packet.invE2[l] = (e2Norm2 > 0 ? (float)(1.0/e2Norm2) : 0);
+						packet.d00[l] = (float)d00;
+						packet.d01[l] = (float)d01;
+						packet.d11[l] = (float)d11;
+						packet.invDenom[l] = (degenerate ? 0 : (float)(1.0/denom));
+						unsigned mask = (degenerate ? 0 : 0xFFFFFFFF);
+						memcpy(packet.faceMask+l,&mask,sizeof(float));
+					}
+					continue;
+				}
+				node.count = 0;
+
+				//we look for the best split (SAH)
+				float bestCost = FLT_MAX;
+				SAHSplitTest split;
+				split.triangles = &(triangles[0]);
+				split.axis = 3;
+				for (unsigned axis=0; axis<3; ++axis)
+				{
+					PointCoordinateType extent = cbMax.u[axis]-cbMin.u[axis];
+					if (extent <= 0)
+						continue;
+
+					SAHSplitTest test = split;
+					test.axis = axis;
+					test.minCoord = cbMin.u[axis];
+					test.binScale = (PointCoordinateType)c_sahBinCount / extent;
+
+					unsigned binCount[c_sahBinCount];
+					CCVector3 binMin[c_sahBinCount],binMax[c_sahBinCount];
+					memset(binCount,0,sizeof(unsigned)*c_sahBinCount);
+					for (unsigned i=task.begin; i<task.end; ++i)
+					{
+						const BuildTriangle& bt = triangles[order[i]];
+						unsigned b = test.bin(order[i]);
+						if (binCount[b]++ == 0)
+						{
+							binMin[b] = bt.bbMin;
+							binMax[b] = bt.bbMax;
+						}
+						else
+						{
+							Extend(binMin[b],binMax[b],bt.bbMin,bt.bbMax);
+						}
+					}
+
+					//right side areas (sweep from the last bin)
+					float rightArea[c_sahBinCount];
+					unsigned rightCount[c_sahBinCount];
+					{
+						CCVector3 rMin,rMax;
+						unsigned rCount = 0;
+						for (unsigned b=c_sahBinCount-1; b>0; --b)
+						{
+							if (binCount[b])
+							{
+								if (rCount == 0)
+								{
+									rMin = binMin[b];
+									rMax = binMax[b];
+								}
+								else
+								{
+									Extend(rMin,rMax,binMin[b],binMax[b]);
+								}
+								rCount += binCount[b];
+							}
+							rightCount[b] = rCount;
+							rightArea[b] = (rCount ? HalfArea(rMin,rMax) : 0);
+						}
+					}
+
+					//left side areas and costs
+					CCVector3 lMin,lMax;
+					unsigned lCount = 0;
+					for (unsigned b=0; b+1<c_sahBinCount; ++b)
+					{
+						if (binCount[b])
+						{
+							if (lCount == 0)
+							{
+								lMin = binMin[b];
+								lMax = binMax[b];
+							}
+							else
+							{
+								Extend(lMin,lMax,binMin[b],binMax[b]);
+							}
+							lCount += binCount[b];
+						}
+						if (lCount == 0 || rightCount[b+1] == 0)
+							continue;
+
+						float cost = HalfArea(lMin,lMax)*lCount + rightArea[b+1]*rightCount[b+1];
+						if (cost < bestCost)
+						{
+							bestCost = cost;
+							split = test;
+							split.splitBin = b;
+						}
+					}
+				}
+
+				unsigned mid;
+				if (split.axis < 3)
+				{
+					mid = static_cast<unsigned>(std::partition(order.begin()+task.begin,order.begin()+task.end,split) - order.begin());
+				}
+				else
+				{
+					//all the centroids are the same
+					mid = task.begin + count/2;
+				}
+				assert(mid > task.begin && mid < task.end);
+
+				//the left child must be processed first (so that it directly follows its parent)
+				BuildTask right = { mid, task.end, static_cast<int>(nodeIndex) };
+				BuildTask left = { task.begin, mid, -1 };
+				tasks.push_back(right);
+				tasks.push_back(left);
+			}
+
+			m_triangleCount = n;
+		}
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		success = false;
+	}
+
+	if (nProgress)
+		delete nProgress;
+
+	if (!success)
+		clear();
+
+	return success;
+}
+
+void TriangleBVH::ComputeSquareDistances(const TrianglePacket& t, const CCVector3& P, float dist2[4])
+{
+	//For each triangle, the distance is the smallest one between the 3 edges (segments)
+	//and the plane (if the point projects inside the triangle).
+#ifdef CC_USE_SSE_KERNELS
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	__m128 apx = _mm_sub_ps(_mm_set1_ps(P.x),_mm_loadu_ps(t.ax));
+	__m128 apy = _mm_sub_ps(_mm_set1_ps(P.y),_mm_loadu_ps(t.ay));
+	__m128 apz = _mm_sub_ps(_mm_set1_ps(P.z),_mm_loadu_ps(t.az));
+
+	__m128 e0x = _mm_loadu_ps(t.e0x);
+	__m128 e0y = _mm_loadu_ps(t.e0y);
+	__m128 e0z = _mm_loadu_ps(t.e0z);
+	__m128 e1x = _mm_loadu_ps(t.e1x);
+	__m128 e1y = _mm_loadu_ps(t.e1y);
+	__m128 e1z = _mm_loadu_ps(t.e1z);
+
+	__m128 d20 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(apx,e0x),_mm_mul_ps(apy,e0y)),_mm_mul_ps(apz,e0z));
+	__m128 d21 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(apx,e1x),_mm_mul_ps(apy,e1y)),_mm_mul_ps(apz,e1z));
+
+	//barycentric coordinates of the projection
+	__m128 d00 = _mm_loadu_ps(t.d00);
+	__m128 d01 = _mm_loadu_ps(t.d01);
+	__m128 d11 = _mm_loadu_ps(t.d11);
+	__m128 invDenom = _mm_loadu_ps(t.invDenom);
+	__m128 v = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(d11,d20),_mm_mul_ps(d01,d21)),invDenom);
+	__m128 w = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(d00,d21),_mm_mul_ps(d01,d20)),invDenom);
+	__m128 inside = _mm_and_ps(_mm_cmpge_ps(v,zero),_mm_cmpge_ps(w,zero));
+	inside = _mm_and_ps(inside,_mm_cmple_ps(_mm_add_ps(v,w),one));
+	inside = _mm_and_ps(inside,_mm_loadu_ps(t.faceMask));
+
+	//distance to the plane
+	__m128 pd = _mm_add_ps(_mm_add_ps(_mm_mul_ps(apx,_mm_loadu_ps(t.nx)),_mm_mul_ps(apy,_mm_loadu_ps(t.ny))),_mm_mul_ps(apz,_mm_loadu_ps(t.nz)));
+	__m128 planeDist2 = _mm_mul_ps(pd,pd);
+
+	//distance to edge AB
+	__m128 s = _mm_min_ps(_mm_max_ps(_mm_mul_ps(d20,_mm_loadu_ps(t.invE0)),zero),one);
+	__m128 rx = _mm_sub_ps(apx,_mm_mul_ps(s,e0x));
+	__m128 ry = _mm_sub_ps(apy,_mm_mul_ps(s,e0y));
+	__m128 rz = _mm_sub_ps(apz,_mm_mul_ps(s,e0z));
+	__m128 edgeDist2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx,rx),_mm_mul_ps(ry,ry)),_mm_mul_ps(rz,rz));
+
+	//distance to edge AC
+	s = _mm_min_ps(_mm_max_ps(_mm_mul_ps(d21,_mm_loadu_ps(t.invE1)),zero),one);
+	rx = _mm_sub_ps(apx,_mm_mul_ps(s,e1x));
+	ry = _mm_sub_ps(apy,_mm_mul_ps(s,e1y));
+	rz = _mm_sub_ps(apz,_mm_mul_ps(s,e1z));
+	edgeDist2 = _mm_min_ps(edgeDist2,_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx,rx),_mm_mul_ps(ry,ry)),_mm_mul_ps(rz,rz)));
+
+	//distance to edge BC
+	__m128 bpx = _mm_sub_ps(apx,e0x);
+	__m128 bpy = _mm_sub_ps(apy,e0y);
+	__m128 bpz = _mm_sub_ps(apz,e0z);
+	__m128 e2x = _mm_loadu_ps(t.e2x);
+	__m128 e2y = _mm_loadu_ps(t.e2y);
+	__m128 e2z = _mm_loadu_ps(t.e2z);
+	__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(bpx,e2x),_mm_mul_ps(bpy,e2y)),_mm_mul_ps(bpz,e2z));
+	s = _mm_min_ps(_mm_max_ps(_mm_mul_ps(d2,_mm_loadu_ps(t.invE2)),zero),one);
+	rx = _mm_sub_ps(bpx,_mm_mul_ps(s,e2x));
+	ry = _mm_sub_ps(bpy,_mm_mul_ps(s,e2y));
+	rz = _mm_sub_ps(bpz,_mm_mul_ps(s,e2z));
+	edgeDist2 = _mm_min_ps(edgeDist2,_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx,rx),_mm_mul_ps(ry,ry)),_mm_mul_ps(rz,rz)));
+
+	//the plane distance is only relevant if the point projects inside the triangle
+	__m128 result = _mm_or_ps(_mm_and_ps(inside,_mm_min_ps(planeDist2,edgeDist2)),_mm_andnot_ps(inside,edgeDist2));
+	_mm_storeu_ps(dist2,result);
+#else
+	for (unsigned l=0; l<4; ++l)
+	{
+		float apx = P.x-t.ax[l], apy = P.y-t.ay[l], apz = P.z-t.az[l];
+		float d20 = apx*t.e0x[l] + apy*t.e0y[l] + apz*t.e0z[l];
+		float d21 = apx*t.e1x[l] + apy*t.e1y[l] + apz*t.e1z[l];
+
+		//distance to edge AB
+		float s = std::min(std::max(d20*t.invE0[l],0.0f),1.0f);
+		float rx = apx-s*t.e0x[l], ry = apy-s*t.e0y[l], rz = apz-s*t.e0z[l];
+		float d = rx*rx + ry*ry + rz*rz;
+
+		//distance to edge AC
+		s = std::min(std::max(d21*t.invE1[l],0.0f),1.0f);
+		rx = apx-s*t.e1x[l]; ry = apy-s*t.e1y[l]; rz = apz-s*t.e1z[l];
+		d = std::min(d,rx*rx + ry*ry + rz*rz);
+
+		//distance to edge BC
+		float bpx = apx-t.e0x[l], bpy = apy-t.e0y[l], bpz = apz-t.e0z[l];
+		s = std::min(std::max((bpx*t.e2x[l] + bpy*t.e2y[l] + bpz*t.e2z[l])*t.invE2[l],0.0f),1.0f);
+		rx = bpx-s*t.e2x[l]; ry = bpy-s*t.e2y[l]; rz = bpz-s*t.e2z[l];
+		d = std::min(d,rx*rx + ry*ry + rz*rz);
+
+		//distance to the plane (if the point projects inside the triangle)
+		if (t.invDenom[l] != 0)
+		{
+			float v = (t.d11[l]*d20 - t.d01[l]*d21)*t.invDenom[l];
+			float w = (t.d00[l]*d21 - t.d01[l]*d20)*t.invDenom[l];
+			if (v >= 0 && w >= 0 && v+w <= 1.0f)
+			{
+				float pd = apx*t.nx[l] + apy*t.ny[l] + apz*t.nz[l];
+				d = std::min(d,pd*pd);
+			}
+		}
+
+		dist2[l] = d;
+	}
+#endif
+}
+
+inline void TriangleBVH::testLeaf(unsigned leafIndex, const CCVector3& P, float& minDist2, int& bestSlot, int& bestLeaf) const
+{
+	const Node& node = m_nodes[leafIndex];
+	assert(node.count != 0);
+
+	float dist2[4];
+	ComputeSquareDistances(m_packets[node.index],P,dist2);
+	for (unsigned l=0; l<node.count; ++l)
+	{
+		if (dist2[l] < minDist2)
+		{
+			minDist2 = dist2[l];
+			bestSlot = static_cast<int>(node.index*c_maxTrianglesPerLeaf+l);
+			bestLeaf = static_cast<int>(leafIndex);
+		}
+	}
+}
+
+bool TriangleBVH::findNearestTriangle(NearestTriangleSearchStruct& nTSS) const
+{
+	if (m_nodes.empty())
+		return false;
+
+	const CCVector3& P = nTSS.queryPoint;
+	float minDist2 = (nTSS.maxSearchSquareDist >= 0 ? nTSS.maxSearchSquareDist : FLT_MAX);
+	int bestSlot = -1;
+	int bestLeaf = -1;
+
+	//we start with the leaf of the previous query (good initial bound)
+	int hintLeaf = nTSS.lastLeaf;
+	if (hintLeaf >= 0 && static_cast<size_t>(hintLeaf) < m_nodes.size() && m_nodes[hintLeaf].count != 0)
+		testLeaf(static_cast<unsigned>(hintLeaf),P,minDist2,bestSlot,bestLeaf);
+	else
+		hintLeaf = -1;
+
+	std::vector<unsigned>& stack = nTSS.stack;
+	stack.clear();
+
+	unsigned nodeIndex = 0;
+	bool visit = (BoxSquareDist(m_nodes[0].bbMin,m_nodes[0].bbMax,P) < minDist2);
+	while (visit)
+	{
+		const Node& node = m_nodes[nodeIndex];
+		if (node.count != 0)
+		{
+			if (static_cast<int>(nodeIndex) != hintLeaf)
+				testLeaf(nodeIndex,P,minDist2,bestSlot,bestLeaf);
+		}
+		else
+		{
+			//we visit the nearest child first
+			unsigned nearChild = nodeIndex+1;
+			unsigned farChild = node.index;
+			float nearDist2 = BoxSquareDist(m_nodes[nearChild].bbMin,m_nodes[nearChild].bbMax,P);
+			float farDist2 = BoxSquareDist(m_nodes[farChild].bbMin,m_nodes[farChild].bbMax,P);
+			if (farDist2 < nearDist2)
+			{
+				std::swap(nearChild,farChild);
+				std::swap(nearDist2,farDist2);
+			}
+			if (nearDist2 < minDist2)
+			{
+				if (farDist2 < minDist2)
+					stack.push_back(farChild);
+				nodeIndex = nearChild;
+				continue;
+			}
+		}
+
+		//next node on the stack (the current bound may have decreased since it was pushed)
+		visit = false;
+		while (!stack.empty())
+		{
+			nodeIndex = stack.back();
+			stack.pop_back();
+			if (BoxSquareDist(m_nodes[nodeIndex].bbMin,m_nodes[nodeIndex].bbMax,P) < minDist2)
+			{
+				visit = true;
+				break;
+			}
+		}
+	}
+
+	if (bestSlot < 0)
+		return false;
+
+	nTSS.nearestTriangleIndex = m_slotToTriangle[bestSlot];
+	nTSS.squareDist = minDist2;
+	nTSS.lastLeaf = bestLeaf;
+
+	return true;
+}
+
+SimpleRefTriangle TriangleBVH::getTriangle(unsigned triangleIndex) const
+{
+	assert(triangleIndex < m_triangleCount);
+	const CCVector3* S = &(m_summits[3*m_triangleToSlot[triangleIndex]]);
+	return SimpleRefTriangle(S,S+1,S+2);
+}
@@ -0,0 +1,168 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+//Benchmark: generation of the visible points indexes (used to display clouds with hidden points)
+//Usage: VisibleIndexesBenchmark [point count (default: 50000000)]
+
+#include "ccPointCloud.h"
+
+//CCLib
+#include <CCConst.h>
+
+//Qt
+#include <QtCore/QTime>
+
+//system
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+
+//! Gives access to the visible indexes of a ccPointCloud
+class BenchmarkCloud : public ccPointCloud
+{
+public:
+
+	using ccPointCloud::updateVisibleIndexes;
+
+	//! Checks the visible indexes against the visibility array
+	bool checkVisibleIndexes() const
+	{
+		if (!m_pointsVisibility || m_visibleIndexes.size() != m_pointsVisibility->chunksCount())
+			return false;
+
+		for (unsigned k=0; k<m_pointsVisibility->chunksCount(); ++k)
+		{
+			const VisibleIndexesChunk& chunk = m_visibleIndexes[k];
+			const uchar* visibility = m_pointsVisibility->chunkStartPtr(k);
+			unsigned chunkSize = m_pointsVisibility->chunkSize(k);
+			if (!chunk.upToDate)
+				return false;
+
+			unsigned visibleCount = 0;
+			for (unsigned i=0; i<chunkSize; ++i)
+			{
+				if (visibility[i] == POINT_VISIBLE)
+				{
+					//no indexes if all (or none) of the chunk points are visible
+					if (!chunk.indexes.empty() && (visibleCount >= chunk.indexes.size() || chunk.indexes[visibleCount] != i))
+						return false;
+					++visibleCount;
+				}
+			}
+
+			if (chunk.visibleCount != visibleCount)
+				return false;
+			if (chunk.indexes.empty() && visibleCount != 0 && visibleCount != chunkSize)
+				return false;
+		}
+
+		return true;
+	}
+};
+
+//! Visibility patterns
+enum VisibilityPattern { ALL_VISIBLE, RANDOM_50, BANDS, RANDOM_99 };
+static const char* PATTERN_NAMES[4] = { "all visible", "random 50%", "bands (2/3 visible)", "random 99%" };
+
+//! Fills the visibility array with a given pattern
+static void FillVisibility(ccGenericPointCloud::VisibilityTableType* visibility, VisibilityPattern pattern)
+{
+	srand(0);
+	unsigned count = visibility->currentSize();
+	for (unsigned i=0; i<count; ++i)
+	{
+		uchar v = POINT_VISIBLE;
+		switch (pattern)
+		{
+		case ALL_VISIBLE:
+			break;
+		case RANDOM_50:
+			v = ((rand() & 1) ? POINT_VISIBLE : POINT_HIDDEN);
+			break;
+		case BANDS:
+			v = ((i/1000) % 3 == 0 ? POINT_HIDDEN : POINT_VISIBLE);
+			break;
+		case RANDOM_99:
+			v = (rand() % 100 == 0 ? POINT_HIDDEN : POINT_VISIBLE);
+			break;
+		}
+		visibility->setValue(i,v);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned count = (argc > 1 ? static_cast<unsigned>(atol(argv[1])) : 50000000);
+	if (count == 0)
+	{
+		fprintf(stderr,"Usage: %s [point count]\n",argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	BenchmarkCloud cloud;
+	if (!cloud.resize(count) || !cloud.razVisibilityArray())
+	{
+		fprintf(stderr,"Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
+	ccGenericPointCloud::VisibilityTableType* visibility = cloud.getTheVisibilityArray();
+
+	bool success = true;
+	QTime timer;
+	for (int p=0; p<4; ++p)
+	{
+		FillVisibility(visibility,static_cast<VisibilityPattern>(p));
+
+		//full update
+		cloud.visibilityArrayChanged();
+		timer.start();
+		if (!cloud.updateVisibleIndexes())
+		{
+			fprintf(stderr,"Not enough memory!\n");
+			return EXIT_FAILURE;
+		}
+		int tFull = timer.elapsed();
+		bool ok = cloud.checkVisibleIndexes();
+
+		//reference: per-point test
+		std::vector<unsigned> visibleIndexes;
+		visibleIndexes.reserve(count);
+		timer.start();
+		for (unsigned i=0; i<count; ++i)
+			if (visibility->getValue(i) == POINT_VISIBLE)
+				visibleIndexes.push_back(i);
+		int tNaive = timer.elapsed();
+
+		//incremental update: a few points hidden in the middle of the cloud (e.g. segmentation)
+		unsigned firstIndex = count/2;
+		unsigned lastIndex = std::min(firstIndex+1000,count)-1;
+		for (unsigned i=firstIndex; i<=lastIndex; ++i)
+			visibility->setValue(i,POINT_HIDDEN);
+		cloud.visibilityArrayChanged(firstIndex,lastIndex);
+		timer.start();
+		cloud.updateVisibleIndexes();
+		int tIncremental = timer.elapsed();
+		ok = ok && cloud.checkVisibleIndexes();
+
+		printf("[%s] %u/%u visible points: full update %i ms (per-point test %i ms), incremental update %i ms%s\n",PATTERN_NAMES[p],static_cast<unsigned>(visibleIndexes.size()),count,tFull,tNaive,tIncremental,ok ? "" : " - WRONG INDEXES");
+		if (!ok)
+			success = false;
+	}
+
+	return (success ? EXIT_SUCCESS : EXIT_FAILURE);
+}
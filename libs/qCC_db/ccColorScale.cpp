@@ -32,6 +32,7 @@ ccColorScale::ccColorScale(QString name, QString uuid/*=QString()*/)
 	: m_name(name)
 	, m_uuid(uuid)
 	, m_updated(false)
+	, m_updateCount(0)
 	, m_relative(true)
 	, m_locked(false)
 	, m_absoluteMinValue(0.0)
@@ -101,6 +102,8 @@ void ccColorScale::sort()
 
 void ccColorScale::update()
 {
+	++m_updateCount;
+
 	if (m_steps.size() >= (int)MIN_STEPS)
 	{
 		sort();
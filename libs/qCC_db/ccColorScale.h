@@ -189,6 +189,11 @@ public:
 	**/
 	void update();
 
+	//! Returns the number of updates of the internal representation
+	/** Can be used to detect modifications of the scale (see update).
+	**/
+	inline unsigned updateCount() const { return m_updateCount; }
+
 	//! Returns relative position of a given value (wrt to scale absolute min and max)
 	/** Warning: only valid with absolute scales! Use 'getColorByRelativePos' otherwise.
 	**/
@@ -275,6 +280,9 @@ protected:
 	//! Internal representation validity
 	bool m_updated;
 
+	//! Number of updates of the internal representation
+	unsigned m_updateCount;
+
 	//! Whether scale is relative or not
 	bool m_relative;
 
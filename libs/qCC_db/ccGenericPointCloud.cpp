@@ -62,6 +62,7 @@ bool ccGenericPointCloud::razVisibilityArray()
 	}
 
 	m_pointsVisibility->fill(POINT_VISIBLE); //by default, all points are visible
+	visibilityArrayChanged();
 
 	return true;
 }
@@ -71,6 +72,8 @@ void ccGenericPointCloud::unallocateVisibilityArray()
 	if (m_pointsVisibility)
 		m_pointsVisibility->release();
 	m_pointsVisibility=0;
+
+	visibilityArrayChanged();
 }
 
 bool ccGenericPointCloud::isVisibilityTableInstantiated() const
@@ -354,6 +357,7 @@ bool ccGenericPointCloud::fromFile_MeOnly(QFile& in, short dataVersion)
 			unallocateVisibilityArray();
 			return false;
 		}
+		visibilityArrayChanged();
 	}
 
 	//'point size' (dataVersion>=24)
@@ -176,6 +176,21 @@ public:
 	//! Erases the points visibility information
 	virtual void unallocateVisibilityArray();
 
+	//! Notifies that the visiblity array values have been modified
+	/** Must be called after any direct modification of the visibility array
+		(see getTheVisibilityArray), so that the structures depending on it
+		(e.g. for display) can be updated.
+	**/
+	void visibilityArrayChanged() { if (size() != 0) onVisibilityArrayChanged(0,size()-1); }
+
+	//! Notifies that a range of the visiblity array values have been modified
+	/** See ccGenericPointCloud::visibilityArrayChanged(). Only the structures
+		depending on this range will be updated.
+		\param firstIndex index of the first modified point
+		\param lastIndex index of the last modified point (included)
+	**/
+	void visibilityArrayChanged(unsigned firstIndex, unsigned lastIndex) { onVisibilityArrayChanged(firstIndex,lastIndex); }
+
 	/***************************************************
                     Other methods
 	***************************************************/
@@ -231,6 +246,13 @@ protected:
 	virtual bool toFile_MeOnly(QFile& out) const;
 	virtual bool fromFile_MeOnly(QFile& in, short dataVersion);
 
+	//! Called when (a part of) the visibility array has been modified or (un)allocated
+	/** See ccGenericPointCloud::visibilityArrayChanged. Does nothing by default.
+		\param firstIndex index of the first modified point
+		\param lastIndex index of the last modified point (included)
+	**/
+	virtual void onVisibilityArrayChanged(unsigned firstIndex, unsigned lastIndex) {}
+
 	//! Per-point visibility table
 	/** If this table is allocated, only values set to POINT_VISIBLE
 		will be considered as visible/selected.
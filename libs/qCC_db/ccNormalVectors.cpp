@@ -17,12 +17,18 @@
 
 #include "ccNormalVectors.h"
 
+#include <CCTypes.h>
 #include <CCGeom.h>
 #include <DgmOctreeReferenceCloud.h>
 #include <Neighbourhood.h>
 
 #include <assert.h>
 
+//SSE instructions for the covariance sums (see CC_USE_SSE_KERNELS in CCTypes.h)
+#ifdef CC_USE_SSE_KERNELS
+#include <xmmintrin.h>
+#endif
+
 static ccNormalVectors* s_uniqueInstance = 0;
 
 //Number of points for local modeling to compute normals with 2D1/2 Delaunay triangulation
@@ -137,7 +143,8 @@ bool ccNormalVectors::ComputeCloudNormals(ccGenericPointCloud* theCloud,
 											float radius,
                                             int preferedOrientation/*=-1*/,
                                             CCLib::GenericProgressCallback* progressCb/*=0*/,
-                                            CCLib::DgmOctree* _theOctree/*=0*/)
+                                            CCLib::DgmOctree* _theOctree/*=0*/,
+											unsigned knn/*=0*/)
 {
     assert(theCloud);
 
@@ -156,6 +163,11 @@ bool ccNormalVectors::ComputeCloudNormals(ccGenericPointCloud* theCloud,
 		}
 	}
 
+	//we can't look for more neighbours than there are points in the octree
+	//(otherwise the nearest neighbours search would never end!)
+	if (knn > theOctree->getNumberOfProjectedPoints())
+		knn = theOctree->getNumberOfProjectedPoints();
+
 	//on reserve la memoire pour stocker les normales
 	if (!theNormsCodes.isAllocated() || theNormsCodes.currentSize()<n)
 		if (!theNormsCodes.resize(n))
@@ -177,16 +189,18 @@ bool ccNormalVectors::ComputeCloudNormals(ccGenericPointCloud* theCloud,
 	}
 	//theNorms->fill(0);
 
-	void* additionalParameters[2];
+	void* additionalParameters[3];
 	additionalParameters[0] = (void*)theNorms;
 	additionalParameters[1] = (void*)&radius;
+	additionalParameters[2] = (void*)&knn;
 
 	unsigned processedCells = 0;
 	switch(method)
 	{
 	case LS:
 		{
-		uchar level=theOctree->findBestLevelForAGivenNeighbourhoodSizeExtraction(radius);
+		uchar level = (knn != 0 ? theOctree->findBestLevelForAGivenPopulationPerCell(knn)
+								: theOctree->findBestLevelForAGivenNeighbourhoodSizeExtraction(radius));
 #ifndef ENABLE_MT_OCTREE
 		processedCells = theOctree->executeFunctionForAllCellsAtLevel(level,
 #else
@@ -300,7 +314,8 @@ bool ccNormalVectors::ComputeNormsAtLevelWithHF(const CCLib::DgmOctree::octreeCe
 	unsigned i,j,n;
 
 	//nombre de points dans la cellule courante
-	n = cell.points->size();
+	n = cell.pointCount;
+	CCLib::GenericIndexedCloudPersist* cloud = cell.parentOctree->associatedCloud();
 
 	CCLib::DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
 	nNSS.level												= cell.level;
@@ -315,8 +330,8 @@ bool ccNormalVectors::ComputeNormsAtLevelWithHF(const CCLib::DgmOctree::octreeCe
 	CCLib::DgmOctree::NeighboursSet::iterator it = nNSS.pointsInNeighbourhood.begin();
 	for (j=0;j<n;++j,++it)
 	{
-		it->point = cell.points->getPointPersistentPtr(j);
-		it->pointIndex = cell.points->getPointGlobalIndex(j);
+		it->pointIndex = cell.getPointGlobalIndex(j);
+		it->point = cloud->getPointPersistentPtr(it->pointIndex);
 	}
 	nNSS.alreadyVisitedNeighbourhoodSize = 1;
 
@@ -326,7 +341,7 @@ bool ccNormalVectors::ComputeNormsAtLevelWithHF(const CCLib::DgmOctree::octreeCe
 
 	for (i=0;i<n;++i)
 	{
-		cell.points->getPoint(i,nNSS.queryPoint);
+		nNSS.queryPoint = *cloud->getPointPersistentPtr(cell.getPointGlobalIndex(i));
 
 		unsigned k = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS,radius,false);
 		if (k>=NUMBER_OF_POINTS_FOR_NORM_WITH_LS)
@@ -356,7 +371,7 @@ bool ccNormalVectors::ComputeNormsAtLevelWithHF(const CCLib::DgmOctree::octreeCe
 				//on normalise
 				CCVector3::vnormalize(N);
 
-				theNorms->setValue(cell.points->getPointGlobalIndex(i),N);
+				theNorms->setValue(cell.getPointGlobalIndex(i),N);
 			}
 			//FIN CALCUL DE LA NORMALE
 		}
@@ -366,21 +381,198 @@ bool ccNormalVectors::ComputeNormsAtLevelWithHF(const CCLib::DgmOctree::octreeCe
 	return true;
 }
 
+//! Computes the (smallest eigen value) eigen vector of a symmetric 3x3 matrix
+/** Closed-form solution (trigonometric method for the eigen value, then
+	cross product of two rows of A-l.I for the eigen vector).
+	\param A symmetric matrix (a00,a11,a22,a01,a02,a12)
+	\param N eigen vector (output - normalized)
+	\return false if the matrix is null
+**/
+static bool ComputeSmallestEigenVector(const double A[6], PointCoordinateType N[3])
+{
+	//we scale the matrix to avoid over/underflows
+	double scale = 0.0;
+	for (unsigned i=0; i<6; ++i)
+		if (scale < fabs(A[i]))
+			scale = fabs(A[i]);
+	if (scale < 1.0e-30)
+		return false;
+
+	double a00 = A[0]/scale, a11 = A[1]/scale, a22 = A[2]/scale;
+	double a01 = A[3]/scale, a02 = A[4]/scale, a12 = A[5]/scale;
+
+	//smallest eigen value
+	double lambda;
+	double p1 = a01*a01 + a02*a02 + a12*a12;
+	double q = (a00 + a11 + a22) / 3.0;
+	double b00 = a00-q, b11 = a11-q, b22 = a22-q;
+	double p2 = b00*b00 + b11*b11 + b22*b22 + 2.0*p1;
+	if (p2 < 1.0e-24)
+	{
+		//isotropic matrix: any direction is valid
+		lambda = q;
+	}
+	else
+	{
+		double p = sqrt(p2/6.0);
+		//r = det((A-q.I)/p)/2
+		double r = (b00*(b11*b22-a12*a12) - a01*(a01*b22-a12*a02) + a02*(a01*a12-b11*a02)) / (2.0*p*p*p);
+		if (r < -1.0)
+			r = -1.0;
+		else if (r > 1.0)
+			r = 1.0;
+		double phi = acos(r)/3.0;
+		lambda = q + 2.0*p*cos(phi + 2.0*M_PI/3.0);
+	}
+
+	//eigen vector: the rows of A-l.I are orthogonal to it
+	double r0[3] = {a00-lambda, a01, a02};
+	double r1[3] = {a01, a11-lambda, a12};
+	double r2[3] = {a02, a12, a22-lambda};
+	double c[3][3] = {	{r0[1]*r1[2]-r0[2]*r1[1], r0[2]*r1[0]-r0[0]*r1[2], r0[0]*r1[1]-r0[1]*r1[0]},
+						{r0[1]*r2[2]-r0[2]*r2[1], r0[2]*r2[0]-r0[0]*r2[2], r0[0]*r2[1]-r0[1]*r2[0]},
+						{r1[1]*r2[2]-r1[2]*r2[1], r1[2]*r2[0]-r1[0]*r2[2], r1[0]*r2[1]-r1[1]*r2[0]} };
+
+	unsigned best = 0;
+	double bestNorm2 = 0.0;
+	for (unsigned i=0; i<3; ++i)
+	{
+		double n2 = c[i][0]*c[i][0] + c[i][1]*c[i][1] + c[i][2]*c[i][2];
+		if (n2 > bestNorm2)
+		{
+			bestNorm2 = n2;
+			best = i;
+		}
+	}
+
+	double v[3];
+	if (bestNorm2 > 1.0e-24)
+	{
+		double n = sqrt(bestNorm2);
+		v[0] = c[best][0]/n; v[1] = c[best][1]/n; v[2] = c[best][2]/n;
+	}
+	else
+	{
+		//the two smallest eigen values are equal (linear neighbourhood): any vector
+		//orthogonal to the (largest) row of A-l.I is valid
+		const double* rows[3] = {r0,r1,r2};
+		const double* row = r0;
+		double rowNorm2 = 0.0;
+		for (unsigned i=0; i<3; ++i)
+		{
+			double n2 = rows[i][0]*rows[i][0] + rows[i][1]*rows[i][1] + rows[i][2]*rows[i][2];
+			if (n2 > rowNorm2)
+			{
+				rowNorm2 = n2;
+				row = rows[i];
+			}
+		}
+		if (rowNorm2 < 1.0e-24)
+		{
+			//isotropic matrix
+			v[0] = 0.0; v[1] = 0.0; v[2] = 1.0;
+		}
+		else
+		{
+			//cross product with the axis on which 'row' is the smallest
+			unsigned k = (fabs(row[0]) < fabs(row[1]) ? (fabs(row[0]) < fabs(row[2]) ? 0 : 2) : (fabs(row[1]) < fabs(row[2]) ? 1 : 2));
+			double e[3] = {0.0,0.0,0.0};
+			e[k] = 1.0;
+			v[0] = row[1]*e[2]-row[2]*e[1];
+			v[1] = row[2]*e[0]-row[0]*e[2];
+			v[2] = row[0]*e[1]-row[1]*e[0];
+			double n = sqrt(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+			v[0] /= n; v[1] /= n; v[2] /= n;
+		}
+	}
+
+	N[0] = (PointCoordinateType)v[0];
+	N[1] = (PointCoordinateType)v[1];
+	N[2] = (PointCoordinateType)v[2];
+
+	return true;
+}
+
+//! Computes the least square plane normal of the first 'k' points of a neighbourhood
+/** Faster equivalent of CCLib::Neighbourhood::getLSQPlane: the covariance matrix
+	is built in a single pass (sums of the coordinates and of their products,
+	relatively to the query point to limit the numerical cancellation) and its
+	eigen vector is computed directly (see ComputeSmallestEigenVector).
+**/
+static bool ComputeLSNormal(const CCLib::DgmOctree::NeighboursSet& neighbours, unsigned k, const CCVector3& Q, PointCoordinateType N[3])
+{
+	assert(k <= neighbours.size());
+	if (k < CC_LOCAL_MODEL_MIN_SIZE[LS])
+		return false;
+
+	double sX,sY,sZ,sXX,sYY,sZZ,sXY,sYZ,sZX;
+#ifdef CC_USE_SSE_KERNELS
+	{
+		//components: [x y z 0] and [x*y y*z z*x 0]
+		__m128 q = _mm_set_ps(0.0f,Q.z,Q.y,Q.x);
+		__m128 s = _mm_setzero_ps();
+		__m128 s2 = _mm_setzero_ps();
+		__m128 sCross = _mm_setzero_ps();
+		for (unsigned i=0; i<k; ++i)
+		{
+			const CCVector3* P = neighbours[i].point;
+			__m128 d = _mm_sub_ps(_mm_set_ps(0.0f,P->z,P->y,P->x),q);
+			s = _mm_add_ps(s,d);
+			s2 = _mm_add_ps(s2,_mm_mul_ps(d,d));
+			sCross = _mm_add_ps(sCross,_mm_mul_ps(d,_mm_shuffle_ps(d,d,_MM_SHUFFLE(3,0,2,1))));
+		}
+		float buffer[12];
+		_mm_storeu_ps(buffer,s);
+		_mm_storeu_ps(buffer+4,s2);
+		_mm_storeu_ps(buffer+8,sCross);
+		sX = buffer[0]; sY = buffer[1]; sZ = buffer[2];
+		sXX = buffer[4]; sYY = buffer[5]; sZZ = buffer[6];
+		sXY = buffer[8]; sYZ = buffer[9]; sZX = buffer[10];
+	}
+#else
+	sX=sY=sZ=sXX=sYY=sZZ=sXY=sYZ=sZX=0.0;
+	for (unsigned i=0; i<k; ++i)
+	{
+		CCVector3 d = *neighbours[i].point - Q;
+		sX += d.x; sY += d.y; sZ += d.z;
+		sXX += d.x*d.x; sYY += d.y*d.y; sZZ += d.z*d.z;
+		sXY += d.x*d.y; sYZ += d.y*d.z; sZX += d.z*d.x;
+	}
+#endif
+
+	//covariance matrix: E[d.d'] - E[d].E[d]'
+	double invK = 1.0/(double)k;
+	double mX = sX*invK, mY = sY*invK, mZ = sZ*invK;
+	double cov[6] = {	sXX*invK - mX*mX,
+						sYY*invK - mY*mY,
+						sZZ*invK - mZ*mZ,
+						sXY*invK - mX*mY,
+						sZX*invK - mX*mZ,
+						sYZ*invK - mY*mZ };
+
+	return ComputeSmallestEigenVector(cov,N);
+}
+
 bool ccNormalVectors::ComputeNormsAtLevelWithLS(const CCLib::DgmOctree::octreeCell& cell, void** additionalParameters)
 {
 	//variables additionnelles
 	NormsTableType* theNorms				    = (NormsTableType*)additionalParameters[0];
 	float radius								= *(float*)additionalParameters[1];
+	unsigned knn								= *(unsigned*)additionalParameters[2];
 
 	unsigned i,j,n;
 
 	//nombre de points dans la cellule courante
-	n = cell.points->size();
+	n = cell.pointCount;
+	CCLib::GenericIndexedCloudPersist* cloud = cell.parentOctree->associatedCloud();
 
 	CCLib::DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
 	nNSS.level												= cell.level;
 	nNSS.truncatedCellCode									= cell.truncatedCode;
-	nNSS.prepare(radius,cell.parentOctree->getCellSize(nNSS.level));
+	if (knn != 0)
+		nNSS.minNumberOfNeighbors							= knn;
+	else
+		nNSS.prepare(radius,cell.parentOctree->getCellSize(nNSS.level));
 	cell.parentOctree->getCellPos(cell.truncatedCode,cell.level,nNSS.cellPos,true);
 	cell.parentOctree->computeCellCenter(nNSS.cellPos,cell.level,nNSS.cellCenter);
 
@@ -390,33 +582,35 @@ bool ccNormalVectors::ComputeNormsAtLevelWithLS(const CCLib::DgmOctree::octreeCe
 	CCLib::DgmOctree::NeighboursSet::iterator it = nNSS.pointsInNeighbourhood.begin();
 	for (j=0;j<n;++j,++it)
 	{
-		it->point = cell.points->getPointPersistentPtr(j);
-		it->pointIndex = cell.points->getPointGlobalIndex(j);
+		it->pointIndex = cell.getPointGlobalIndex(j);
+		it->point = cloud->getPointPersistentPtr(it->pointIndex);
 	}
 	nNSS.alreadyVisitedNeighbourhoodSize = 1;
 
+	//the same search structure (and its neighbours buffer) is used for all the cell points
 	for (i=0;i<n;++i)
 	{
-		cell.points->getPoint(i,nNSS.queryPoint);
+		nNSS.queryPoint = *cloud->getPointPersistentPtr(cell.getPointGlobalIndex(i));
 
-		unsigned k = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS,radius,false);
-		if (k>=NUMBER_OF_POINTS_FOR_NORM_WITH_HF)
+		unsigned k = 0;
+		if (knn != 0)
 		{
-			CCLib::DgmOctreeReferenceCloud neighbours(&nNSS.pointsInNeighbourhood,k);
-			CCLib::Neighbourhood Z(&neighbours);
-
-			//CALCUL DE LA NORMALE PAR INTERPOLATION AVEC UN PLAN
-			const PointCoordinateType* lsqPlane = Z.getLSQPlane();
-			if (lsqPlane)
-			{
-				CCVector3 N = CCVector3(lsqPlane);
-				//don't forget to normalize
-				N.normalize();
-
-				theNorms->setValue(cell.points->getPointGlobalIndex(i),N.u);
-			}
-			//FIN CALCUL DE LA NORMALE
+			k = cell.parentOctree->findNearestNeighborsStartingFromCell(nNSS);
+			if (k > knn)
+				k = knn;
 		}
+		else
+		{
+			k = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS,radius,false);
+			if (k < NUMBER_OF_POINTS_FOR_NORM_WITH_HF)
+				k = 0;
+		}
+
+		//CALCUL DE LA NORMALE PAR INTERPOLATION AVEC UN PLAN
+		PointCoordinateType N[3];
+		if (k != 0 && ComputeLSNormal(nNSS.pointsInNeighbourhood,k,nNSS.queryPoint,N))
+			theNorms->setValue(cell.getPointGlobalIndex(i),N);
+		//FIN CALCUL DE LA NORMALE
 	}
 
 	return true;
@@ -430,7 +624,8 @@ bool ccNormalVectors::ComputeNormsAtLevelWithTri(const CCLib::DgmOctree::octreeC
 	unsigned i,j,n;
 
 	//nombre de points dans la cellule courante
-	n = cell.points->size();
+	n = cell.pointCount;
+	CCLib::GenericIndexedCloudPersist* cloud = cell.parentOctree->associatedCloud();
 
 	CCLib::DgmOctree::NearestNeighboursSearchStruct nNSS;
 	nNSS.level												= cell.level;
@@ -445,14 +640,14 @@ bool ccNormalVectors::ComputeNormsAtLevelWithTri(const CCLib::DgmOctree::octreeC
 	CCLib::DgmOctree::NeighboursSet::iterator it = nNSS.pointsInNeighbourhood.begin();
 	for (j=0;j<n;++j,++it)
 	{
-		it->point = cell.points->getPointPersistentPtr(j);
-		it->pointIndex = cell.points->getPointGlobalIndex(j);
+		it->pointIndex = cell.getPointGlobalIndex(j);
+		it->point = cloud->getPointPersistentPtr(it->pointIndex);
 	}
 	nNSS.alreadyVisitedNeighbourhoodSize = 1;
 
 	for (i=0;i<n;++i)
 	{
-		cell.points->getPoint(i,nNSS.queryPoint);
+		nNSS.queryPoint = *cloud->getPointPersistentPtr(cell.getPointGlobalIndex(i));
 
 		unsigned k = cell.parentOctree->findNearestNeighborsStartingFromCell(nNSS);
 		if (k>NUMBER_OF_POINTS_FOR_NORM_WITH_TRI)
@@ -515,7 +710,7 @@ bool ccNormalVectors::ComputeNormsAtLevelWithTri(const CCLib::DgmOctree::octreeC
 			}
 			//FIN CALCUL DE LA NORMALE
 
-			theNorms->setValue(cell.points->getPointGlobalIndex(i),N.u);
+			theNorms->setValue(cell.getPointGlobalIndex(i),N.u);
 		}
 	}
 
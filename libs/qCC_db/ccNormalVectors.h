@@ -80,6 +80,7 @@ public:
         \param preferedOrientation specifies a prefered orientation for normals (-1: no prefered orientation, 0:X, 1:-X, 2:Y, 3:-Y, 4:Z, 5: -Z, 6:+Barycenter, 7:-Barycenter)
         \param progressCb progress bar
         \param _theOctree octree associated with theCloud.
+		\param knn number of nearest neighbours to use instead of a spherical neighbourhood (LS only - ignored if 0)
     **/
 	static bool ComputeCloudNormals(ccGenericPointCloud* theCloud,
                                     NormsIndexesTableType& theNormsCodes,
@@ -87,7 +88,8 @@ public:
 									float radius,
                                     int preferedOrientation=-1,
                                     CCLib::GenericProgressCallback* progressCb=0,
-                                    CCLib::DgmOctree* _theOctree=0);
+                                    CCLib::DgmOctree* _theOctree=0,
+									unsigned knn=0);
 
 	//! Converts a normal vector to geological 'strike & dip' parameters (N[dip]E - [strike]SE)
 	/** \param[in] N normal (should be normalized!)
@@ -275,27 +275,31 @@ bool ccOctree::DrawCellAsAPoint(const CCLib::DgmOctree::octreeCell& cell, void**
 	glDrawParams* glParams						= (glDrawParams*)additionalParameters[0];
 	ccGenericPointCloud* theAssociatedCloud		= (ccGenericPointCloud*)additionalParameters[1];
 
+	CCLib::ReferenceCloud* cellPoints = cell.getPoints();
+	if (!cellPoints) //not enough memory
+		return false;
+
 	if (glParams->showSF)
 	{
-		ScalarType dist = CCLib::ScalarFieldTools::computeMeanScalarValue(cell.points);
+		ScalarType dist = CCLib::ScalarFieldTools::computeMeanScalarValue(cellPoints);
 		const colorType* col = theAssociatedCloud->geScalarValueColor(dist);
 		glColor3ubv(col ? col : ccColor::lightGrey);
 	}
 	else if (glParams->showColors)
 	{
 		colorType col[3];
-		ComputeAverageColor(cell.points,theAssociatedCloud,col);
+		ComputeAverageColor(cellPoints,theAssociatedCloud,col);
 		glColor3ubv(col);
 	}
 
 	if (glParams->showNorms)
 	{
 		GLfloat N[3];
-		ComputeAverageNorm(cell.points,theAssociatedCloud,N);
+		ComputeAverageNorm(cellPoints,theAssociatedCloud,N);
 		glNormal3fv(N);
 	}
 
-	const CCVector3* gravityCenter = CCLib::Neighbourhood(cell.points).getGravityCenter();
+	const CCVector3* gravityCenter = CCLib::Neighbourhood(cellPoints).getGravityCenter();
 	glVertex3fv(gravityCenter->u);
 
 	return true;
@@ -313,23 +317,27 @@ bool ccOctree::DrawCellAsAPrimitive(const CCLib::DgmOctree::octreeCell& cell, vo
 	GLfloat cellCenter[3];
 	cell.parentOctree->computeCellCenter(cell.truncatedCode,cell.level,cellCenter,true);
 
+	CCLib::ReferenceCloud* cellPoints = cell.getPoints();
+	if (!cellPoints) //not enough memory
+		return false;
+
 	if (glParams->showSF)
 	{
-		ScalarType dist = CCLib::ScalarFieldTools::computeMeanScalarValue(cell.points);
+		ScalarType dist = CCLib::ScalarFieldTools::computeMeanScalarValue(cellPoints);
 		const colorType* col = theAssociatedCloud->geScalarValueColor(dist);
 		primitive->setColor(col);
 	}
 	else if (glParams->showColors)
 	{
 		colorType col[3];
-		ComputeAverageColor(cell.points,theAssociatedCloud,col);
+		ComputeAverageColor(cellPoints,theAssociatedCloud,col);
 		primitive->setColor(col);
 	}
 
 	if (glParams->showNorms)
 	{
 		GLfloat N[3];
-		ComputeAverageNorm(cell.points,theAssociatedCloud,N);
+		ComputeAverageNorm(cellPoints,theAssociatedCloud,N);
 		if (primitive->getTriNormsTable())
 			primitive->getTriNormsTable()->setValue(0,ccNormalVectors::GetNormIndex(N));
 	}
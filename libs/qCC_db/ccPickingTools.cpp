@@ -0,0 +1,302 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "ccPickingTools.h"
+
+//Local
+#include "ccGenericPointCloud.h"
+#include "ccGenericMesh.h"
+#include "ccOctree.h"
+
+//CCLib
+#include <CCConst.h>
+
+//System
+#include <algorithm>
+#include <assert.h>
+
+//! Multiplies two 4x4 matrices (column major): dest = A * B
+static void MultMatrices(const double A[16], const double B[16], double dest[16])
+{
+	for (int c=0; c<4; ++c)
+		for (int r=0; r<4; ++r)
+			dest[(c<<2)+r] = A[r]*B[(c<<2)] + A[4+r]*B[(c<<2)+1] + A[8+r]*B[(c<<2)+2] + A[12+r]*B[(c<<2)+3];
+}
+
+//! Inverts a 4x4 matrix (column major)
+/** \return false if the matrix is singular
+**/
+static bool InvertMatrix(const double m[16], double inv[16])
+{
+	inv[0]  =  m[5]*m[10]*m[15] - m[5]*m[11]*m[14] - m[9]*m[6]*m[15] + m[9]*m[7]*m[14] + m[13]*m[6]*m[11] - m[13]*m[7]*m[10];
+	inv[4]  = -m[4]*m[10]*m[15] + m[4]*m[11]*m[14] + m[8]*m[6]*m[15] - m[8]*m[7]*m[14] - m[12]*m[6]*m[11] + m[12]*m[7]*m[10];
+	inv[8]  =  m[4]*m[9]*m[15]  - m[4]*m[11]*m[13] - m[8]*m[5]*m[15] + m[8]*m[7]*m[13] + m[12]*m[5]*m[11] - m[12]*m[7]*m[9];
+	inv[12] = -m[4]*m[9]*m[14]  + m[4]*m[10]*m[13] + m[8]*m[5]*m[14] - m[8]*m[6]*m[13] - m[12]*m[5]*m[10] + m[12]*m[6]*m[9];
+	inv[1]  = -m[1]*m[10]*m[15] + m[1]*m[11]*m[14] + m[9]*m[2]*m[15] - m[9]*m[3]*m[14] - m[13]*m[2]*m[11] + m[13]*m[3]*m[10];
+	inv[5]  =  m[0]*m[10]*m[15] - m[0]*m[11]*m[14] - m[8]*m[2]*m[15] + m[8]*m[3]*m[14] + m[12]*m[2]*m[11] - m[12]*m[3]*m[10];
+	inv[9]  = -m[0]*m[9]*m[15]  + m[0]*m[11]*m[13] + m[8]*m[1]*m[15] - m[8]*m[3]*m[13] - m[12]*m[1]*m[11] + m[12]*m[3]*m[9];
+	inv[13] =  m[0]*m[9]*m[14]  - m[0]*m[10]*m[13] - m[8]*m[1]*m[14] + m[8]*m[2]*m[13] + m[12]*m[1]*m[10] - m[12]*m[2]*m[9];
+	inv[2]  =  m[1]*m[6]*m[15]  - m[1]*m[7]*m[14]  - m[5]*m[2]*m[15] + m[5]*m[3]*m[14] + m[13]*m[2]*m[7]  - m[13]*m[3]*m[6];
+	inv[6]  = -m[0]*m[6]*m[15]  + m[0]*m[7]*m[14]  + m[4]*m[2]*m[15] - m[4]*m[3]*m[14] - m[12]*m[2]*m[7]  + m[12]*m[3]*m[6];
+	inv[10] =  m[0]*m[5]*m[15]  - m[0]*m[7]*m[13]  - m[4]*m[1]*m[15] + m[4]*m[3]*m[13] + m[12]*m[1]*m[7]  - m[12]*m[3]*m[5];
+	inv[14] = -m[0]*m[5]*m[14]  + m[0]*m[6]*m[13]  + m[4]*m[1]*m[14] - m[4]*m[2]*m[13] - m[12]*m[1]*m[6]  + m[12]*m[2]*m[5];
+	inv[3]  = -m[1]*m[6]*m[11]  + m[1]*m[7]*m[10]  + m[5]*m[2]*m[11] - m[5]*m[3]*m[10] - m[9]*m[2]*m[7]   + m[9]*m[3]*m[6];
+	inv[7]  =  m[0]*m[6]*m[11]  - m[0]*m[7]*m[10]  - m[4]*m[2]*m[11] + m[4]*m[3]*m[10] + m[8]*m[2]*m[7]   - m[8]*m[3]*m[6];
+	inv[11] = -m[0]*m[5]*m[11]  + m[0]*m[7]*m[9]   + m[4]*m[1]*m[11] - m[4]*m[3]*m[9]  - m[8]*m[1]*m[7]   + m[8]*m[3]*m[5];
+	inv[15] =  m[0]*m[5]*m[10]  - m[0]*m[6]*m[9]   - m[4]*m[1]*m[10] + m[4]*m[2]*m[9]  + m[8]*m[1]*m[6]   - m[8]*m[2]*m[5];
+
+	double det = m[0]*inv[0] + m[1]*inv[4] + m[2]*inv[8] + m[3]*inv[12];
+	if (det == 0.0)
+		return false;
+
+	det = 1.0/det;
+	for (int i=0; i<16; ++i)
+		inv[i] *= det;
+
+	return true;
+}
+
+//! Unprojects a point (normalized device coordinates) with the inverse of the clip matrix
+static bool Unproject(const double invClipMat[16], double x, double y, double z, double P[3])
+{
+	double w = invClipMat[3]*x + invClipMat[7]*y + invClipMat[11]*z + invClipMat[15];
+	if (w == 0.0)
+		return false;
+	P[0] = (invClipMat[0]*x + invClipMat[4]*y + invClipMat[8]*z  + invClipMat[12]) / w;
+	P[1] = (invClipMat[1]*x + invClipMat[5]*y + invClipMat[9]*z  + invClipMat[13]) / w;
+	P[2] = (invClipMat[2]*x + invClipMat[6]*y + invClipMat[10]*z + invClipMat[14]) / w;
+	return true;
+}
+
+bool ccPickingTools::ComputePickingVolume(	const double modelViewMat[16],
+											const double projectionMat[16],
+											const int viewport[4],
+											int centerX,
+											int centerY,
+											int pickWidth,
+											int pickHeight,
+											const ccGLMatrix* entityTrans,
+											PickingVolume& volume)
+{
+	if (viewport[2] <= 0 || viewport[3] <= 0)
+		return false;
+
+	//entity to clip coordinates
+	{
+		double modelViewTrans[16];
+		if (entityTrans)
+		{
+			double trans[16];
+			const float* T = entityTrans->data();
+			for (int i=0; i<16; ++i)
+				trans[i] = static_cast<double>(T[i]);
+			MultMatrices(modelViewMat,trans,modelViewTrans);
+		}
+		else
+		{
+			for (int i=0; i<16; ++i)
+				modelViewTrans[i] = modelViewMat[i];
+		}
+		MultMatrices(projectionMat,modelViewTrans,volume.clipMat);
+	}
+	const double* M = volume.clipMat;
+
+	//picking area in normalized device coordinates (same conventions as gluPickMatrix)
+	double xc = 2.0*static_cast<double>(centerX-viewport[0])/static_cast<double>(viewport[2]) - 1.0;
+	double yc = 2.0*static_cast<double>(viewport[3]-centerY-viewport[1])/static_cast<double>(viewport[3]) - 1.0;
+	double hx = static_cast<double>(std::max(pickWidth,1))/static_cast<double>(viewport[2]);
+	double hy = static_cast<double>(std::max(pickHeight,1))/static_cast<double>(viewport[3]);
+
+	//frustum planes: a clip space point (x,y,z,w) is inside if |x-xc.w| <= hx.w, |y-yc.w| <= hy.w and |z| <= w
+	for (int k=0; k<4; ++k)
+	{
+		const double& row0 = M[(k<<2)];
+		const double& row1 = M[(k<<2)+1];
+		const double& row2 = M[(k<<2)+2];
+		const double& row3 = M[(k<<2)+3];
+
+		volume.planes[0][k] = row0 - (xc-hx)*row3;	//left
+		volume.planes[1][k] = (xc+hx)*row3 - row0;	//right
+		volume.planes[2][k] = row1 - (yc-hy)*row3;	//bottom
+		volume.planes[3][k] = (yc+hy)*row3 - row1;	//top
+		volume.planes[4][k] = row3 + row2;			//near
+		volume.planes[5][k] = row3 - row2;			//far
+
+		//depth: 'w' (i.e. distance to the eye) in perspective mode, 'z' otherwise
+		//(the normalized depth z/w is a monotonic function of both)
+		volume.depthEquation[k] = (projectionMat[11] != 0.0 ? row3 : row2);
+	}
+
+	//picking ray
+	double invClipMat[16];
+	if (!InvertMatrix(M,invClipMat))
+		return false;
+
+	return	Unproject(invClipMat,xc,yc,-1.0,volume.rayOrigin)
+		&&	Unproject(invClipMat,xc,yc,1.0,volume.rayEnd);
+}
+
+double ccPickingTools::ComputeDepth(const PickingVolume& volume, const CCVector3& P)
+{
+	const double* M = volume.clipMat;
+	double X = static_cast<double>(P.x);
+	double Y = static_cast<double>(P.y);
+	double Z = static_cast<double>(P.z);
+
+	double z = M[2]*X + M[6]*Y + M[10]*Z + M[14];
+	double w = M[3]*X + M[7]*Y + M[11]*Z + M[15];
+
+	return (w != 0.0 ? z/w : z);
+}
+
+bool ccPickingTools::PickPoint(ccGenericPointCloud* cloud, const PickingVolume& volume, unsigned& pointIndex, double& depth)
+{
+	assert(cloud);
+	unsigned count = cloud->size();
+	if (count == 0)
+		return false;
+
+	//points visibility
+	const ccGenericPointCloud::VisibilityTableType* visibility = cloud->getTheVisibilityArray();
+	bool visFiltering = (visibility && visibility->isAllocated());
+
+	bool found = false;
+	double bestDepth = 0.0;
+
+	ccOctree* octree = cloud->getOctree();
+	if (octree && !visFiltering && octree->getNumberOfProjectedPoints() == count)
+	{
+		found = octree->findNearestPointInConvexVolume(volume.planes,6,volume.depthEquation,pointIndex,bestDepth);
+	}
+	else
+	{
+		const double* D = volume.depthEquation;
+		for (unsigned i=0; i<count; ++i)
+		{
+			if (visFiltering && visibility->getValue(i) != POINT_VISIBLE)
+				continue;
+
+			const CCVector3* P = cloud->getPoint(i);
+			double X = static_cast<double>(P->x);
+			double Y = static_cast<double>(P->y);
+			double Z = static_cast<double>(P->z);
+
+			double d = D[0]*X + D[1]*Y + D[2]*Z + D[3];
+			if (found && d >= bestDepth)
+				continue;
+
+			int j=0;
+			for (; j<6; ++j)
+			{
+				const double* plane = volume.planes[j];
+				if (plane[0]*X + plane[1]*Y + plane[2]*Z + plane[3] < 0.0)
+					break;
+			}
+			if (j < 6) //outside
+				continue;
+
+			pointIndex = i;
+			bestDepth = d;
+			found = true;
+		}
+	}
+
+	if (found)
+		depth = ComputeDepth(volume,*cloud->getPoint(pointIndex));
+
+	return found;
+}
+
+bool ccPickingTools::PickTriangle(ccGenericMesh* mesh, const PickingVolume& volume, unsigned& triangleIndex, double& depth)
+{
+	assert(mesh);
+	ccGenericPointCloud* vertices = mesh->getAssociatedCloud();
+	unsigned triCount = mesh->size();
+	if (!vertices || triCount == 0)
+		return false;
+
+	//vertices visibility
+	const ccGenericPointCloud::VisibilityTableType* visibility = vertices->getTheVisibilityArray();
+	bool visFiltering = (visibility && visibility->isAllocated());
+
+	//ray: O + t.D (with t in [0,1] between the near and far planes)
+	const double* O = volume.rayOrigin;
+	double D[3] = {	volume.rayEnd[0]-O[0],
+					volume.rayEnd[1]-O[1],
+					volume.rayEnd[2]-O[2] };
+
+	bool found = false;
+	double bestT = 1.0;
+
+	//Moller-Trumbore intersection test (both sides)
+	for (unsigned n=0; n<triCount; ++n)
+	{
+		const CCLib::TriangleSummitsIndexes* tsi = mesh->getTriangleIndexes(n);
+		if (visFiltering)
+		{
+			if ((visibility->getValue(tsi->i1) != POINT_VISIBLE) ||
+				(visibility->getValue(tsi->i2) != POINT_VISIBLE) ||
+				(visibility->getValue(tsi->i3) != POINT_VISIBLE))
+				continue;
+		}
+
+		const CCVector3* A = vertices->getPoint(tsi->i1);
+		const CCVector3* B = vertices->getPoint(tsi->i2);
+		const CCVector3* C = vertices->getPoint(tsi->i3);
+
+		double e1[3] = { static_cast<double>(B->x)-A->x, static_cast<double>(B->y)-A->y, static_cast<double>(B->z)-A->z };
+		double e2[3] = { static_cast<double>(C->x)-A->x, static_cast<double>(C->y)-A->y, static_cast<double>(C->z)-A->z };
+
+		double p[3] = {	D[1]*e2[2] - D[2]*e2[1],
+						D[2]*e2[0] - D[0]*e2[2],
+						D[0]*e2[1] - D[1]*e2[0] };
+		double det = e1[0]*p[0] + e1[1]*p[1] + e1[2]*p[2];
+		if (det == 0.0) //ray parallel to the triangle
+			continue;
+		double invDet = 1.0/det;
+
+		double s[3] = { O[0]-A->x, O[1]-A->y, O[2]-A->z };
+		double u = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2]) * invDet;
+		if (u < 0.0 || u > 1.0)
+			continue;
+
+		double q[3] = {	s[1]*e1[2] - s[2]*e1[1],
+						s[2]*e1[0] - s[0]*e1[2],
+						s[0]*e1[1] - s[1]*e1[0] };
+		double v = (D[0]*q[0] + D[1]*q[1] + D[2]*q[2]) * invDet;
+		if (v < 0.0 || u+v > 1.0)
+			continue;
+
+		double t = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2]) * invDet;
+		if (t < 0.0 || t > bestT || (found && t == bestT))
+			continue;
+
+		triangleIndex = n;
+		bestT = t;
+		found = true;
+	}
+
+	if (found)
+	{
+		CCVector3 I(static_cast<PointCoordinateType>(O[0]+bestT*D[0]),
+					static_cast<PointCoordinateType>(O[1]+bestT*D[1]),
+					static_cast<PointCoordinateType>(O[2]+bestT*D[2]));
+		depth = ComputeDepth(volume,I);
+	}
+
+	return found;
+}
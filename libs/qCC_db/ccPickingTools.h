@@ -0,0 +1,104 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_PICKING_TOOLS_HEADER
+#define CC_PICKING_TOOLS_HEADER
+
+//Local
+#include "ccGLMatrix.h"
+
+class ccGenericPointCloud;
+class ccGenericMesh;
+
+//! CPU based picking of points and triangles
+/** Replaces the OpenGL selection mode (GL_SELECT) for points and triangles:
+	instead of redrawing the whole scene with one GL name per element, the
+	picking area is converted into a frustum (points) or a ray (triangles)
+	and the entities are directly queried. No OpenGL context is required.
+**/
+#ifdef QCC_DB_USE_AS_DLL
+#include "qCC_db_dll.h"
+class QCC_DB_DLL_API ccPickingTools
+#else
+class ccPickingTools
+#endif
+{
+public:
+
+	//! Picking volume (expressed in the coordinate system of a given entity)
+	struct PickingVolume
+	{
+		//! Frustum of the picking area (as [Nx Ny Nz d]: a point P is inside if N.P+d >= 0 for all planes)
+		double planes[6][4];
+		//! Depth equation (the nearest point has the smallest D.P+d value)
+		double depthEquation[4];
+		//! Entity to clip coordinates transformation (column major)
+		double clipMat[16];
+		//! Ray origin (center of the picking area, on the near plane)
+		double rayOrigin[3];
+		//! Ray end (center of the picking area, on the far plane)
+		double rayEnd[3];
+	};
+
+	//! Computes the picking volume corresponding to a picking area
+	/** \param modelViewMat model view matrix (column major - see glGetDoublev)
+		\param projectionMat projection matrix (column major)
+		\param viewport viewport (x, y, width and height - see glGetIntegerv)
+		\param centerX picking area center X position (in pixels)
+		\param centerY picking area center Y position (in pixels, from the top of the viewport)
+		\param pickWidth picking area width (in pixels)
+		\param pickHeight picking area height (in pixels)
+		\param entityTrans entity 'display' transformation (see ccDrawableObject::getGLTransformation) or 0
+		\param[out] volume picking volume (in the entity coordinate system)
+		\return false if the transformation is singular
+	**/
+	static bool ComputePickingVolume(	const double modelViewMat[16],
+										const double projectionMat[16],
+										const int viewport[4],
+										int centerX,
+										int centerY,
+										int pickWidth,
+										int pickHeight,
+										const ccGLMatrix* entityTrans,
+										PickingVolume& volume);
+
+	//! Picks the nearest point of a cloud lying inside a picking volume
+	/** The cloud octree is used if it has already been computed (and if all
+		the points are visible). Otherwise all the points are tested.
+		\param cloud point cloud
+		\param volume picking volume (see ComputePickingVolume)
+		\param[out] pointIndex index of the picked point
+		\param[out] depth picked point normalized depth (between -1 and 1 as OpenGL 'NDC' coordinates)
+		\return whether a point has been picked
+	**/
+	static bool PickPoint(ccGenericPointCloud* cloud, const PickingVolume& volume, unsigned& pointIndex, double& depth);
+
+	//! Picks the nearest triangle of a mesh crossed by the picking ray
+	/** Triangles with at least one hidden vertex are ignored (as they are not displayed).
+		\param mesh mesh
+		\param volume picking volume (see ComputePickingVolume)
+		\param[out] triangleIndex index of the picked triangle
+		\param[out] depth intersection normalized depth (between -1 and 1 as OpenGL 'NDC' coordinates)
+		\return whether a triangle has been picked
+	**/
+	static bool PickTriangle(ccGenericMesh* mesh, const PickingVolume& volume, unsigned& triangleIndex, double& depth);
+
+	//! Returns the normalized depth (between -1 and 1 if visible) of a point
+	static double ComputeDepth(const PickingVolume& volume, const CCVector3& P);
+};
+
+#endif //CC_PICKING_TOOLS_HEADER
@@ -21,6 +21,7 @@
 #include "ccPointCloud.h"
 
 //CCLib
+#include <CCTypes.h>
 #include <ManualSegmentationTools.h>
 #include <GeometricalAnalysisTools.h>
 #include <ReferenceCloud.h>
@@ -34,12 +35,19 @@
 #include "ccImage.h"
 #include "cc2DLabel.h"
 #include "ccGLUtils.h"
+#include "ccPointCloudLOD.h"
 
 //ccFBO
 #include <ccShader.h>
 
 //system
 #include <assert.h>
+#include <algorithm>
+
+//SSE instructions for the visible points indexes computation (see CC_USE_SSE_KERNELS in CCTypes.h)
+#ifdef CC_USE_SSE_KERNELS
+#include <emmintrin.h>
+#endif
 
 ccPointCloud::ccPointCloud(QString name)
 	: ChunkedPointCloud()
@@ -48,6 +56,8 @@ ccPointCloud::ccPointCloud(QString name)
 	, m_normals(0)
 	, m_currentDisplayedScalarField(0)
 	, m_currentDisplayedScalarFieldIndex(-1)
+	, m_lod(0)
+	, m_lodModificationTime(0)
 {
     init();
 }
@@ -59,6 +69,8 @@ ccPointCloud::ccPointCloud(CCLib::GenericCloud* cloud)
 	, m_normals(0)
 	, m_currentDisplayedScalarField(0)
 	, m_currentDisplayedScalarFieldIndex(-1)
+	, m_lod(0)
+	, m_lodModificationTime(0)
 {
     init();
 
@@ -85,6 +97,8 @@ ccPointCloud::ccPointCloud(const CCLib::GenericIndexedCloud* cloud)
 	, m_normals(0)
 	, m_currentDisplayedScalarField(0)
 	, m_currentDisplayedScalarFieldIndex(-1)
+	, m_lod(0)
+	, m_lodModificationTime(0)
 {
     init();
 
@@ -114,6 +128,8 @@ ccPointCloud::ccPointCloud(const CCLib::ReferenceCloud* selection, const ccPoint
 	, m_normals(0)
 	, m_currentDisplayedScalarField(0)
 	, m_currentDisplayedScalarFieldIndex(-1)
+	, m_lod(0)
+	, m_lodModificationTime(0)
 {
     assert(source);
 	if (!source)
@@ -277,6 +293,10 @@ ccPointCloud::ccPointCloud(const CCLib::ReferenceCloud* selection, const ccPoint
 ccPointCloud::~ccPointCloud()
 {
     clear();
+
+	if (m_lod)
+		delete m_lod;
+	m_lod = 0;
 }
 
 void ccPointCloud::init()
@@ -288,6 +308,9 @@ void ccPointCloud::init()
 
 void ccPointCloud::clear()
 {
+	clearLOD();
+	m_visibleIndexes.clear();
+
     ChunkedPointCloud::clear();
     ccGenericPointCloud::clear();
 
@@ -358,6 +381,8 @@ const ccPointCloud& ccPointCloud::append(ccPointCloud* addedCloud, unsigned poin
 
     unsigned addedPoints = addedCloud->size();
 
+	clearLOD();
+
     if (!reserve(pointCountBefore+addedPoints))
     {
         ccLog::Error("[ccPointCloud::append] Not enough memory!");
@@ -644,6 +669,8 @@ void ccPointCloud::unallocateColors()
 
 bool ccPointCloud::reserveThePointsTable(unsigned newNumberOfPoints)
 {
+	clearLOD();
+
     return m_points->reserve(newNumberOfPoints);
 }
 
@@ -760,6 +787,9 @@ bool ccPointCloud::reserve(unsigned newNumberOfPoints)
     if (newNumberOfPoints < size())
         return false;
 
+	//the L.O.D. structure is deprecated (and the points may move in memory)
+	clearLOD();
+
 	//call parent method first (for points + scalar fields)
     if (!ChunkedPointCloud::reserve(newNumberOfPoints))
     {
@@ -788,6 +818,9 @@ bool ccPointCloud::resize(unsigned newNumberOfPoints)
     if (newNumberOfPoints < size() && isLocked())
         return false;
 
+	//the L.O.D. structure is deprecated (and the points may move in memory)
+	clearLOD();
+
 	//call parent method first (for points + scalar fields)
     if (!ChunkedPointCloud::resize(newNumberOfPoints))
     {
@@ -914,6 +947,8 @@ bool ccPointCloud::hasDisplayedScalarField() const
 
 void ccPointCloud::refreshBB()
 {
+	clearLOD();
+
     invalidateBoundingBox();
     updateModificationTime();
 }
@@ -1109,8 +1144,15 @@ void ccPointCloud::applyGLTransformation(const ccGLMatrix& trans)
 void ccPointCloud::applyRigidTransformation(const ccGLMatrix& trans)
 {
     unsigned i,count=size();
-    for (i=0;i<count;i++)
-		trans.apply(*point(i));
+
+	clearLOD();
+
+	//rotation part (row-major) + translation
+	const float* M = trans.data();
+	const PointCoordinateType R[9] = {	M[0], M[4], M[8],
+										M[1], M[5], M[9],
+										M[2], M[6], M[10] };
+	transformPoints(R,trans.getTranslation());
 
     //we must also take care of the normals!
     if (hasNormals())
@@ -1175,9 +1217,9 @@ void ccPointCloud::translate(const CCVector3& T)
     if (fabs(T.x)+fabs(T.y)+fabs(T.z) < ZERO_TOLERANCE)
         return;
 
-    unsigned i,count=size();
-    for (i=0;i<count;i++)
-        *point(i) += T;
+	clearLOD();
+
+    translatePoints(T);
 
     updateModificationTime();
 
@@ -1195,14 +1237,9 @@ void ccPointCloud::translate(const CCVector3& T)
 
 void ccPointCloud::multiply(PointCoordinateType fx, PointCoordinateType fy, PointCoordinateType fz)
 {
-    unsigned i,count=size();
-    for (i=0;i<count;i++)
-	{
-        CCVector3* P = point(i);
-        P->x *= fx;
-        P->y *= fy;
-        P->z *= fz;
-    }
+	clearLOD();
+
+    scalePoints(fx,fy,fz);
 
     updateModificationTime();
 
@@ -1253,9 +1290,15 @@ void ccPointCloud::swapPoints(unsigned firstIndex, unsigned secondIndex)
     if ((firstIndex==secondIndex)||(firstIndex>=size())||(secondIndex>=size()))
         return;
 
+	clearLOD();
+
     //points + associated SF values
     ChunkedPointCloud::swapPoints(firstIndex,secondIndex);
 
+	//SF colors cache is deprecated
+	for (unsigned i=0; i<getNumberOfScalarFields(); ++i)
+		static_cast<ccScalarField*>(getScalarField(i))->invalidateColors();
+
     //colors
     if (hasColors())
         m_rgbColors->swap(firstIndex,secondIndex);
@@ -1265,6 +1308,152 @@ void ccPointCloud::swapPoints(unsigned firstIndex, unsigned secondIndex)
         m_normals->swap(firstIndex,secondIndex);
 }
 
+bool ccPointCloud::initLOD()
+{
+	if (!m_lod)
+	{
+		m_lod = new ccPointCloudLOD;
+	}
+	else if (!m_lod->isNull() && m_lodModificationTime != getLastModificationTime())
+	{
+		//the points have been modified in place since the structure has been computed
+		m_lod->clear();
+	}
+
+	if (m_lod->isNull())
+	{
+		m_lodModificationTime = getLastModificationTime();
+		return m_lod->startBuild(this);
+	}
+
+	return true;
+}
+
+void ccPointCloud::clearLOD()
+{
+	if (m_lod)
+		m_lod->clear();
+}
+
+//! Computes the indexes of the visible points of a chunk
+/** Indexes are relative to the chunk start (hence the 16 bits storage).
+	\param visibility chunk visibility values
+	\param count number of values (at most MAX_NUMBER_OF_ELEMENTS_PER_CHUNK)
+	\param[out] indexes visible points indexes (must be at least of size 'count')
+	\return number of visible points
+**/
+static unsigned ComputeVisibleIndexes(const uchar* visibility, unsigned count, unsigned short* indexes)
+{
+	assert(count <= MAX_NUMBER_OF_ELEMENTS_PER_CHUNK);
+
+	unsigned visibleCount = 0;
+	unsigned i = 0;
+
+#ifdef CC_USE_SSE_KERNELS
+	//16 values at once: fully visible or fully hidden blocks are the most common case
+	const __m128i _visible = _mm_set1_epi8(static_cast<char>(POINT_VISIBLE));
+	for (; i+16<=count; i+=16)
+	{
+		__m128i _v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(visibility+i));
+		unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(_v,_visible)));
+		if (mask == 0xFFFF)
+		{
+			for (unsigned b=0; b<16; ++b)
+				indexes[visibleCount++] = static_cast<unsigned short>(i+b);
+		}
+		else if (mask != 0)
+		{
+			for (unsigned b=0; b<16; ++b)
+			{
+				indexes[visibleCount] = static_cast<unsigned short>(i+b);
+				visibleCount += ((mask >> b) & 1);
+			}
+		}
+	}
+#endif
+
+	//remaining values (without branching)
+	for (; i<count; ++i)
+	{
+		indexes[visibleCount] = static_cast<unsigned short>(i);
+		visibleCount += (visibility[i] == POINT_VISIBLE ? 1 : 0);
+	}
+
+	return visibleCount;
+}
+
+//Temporary buffer for visible points indexes
+static unsigned short s_indexBuffer[MAX_NUMBER_OF_ELEMENTS_PER_CHUNK];
+
+void ccPointCloud::onVisibilityArrayChanged(unsigned firstIndex, unsigned lastIndex)
+{
+	//no more visibility array: we release the memory
+	if (!isVisibilityTableInstantiated())
+	{
+		m_visibleIndexes.clear();
+		return;
+	}
+
+	if (m_visibleIndexes.empty())
+		return; //nothing to invalidate
+
+	unsigned lastChunk = std::min<unsigned>(lastIndex >> CHUNK_INDEX_BIT_DEC, static_cast<unsigned>(m_visibleIndexes.size())-1);
+	for (unsigned k=(firstIndex >> CHUNK_INDEX_BIT_DEC); k<=lastChunk; ++k)
+		m_visibleIndexes[k].upToDate = false;
+}
+
+bool ccPointCloud::updateVisibleIndexes()
+{
+	if (!isVisibilityTableInstantiated() || m_pointsVisibility->currentSize() != size())
+		return false;
+
+	unsigned chunks = m_points->chunksCount();
+	assert(m_pointsVisibility->chunksCount() == chunks);
+	if (m_visibleIndexes.size() != chunks)
+	{
+		try
+		{
+			m_visibleIndexes.resize(chunks);
+		}
+		catch (.../*const std::bad_alloc&*/) //out of memory
+		{
+			m_visibleIndexes.clear();
+			return false;
+		}
+	}
+
+	for (unsigned k=0; k<chunks; ++k)
+	{
+		VisibleIndexesChunk& chunk = m_visibleIndexes[k];
+		if (chunk.upToDate)
+			continue;
+
+		unsigned chunkSize = m_pointsVisibility->chunkSize(k);
+		chunk.visibleCount = ComputeVisibleIndexes(m_pointsVisibility->chunkStartPtr(k),chunkSize,s_indexBuffer);
+
+		if (chunk.visibleCount == 0 || chunk.visibleCount == chunkSize)
+		{
+			//no need for indexes
+			std::vector<unsigned short>().swap(chunk.indexes);
+		}
+		else
+		{
+			try
+			{
+				chunk.indexes.assign(s_indexBuffer,s_indexBuffer+chunk.visibleCount);
+			}
+			catch (.../*const std::bad_alloc&*/) //out of memory
+			{
+				m_visibleIndexes.clear();
+				return false;
+			}
+		}
+		chunk.upToDate = true;
+	}
+
+	return true;
+}
+
 void ccPointCloud::getDrawingParameters(glDrawParams& params) const
 {
     //color override
@@ -1289,6 +1478,8 @@ static PointCoordinateType s_normBuffer[MAX_NUMBER_OF_ELEMENTS_PER_CHUNK*3];
 static colorType s_rgbBuffer3ub[MAX_NUMBER_OF_ELEMENTS_PER_CHUNK*3];
 static float s_rgbBuffer3f[MAX_NUMBER_OF_ELEMENTS_PER_CHUNK*3];
 static float s_colormapf[glDrawContext::MAX_SHADER_COLOR_RAMP_SIZE];
+static PointCoordinateType s_pointBuffer[MAX_NUMBER_OF_ELEMENTS_PER_CHUNK*3];
+static std::vector<ccPointCloudLOD::SelectedNode> s_lodSelection;
 
 //helpers (for ColorRamp shader)
 
@@ -1386,10 +1577,12 @@ void ccPointCloud::drawMeOnly(CC_DRAW_CONTEXT& context)
         // L.O.D.
 		unsigned numberOfPoints = size();
         unsigned decimStep = 1;
-        if (numberOfPoints>MAX_LOD_POINTS_NUMBER && context.decimateCloudOnMove &&  MACRO_LODActivated(context))
-        {
-            decimStep = int(ceil(float(numberOfPoints) / float(MAX_LOD_POINTS_NUMBER)));
-        }
+		bool useLOD = false;
+		if (numberOfPoints>MAX_LOD_POINTS_NUMBER && context.decimateCloudOnMove)
+		{
+			//the hierarchical L.O.D. structure is computed in background (as soon as the cloud is displayed)
+			initLOD();
+		}
 
         /*** DISPLAY ***/
 
@@ -1398,11 +1591,227 @@ void ccPointCloud::drawMeOnly(CC_DRAW_CONTEXT& context)
 		if (m_pointSize != 0)
 			glPointSize((GLfloat)m_pointSize);
 
+        if (numberOfPoints>MAX_LOD_POINTS_NUMBER && context.decimateCloudOnMove &&  MACRO_LODActivated(context))
+        {
+			//if the L.O.D. structure is ready (and all points are visible) we only display the
+			//nodes inside the frustum, with a density depending on their size on screen
+			if (!pushPointNames && !isVisibilityTableInstantiated() && m_lod && m_lod->isReady())
+			{
+				GLdouble modelViewMat[16],projectionMat[16];
+				GLint viewport[4];
+				GLfloat pointSize = 1.0f;
+				glGetDoublev(GL_MODELVIEW_MATRIX,modelViewMat);
+				glGetDoublev(GL_PROJECTION_MATRIX,projectionMat);
+				glGetIntegerv(GL_VIEWPORT,viewport);
+				glGetFloatv(GL_POINT_SIZE,&pointSize);
+
+				ccPointCloudLOD::ViewFrustum frustum;
+				if (ccPointCloudLOD::ComputeViewFrustum(modelViewMat,projectionMat,viewport,frustum))
+				{
+					try
+					{
+						m_lod->select(frustum,MAX_LOD_POINTS_NUMBER,pointSize,s_lodSelection);
+						useLOD = true;
+					}
+					catch (.../*const std::bad_alloc&*/) //out of memory
+					{
+						s_lodSelection.clear();
+					}
+				}
+			}
+
+			if (!useLOD)
+				decimStep = int(ceil(float(numberOfPoints) / float(MAX_LOD_POINTS_NUMBER)));
+        }
+
 		if (!pushPointNames) //standard "full" display
 		{
-			//if some points are hidden (= visibility table instantiated), we can't use display arrays :(
-			if (isVisibilityTableInstantiated())
+			if (useLOD) //hierarchical L.O.D. (no visibility table)
 			{
+				//the selected points are gathered (with their features) in temporary buffers
+				glEnableClientState(GL_VERTEX_ARRAY);
+				glVertexPointer(3,GL_FLOAT,0,s_pointBuffer);
+				if (glParams.showSF || glParams.showColors)
+				{
+					glEnableClientState(GL_COLOR_ARRAY);
+					glColorPointer(3,GL_UNSIGNED_BYTE,0,s_rgbBuffer3ub);
+				}
+				if (glParams.showNorms)
+				{
+					glEnableClientState(GL_NORMAL_ARRAY);
+					glNormalPointer(GL_FLOAT,0,s_normBuffer);
+				}
+
+				//cached SF colors (only if NaN values are shown in grey, as other points must be skipped)
+				const ccScalarField::ColorsArray* sfColors = 0;
+				if (glParams.showSF && m_currentDisplayedScalarField->areNaNValuesShownInGrey())
+					sfColors = m_currentDisplayedScalarField->getColors();
+
+				PointCoordinateType* _points = s_pointBuffer;
+				colorType* _colors = s_rgbBuffer3ub;
+				PointCoordinateType* _normals = s_normBuffer;
+				unsigned count = 0;
+
+				for (size_t n=0; n<s_lodSelection.size(); ++n)
+				{
+					const ccPointCloudLOD::SelectedNode& node = s_lodSelection[n];
+					for (unsigned i=0; i<node.displayedCount; ++i)
+					{
+						unsigned j = m_lod->getPointIndex(node,i);
+
+						if (glParams.showSF)
+						{
+							const colorType* col = (sfColors ? sfColors->getValue(j) : m_currentDisplayedScalarField->getValueColor(j));
+							if (!col) //hidden point (NaN or out of the displayed range)
+								continue;
+							*_colors++ = *col++;
+							*_colors++ = *col++;
+							*_colors++ = *col++;
+						}
+						else if (glParams.showColors)
+						{
+							const colorType* col = m_rgbColors->getValue(j);
+							*_colors++ = *col++;
+							*_colors++ = *col++;
+							*_colors++ = *col++;
+						}
+
+						if (glParams.showNorms)
+						{
+							const PointCoordinateType* N = compressedNormals->getNormal(m_normals->getValue(j));
+							*_normals++ = *N++;
+							*_normals++ = *N++;
+							*_normals++ = *N++;
+						}
+
+						const PointCoordinateType* P = m_points->getValue(j);
+						*_points++ = *P++;
+						*_points++ = *P++;
+						*_points++ = *P++;
+
+						if (++count == MAX_NUMBER_OF_ELEMENTS_PER_CHUNK)
+						{
+							glDrawArrays(GL_POINTS,0,count);
+							_points = s_pointBuffer;
+							_colors = s_rgbBuffer3ub;
+							_normals = s_normBuffer;
+							count = 0;
+						}
+					}
+				}
+
+				if (count != 0)
+					glDrawArrays(GL_POINTS,0,count);
+
+				glDisableClientState(GL_VERTEX_ARRAY);
+				if (glParams.showSF || glParams.showColors)
+					glDisableClientState(GL_COLOR_ARRAY);
+				if (glParams.showNorms)
+					glDisableClientState(GL_NORMAL_ARRAY);
+			}
+			//if some points are hidden (= visibility table instantiated), we only display the visible ones
+			//(their indexes are only updated when the visibility table changes)
+			else if (isVisibilityTableInstantiated() && updateVisibleIndexes())
+			{
+				//cached SF colors (NaN values are displayed in grey in any case, see below)
+				const ccScalarField::ColorsArray* sfColors = (glParams.showSF ? m_currentDisplayedScalarField->getColors() : 0);
+
+				glEnableClientState(GL_VERTEX_ARRAY);
+				if (glParams.showSF || glParams.showColors)
+					glEnableClientState(GL_COLOR_ARRAY);
+				if (glParams.showNorms)
+				{
+					glEnableClientState(GL_NORMAL_ARRAY);
+					glNormalPointer(GL_FLOAT,0,s_normBuffer);
+				}
+
+				unsigned chunks = m_points->chunksCount();
+				assert(m_visibleIndexes.size() == chunks);
+				for (unsigned k=0; k<chunks; ++k)
+				{
+					const VisibleIndexesChunk& chunk = m_visibleIndexes[k];
+					if (chunk.visibleCount == 0)
+						continue;
+
+					//no indexes if all the chunk points are visible
+					const unsigned short* indexes = (chunk.indexes.empty() ? 0 : &(chunk.indexes[0]));
+					unsigned count = chunk.visibleCount;
+
+					if (decimStep > 1)
+					{
+						//we only keep one visible point out of 'decimStep'
+						unsigned short* _indexes = s_indexBuffer;
+						for (unsigned i=0; i<count; i+=decimStep)
+							*_indexes++ = (indexes ? indexes[i] : static_cast<unsigned short>(i));
+						indexes = s_indexBuffer;
+						count = static_cast<unsigned>(_indexes-s_indexBuffer);
+					}
+
+					if (glParams.showSF)
+					{
+						if (sfColors)
+						{
+							//same chunks as the points
+							glColorPointer(3,GL_UNSIGNED_BYTE,0,sfColors->chunkStartPtr(k));
+						}
+						else
+						{
+							//we force display of points hidden because of their scalar field value
+							//to be sure that the user don't miss them (during manual segmentation for instance)
+							const ScalarType* _sf = m_currentDisplayedScalarField->chunkStartPtr(k);
+							for (unsigned i=0; i<count; ++i)
+							{
+								unsigned j = (indexes ? indexes[i] : i);
+								const colorType* col = m_currentDisplayedScalarField->getColor(_sf[j]);
+								if (!col)
+									col = ccColor::lightGrey;
+								colorType* _sfColor = s_rgbBuffer3ub+3*j;
+								*_sfColor++ = *col++;
+								*_sfColor++ = *col++;
+								*_sfColor++ = *col++;
+							}
+							glColorPointer(3,GL_UNSIGNED_BYTE,0,s_rgbBuffer3ub);
+						}
+					}
+					else if (glParams.showColors)
+					{
+						glColorPointer(3,GL_UNSIGNED_BYTE,0,m_rgbColors->chunkStartPtr(k));
+					}
+
+					if (glParams.showNorms)
+					{
+						//only the visible points normals are decompressed
+						const normsType* _normalsIndexes = m_normals->chunkStartPtr(k);
+						for (unsigned i=0; i<count; ++i)
+						{
+							unsigned j = (indexes ? indexes[i] : i);
+							const PointCoordinateType* N = compressedNormals->getNormal(_normalsIndexes[j]);
+							PointCoordinateType* _normal = s_normBuffer+3*j;
+							*_normal++ = *N++;
+							*_normal++ = *N++;
+							*_normal++ = *N++;
+						}
+					}
+
+					glVertexPointer(3,GL_FLOAT,0,m_points->chunkStartPtr(k));
+					if (indexes)
+						glDrawElements(GL_POINTS,count,GL_UNSIGNED_SHORT,indexes);
+					else
+						glDrawArrays(GL_POINTS,0,count);
+				}
+
+				glDisableClientState(GL_VERTEX_ARRAY);
+				if (glParams.showSF || glParams.showColors)
+					glDisableClientState(GL_COLOR_ARRAY);
+				if (glParams.showNorms)
+					glDisableClientState(GL_NORMAL_ARRAY);
+			}
+			//fallback (e.g. not enough memory for the visible points indexes)
+			else if (isVisibilityTableInstantiated())
+			{
+				//cached SF colors (NaN values are displayed in grey in any case, see below)
+				const ccScalarField::ColorsArray* sfColors = (glParams.showSF ? m_currentDisplayedScalarField->getColors() : 0);
+
 				glBegin(GL_POINTS);
 
 				for (unsigned j=0;j<numberOfPoints;j+=decimStep)
@@ -1413,10 +1822,17 @@ void ccPointCloud::drawMeOnly(CC_DRAW_CONTEXT& context)
 						assert(j<m_currentDisplayedScalarField->currentSize());
 						if (glParams.showSF)
 						{
-							const colorType* col = m_currentDisplayedScalarField->getValueColor(j);
 							//we force display of points hidden because of their scalar field value
 							//to be sure that the user don't miss them (during manual segmentation for instance)
-							glColor3ubv(col ? col : ccColor::lightGrey);
+							if (sfColors)
+							{
+								glColor3ubv(sfColors->getValue(j));
+							}
+							else
+							{
+								const colorType* col = m_currentDisplayedScalarField->getValueColor(j);
+								glColor3ubv(col ? col : ccColor::lightGrey);
+							}
 						}
 						else if (glParams.showColors)
 						{
@@ -1550,9 +1966,13 @@ void ccPointCloud::drawMeOnly(CC_DRAW_CONTEXT& context)
 					glEnableClientState(GL_VERTEX_ARRAY);
 					glEnableClientState(GL_COLOR_ARRAY);
 
+					//cached SF colors (only updated when the SF or its display parameters change)
+					const ccScalarField::ColorsArray* sfColors = (colorRampShader ? 0 : m_currentDisplayedScalarField->getColors());
+					assert(!sfColors || sfColors->currentSize() >= numberOfPoints);
+
 					if (colorRampShader)
 						glColorPointer(3,GL_FLOAT,0,s_rgbBuffer3f);
-					else
+					else if (!sfColors)
 						glColorPointer(3,GL_UNSIGNED_BYTE,0,s_rgbBuffer3ub);
 
 					if (glParams.showNorms)
@@ -1593,6 +2013,11 @@ void ccPointCloud::drawMeOnly(CC_DRAW_CONTEXT& context)
 								}
 							}
 						}
+						else if (sfColors)
+						{
+							//same chunks as the points
+							glColorPointer(3,GL_UNSIGNED_BYTE,decimStep*3*sizeof(colorType),sfColors->chunkStartPtr(k));
+						}
 						else
 						{
 							colorType* _sfColors = s_rgbBuffer3ub;
@@ -1966,6 +2391,7 @@ void ccPointCloud::hidePointsByScalarValue(ScalarType minVal, ScalarType maxVal)
         if (val<minVal || val>maxVal || val != val) //handle NaN values!
             m_pointsVisibility->setValue(i,POINT_HIDDEN);
     }
+	visibilityArrayChanged();
 }
 
 ccGenericPointCloud* ccPointCloud::createNewCloudFromVisibilitySelection(bool removeSelectedPoints)
@@ -2057,9 +2483,25 @@ int ccPointCloud::getCurrentDisplayedScalarFieldIndex() const
 
 void ccPointCloud::setCurrentDisplayedScalarField(int index)
 {
+	ccScalarField* previousSF = m_currentDisplayedScalarField;
+
     m_currentDisplayedScalarFieldIndex=index;
     m_currentDisplayedScalarField=static_cast<ccScalarField*>(getScalarField(index));
 
+	//the previously displayed SF doesn't need its colors cache anymore
+	//(we only release it if the SF still belongs to this cloud, as it may have been deleted)
+	if (previousSF && previousSF != m_currentDisplayedScalarField)
+	{
+		for (unsigned i=0; i<getNumberOfScalarFields(); ++i)
+		{
+			if (getScalarField(i) == previousSF)
+			{
+				previousSF->invalidateColors();
+				break;
+			}
+		}
+	}
+
 	if (m_currentDisplayedScalarFieldIndex>=0 && m_currentDisplayedScalarField)
 		setCurrentOutScalarField(m_currentDisplayedScalarFieldIndex);
 }
@@ -2136,6 +2578,8 @@ void ccPointCloud::unrollOnCylinder(double radius, CCVector3* center, int dim, C
     uchar dim1 = (dim>0 ? dim-1 : 2);
     uchar dim2 = (dim<2 ? dim+1 : 0);
 
+	clearLOD();
+
 	unsigned numberOfPoints=size();
     float percent = 0.0;
     float percentAdd = 1.0;
@@ -2227,6 +2671,8 @@ void ccPointCloud::unrollOnCone(double baseRadius, double alpha, const CCVector3
     uchar dim1 = (dim>0 ? dim-1 : 2);
     uchar dim2 = (dim<2 ? dim+1 : 0);
 
+	clearLOD();
+
 	unsigned numberOfPoints=size();
 	CCLib::NormalizedProgress* nprogress=0;
     if (progressCb)
@@ -30,8 +30,12 @@
 
 #include "ccGenericPointCloud.h"
 
+//system
+#include <vector>
+
 class ccPointCloud;
 class ccScalarField;
+class ccPointCloudLOD;
 
 /***************************************************
 				ccPointCloud
@@ -446,6 +450,22 @@ public:
 	//! Returns pointer on compressed normals indexes table
 	NormsIndexesTableType* normals() const {return m_normals;}
 
+	//! Starts the computation of the hierarchical L.O.D. structure (in background)
+	/** Does nothing if the structure has already been computed (or is being computed),
+		unless the cloud has been modified since then (see getLastModificationTime).
+		It is used to display big clouds while the camera is moving (see MAX_LOD_POINTS_NUMBER).
+		\return false if the computation couldn't be started
+	**/
+	bool initLOD();
+
+	//! Clears the L.O.D. structure
+	/** Must be called before any change of the number or order of the points, as
+		the structure may be computed in background (the computation is canceled).
+		In-place modifications of the points positions only require a call to
+		updateModificationTime (the structure is then recomputed by initLOD).
+	**/
+	void clearLOD();
+
 protected:
 
 	//! Appends a cloud to this one
@@ -460,6 +480,16 @@ protected:
     //inherited from ChunkedPointCloud
 	virtual void swapPoints(unsigned firstIndex, unsigned secondIndex);
 
+	//inherited from ccGenericPointCloud
+	virtual void onVisibilityArrayChanged(unsigned firstIndex, unsigned lastIndex);
+
+	//! Updates the indexes of the visible points (only for the modified chunks)
+	/** See m_visibleIndexes.
+		\return false if the indexes couldn't be updated (not enough memory, or
+		visibility array not instantiated or not of the right size)
+	**/
+	bool updateVisibleIndexes();
+
     //! Colors
 	ColorsTableType* m_rgbColors;
 
@@ -474,6 +504,34 @@ protected:
 	//! Currently displayed scalar field index
 	int m_currentDisplayedScalarFieldIndex;
 
+	//! Hierarchical L.O.D. structure (for display)
+	ccPointCloudLOD* m_lod;
+	//! Cloud modification time when the L.O.D. structure has been computed (see getLastModificationTime)
+	int m_lodModificationTime;
+
+	//! Indexes of the visible points of a chunk (when the visibility array is instantiated)
+	struct VisibleIndexesChunk
+	{
+		//! Indexes of the visible points (relatively to the chunk start)
+		/** Empty if all (or none) of the chunk points are visible.
+		**/
+		std::vector<unsigned short> indexes;
+		//! Number of visible points
+		unsigned visibleCount;
+		//! Whether the indexes are up to date with the visibility array
+		bool upToDate;
+
+		//! Default constructor
+		VisibleIndexesChunk() : visibleCount(0), upToDate(false) {}
+	};
+
+	//! Per-chunk indexes of the visible points (for display)
+	/** Chunks are the same as the points ones (see GenericChunkedArray). They
+		are only updated when the visibility array changes (see
+		ccGenericPointCloud::visibilityArrayChanged).
+	**/
+	std::vector<VisibleIndexesChunk> m_visibleIndexes;
+
 private:
 
     //! Inits default parameters
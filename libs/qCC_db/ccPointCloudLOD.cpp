@@ -0,0 +1,417 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "ccPointCloudLOD.h"
+
+//CCLib
+#include <DgmOctree.h>
+
+//Qt
+#include <QtConcurrentRun>
+
+//System
+#include <algorithm>
+#include <queue>
+#include <math.h>
+#include <assert.h>
+
+//! Progress callback used to cancel a background computation
+class ccLODCancelCallback : public CCLib::GenericProgressCallback
+{
+public:
+
+	ccLODCancelCallback(QAtomicInt& cancelRequested) : m_cancelRequested(cancelRequested) {}
+
+	//inherited from GenericProgressCallback
+	virtual void reset() {}
+	virtual void update(float percent) {}
+	virtual void setMethodTitle(const char* methodTitle) {}
+	virtual void setInfo(const char* infoStr) {}
+	virtual void start() {}
+	virtual void stop() {}
+	virtual bool isCancelRequested() { return m_cancelRequested.fetchAndAddOrdered(0) != 0; }
+
+protected:
+
+	QAtomicInt& m_cancelRequested;
+};
+
+//! Compares a truncated cell code with the (truncated) code of an IndexAndCode structure
+struct TruncatedCodeComp
+{
+	TruncatedCodeComp(unsigned char bitShift) : shift(bitShift) {}
+
+	inline bool operator()(CCLib::DgmOctree::OctreeCellCodeType truncatedCode, const CCLib::DgmOctree::IndexAndCode& a) const
+	{
+		return truncatedCode < (a.theCode >> shift);
+	}
+
+	unsigned char shift;
+};
+
+ccPointCloudLOD::ccPointCloudLOD()
+	: m_state(NOT_BUILT)
+	, m_cancelRequested(0)
+{
+}
+
+ccPointCloudLOD::~ccPointCloudLOD()
+{
+	clear();
+}
+
+void ccPointCloudLOD::clear()
+{
+	if (m_future.isRunning())
+	{
+		m_cancelRequested.fetchAndStoreOrdered(1);
+		m_future.waitForFinished();
+	}
+	m_cancelRequested.fetchAndStoreOrdered(0);
+
+	m_nodes.clear();
+	m_indexes.clear();
+	m_state.fetchAndStoreOrdered(NOT_BUILT);
+}
+
+bool ccPointCloudLOD::build(CCLib::GenericIndexedCloudPersist* cloud, CCLib::GenericProgressCallback* progressCb/*=0*/)
+{
+	clear();
+
+	m_state.fetchAndStoreOrdered(BUILDING);
+	bool success = buildStructure(cloud,progressCb);
+	if (!success)
+	{
+		m_nodes.clear();
+		m_indexes.clear();
+	}
+	m_state.fetchAndStoreOrdered(success ? READY : BUILD_FAILED);
+
+	return success;
+}
+
+bool ccPointCloudLOD::startBuild(CCLib::GenericIndexedCloudPersist* cloud)
+{
+	if (!cloud)
+		return false;
+
+	clear();
+
+	m_state.fetchAndStoreOrdered(BUILDING);
+	m_future = QtConcurrent::run(this, &ccPointCloudLOD::buildInBackground, cloud);
+
+	return true;
+}
+
+bool ccPointCloudLOD::buildInBackground(CCLib::GenericIndexedCloudPersist* cloud)
+{
+	ccLODCancelCallback cancelCb(m_cancelRequested);
+	bool success = buildStructure(cloud,&cancelCb);
+	if (!success)
+	{
+		m_nodes.clear();
+		m_indexes.clear();
+	}
+	m_state.fetchAndStoreOrdered(success ? READY : BUILD_FAILED);
+
+	return success;
+}
+
+bool ccPointCloudLOD::buildStructure(CCLib::GenericIndexedCloudPersist* cloud, CCLib::GenericProgressCallback* progressCb)
+{
+	assert(cloud);
+	if (!cloud || cloud->size() == 0)
+		return false;
+
+	CCLib::DgmOctree octree(cloud);
+	if (octree.build(progressCb) <= 0)
+		return false;
+
+	//the octree points are sorted by cell codes: all the points of a given cell are contiguous
+	const CCLib::DgmOctree::cellsContainer& codes = octree.pointsAndTheirCellCodes();
+	unsigned count = static_cast<unsigned>(codes.size());
+	if (count == 0)
+		return false;
+
+	const int maxLevel = CCLib::DgmOctree::MAX_OCTREE_LEVEL;
+	const PointCoordinateType radiusCoef = static_cast<PointCoordinateType>(sqrt(3.0)/2.0);
+
+	try
+	{
+		m_indexes.resize(count);
+		for (unsigned i=0; i<count; ++i)
+			m_indexes[i] = codes[i].theIndex;
+
+		//root node
+		Node root;
+		root.firstIndex = 0;
+		root.pointCount = count;
+		root.representativeCount = 0;
+		root.firstChild = 0;
+		root.childCount = 0;
+		root.level = 0;
+		m_nodes.push_back(root);
+
+		//the nodes are created level by level (breadth first)
+		for (size_t n=0; n<m_nodes.size(); ++n)
+		{
+			if (progressCb && progressCb->isCancelRequested())
+				return false;
+
+			Node node = m_nodes[n];
+			CCLib::DgmOctree::cellsContainer::const_iterator begin = codes.begin() + node.firstIndex;
+			CCLib::DgmOctree::cellsContainer::const_iterator end = begin + node.pointCount;
+
+			//cell center and bounding sphere
+			octree.computeCellCenter(begin->theCode,node.level,node.center);
+			node.radius = octree.getCellSize(node.level) * radiusCoef;
+
+			//representatives: one per non empty sub-cell
+			{
+				unsigned char repShift = GET_BIT_SHIFT(std::min<int>(node.level+REPRESENTATIVE_DEPTH,maxLevel));
+				CCLib::DgmOctree::OctreeCellCodeType previousCode = (begin->theCode >> repShift);
+				node.representativeCount = 1;
+				for (CCLib::DgmOctree::cellsContainer::const_iterator it=begin+1; it!=end; ++it)
+				{
+					CCLib::DgmOctree::OctreeCellCodeType truncatedCode = (it->theCode >> repShift);
+					if (truncatedCode != previousCode)
+					{
+						++node.representativeCount;
+						previousCode = truncatedCode;
+					}
+				}
+			}
+
+			//subdivision
+			if (node.pointCount > MAX_POINTS_PER_LEAF && node.level < maxLevel)
+			{
+				unsigned char childLevel = node.level+1;
+				TruncatedCodeComp comp(GET_BIT_SHIFT(childLevel));
+
+				node.firstChild = static_cast<unsigned>(m_nodes.size());
+				CCLib::DgmOctree::cellsContainer::const_iterator it = begin;
+				while (it != end)
+				{
+					CCLib::DgmOctree::cellsContainer::const_iterator next = std::upper_bound(it,end,it->theCode >> comp.shift,comp);
+
+					Node child;
+					child.firstIndex = static_cast<unsigned>(it - codes.begin());
+					child.pointCount = static_cast<unsigned>(next - it);
+					child.representativeCount = 0;
+					child.firstChild = 0;
+					child.childCount = 0;
+					child.level = childLevel;
+					m_nodes.push_back(child);
+					++node.childCount;
+
+					it = next;
+				}
+			}
+
+			m_nodes[n] = node;
+		}
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		m_nodes.clear();
+		m_indexes.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool ccPointCloudLOD::ComputeViewFrustum(	const double modelViewMat[16],
+											const double projectionMat[16],
+											const int viewport[4],
+											ViewFrustum& frustum)
+{
+	//clip coordinates transformation: P * MV (column major)
+	double M[16];
+	for (int c=0; c<4; ++c)
+		for (int r=0; r<4; ++r)
+			M[(c<<2)+r] =	projectionMat[r]    * modelViewMat[(c<<2)]
+						+	projectionMat[4+r]  * modelViewMat[(c<<2)+1]
+						+	projectionMat[8+r]  * modelViewMat[(c<<2)+2]
+						+	projectionMat[12+r] * modelViewMat[(c<<2)+3];
+
+	//frustum planes: w+x, w-x, w+y, w-y, w+z, w-z >= 0
+	for (int i=0; i<6; ++i)
+	{
+		int row = (i>>1);
+		double sign = ((i & 1) ? -1.0 : 1.0);
+		double* plane = frustum.planes[i];
+		for (int c=0; c<4; ++c)
+			plane[c] = M[(c<<2)+3] + sign * M[(c<<2)+row];
+
+		double norm = sqrt(plane[0]*plane[0] + plane[1]*plane[1] + plane[2]*plane[2]);
+		if (norm < 1.0e-12)
+			return false;
+		for (int c=0; c<4; ++c)
+			plane[c] /= norm;
+	}
+
+	//model view scale (the cloud units may differ from the eye ones)
+	double scale = sqrt(	modelViewMat[0]*modelViewMat[0]
+						+	modelViewMat[1]*modelViewMat[1]
+						+	modelViewMat[2]*modelViewMat[2]);
+	if (scale < 1.0e-12)
+		return false;
+
+	//depth = -Z (eye coordinates), expressed in the cloud units
+	for (int c=0; c<4; ++c)
+		frustum.depthEquation[c] = -modelViewMat[(c<<2)+2] / scale;
+
+	frustum.perspective = (projectionMat[11] != 0.0);
+	frustum.pixelScale = projectionMat[5] * static_cast<double>(viewport[3]) / 2.0;
+	if (!frustum.perspective)
+		frustum.pixelScale *= scale;
+
+	return true;
+}
+
+bool ccPointCloudLOD::TestNode(const Node& node, const ViewFrustum& frustum, double& projectedRadius)
+{
+	const double radius = static_cast<double>(node.radius);
+
+	for (int i=0; i<6; ++i)
+	{
+		const double* plane = frustum.planes[i];
+		double dist = plane[0]*node.center[0] + plane[1]*node.center[1] + plane[2]*node.center[2] + plane[3];
+		if (dist < -radius)
+			return false;
+	}
+
+	if (frustum.perspective)
+	{
+		const double* D = frustum.depthEquation;
+		double nearestDepth = D[0]*node.center[0] + D[1]*node.center[1] + D[2]*node.center[2] + D[3] - radius;
+		//the camera is inside (or very close to) the node bounding sphere
+		if (nearestDepth <= radius * 1.0e-3)
+			nearestDepth = radius * 1.0e-3;
+		projectedRadius = radius * frustum.pixelScale / nearestDepth;
+	}
+	else
+	{
+		projectedRadius = radius * frustum.pixelScale;
+	}
+
+	return true;
+}
+
+//! Node waiting for refinement (see ccPointCloudLOD::select)
+struct LODCandidate
+{
+	unsigned nodeIndex;
+	double projectedRadius;
+
+	LODCandidate(unsigned index, double radius) : nodeIndex(index), projectedRadius(radius) {}
+
+	//! The largest nodes (on screen) are refined first
+	inline bool operator<(const LODCandidate& other) const { return projectedRadius < other.projectedRadius; }
+};
+
+unsigned ccPointCloudLOD::select(	const ViewFrustum& frustum,
+									unsigned pointBudget,
+									float pointSize,
+									std::vector<SelectedNode>& selection) const
+{
+	selection.clear();
+
+	if (!isReady() || m_nodes.empty() || pointBudget == 0)
+		return 0;
+
+	//size of a node on screen divided by the size of its representatives sub-cells
+	const double subCellsRatio = 2.0 / (sqrt(3.0) * static_cast<double>(1 << REPRESENTATIVE_DEPTH));
+	if (pointSize < 1.0f)
+		pointSize = 1.0f;
+
+	double projectedRadius = 0;
+	if (!TestNode(m_nodes.front(),frustum,projectedRadius))
+		return 0;
+
+	const Node& root = m_nodes.front();
+	if (root.representativeCount >= pointBudget)
+	{
+		//not even enough points to represent the root node
+		SelectedNode selected = { root.firstIndex, root.pointCount, pointBudget };
+		selection.push_back(selected);
+		return pointBudget;
+	}
+
+	std::priority_queue<LODCandidate> candidates;
+	candidates.push(LODCandidate(0,projectedRadius));
+	unsigned totalCount = root.representativeCount;
+
+	while (!candidates.empty())
+	{
+		LODCandidate candidate = candidates.top();
+		candidates.pop();
+		const Node& node = m_nodes[candidate.nodeIndex];
+
+		//the node representatives are too sparse on screen: we try to refine it
+		if (	node.representativeCount < node.pointCount
+			&&	candidate.projectedRadius * subCellsRatio > static_cast<double>(pointSize))
+		{
+			if (node.childCount == 0)
+			{
+				//leaf: we display all its points
+				if (totalCount - node.representativeCount + node.pointCount <= pointBudget)
+				{
+					totalCount += node.pointCount - node.representativeCount;
+					SelectedNode selected = { node.firstIndex, node.pointCount, node.pointCount };
+					selection.push_back(selected);
+					continue;
+				}
+			}
+			else
+			{
+				//we replace the node by its visible children
+				LODCandidate visibleChildren[8] = {	LODCandidate(0,0), LODCandidate(0,0), LODCandidate(0,0), LODCandidate(0,0),
+													LODCandidate(0,0), LODCandidate(0,0), LODCandidate(0,0), LODCandidate(0,0) };
+				unsigned visibleCount = 0;
+				unsigned childrenCount = 0;
+				for (unsigned i=0; i<node.childCount; ++i)
+				{
+					unsigned childIndex = node.firstChild + i;
+					const Node& child = m_nodes[childIndex];
+					double childRadius = 0;
+					if (TestNode(child,frustum,childRadius))
+					{
+						visibleChildren[visibleCount++] = LODCandidate(childIndex,childRadius);
+						childrenCount += child.representativeCount;
+					}
+				}
+
+				if (totalCount - node.representativeCount + childrenCount <= pointBudget)
+				{
+					totalCount += childrenCount;
+					totalCount -= node.representativeCount;
+					for (unsigned i=0; i<visibleCount; ++i)
+						candidates.push(visibleChildren[i]);
+					continue;
+				}
+			}
+		}
+
+		//the node is displayed with its representatives only
+		SelectedNode selected = { node.firstIndex, node.pointCount, node.representativeCount };
+		selection.push_back(selected);
+	}
+
+	return totalCount;
+}
@@ -0,0 +1,214 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_POINT_CLOUD_LOD_HEADER
+#define CC_POINT_CLOUD_LOD_HEADER
+
+//CCLib
+#include <CCTypes.h>
+#include <GenericIndexedCloudPersist.h>
+#include <GenericProgressCallback.h>
+
+//Qt
+#include <QAtomicInt>
+#include <QFuture>
+
+//system
+#include <vector>
+
+//! Multi-resolution structure for the display of big point clouds (L.O.D.)
+/** The points are sorted in the order of their octree cell codes, so that the
+	points of any octree cell are contiguous in this permutation. A (sparse)
+	tree of nodes is built over it: each node corresponds to a non empty
+	octree cell and stores a 'representative' count, i.e. the number of points
+	that is sufficient to display it when it appears small on screen (one per
+	non empty sub-cell, REPRESENTATIVE_DEPTH levels below).
+	At display time, the nodes are selected by frustum culling and projected
+	size, under a given point budget (see ccPointCloudLOD::select). Nothing
+	here requires an OpenGL context.
+**/
+#ifdef QCC_DB_USE_AS_DLL
+#include "qCC_db_dll.h"
+class QCC_DB_DLL_API ccPointCloudLOD
+#else
+class ccPointCloudLOD
+#endif
+{
+public:
+
+	//! Max number of points in a leaf node
+	static const unsigned MAX_POINTS_PER_LEAF = 256;
+
+	//! Number of levels between a node and the sub-cells its representatives are taken from
+	static const unsigned char REPRESENTATIVE_DEPTH = 3;
+
+	//! Tree node
+	struct Node
+	{
+		//! Index of the first point of the node in the permutation (see getPointIndex)
+		unsigned firstIndex;
+		//! Number of points in the node
+		unsigned pointCount;
+		//! Number of points sufficient to represent the node when seen from 'far'
+		unsigned representativeCount;
+		//! Index of the first child node (children are contiguous)
+		unsigned firstChild;
+		//! Number of children (0 for leaves)
+		unsigned char childCount;
+		//! Octree level of the node
+		unsigned char level;
+		//! Node (cell) center
+		PointCoordinateType center[3];
+		//! Node bounding sphere radius
+		PointCoordinateType radius;
+	};
+
+	//! View frustum (expressed in the cloud coordinate system)
+	struct ViewFrustum
+	{
+		//! Clipping planes (as [Nx Ny Nz d] with |N|=1: a point P is inside if N.P+d >= 0 for all planes)
+		double planes[6][4];
+		//! Depth equation (distance to the camera plane, in the cloud units)
+		double depthEquation[4];
+		//! Whether the projection is a perspective one
+		bool perspective;
+		//! Pixel scale (projected size in pixels = size*pixelScale, divided by the depth in perspective mode)
+		double pixelScale;
+	};
+
+	//! Selected node (see ccPointCloudLOD::select)
+	struct SelectedNode
+	{
+		//! Index of the first point of the node in the permutation
+		unsigned firstIndex;
+		//! Number of points in the node
+		unsigned pointCount;
+		//! Number of points to display (evenly spread in the node)
+		unsigned displayedCount;
+	};
+
+	//! Default constructor
+	ccPointCloudLOD();
+
+	//! Destructor
+	/** Waits for the end of the computation if it's still running in background.
+	**/
+	virtual ~ccPointCloudLOD();
+
+	//! Computes the structure (blocking)
+	/** \param cloud point cloud
+		\param progressCb progress callback (optional)
+		\return success
+	**/
+	bool build(CCLib::GenericIndexedCloudPersist* cloud, CCLib::GenericProgressCallback* progressCb=0);
+
+	//! Starts the computation of the structure in a separate thread
+	/** The cloud must not be modified before the end of the computation (see clear).
+		\param cloud point cloud
+		\return whether the computation has been started
+	**/
+	bool startBuild(CCLib::GenericIndexedCloudPersist* cloud);
+
+	//! Clears the structure
+	/** If the computation is running in background, it is canceled (and we wait for
+		the thread to stop).
+	**/
+	void clear();
+
+	//! Returns whether the structure is ready to be used
+	bool isReady() const { return const_cast<QAtomicInt&>(m_state).fetchAndAddOrdered(0) == READY; }
+
+	//! Returns whether the structure has not been computed yet (nor is being computed)
+	bool isNull() const { return const_cast<QAtomicInt&>(m_state).fetchAndAddOrdered(0) == NOT_BUILT; }
+
+	//! Returns the nodes (the root is the first one)
+	/** Warning: only valid if the structure is ready.
+	**/
+	const std::vector<Node>& nodes() const { return m_nodes; }
+
+	//! Returns the number of points in the structure
+	unsigned size() const { return static_cast<unsigned>(m_indexes.size()); }
+
+	//! Computes the view frustum from the OpenGL matrices
+	/** \param modelViewMat model view matrix (column major - see glGetDoublev)
+		\param projectionMat projection matrix (column major)
+		\param viewport viewport (x, y, width and height - see glGetIntegerv)
+		\param[out] frustum view frustum
+		\return false if the matrices are degenerate
+	**/
+	static bool ComputeViewFrustum(	const double modelViewMat[16],
+									const double projectionMat[16],
+									const int viewport[4],
+									ViewFrustum& frustum);
+
+	//! Selects the nodes to display
+	/** Nodes outside of the frustum are ignored. The others are refined (largest
+		projected size first) as long as their representatives appear more sparse
+		than the point size on screen, and as long as the total number of points
+		doesn't exceed the budget.
+		\param frustum view frustum
+		\param pointBudget max number of displayed points
+		\param pointSize point size (in pixels)
+		\param[out] selection selected nodes
+		\return total number of points to display
+	**/
+	unsigned select(const ViewFrustum& frustum,
+					unsigned pointBudget,
+					float pointSize,
+					std::vector<SelectedNode>& selection) const;
+
+	//! Returns the (cloud) index of the i-th point to display for a selected node
+	inline unsigned getPointIndex(const SelectedNode& node, unsigned i) const
+	{
+		if (node.displayedCount < node.pointCount)
+			i = static_cast<unsigned>((static_cast<double>(i) * node.pointCount) / node.displayedCount);
+		return m_indexes[node.firstIndex + i];
+	}
+
+protected:
+
+	//! Structure state
+	enum State { NOT_BUILT = 0, BUILDING = 1, READY = 2, BUILD_FAILED = 3 };
+
+	//! Computes the nodes and the permutation
+	bool buildStructure(CCLib::GenericIndexedCloudPersist* cloud, CCLib::GenericProgressCallback* progressCb);
+
+	//! Computation method run in background (see startBuild)
+	bool buildInBackground(CCLib::GenericIndexedCloudPersist* cloud);
+
+	//! Tests a node against a frustum
+	/** \param node node
+		\param frustum view frustum
+		\param[out] projectedRadius node radius once projected on screen (in pixels)
+		\return whether the node is (at least partially) inside the frustum
+	**/
+	static bool TestNode(const Node& node, const ViewFrustum& frustum, double& projectedRadius);
+
+	//! Nodes
+	std::vector<Node> m_nodes;
+	//! Points indexes (sorted by octree cell codes)
+	std::vector<unsigned> m_indexes;
+
+	//! State (see State)
+	QAtomicInt m_state;
+	//! Whether the computation should be canceled
+	QAtomicInt m_cancelRequested;
+	//! Background computation
+	QFuture<bool> m_future;
+};
+
+#endif //CC_POINT_CLOUD_LOD_HEADER
@@ -22,6 +22,12 @@
 
 //CCLib
 #include <CCConst.h>
+#include <CCTypes.h>
+
+//SSE instructions for the colors computation (see CC_USE_SSE_KERNELS in CCTypes.h)
+#ifdef CC_USE_SSE_KERNELS
+#include <emmintrin.h>
+#endif
 
 using namespace CCLib;
 
@@ -36,11 +42,19 @@ ccScalarField::ccScalarField(const char* name/*=0*/)
 	, m_alwaysShowZero(false)
 	, m_colorScale(0)
 	, m_colorRampSteps(256)
+	, m_colors(0)
 {
+	memset(&m_colorsParameters,0,sizeof(ColorsCacheParameters));
+
 	setColorRampSteps(ccColorScale::DEFAULT_STEPS);
 	setColorScale(ccColorScalesManager::GetUniqueInstance()->getDefaultScale(ccColorScalesManager::BGYR));
 }
 
+ccScalarField::~ccScalarField()
+{
+	invalidateColors();
+}
+
 ScalarType ccScalarField::normalize(ScalarType d) const
 {
 	if (/*!ValidValue(d) || */!m_displayRange.isInRange(d)) //NaN values are also rejected by 'isInRange'!
@@ -131,6 +145,9 @@ void ccScalarField::setLogScale(bool state)
 
 void ccScalarField::computeMinAndMax()
 {
+	//values have (potentially) changed
+	invalidateColors();
+
 	ScalarField::computeMinAndMax();
 
 	m_displayRange.setBounds(m_minVal,m_maxVal);
@@ -266,6 +283,190 @@ void ccScalarField::setColorRampSteps(unsigned steps)
         m_colorRampSteps = steps;
 }
 
+bool ccScalarField::ColorsCacheParameters::operator==(const ColorsCacheParameters& p) const
+{
+	return	displayStart			== p.displayStart
+		&&	displayStop				== p.displayStop
+		&&	saturationStart			== p.saturationStart
+		&&	saturationStop			== p.saturationStop
+		&&	symmetricalScale		== p.symmetricalScale
+		&&	logScale				== p.logScale
+		&&	colorRampSteps			== p.colorRampSteps
+		&&	colorScale				== p.colorScale
+		&&	colorScaleUpdateCount	== p.colorScaleUpdateCount
+		&&	count					== p.count;
+}
+
+ccScalarField::ColorsCacheParameters ccScalarField::getColorsCacheParameters() const
+{
+	ColorsCacheParameters params;
+
+	params.displayStart = m_displayRange.start();
+	params.displayStop = m_displayRange.stop();
+	params.saturationStart = saturationRange().start();
+	params.saturationStop = saturationRange().stop();
+	params.symmetricalScale = m_symmetricalScale;
+	params.logScale = m_logScale;
+	params.colorRampSteps = m_colorRampSteps;
+	params.colorScale = m_colorScale.data();
+	params.colorScaleUpdateCount = (m_colorScale ? m_colorScale->updateCount() : 0);
+	params.count = currentSize();
+
+	return params;
+}
+
+void ccScalarField::invalidateColors()
+{
+	if (m_colors)
+		m_colors->release();
+	m_colors = 0;
+}
+
+#ifdef CC_USE_SSE_KERNELS
+//! Computes the colors of a set of values (linear scales only)
+/** Same results as ccScalarField::getColor (see ccScalarField::normalize and
+	ccColorScale::getColorByRelativePos) but 4 values are processed at once.
+	\param sf scalar field (for display parameters)
+	\param values scalar values
+	\param count number of values
+	\param palette colors corresponding to each color ramp step
+	\param[out] colors RGB colors
+	\return number of processed values (a multiple of 4)
+**/
+static unsigned ComputeLinearScaleColors(const ccScalarField* sf, const ScalarType* values, unsigned count, const colorType* palette, colorType* colors)
+{
+	assert(!sf->logScale());
+
+	const ccScalarField::Range& displayRange = sf->displayRange();
+	const ccScalarField::Range& saturationRange = sf->saturationRange();
+
+	const __m128 displayStart = _mm_set1_ps(displayRange.start());
+	const __m128 displayStop = _mm_set1_ps(displayRange.stop());
+	const __m128 satStart = _mm_set1_ps(saturationRange.start());
+	const __m128 satStop = _mm_set1_ps(saturationRange.stop());
+	const __m128 satRange = _mm_set1_ps(saturationRange.range());
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128d steps = _mm_set1_pd(static_cast<double>(sf->getColorRampSteps()));
+	const __m128d quantization = _mm_set1_pd(65535.0);
+	const bool symmetricalScale = sf->symmetricalScale();
+
+	unsigned processed = (count & (~3));
+	int indexes[4];
+	for (unsigned i=0; i<processed; i+=4, values+=4)
+	{
+		__m128 v = _mm_loadu_ps(values);
+
+		//displayed values (NaN values are also rejected)
+		int displayed = _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(v,displayStart),_mm_cmple_ps(v,displayStop)));
+
+		//relative position in the color scale
+		__m128 relPos;
+		if (!symmetricalScale)
+		{
+			relPos = _mm_div_ps(_mm_sub_ps(v,satStart),satRange);
+			__m128 above = _mm_cmpge_ps(v,satStop);
+			relPos = _mm_or_ps(_mm_and_ps(above,one),_mm_andnot_ps(above,relPos));
+			relPos = _mm_andnot_ps(_mm_cmple_ps(v,satStart),relPos);
+		}
+		else
+		{
+			__m128 sign = _mm_and_ps(v,signMask);
+			__m128 absV = _mm_andnot_ps(signMask,v);
+			//(1 + (v-start)/range)/2 for positive values, (1 + (v+start)/range)/2 for negative ones
+			relPos = _mm_div_ps(_mm_sub_ps(absV,satStart),satRange);
+			relPos = _mm_mul_ps(_mm_add_ps(one,_mm_xor_ps(relPos,sign)),half);
+			__m128 above = _mm_cmpge_ps(v,satStop);
+			relPos = _mm_or_ps(_mm_and_ps(above,one),_mm_andnot_ps(above,relPos));
+			relPos = _mm_andnot_ps(_mm_cmple_ps(v,_mm_xor_ps(satStop,signMask)),relPos);
+			__m128 inside = _mm_cmple_ps(absV,satStart);
+			relPos = _mm_or_ps(_mm_and_ps(inside,half),_mm_andnot_ps(inside,relPos));
+		}
+
+		//color ramp step (16 bits quantization, in double precision as ccColorScale::getColorByRelativePos)
+		__m128d lo = _mm_mul_pd(_mm_mul_pd(_mm_cvtps_pd(relPos),steps),quantization);
+		__m128d hi = _mm_mul_pd(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(relPos,relPos)),steps),quantization);
+		__m128i index = _mm_unpacklo_epi64(_mm_cvttpd_epi32(lo),_mm_cvttpd_epi32(hi));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(indexes),_mm_srli_epi32(index,16));
+
+		for (unsigned j=0; j<4; ++j)
+		{
+			const colorType* col = ((displayed >> j) & 1) ? palette + 3*indexes[j] : ccColor::lightGrey;
+			*colors++ = col[0];
+			*colors++ = col[1];
+			*colors++ = col[2];
+		}
+	}
+
+	return processed;
+}
+#endif
+
+const ccScalarField::ColorsArray* ccScalarField::getColors()
+{
+	assert(m_colorScale);
+	if (!m_colorScale)
+		return 0;
+
+	ColorsCacheParameters params = getColorsCacheParameters();
+	if (m_colors && m_colorsParameters == params)
+		return m_colors;
+
+	if (!m_colors)
+	{
+		m_colors = new ColorsArray();
+		m_colors->link();
+	}
+	if (m_colors->currentSize() != params.count && !m_colors->resize(params.count))
+	{
+		//not enough memory
+		invalidateColors();
+		return 0;
+	}
+
+	//colors of each color ramp step (see ccColorScale::getColorByRelativePos)
+	colorType palette[ccColorScale::MAX_STEPS*3];
+	for (unsigned i=0; i<m_colorRampSteps; ++i)
+	{
+		const colorType* col = m_colorScale->getColorByIndex((i*(ccColorScale::MAX_STEPS-1)) / (m_colorRampSteps-1));
+		palette[3*i  ] = col[0];
+		palette[3*i+1] = col[1];
+		palette[3*i+2] = col[2];
+	}
+
+	//both arrays have the same chunks
+	unsigned remaining = params.count;
+	for (unsigned k=0; k<chunksCount() && remaining!=0; ++k)
+	{
+		unsigned count = std::min(chunkSize(k),remaining);
+		const ScalarType* values = chunkStartPtr(k);
+		colorType* colors = m_colors->chunkStartPtr(k);
+
+		unsigned i = 0;
+#ifdef CC_USE_SSE_KERNELS
+		if (!m_logScale)
+			i = ComputeLinearScaleColors(this,values,count,palette,colors);
+#endif
+		//remaining values (or log scale)
+		for (; i<count; ++i)
+		{
+			const colorType* col = getColor(values[i]);
+			if (!col)
+				col = ccColor::lightGrey;
+			colors[3*i  ] = col[0];
+			colors[3*i+1] = col[1];
+			colors[3*i+2] = col[2];
+		}
+
+		remaining -= count;
+	}
+
+	m_colorsParameters = params;
+
+	return m_colors;
+}
+
 bool ccScalarField::toFile(QFile& out) const
 {
 	assert(out.isOpen() && (out.openMode() & QIODevice::WriteOnly));
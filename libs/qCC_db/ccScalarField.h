@@ -20,6 +20,7 @@
 
 //CCLib
 #include <ScalarField.h>
+#include <GenericChunkedArray.h>
 
 //qCC_db
 #include "ccSerializableObject.h"
@@ -144,6 +145,28 @@ public:
 	//! Shortcut to getColor
 	inline const colorType* getValueColor(unsigned index) const { return getColor(getValue(index)); }
 
+	//! Array of colors (same chunks as the scalar field)
+	typedef CCLib::GenericChunkedArray<3,colorType> ColorsArray;
+
+	//! Returns the colors of all values (wrt to the current display parameters)
+	/** Colors are kept in cache: they are only updated if the display parameters
+		(displayed and saturation ranges, color scale, etc.) have changed, or after a
+		call to computeMinAndMax (i.e. when the values have changed). Contrarily to
+		getColor, NaN or not displayed values always get the grey color.
+		The array has the same chunks as the scalar field (see chunkStartPtr).
+		Warning: values edited in place (setValue, etc.) are not tracked. The
+		caller must call computeMinAndMax (or invalidateColors) afterwards,
+		otherwise the cached colors are stale.
+		The cache (3 bytes per value) is released by the owner cloud when the
+		SF stops being the displayed one (see invalidateColors).
+		Warning: must no be called if the SF is not associated to a color scale!
+		\return colors array (or 0 if not enough memory)
+	**/
+	const ColorsArray* getColors();
+
+	//! Clears (and releases) the colors cache (see getColors)
+	void invalidateColors();
+
 	//! Sets whether NaN/out of displayed range values should be displayed in grey or hidden
 	inline void showNaNValuesInGrey(bool state) { m_showNaNValuesInGrey = state; }
 
@@ -210,7 +233,7 @@ protected:
 	//! Default destructor
 	/** [SHAREABLE] Call 'release' to destroy this object properly.
 	**/
-	virtual ~ccScalarField() {};
+	virtual ~ccScalarField();
 
 	//! Updates saturation values
 	void updateSaturationBounds();
@@ -256,6 +279,32 @@ protected:
 
 	//! Associated histogram values (for display)
 	Histogram m_histogram;
+
+	//! Display parameters used to compute the colors cache
+	struct ColorsCacheParameters
+	{
+		ScalarType displayStart;
+		ScalarType displayStop;
+		ScalarType saturationStart;
+		ScalarType saturationStop;
+		bool symmetricalScale;
+		bool logScale;
+		unsigned colorRampSteps;
+		const ccColorScale* colorScale;
+		unsigned colorScaleUpdateCount;
+		unsigned count;
+
+		bool operator==(const ColorsCacheParameters& p) const;
+	};
+
+	//! Returns the current display parameters (see getColors)
+	ColorsCacheParameters getColorsCacheParameters() const;
+
+	//! Colors cache (see getColors)
+	ColorsArray* m_colors;
+
+	//! Display parameters used to compute the colors cache
+	ColorsCacheParameters m_colorsParameters;
 };
 
 #endif //CC_DB_SCALAR_FIELD_HEADER
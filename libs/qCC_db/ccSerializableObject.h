@@ -23,10 +23,12 @@
 
 //CCLib
 #include <GenericChunkedArray.h>
+#include <ChunkAllocator.h>
 
 //System
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 
 //Qt
 #include <QFile>
@@ -85,6 +87,25 @@ class ccSerializationHelper
 {
 public:
 
+	//! Alignment of big arrays data in BIN files (dataVersion>=28)
+	/** So that each (full) chunk can be directly mapped in memory (see
+		ChunkAllocator::MapFileView). 64 KB is the allocation granularity
+		of file views on Windows (4 KB pages are enough elsewhere).
+	**/
+	static const unsigned ARRAY_DATA_ALIGNMENT = (1<<16);
+
+	//! Helper: returns the number of padding bytes before a big array data (dataVersion>=28)
+	/** \param pos current position in file
+		\param count array size
+	**/
+	static unsigned ArrayDataPadding(qint64 pos, unsigned count)
+	{
+		//only arrays with at least one full chunk are aligned
+		if (count < MAX_NUMBER_OF_ELEMENTS_PER_CHUNK)
+			return 0;
+		return (unsigned)((ARRAY_DATA_ALIGNMENT - (pos % ARRAY_DATA_ALIGNMENT)) % ARRAY_DATA_ALIGNMENT);
+	}
+
 	//! Helper: saves a GenericChunkedArray structure to file
 	/** \param chunkArray GenericChunkedArray structure to save (must be allocated)
 		\param out output file (must be already opened)
@@ -107,6 +128,16 @@ public:
 		if (out.write((const char*)&count,4)<0)
 			return ccSerializableObject::WriteError();
 
+		//padding (dataVersion>=28)
+		unsigned padding = ArrayDataPadding(out.pos(),count);
+		if (padding != 0)
+		{
+			char zeros[ARRAY_DATA_ALIGNMENT];
+			memset(zeros,0,padding);
+			if (out.write(zeros,padding)<0)
+				return ccSerializableObject::WriteError();
+		}
+
 		//array data (dataVersion>=20)
 		//--> we write each chunk as a block (faster)
 		while (count!=0)
@@ -126,7 +157,9 @@ public:
 	}
 
 	//! Helper: loads a GenericChunkedArray structure from file
-	/** \param chunkArray GenericChunkedArray structure to load
+	/** Since dataVersion>=28, full chunks are directly mapped in memory
+		(no copy, pages are loaded on demand) if possible.
+		\param chunkArray GenericChunkedArray structure to load
 		\param in input file (must be already opened)
 		\param dataVersion version current data version
 		\return success
@@ -150,13 +183,50 @@ public:
 		if (in.read((char*)&count,4)<0)
 			return ccSerializableObject::ReadError();
 
-		//try to allocate memory
+		chunkArray.clear();
+
+		//aligned full chunks (dataVersion>=28)
+		if (dataVersion>=28)
+		{
+			unsigned padding = ArrayDataPadding(in.pos(),count);
+			if (padding != 0 && !in.seek(in.pos()+padding))
+				return ccSerializableObject::ReadError();
+
+			const unsigned fullChunkCount = (unsigned)(count / MAX_NUMBER_OF_ELEMENTS_PER_CHUNK);
+			const qint64 chunkBytes = (qint64)MAX_NUMBER_OF_ELEMENTS_PER_CHUNK*N*sizeof(ElementType);
+			for (unsigned i=0;i<fullChunkCount;++i)
+			{
+				qint64 pos = in.pos();
+
+				//try to map the chunk directly
+				void* view = ChunkAllocator::MapFileView(in.handle(),(unsigned long long)pos,(size_t)chunkBytes);
+				if (view)
+				{
+					if (chunkArray.adoptChunk((ElementType*)view))
+					{
+						if (!in.seek(pos+chunkBytes))
+							return ccSerializableObject::ReadError();
+						continue;
+					}
+					ChunkAllocator::Release(view);
+				}
+
+				//otherwise we read it
+				if (!chunkArray.reserve(chunkArray.capacity()+MAX_NUMBER_OF_ELEMENTS_PER_CHUNK))
+					return ccSerializableObject::MemoryError();
+				if (in.read((char*)chunkArray.chunkStartPtr(chunkArray.chunksCount()-1),chunkBytes)<0)
+					return ccSerializableObject::ReadError();
+			}
+		}
+
+		//try to allocate memory (for the remaining elements)
+		unsigned firstChunkToRead = chunkArray.chunksCount();
 		if (!chunkArray.resize(count))
 			return ccSerializableObject::MemoryError();
 
 		//array data (dataVersion>=20)
 		//--> we read each chunk as a block (faster)
-		for (unsigned i=0;i<chunkArray.chunksCount();++i)
+		for (unsigned i=firstChunkToRead;i<chunkArray.chunksCount();++i)
 			if (in.read((char*)chunkArray.chunkStartPtr(i),sizeof(ElementType)*N*chunkArray.chunkSize(i))<0)
 				return ccSerializableObject::ReadError();
 
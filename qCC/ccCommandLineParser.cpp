@@ -8,10 +8,12 @@
 #include <ccGenericMesh.h>
 #include <ccProgressDialog.h>
 #include <Neighbourhood.h>
+#include <ChunkAllocator.h>
 
 //qCC
 #include "fileIO/FileIOFilter.h"
 #include "fileIO/BundlerFilter.h"
+#include "fileIO/LASFilter.h"
 #include <ui_commandLineDlg.h>
 #include "ccConsole.h"
 #include "mainwindow.h"
@@ -173,6 +175,73 @@ int ccCommandLineParser::parse(int nargs, char** args, bool silent, QDialog* dia
 			delete db;
 			db=0;
 		}
+		// "MEMORY_MAPPING" MEMORY-MAPPED CHUNKS (FOR THE NEXT OPENED/CREATED ENTITIES)
+		else if (argument == "-MEMORY_MAPPING")
+		{
+			if (++i==nargs)
+				return Error("Missing parameter: max resident memory (in MB) after \"-MEMORY_MAPPING\"");
+
+			bool paramOk=false;
+			int budget = QString(args[i]).toInt(&paramOk);
+			if (!paramOk || budget<0)
+				return Error(QString("Invalid parameter: max resident memory in MB (after \"-MEMORY_MAPPING\"). Got '%1' instead.").arg(args[i]));
+
+			if (!ChunkAllocator::EnableFileMapping(0,(size_t)budget << 20))
+				return Error("Failed to enable memory-mapped files!");
+			if (budget)
+				Print(QString("Memory-mapped files enabled (max resident memory: %1 MB)").arg(budget));
+			else
+				Print("Memory-mapped files enabled (no resident memory limit)");
+		}
+#ifdef CC_LAS_SUPPORT
+		// "LAS_SKIP" LAS ATTRIBUTE TO SKIP (FOR THE NEXT OPENED FILES)
+		else if (argument == "-LAS_SKIP")
+		{
+			if (++i==nargs)
+				return Error("Missing parameter: attribute after \"-LAS_SKIP\"");
+
+			QString attribute = QString(args[i]).toUpper();
+			LASFilter::LoadOptions options = LASFilter::GetLoadOptions();
+			if (attribute == "RGB")
+				options.loadColors = false;
+			else if (attribute == "INTENSITY")
+				options.loadIntensity = false;
+			else if (attribute == "CLASSIFICATION")
+				options.loadClassification = false;
+			else if (attribute == "TIME")
+				options.loadTime = false;
+			else if (attribute == "RETURN_NUMBER")
+				options.loadReturnNumber = false;
+			else
+				return Error(QString("Invalid attribute after \"-LAS_SKIP\". Got '%1' instead of RGB, INTENSITY, CLASSIFICATION, TIME or RETURN_NUMBER.").arg(attribute));
+			LASFilter::SetLoadOptions(options);
+			Print(QString("LAS attribute '%1' will be skipped").arg(attribute));
+		}
+		// "LAS_BOX" LAS BOX FILTER (FOR THE NEXT OPENED FILES)
+		else if (argument == "-LAS_BOX")
+		{
+			double values[6];
+			for (unsigned k=0;k<6;++k)
+			{
+				if (++i==nargs)
+					return Error("Missing parameter: box corners (Xmin Ymin Zmin Xmax Ymax Zmax) after \"-LAS_BOX\"");
+				bool paramOk=false;
+				values[k] = QString(args[i]).toDouble(&paramOk);
+				if (!paramOk)
+					return Error(QString("Failed to read a numerical parameter: box corner coordinate (after \"-LAS_BOX\"). Got '%1' instead.").arg(args[i]));
+			}
+
+			LASFilter::LoadOptions options = LASFilter::GetLoadOptions();
+			options.filterByBox = true;
+			for (unsigned k=0;k<3;++k)
+			{
+				options.boxMin[k] = values[k];
+				options.boxMax[k] = values[3+k];
+			}
+			LASFilter::SetLoadOptions(options);
+			Print(QString("LAS files will be filtered by box: (%1,%2,%3) - (%4,%5,%6)").arg(values[0]).arg(values[1]).arg(values[2]).arg(values[3]).arg(values[4]).arg(values[5]));
+		}
+#endif
 		// "SS" SUBSAMPLING
 		else if (argument == "-SS")
 		{
@@ -235,7 +304,7 @@ int ccCommandLineParser::parse(int nargs, char** args, bool silent, QDialog* dia
 					const QString& cloudFilename = m_clouds[i].filename;
 					Print(QString("\tProcessing cloud #%1 (%2)").arg(i+1).arg(!cloud->getName().isEmpty() ? cloud->getName() : "no name"));
 
-					CCLib::ReferenceCloud* refCloud = CCLib::CloudSamplingTools::resampleCloudSpatially(cloud,step,0,_progressDlg);
+					CCLib::ReferenceCloud* refCloud = CCLib::CloudSamplingTools::resampleCloudSpatiallyParallel(cloud,step,0,0,_progressDlg);
 					if (!refCloud)
 						return Error("Subsampling process failed!");
 					Print(QString("\tResult: %1 points").arg(refCloud->size()));
@@ -287,6 +356,51 @@ int ccCommandLineParser::parse(int nargs, char** args, bool silent, QDialog* dia
 				return Error("Unknown method!");
 			}
 		}
+		// "SOR" STATISTICAL OUTLIERS REMOVAL
+		else if (argument == "-SOR")
+		{
+			Print("[STATISTICAL OUTLIERS REMOVAL]");
+			if (m_clouds.empty())
+				return Error("No point cloud to filter! (be sure to open one with \"-O [cloud filename]\" before \"-SOR\")");
+
+			if (++i==nargs)
+				return Error("Missing parameter: number of neighbours after \"-SOR\"");
+
+			bool paramOk=false;
+			int knn = QString(args[i]).toInt(&paramOk);
+			if (!paramOk || knn<1)
+				return Error(QString("Invalid parameter: number of neighbours (after \"-SOR\"). Got '%1' instead.").arg(args[i]));
+			Print(QString("\tNumber of neighbours: %1").arg(knn));
+
+			if (++i==nargs)
+				return Error("Missing parameter: sigma multiplier after number of neighbours (SOR)");
+
+			double nSigma = QString(args[i]).toDouble(&paramOk);
+			if (!paramOk || nSigma<0.0)
+				return Error(QString("Invalid parameter: sigma multiplier (after number of neighbours). Got '%1' instead.").arg(args[i]));
+			Print(QString("\tSigma multiplier: %1").arg(nSigma));
+
+			for (unsigned i=0;i<m_clouds.size();++i)
+			{
+				ccPointCloud* cloud = m_clouds[i].pc;
+				const QString& cloudFilename = m_clouds[i].filename;
+				Print(QString("\tProcessing cloud #%1 (%2)").arg(i+1).arg(!cloud->getName().isEmpty() ? cloud->getName() : "no name"));
+
+				CCLib::ReferenceCloud* refCloud = CCLib::CloudSamplingTools::sorFilter(cloud,(unsigned)knn,nSigma,0,_progressDlg);
+				if (!refCloud)
+					return Error("SOR filter failed!");
+				Print(QString("\tResult: %1 points").arg(refCloud->size()));
+
+				//save output
+				ccPointCloud result(refCloud,cloud);
+				delete refCloud;
+				refCloud=0;
+				CloudDesc cloudDesc(&result,cloudFilename,m_clouds[i].indexInFile);
+				QString errorStr = Export2BIN(cloudDesc,"SOR");
+				if (!errorStr.isEmpty())
+					return Error(errorStr);
+			}
+		}
 		// "CURV" CURVATURE
 		else if (argument == "-CURV")
 		{
@@ -654,6 +654,18 @@ void ccComparisonDlg::compute()
 			refOctree);
 		break;
 	case CLOUDMESH_DIST: //cloud-mesh
+		if (useBVHCheckBox->isChecked())
+		{
+			//the mesh triangles are indexed by a BVH (no octree needed)
+			result = CCLib::DistanceComputationTools::computePointCloud2MeshDistanceWithBVH(compCloud,
+				refMesh,
+				maxSearchDist,
+				signedDistances,
+				flipNormals,
+				enableMT,
+				&progressCb);
+			break;
+		}
 		if (enableMT && maxSearchDistSpinBox->isEnabled())
 			ccConsole::Warning("[Cloud/Mesh comparison] Max search distance is not supported in multi-thread mode! Switching to single thread mode...");
 		result = CCLib::DistanceComputationTools::computePointCloud2MeshDistance(compCloud,
@@ -58,6 +58,9 @@ ccDisplayOptionsDlg::ccDisplayOptionsDlg(QWidget* parent) : QDialog(parent), Ui:
 	connect(labelsTransparencySpinBox, SIGNAL(valueChanged(int)), this, SLOT(changeLabelsTransparency(int)));
 	connect(labelMarkerSizeSpinBox, SIGNAL(valueChanged(int)), this, SLOT(changeLabelsMarkerSize(int)));
 
+	connect(memoryMappingCheckBox, SIGNAL(clicked()), this, SLOT(changeMemoryMapping()));
+	connect(memoryMappingBudgetSpinBox, SIGNAL(valueChanged(int)), this, SLOT(changeMemoryMappingBudget(int)));
+
 	connect(okButton, SIGNAL(clicked()), this, SLOT(doAccept()));
 	connect(applyButton, SIGNAL(clicked()), this, SLOT(apply()));
 	connect(resetButton, SIGNAL(clicked()), this, SLOT(reset()));
@@ -136,6 +139,10 @@ void ccDisplayOptionsDlg::refresh()
 	labelsTransparencySpinBox->setValue(parameters.labelsTransparency);
 	labelMarkerSizeSpinBox->setValue(parameters.pickedPointsSize);
 
+	memoryMappingCheckBox->setChecked(parameters.useMemoryMapping);
+	memoryMappingBudgetSpinBox->setValue(parameters.memoryMappingBudget);
+	memoryMappingBudgetSpinBox->setEnabled(parameters.useMemoryMapping);
+
 	update();
 }
 
@@ -406,6 +413,19 @@ void ccDisplayOptionsDlg::changeLabelsMarkerSize(int val)
 	parameters.pickedPointsSize = (unsigned)val;
 }
 
+void ccDisplayOptionsDlg::changeMemoryMapping()
+{
+	parameters.useMemoryMapping = memoryMappingCheckBox->isChecked();
+	memoryMappingBudgetSpinBox->setEnabled(parameters.useMemoryMapping);
+}
+
+void ccDisplayOptionsDlg::changeMemoryMappingBudget(int val)
+{
+	if (val<0)
+		return;
+	parameters.memoryMappingBudget = (unsigned)val;
+}
+
 void ccDisplayOptionsDlg::doReject()
 {
 	ccGui::Set(oldParameters);
@@ -76,6 +76,9 @@ protected slots:
 	void changeLabelsTransparency(int);
 	void changeLabelsMarkerSize(int);
 
+	void changeMemoryMapping();
+	void changeMemoryMappingBudget(int);
+
     void doAccept();
     void doReject();
     void apply();
@@ -32,20 +32,6 @@ ccFastMarchingForNormsDirection::ccFastMarchingForNormsDirection()
 {
 }
 
-bool ccFastMarchingForNormsDirection::instantiateGrid(unsigned size)
-{
-    assert(theGrid==0);
-
-	DirectionCell** _theGrid = new DirectionCell*[size];
-	if (!_theGrid)
-        return false;
-	memset(_theGrid,0,size*sizeof(DirectionCell*));
-
-	theGrid = (CCLib::FastMarching::Cell**)_theGrid;
-
-	return true;
-}
-
 int ccFastMarchingForNormsDirection::init(ccGenericPointCloud* aList,
                                             NormsIndexesTableType* theNorms,
                                             CCLib::DgmOctree* theOctree,
@@ -65,9 +51,6 @@ int ccFastMarchingForNormsDirection::init(ccGenericPointCloud* aList,
 		int cellPos[3];
 		theOctree->getCellPos(cellCodes.back(),level,cellPos,true);
 
-		//on renseigne la grille
-		unsigned gridPos = FM_pos2index(cellPos);
-
 		DirectionCell* aCell = new DirectionCell;
 		aCell->state = CCLib::FastMarching::Cell::FAR_CELL;
 		aCell->T = Cell::T_INF();
@@ -80,7 +63,17 @@ int ccFastMarchingForNormsDirection::init(ccGenericPointCloud* aList,
 		{
 			ccOctree::ComputeRobustAverageNorm(Yk,aList,aCell->N.u);
 			//Yk->clear(); //inutile
-			theGrid[gridPos] = (CCLib::FastMarching::Cell*)aCell;
+			//on renseigne la grille
+			if (!addCell(cellPos,aCell))
+			{
+				//not enough memory
+				delete aCell;
+				return -4;
+			}
+		}
+		else
+		{
+			delete aCell;
 		}
 
 		cellCodes.pop_back();
@@ -103,7 +96,7 @@ int ccFastMarchingForNormsDirection::step()
 
 	//printf("minTCellIndex=%i\n",minTCellIndex);
 
-	CCLib::FastMarching::Cell* minTCell =  theGrid[minTCellIndex];
+	CCLib::FastMarching::Cell* minTCell =  getCell(minTCellIndex);
 	assert(minTCell != NULL);
 
 	assert(minTCell->state != CCLib::FastMarching::Cell::ACTIVE_CELL);
@@ -119,9 +112,9 @@ int ccFastMarchingForNormsDirection::step()
 		//on doit rajouter ses voisines au groupe TRIAL
 		for (int i=0;i<CC_FM_NUMBER_OF_NEIGHBOURS;++i)
 		{
-         unsigned nIndex = minTCellIndex + neighboursIndexShift[i];
+         unsigned nIndex = getNeighbourIndex(minTCellIndex,i);
 			//pointeur vers la cellule voisine
-         CCLib::FastMarching::Cell* nCell = theGrid[nIndex];
+         CCLib::FastMarching::Cell* nCell = getCell(nIndex);
 
 			//si elle est definie
 			if (nCell)
@@ -142,18 +135,26 @@ int ccFastMarchingForNormsDirection::step()
 					float t_new = computeT(nIndex);
 
 					if (t_new<t_old)
-						nCell->T = t_new;
+						decreaseTrialCellT(nIndex,t_new);
 				}
 			}
 		}
 	}
+	else
+	{
+		//this cell is not reachable yet: it has been removed from the TRIAL
+		//cells list, so it can't keep the TRIAL state (its heap position is
+		//obsolete). As a FAR cell it will be added again if one of its
+		//neighbours becomes ACTIVE.
+		minTCell->state = CCLib::FastMarching::Cell::FAR_CELL;
+	}
 
 	return 1;
 }
 
 float ccFastMarchingForNormsDirection::computeT(unsigned index)
 {
-	DirectionCell* theCell = (DirectionCell*)theGrid[index];
+	DirectionCell* theCell = (DirectionCell*)getCell(index);
 
 	CCVector3& N = theCell->N;
 
@@ -168,7 +169,7 @@ float ccFastMarchingForNormsDirection::computeT(unsigned index)
 			Tzm=Cell::T_INF(),
 			Tzp=Cell::T_INF();
 
-	DirectionCell* nCell = (DirectionCell*)theGrid[index+neighboursIndexShift[1]];
+	DirectionCell* nCell = (DirectionCell*)getCell(getNeighbourIndex(index,1));
 	if (nCell)
 	{
 		Txp = nCell->T + neighboursDistance[1];
@@ -181,7 +182,7 @@ float ccFastMarchingForNormsDirection::computeT(unsigned index)
                 directionAgreements[1] = ps*nCell->v;
 		}
 	}
-	nCell = (DirectionCell*)theGrid[index+neighboursIndexShift[3]];
+	nCell = (DirectionCell*)getCell(getNeighbourIndex(index,3));
 	if (nCell)
 	{
 		Txm = nCell->T + neighboursDistance[3];
@@ -192,7 +193,7 @@ float ccFastMarchingForNormsDirection::computeT(unsigned index)
 				directionAgreements[3] = ps*nCell->v;
 		}
 	}
-	nCell = (DirectionCell*)theGrid[index+neighboursIndexShift[0]];
+	nCell = (DirectionCell*)getCell(getNeighbourIndex(index,0));
 	if (nCell)
 	{
 		Tym = nCell->T + neighboursDistance[0];
@@ -203,7 +204,7 @@ float ccFastMarchingForNormsDirection::computeT(unsigned index)
 				directionAgreements[0] = ps*nCell->v;
 		}
 	}
-	nCell = (DirectionCell*)theGrid[index+neighboursIndexShift[2]];
+	nCell = (DirectionCell*)getCell(getNeighbourIndex(index,2));
 	if (nCell)
 	{
 		Typ = nCell->T + neighboursDistance[2];
@@ -214,7 +215,7 @@ float ccFastMarchingForNormsDirection::computeT(unsigned index)
 				directionAgreements[2] = ps*nCell->v;
 		}
 	}
-	nCell = (DirectionCell*)theGrid[index+neighboursIndexShift[4]];
+	nCell = (DirectionCell*)getCell(getNeighbourIndex(index,4));
 	if (nCell)
 	{
 		Tzm = nCell->T + neighboursDistance[4];
@@ -225,7 +226,7 @@ float ccFastMarchingForNormsDirection::computeT(unsigned index)
 				directionAgreements[4] = ps*nCell->v;
 		}
 	}
-	nCell = (DirectionCell*)theGrid[index+neighboursIndexShift[5]];
+	nCell = (DirectionCell*)getCell(getNeighbourIndex(index,5));
 	if (nCell)
 	{
 		Tzp = nCell->T + neighboursDistance[5];
@@ -279,8 +280,8 @@ float ccFastMarchingForNormsDirection::computeT(unsigned index)
 
 		for(int n=0;n<CC_FM_NUMBER_OF_NEIGHBOURS;n++)
 		{
-			int candidateIndex = index + neighboursIndexShift[n];
-			DirectionCell* cCell = (DirectionCell*)theGrid[candidateIndex];
+			unsigned candidateIndex = getNeighbourIndex(index,n);
+			DirectionCell* cCell = (DirectionCell*)getCell(candidateIndex);
 			if (cCell)
 			{
 				if( (cCell->state==CCLib::FastMarching::Cell::TRIAL_CELL) || (cCell->state==CCLib::FastMarching::Cell::ACTIVE_CELL) )
@@ -363,7 +364,7 @@ void ccFastMarchingForNormsDirection::initLastT()
 	lastT = 0.0f;
 	for (size_t i=0; i<activeCells.size(); i++)
 	{
-		CCLib::FastMarching::Cell* aCell = theGrid[activeCells[i]];
+		CCLib::FastMarching::Cell* aCell = getCell(activeCells[i]);
 		lastT = std::max(lastT,aCell->T);
 	}
 }
@@ -399,7 +400,7 @@ int ccFastMarchingForNormsDirection::updateResolvedTable(ccGenericPointCloud* th
 	int count=0;
 	for (unsigned i=0;i<activeCells.size();++i)
 	{
-		DirectionCell* aCell = (DirectionCell*)theGrid[activeCells[i]];
+		DirectionCell* aCell = (DirectionCell*)getCell(activeCells[i]);
 		CCLib::ReferenceCloud* Yk = m_octree->getPointsInCell(aCell->cellCode,m_gridLevel,true);
 		if (!Yk)
 			continue;
@@ -440,16 +441,16 @@ void ccFastMarchingForNormsDirection::endPropagation()
 {
 	while (!activeCells.empty())
 	{
-		DirectionCell* aCell = (DirectionCell*)theGrid[activeCells.back()];
+		DirectionCell* aCell = (DirectionCell*)getCell(activeCells.back());
 		delete aCell;
-		theGrid[activeCells.back()]=NULL;
+		setCell(activeCells.back(),0);
 
 		activeCells.pop_back();
 	}
 
 	while (!trialCells.empty())
 	{
-		CCLib::FastMarching::Cell* aCell = theGrid[trialCells.back()];
+		CCLib::FastMarching::Cell* aCell = getCell(trialCells.back());
 
 		assert(aCell!=NULL);
 
@@ -463,47 +464,6 @@ void ccFastMarchingForNormsDirection::endPropagation()
 }
 
 
-//rajouter un element a la structure "untidy priority queue"
-void ccFastMarchingForNormsDirection::addTrialCell(unsigned index, float T)
-{
-	trialCells.push_back(index);
-}
-
-//recuperer le premier element de la structure "untidy priority queue"
-unsigned ccFastMarchingForNormsDirection::getNearestTrialCell() //renvoie 0 si probleme
-{
-	if (trialCells.empty()) return 0;
-
-	//on trouve la cellule de "TRIAL" qui a le T minimum
-	std::vector<unsigned>::const_iterator p = trialCells.begin();
-
-	int i=0,k=0;
-	unsigned minTCellIndex = *p;
-	CCLib::FastMarching::Cell* minTCell = theGrid[minTCellIndex];
-	assert(minTCell != NULL);
-	++p;
-	++i;
-
-	while (p != trialCells.end())
-	{
-		assert(theGrid[*p] != NULL);
-		if (theGrid[*p]->T <minTCell->T)
-		{
-			minTCellIndex = *p;
-			minTCell = theGrid[minTCellIndex];
-			k=i;
-		}
-		++p;
-		++i;
-	}
-
-	//on l'enleve de la liste
-	trialCells[k]=trialCells[trialCells.size()-1];
-	trialCells.pop_back();
-
-	return minTCellIndex;
-}
-
 void ccFastMarchingForNormsDirection::initTrialCells()
 {
 	DirectionCell *aCell,*nCell;
@@ -512,16 +472,16 @@ void ccFastMarchingForNormsDirection::initTrialCells()
 	for (j=0;j<activeCells.size();++j)
 	{
 		index = activeCells[j];
-		aCell = (DirectionCell*)theGrid[index];
+		aCell = (DirectionCell*)getCell(index);
 
 		assert(aCell != NULL);
 		aCell->v = 1.0;
 
 		for (i=0;i<CC_FM_NUMBER_OF_NEIGHBOURS;++i)
 		{
-			nIndex = index + neighboursIndexShift[i];
+			nIndex = getNeighbourIndex(index,i);
 			//pointeur vers la cellule voisine
-			nCell = (DirectionCell*)theGrid[nIndex];
+			nCell = (DirectionCell*)getCell(nIndex);
 
 			//si elle est definie
 			if (nCell)
@@ -621,16 +581,18 @@ int ccFastMarchingForNormsDirection::ResolveNormsDirectionByFrontPropagation(ccP
 
 	int octreeLength = (1<<octreeLevel)-1;
 
+	//all the points before this index are already resolved
+	int firstUnresolved = 0;
+
 	while (true)
 	{
 		//on cherche un point non encore traite
-		resolved->placeIteratorAtBegining();
-		for (i=0;i<numberOfPoints;++i)
+		for (i=firstUnresolved;i<numberOfPoints;++i)
 		{
-			if (resolved->getCurrentValue()==0)
+			if (resolved->getValue(i)==0)
 				break;
-			resolved->forwardIterator();
 		}
+		firstUnresolved = i;
 
 		//si tous les points ont ete traites, on peut arreter !
 		if (i==numberOfPoints)
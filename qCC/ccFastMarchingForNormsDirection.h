@@ -108,17 +108,11 @@ protected:
 	virtual float computeT(unsigned index);
 	virtual float computeTCoefApprox(CCLib::FastMarching::Cell* currentCell, CCLib::FastMarching::Cell* neighbourCell) {return 1.0;};
 	virtual int step();
-	virtual void addTrialCell(unsigned index, float T);
-	virtual unsigned getNearestTrialCell();
 	virtual void initTrialCells();
-	virtual bool instantiateGrid(unsigned size);
 
 	//! Compute the "biggest" (latest) front arrival time of the ACTIVE cells
 	void initLastT();
 
-	//! TRIAL cells list
-	std::vector<unsigned> trialCells;
-
 	//! Last arrival time
 	float lastT;
 };
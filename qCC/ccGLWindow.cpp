@@ -35,6 +35,7 @@
 #include <ccSphere.h> //for the pivot symbol
 #include <ccPolyline.h>
 #include <ccPointCloud.h>
+#include <ccPickingTools.h>
 
 //CCFbo
 #include <ccShader.h>
@@ -2140,6 +2141,89 @@ int ccGLWindow::startPicking(PICKING_MODE pickingMode, int centerX, int centerY,
 
 	assert(m_interactionMode != TRANSFORM_ENTITY);
 
+	int selectedID=-1,subID=-1;
+	std::set<int> selectedIDs; //for ENTITY_RECT_PICKING mode only
+
+	if (pickingMode == POINT_PICKING || pickingMode == TRIANGLE_PICKING || pickingMode == AUTO_POINT_PICKING)
+	{
+		//points and triangles are picked on the CPU side (much faster than pushing one GL name per element)
+		startCPUBasedPicking(pickingMode,centerX,centerY,pickWidth,pickHeight,selectedID,subID);
+	}
+	else if (!startOpenGLPicking(pickingMode,centerX,centerY,pickWidth,pickHeight,selectedID,selectedIDs))
+	{
+		return -1;
+	}
+
+	//standard "entity" picking
+	if (pickingMode == ENTITY_PICKING)
+	{
+		emit entitySelectionChanged(selectedID);
+	}
+	//rectangular "entity" picking
+	else if (pickingMode == ENTITY_RECT_PICKING)
+	{
+		emit entitiesSelectionChanged(selectedIDs);
+	}
+	//"3D point" picking
+	else if (pickingMode == POINT_PICKING)
+	{
+		if (selectedID>=0 && subID>=0)
+		{
+			emit pointPicked(selectedID,(unsigned)subID,centerX,centerY);
+		}
+	}
+	else if (pickingMode == AUTO_POINT_PICKING)
+	{
+		if (m_globalDBRoot && selectedID>=0 && subID>=0)
+		{
+			ccHObject* obj = m_globalDBRoot->find(selectedID);
+			if (obj)
+			{
+				//auto spawn the right label
+				cc2DLabel* label = 0;
+				if (obj->isKindOf(CC_POINT_CLOUD))
+				{
+					label = new cc2DLabel();
+					label->addPoint(static_cast<ccGenericPointCloud*>(obj),subID);
+					obj->addChild(label,true);
+				}
+				else if (obj->isKindOf(CC_MESH))
+				{
+					label = new cc2DLabel();
+					ccGenericMesh *mesh = static_cast<ccGenericMesh*>(obj);
+					ccGenericPointCloud *cloud = mesh->getAssociatedCloud();
+					assert(cloud);
+					CCLib::TriangleSummitsIndexes *summitsIndexes = mesh->getTriangleIndexes(subID);
+					label->addPoint(cloud,summitsIndexes->i1);
+					label->addPoint(cloud,summitsIndexes->i2);
+					label->addPoint(cloud,summitsIndexes->i3);
+					cloud->addChild(label,true);
+					if (!cloud->isEnabled())
+					{
+						cloud->setVisible(false);
+						cloud->setEnabled(true);
+					}
+				}
+
+				if (label)
+				{
+					label->setVisible(true);
+					label->setDisplay(obj->getDisplay());
+					label->setPosition((float)(centerX+20)/(float)width(),(float)(centerY+20)/(float)height());
+					emit newLabel(static_cast<ccHObject*>(label));
+					QApplication::processEvents();
+
+					toBeRefreshed();
+				}
+			}
+		}
+	}
+
+	return selectedID;
+}
+
+bool ccGLWindow::startOpenGLPicking(PICKING_MODE pickingMode, int centerX, int centerY, int pickWidth, int pickHeight, int& selectedID, std::set<int>& selectedIDs)
+{
 	//setup rendering context
 	CC_DRAW_CONTEXT context;
 	getContext(context);
@@ -2152,18 +2236,8 @@ int ccGLWindow::startPicking(PICKING_MODE pickingMode, int centerX, int centerY,
 	case LABELS_PICKING:
 		pickingFlags |= CC_DRAW_ENTITY_NAMES;
 		break;
-	case POINT_PICKING:
-		pickingFlags |= CC_DRAW_POINT_NAMES;	//automatically push entity names as well!
-		break;
-	case TRIANGLE_PICKING:
-		pickingFlags |= CC_DRAW_TRI_NAMES;		//automatically push entity names as well!
-		break;
-	case AUTO_POINT_PICKING:
-		pickingFlags |= CC_DRAW_POINT_NAMES;	//automatically push entity names as well!
-		pickingFlags |= CC_DRAW_TRI_NAMES;
-		break;
 	default:
-		return -1;
+		return false;
 	}
 
 	makeCurrent();
@@ -2244,12 +2318,10 @@ int ccGLWindow::startPicking(PICKING_MODE pickingMode, int centerX, int centerY,
 	if (hits<0)
 	{
 		ccConsole::Warning("Too many items inside picking zone! Try to zoom in...");
-		return -1;
+		return false;
 	}
 
 	//process hits
-	int selectedID=-1,subID=-1;
-	std::set<int> selectedIDs; //for ENTITY_RECT_PICKING mode only
 	{
 		GLuint minMinDepth = (~0);
 		const GLuint* _selectBuf = m_pickingBuffer;
@@ -2258,8 +2330,8 @@ int ccGLWindow::startPicking(PICKING_MODE pickingMode, int centerX, int centerY,
 			const GLuint& n = _selectBuf[0]; //number of names on stack
 			if (n) //if we draw anything outside of 'glPushName()... glPopName()' then it will appear here with as an empty set!
 			{
-				//n should be esqual to 1 (CC_DRAW_ENTITY_NAMES mode) or 2 (CC_DRAW_POINT_NAMES/CC_DRAW_TRIANGLES_NAMES modes)!
-				assert(n==1 || n==2);
+				//n should be equal to 1 (CC_DRAW_ENTITY_NAMES mode)
+				assert(n==1);
 				const GLuint& minDepth = _selectBuf[1];
 				//const GLuint& maxDepth = _selectBuf[2];
 				const GLuint& currentID = _selectBuf[3];
@@ -2275,7 +2347,6 @@ int ccGLWindow::startPicking(PICKING_MODE pickingMode, int centerX, int centerY,
 					if (selectedID < 0 || minDepth < minMinDepth)
 					{
 						selectedID = currentID;
-						subID = (n>1 ? _selectBuf[4] : -1);
 						minMinDepth = minDepth;
 					}
 				}
@@ -2285,72 +2356,127 @@ int ccGLWindow::startPicking(PICKING_MODE pickingMode, int centerX, int centerY,
 		}
 	}
 
-	//standard "entity" picking
-	if (pickingMode == ENTITY_PICKING)
-	{
-		emit entitySelectionChanged(selectedID);
-	}
-	//rectangular "entity" picking
-	else if (pickingMode == ENTITY_RECT_PICKING)
-	{
-		emit entitiesSelectionChanged(selectedIDs);
-	}
-	//"3D point" picking
-	else if (pickingMode == POINT_PICKING)
+	return true;
+}
+
+//! CPU based picking parameters and result (see ccGLWindow::startCPUBasedPicking)
+struct CPUPickingContext
+{
+	//! Picking window
+	const ccGenericGLDisplay* win;
+	//! Model view matrix
+	const double* modelViewMat;
+	//! Projection matrix
+	const double* projectionMat;
+	//! Viewport
+	int viewport[4];
+	//! Picking area center X position
+	int centerX;
+	//! Picking area center Y position
+	int centerY;
+	//! Picking area width
+	int pickWidth;
+	//! Picking area height
+	int pickHeight;
+	//! Whether to pick points (in clouds)
+	bool pickPoints;
+	//! Whether to pick triangles (in meshes)
+	bool pickTriangles;
+
+	//! [out] Picked entity ID (or -1)
+	int selectedID;
+	//! [out] Picked point or triangle index (or -1)
+	int subID;
+	//! [out] Picked element depth
+	double nearestDepth;
+};
+
+//! Recursively picks the points or triangles of an entity and of its children
+/** Follows the same rules as ccHObject::draw: disabled entities (and their
+	children) are ignored, and the display transformation of an entity is
+	applied to its children as well.
+**/
+static void PickEntityElements(ccHObject* obj, const ccGLMatrix* parentTrans, CPUPickingContext& context)
+{
+	if (!obj->isEnabled())
+		return;
+
+	//display transformation
+	ccGLMatrix trans;
+	const ccGLMatrix* entityTrans = parentTrans;
+	if (obj->isGLTransEnabled())
 	{
-		if (selectedID>=0 && subID>=0)
-		{
-			emit pointPicked(selectedID,(unsigned)subID,centerX,centerY);
-		}
+		trans = (parentTrans ? (*parentTrans) * obj->getGLTransformation() : obj->getGLTransformation());
+		entityTrans = &trans;
 	}
-	else if (pickingMode == AUTO_POINT_PICKING)
+
+	if (obj->isVisible() && obj->getDisplay() == context.win)
 	{
-		if (m_globalDBRoot && selectedID>=0 && subID>=0)
-		{
-			ccHObject* obj = m_globalDBRoot->find(selectedID);
-			if (obj)
-			{
-				//auto spawn the right label
-				cc2DLabel* label = 0;
-				if (obj->isKindOf(CC_POINT_CLOUD))
-				{
-					label = new cc2DLabel();
-					label->addPoint(static_cast<ccGenericPointCloud*>(obj),subID);
-					obj->addChild(label,true);
-				}
-				else if (obj->isKindOf(CC_MESH))
-				{
-					label = new cc2DLabel();
-					ccGenericMesh *mesh = static_cast<ccGenericMesh*>(obj);
-					ccGenericPointCloud *cloud = mesh->getAssociatedCloud();
-					assert(cloud);
-					CCLib::TriangleSummitsIndexes *summitsIndexes = mesh->getTriangleIndexes(subID);
-					label->addPoint(cloud,summitsIndexes->i1);
-					label->addPoint(cloud,summitsIndexes->i2);
-					label->addPoint(cloud,summitsIndexes->i3);
-					cloud->addChild(label,true);
-					if (!cloud->isEnabled())
-					{
-						cloud->setVisible(false);
-						cloud->setEnabled(true);
-					}
-				}
+		bool isCloud = (context.pickPoints && obj->isKindOf(CC_POINT_CLOUD));
+		//mesh groups are picked through their children
+		bool isMesh = (context.pickTriangles && obj->isKindOf(CC_MESH) && !obj->isA(CC_MESH_GROUP));
 
-				if (label)
-				{
-					label->setVisible(true);
-					label->setDisplay(obj->getDisplay());
-					label->setPosition((float)(centerX+20)/(float)width(),(float)(centerY+20)/(float)height());
-					emit newLabel(static_cast<ccHObject*>(label));
-					QApplication::processEvents();
+		ccPickingTools::PickingVolume volume;
+		if ((isCloud || isMesh) && ccPickingTools::ComputePickingVolume(	context.modelViewMat,
+																			context.projectionMat,
+																			context.viewport,
+																			context.centerX,
+																			context.centerY,
+																			context.pickWidth,
+																			context.pickHeight,
+																			entityTrans,
+																			volume))
+		{
+			unsigned index = 0;
+			double depth = 0.0;
+			bool picked = isCloud	? ccPickingTools::PickPoint(static_cast<ccGenericPointCloud*>(obj),volume,index,depth)
+									: ccPickingTools::PickTriangle(static_cast<ccGenericMesh*>(obj),volume,index,depth);
 
-					toBeRefreshed();
-				}
+			//if there are multiple hits, we keep only the nearest
+			if (picked && (context.selectedID < 0 || depth < context.nearestDepth))
+			{
+				context.selectedID = static_cast<int>(obj->getUniqueID());
+				context.subID = static_cast<int>(index);
+				context.nearestDepth = depth;
 			}
 		}
 	}
 
-	return selectedID;
+	for (unsigned i=0; i<obj->getChildrenNumber(); ++i)
+		PickEntityElements(obj->getChild(i),entityTrans,context);
+}
+
+void ccGLWindow::startCPUBasedPicking(PICKING_MODE pickingMode, int centerX, int centerY, int pickWidth, int pickHeight, int& selectedID, int& subID)
+{
+	selectedID = subID = -1;
+	if (!m_globalDBRoot)
+		return;
+
+	CPUPickingContext context;
+	context.win = this;
+	context.modelViewMat = getModelViewMatd();
+	context.projectionMat = getProjectionMatd();
+	//same viewport as the one set in resizeGL
+	context.viewport[0] = 0;
+	context.viewport[1] = 0;
+	context.viewport[2] = m_glWidth;
+	context.viewport[3] = m_glHeight;
+	context.centerX = centerX;
+	context.centerY = centerY;
+	context.pickWidth = pickWidth;
+	context.pickHeight = pickHeight;
+	context.pickPoints = (pickingMode == POINT_PICKING || pickingMode == AUTO_POINT_PICKING);
+	context.pickTriangles = (pickingMode == TRIANGLE_PICKING || pickingMode == AUTO_POINT_PICKING);
+	context.selectedID = -1;
+	context.subID = -1;
+	context.nearestDepth = 0.0;
+
+	PickEntityElements(m_globalDBRoot,0,context);
+
+	selectedID = context.selectedID;
+	subID = context.subID;
+
+	ccConsole::PrintDebug("Picking hit: entity %i / element %i",selectedID,subID);
 }
 
 void ccGLWindow::displayNewMessage(const QString& message,
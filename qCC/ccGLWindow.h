@@ -464,7 +464,7 @@ protected:
 	**/
     CCVector3 getCurrentViewDir() const;
 
-    //! Starts OpenGL picking process
+    //! Starts picking process
 	/** \param mode picking mode
 		\param centerX picking area center X position
 		\param centerY picking area center y position
@@ -473,6 +473,29 @@ protected:
 		\return item ID (if any) or <1 otherwise
 	**/
     int startPicking(PICKING_MODE mode, int centerX, int centerY, int width=5, int height=5);
+
+	//! OpenGL (GL_SELECT) based picking of entities or labels (see startPicking)
+	/** \param mode picking mode (ENTITY_PICKING, ENTITY_RECT_PICKING or LABELS_PICKING)
+		\param centerX picking area center X position
+		\param centerY picking area center y position
+		\param width picking area width
+		\param height picking area height
+		\param[out] selectedID nearest picked entity ID (or -1)
+		\param[out] selectedIDs all picked entities IDs (ENTITY_RECT_PICKING mode only)
+		\return false if the picking process failed
+	**/
+	bool startOpenGLPicking(PICKING_MODE mode, int centerX, int centerY, int width, int height, int& selectedID, std::set<int>& selectedIDs);
+
+	//! CPU based picking of points or triangles (see startPicking and ccPickingTools)
+	/** \param mode picking mode (POINT_PICKING, TRIANGLE_PICKING or AUTO_POINT_PICKING)
+		\param centerX picking area center X position
+		\param centerY picking area center y position
+		\param width picking area width
+		\param height picking area height
+		\param[out] selectedID picked entity ID (or -1)
+		\param[out] subID picked point or triangle index (or -1)
+	**/
+	void startCPUBasedPicking(PICKING_MODE mode, int centerX, int centerY, int width, int height, int& selectedID, int& subID);
 	
 	//! Updates currently active labels list (m_activeLabels)
 	/** The labels must be currently displayed in this context
@@ -502,6 +502,22 @@ void ccGraphicalSegmentationTool::segment(bool keepPointsInside)
         ccGenericPointCloud::VisibilityTableType* visibilityArray = cloud->getTheVisibilityArray();
 		assert(visibilityArray);
 
+		//batch version (screen mask, SSE, multi-threaded and octree based if available)
+		ccPointCloud* pc = ccHObjectCaster::ToPointCloud(cloud);
+		if (pc && CCLib::ManualSegmentationTools::segmentWithScreenPolyline(pc,
+																			visibilityArray,
+																			m_segmentationPoly,
+																			keepPointsInside,
+																			MM,
+																			MP,
+																			VP,
+																			CCVector2(half_w,half_h),
+																			pc->getOctree()))
+		{
+			cloud->visibilityArrayChanged();
+			continue;
+		}
+
         unsigned cloudSize = cloud->size();
 
         //we project each point and we check if it falls inside the segmentation polyline
@@ -521,6 +537,8 @@ void ccGraphicalSegmentationTool::segment(bool keepPointsInside)
 				visibilityArray->setValue(i, keepPointsInside != pointInside ? POINT_HIDDEN : POINT_VISIBLE );
 			}
 		}
+
+		cloud->visibilityArrayChanged();
     }
 
     m_somethingHasChanged = true;
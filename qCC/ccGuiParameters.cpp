@@ -23,6 +23,9 @@
 //qCC_db
 #include <ccBasicTypes.h>
 
+//CCLib
+#include <ChunkAllocator.h>
+
 //System
 #include <string.h>
 
@@ -43,6 +46,14 @@ const ccGui::ParamStruct& ccGui::Parameters()
     return s_gui->params;
 }
 
+void ccGui::ApplyMemoryOptions(const ParamStruct& params)
+{
+	if (params.useMemoryMapping)
+		ChunkAllocator::EnableFileMapping(0,(size_t)params.memoryMappingBudget << 20);
+	else
+		ChunkAllocator::DisableFileMapping();
+}
+
 void ccGui::ReleaseInstance()
 {
     if (s_gui)
@@ -55,7 +66,13 @@ void ccGui::Set(const ParamStruct& params)
     if (!s_gui)
         s_gui = new ccGui();
 
+	bool memoryOptionsChanged = (	s_gui->params.useMemoryMapping != params.useMemoryMapping
+								||	s_gui->params.memoryMappingBudget != params.memoryMappingBudget);
+
     s_gui->params = params;
+
+	if (memoryOptionsChanged)
+		ApplyMemoryOptions(params);
 }
 
 ccGui::ParamStruct::ParamStruct()
@@ -94,6 +111,9 @@ void ccGui::ParamStruct::reset()
 	defaultFontSize				= 10;
 	displayedNumPrecision		= 6;
 	labelsTransparency			= 50;
+
+	useMemoryMapping			= false;
+	memoryMappingBudget			= 1024;
 }
 
 ccGui::ParamStruct& ccGui::ParamStruct::operator =(const ccGui::ParamStruct& params)
@@ -124,6 +144,8 @@ ccGui::ParamStruct& ccGui::ParamStruct::operator =(const ccGui::ParamStruct& par
 	defaultFontSize				= params.defaultFontSize;
 	displayedNumPrecision		= params.displayedNumPrecision;
 	labelsTransparency			= params.labelsTransparency;
+	useMemoryMapping			= params.useMemoryMapping;
+	memoryMappingBudget			= params.memoryMappingBudget;
 
     return *this;
 
@@ -164,6 +186,9 @@ void ccGui::ParamStruct::fromPersistentSettings()
 	displayedNumPrecision		= (unsigned)settings.value("displayedNumPrecision", 6).toInt();
 	labelsTransparency			= (unsigned)settings.value("labelsTransparency", 50).toInt();
 
+	useMemoryMapping			= settings.value("useMemoryMapping", false).toBool();
+	memoryMappingBudget			= (unsigned)settings.value("memoryMappingBudget", 1024).toInt();
+
     settings.endGroup();
 }
 
@@ -197,6 +222,8 @@ void ccGui::ParamStruct::toPersistentSettings() const
 	settings.setValue("defaultFontSize", defaultFontSize);
 	settings.setValue("displayedNumPrecision", displayedNumPrecision);
 	settings.setValue("labelsTransparency", labelsTransparency);
+	settings.setValue("useMemoryMapping", useMemoryMapping);
+	settings.setValue("memoryMappingBudget", memoryMappingBudget);
 
     settings.endGroup();
 }
@@ -94,6 +94,13 @@ public:
 		//! Labels transparency
 		unsigned labelsTransparency;
 
+		//! Whether big chunks of data should be backed by memory-mapped (scratch) files
+		/** See ChunkAllocator (CCLib).
+		**/
+		bool useMemoryMapping;
+		//! Max amount of resident memory for memory-mapped chunks (in MB - 0 = no limit)
+		unsigned memoryMappingBudget;
+
         //! Default constructor
         ParamStruct();
 
@@ -118,6 +125,9 @@ public:
 	//! Returns the stored values of each parameter.
 	static const ParamStruct& Parameters();
 
+	//! Applies the memory options (memory-mapped chunks) to CCLib allocator
+	static void ApplyMemoryOptions(const ParamStruct& params);
+
     //! Sets GUI parameters
 	static void Set(const ParamStruct& params);
 
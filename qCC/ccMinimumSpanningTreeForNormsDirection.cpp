@@ -0,0 +1,378 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "ccMinimumSpanningTreeForNormsDirection.h"
+
+//qCC_db
+#include <ccNormalVectors.h>
+#include <ccPointCloud.h>
+#include <ccLog.h>
+
+//CCLib
+#include <KdTree.h>
+#include <GeometricalAnalysisTools.h>
+
+//Qt
+#include <QThread>
+#include <QtConcurrentMap>
+
+//system
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+//! Graph edge (between a point and one of its neighbours)
+struct MSTGraphEdge
+{
+	//! Weight (see ComputeEdgesWeight)
+	float weight;
+	//! Index in the neighbours table (i.e. point index * neighbours per point + neighbour rank)
+	/** 64 bits: the table size (points count * neighbours per point) may exceed 2^32.
+	**/
+	size_t index;
+
+	//! Strict ordering (the index is used to sort edges with the same weight in a deterministic way)
+	inline bool operator < (const MSTGraphEdge& e) const { return weight < e.weight || (weight == e.weight && index < e.index); }
+};
+
+//! Edges weight computation job (for a block of points)
+struct MSTEdgesJob
+{
+	unsigned firstPoint;
+	unsigned lastPoint; //excluded
+	unsigned edgesPerPoint;
+	const std::vector<unsigned>* neighbours;
+	const NormsIndexesTableType* norms;
+	ccPointCloud* cloud;
+	std::vector<MSTGraphEdge>* edges;
+};
+
+//! Computes the edges weight
+/** Weight = 1-|Ni.Nj| + |Ni.e|.|Nj.e| with e the (unit) edge direction.
+	The first term is the one of Hoppe et al. The second one penalizes the
+	edges that are not tangent to the surface: the normals on both sides of
+	a thin structure are nearly (anti)parallel and the propagation shouldn't
+	jump from one side to the other.
+**/
+static void ComputeEdgesWeight(MSTEdgesJob& job)
+{
+	const std::vector<unsigned>& neighbours = *job.neighbours;
+	std::vector<MSTGraphEdge>& edges = *job.edges;
+
+	for (unsigned i=job.firstPoint; i<job.lastPoint; ++i)
+	{
+		const PointCoordinateType* Ni = ccNormalVectors::GetNormal(job.norms->getValue(i));
+		const CCVector3* Pi = job.cloud->getPoint(i);
+		for (unsigned j=0; j<job.edgesPerPoint; ++j)
+		{
+			size_t edgeIndex = static_cast<size_t>(i)*job.edgesPerPoint+j;
+			unsigned n = neighbours[edgeIndex];
+			MSTGraphEdge& e = edges[edgeIndex];
+			e.index = edgeIndex;
+			if (n == i)
+			{
+				//the point itself (will be ignored)
+				e.weight = 3.0f;
+			}
+			else
+			{
+				const PointCoordinateType* Nn = ccNormalVectors::GetNormal(job.norms->getValue(n));
+				CCVector3 u = *job.cloud->getPoint(n) - *Pi;
+				u.normalize();
+				e.weight = 1.0f - fabs(CCVector3::vdot(Ni,Nn)) + fabs(CCVector3::vdot(Ni,u.u)) * fabs(CCVector3::vdot(Nn,u.u));
+			}
+		}
+	}
+}
+
+//! Edges sort job (for a contiguous range of edges)
+struct MSTSortJob
+{
+	std::vector<MSTGraphEdge>::iterator begin;
+	std::vector<MSTGraphEdge>::iterator end;
+};
+
+static void SortEdges(MSTSortJob& job)
+{
+	std::sort(job.begin,job.end);
+}
+
+//! Sorts the graph edges (each range is sorted in parallel, then they are merged)
+static void ParallelSortEdges(std::vector<MSTGraphEdge>& edges)
+{
+	unsigned threadCount = (unsigned)std::max(QThread::idealThreadCount(),1);
+	size_t count = edges.size();
+	if (threadCount < 2 || count < 65536)
+	{
+		std::sort(edges.begin(),edges.end());
+		return;
+	}
+
+	std::vector<size_t> bounds(threadCount+1);
+	for (unsigned i=0; i<=threadCount; ++i)
+		bounds[i] = (count*i)/threadCount;
+
+	std::vector<MSTSortJob> jobs(threadCount);
+	for (unsigned i=0; i<threadCount; ++i)
+	{
+		jobs[i].begin = edges.begin()+bounds[i];
+		jobs[i].end = edges.begin()+bounds[i+1];
+	}
+	QtConcurrent::blockingMap(jobs, SortEdges);
+
+	//merge of the sorted ranges (two by two)
+	for (unsigned step=1; step<threadCount; step*=2)
+		for (unsigned i=0; i+step<threadCount; i+=2*step)
+			std::inplace_merge(	edges.begin()+bounds[i],
+								edges.begin()+bounds[i+step],
+								edges.begin()+bounds[std::min(i+2*step,threadCount)]);
+}
+
+//! Union-find: returns the root of a point (with path halving)
+static inline unsigned FindRoot(std::vector<unsigned>& parents, unsigned i)
+{
+	while (parents[i] != i)
+	{
+		parents[i] = parents[parents[i]];
+		i = parents[i];
+	}
+	return i;
+}
+
+//! Returns the prefered orientation at a given point (see ccNormalVectors::ComputeCloudNormals)
+static CCVector3 GetPreferedOrientation(int preferedOrientation, const CCVector3& P, const CCVector3& barycenter)
+{
+	CCVector3 orientation(0.0,0.0,0.0);
+	if (preferedOrientation < 6)
+		orientation.u[preferedOrientation>>1] = ((preferedOrientation & 1) == 0 ? 1.0 : -1.0); //odd number --> inverse direction
+	else if (preferedOrientation == 6)
+		orientation = P-barycenter;
+	else //if (preferedOrientation == 7)
+		orientation = barycenter-P;
+	return orientation;
+}
+
+bool ccMinimumSpanningTreeForNormsDirection::OrientNormals(ccPointCloud* theCloud,
+															NormsIndexesTableType* theNorms,
+															unsigned kNN/*=6*/,
+															int preferedOrientation/*=-1*/,
+															CCLib::GenericProgressCallback* progressCb/*=0*/)
+{
+	assert(theCloud && theNorms);
+
+	unsigned pointCount = theCloud->size();
+	if (pointCount < 2)
+		return (pointCount != 0);
+	if (theNorms->capacity() < pointCount)
+		return false;
+
+	//each point is among its own nearest neighbours
+	unsigned edgesPerPoint = std::min(kNN+1,pointCount);
+
+	if (progressCb)
+	{
+		progressCb->reset();
+		progressCb->setMethodTitle("Norms direction (MST)");
+		char buffer[256];
+		sprintf(buffer,"Neighbours: %u\nNumber of points: %u",kNN,pointCount);
+		progressCb->setInfo(buffer);
+		progressCb->start();
+	}
+
+	std::vector<unsigned> neighbours;
+	std::vector<unsigned> parents;
+	std::vector<unsigned> treeNeighbours;
+	std::vector<unsigned> treeOffsets;
+	try
+	{
+		//1st step: the graph (k nearest neighbours of each point)
+		{
+			CCLib::KDTree tree;
+			if (!tree.buildFromCloud(theCloud) || !tree.findKNearestNeighbours(theCloud,edgesPerPoint,neighbours))
+			{
+				ccLog::Warning("[ccMinimumSpanningTreeForNormsDirection] Failed to compute the points neighbourhood! Not enough memory?");
+				return false;
+			}
+		}
+		if (progressCb)
+			progressCb->update(20.0f);
+
+		//2nd step: the minimum spanning tree (Kruskal)
+		std::vector<size_t> treeEdges; //edges index
+		{
+			std::vector<MSTGraphEdge> edges(neighbours.size());
+
+			//edges weight (in parallel)
+			{
+				static const unsigned c_pointsPerJob = 16384;
+				std::vector<MSTEdgesJob> jobs;
+				for (unsigned i=0; i<pointCount; i+=c_pointsPerJob)
+				{
+					MSTEdgesJob job;
+					job.firstPoint = i;
+					job.lastPoint = std::min(i+c_pointsPerJob,pointCount);
+					job.edgesPerPoint = edgesPerPoint;
+					job.neighbours = &neighbours;
+					job.norms = theNorms;
+					job.cloud = theCloud;
+					job.edges = &edges;
+					jobs.push_back(job);
+				}
+				QtConcurrent::blockingMap(jobs, ComputeEdgesWeight);
+			}
+			ParallelSortEdges(edges);
+			if (progressCb)
+				progressCb->update(50.0f);
+
+			parents.resize(pointCount);
+			for (unsigned i=0; i<pointCount; ++i)
+				parents[i] = i;
+
+			treeEdges.reserve(pointCount-1);
+			for (size_t e=0; e<edges.size() && treeEdges.size()+1<pointCount; ++e)
+			{
+				if (edges[e].weight > 2.0f) //self edges (always at the end)
+					break;
+				unsigned a = FindRoot(parents,static_cast<unsigned>(edges[e].index/edgesPerPoint));
+				unsigned b = FindRoot(parents,neighbours[edges[e].index]);
+				if (a != b)
+				{
+					//we always keep the smallest index as root (deterministic)
+					if (a < b)
+						parents[b] = a;
+					else
+						parents[a] = b;
+					treeEdges.push_back(edges[e].index);
+				}
+			}
+		}
+		if (progressCb)
+			progressCb->update(70.0f);
+
+		//tree adjacency lists
+		treeOffsets.resize(pointCount+1,0);
+		for (size_t e=0; e<treeEdges.size(); ++e)
+		{
+			++treeOffsets[static_cast<unsigned>(treeEdges[e]/edgesPerPoint)+1];
+			++treeOffsets[neighbours[treeEdges[e]]+1];
+		}
+		for (unsigned i=0; i<pointCount; ++i)
+			treeOffsets[i+1] += treeOffsets[i];
+		treeNeighbours.resize(treeOffsets[pointCount]);
+		{
+			std::vector<unsigned> fill(treeOffsets.begin(),treeOffsets.end()-1);
+			for (size_t e=0; e<treeEdges.size(); ++e)
+			{
+				unsigned a = static_cast<unsigned>(treeEdges[e]/edgesPerPoint);
+				unsigned b = neighbours[treeEdges[e]];
+				treeNeighbours[fill[a]++] = b;
+				treeNeighbours[fill[b]++] = a;
+			}
+		}
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		ccLog::Warning("[ccMinimumSpanningTreeForNormsDirection] Not enough memory!");
+		return false;
+	}
+
+	//we don't need the graph anymore
+	std::vector<unsigned>().swap(neighbours);
+
+	bool hasPreferedOrientation = (preferedOrientation>=0 && preferedOrientation<8);
+	CCVector3 barycenter(0.0,0.0,0.0);
+	if (hasPreferedOrientation && preferedOrientation >= 6)
+		barycenter = CCLib::GeometricalAnalysisTools::computeGravityCenter(theCloud);
+
+	//3rd step: propagation along the tree (breadth first, one connected component after the other)
+	std::vector<unsigned>& queue = parents; //recycled
+	std::vector<unsigned char> visited;
+	try
+	{
+		visited.resize(pointCount,0);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		ccLog::Warning("[ccMinimumSpanningTreeForNormsDirection] Not enough memory!");
+		return false;
+	}
+
+	unsigned componentCount = 0;
+	unsigned queueEnd = 0;
+	int lastPercent = 70;
+	for (unsigned seed=0; seed<pointCount; ++seed)
+	{
+		if (visited[seed])
+			continue;
+
+		//the seed normal is kept as is
+		unsigned componentStart = queueEnd;
+		queue[queueEnd++] = seed;
+		visited[seed] = 1;
+		double vote = 0.0;
+
+		for (unsigned q=componentStart; q<queueEnd; ++q)
+		{
+			unsigned i = queue[q];
+			const PointCoordinateType* Ni = ccNormalVectors::GetNormal(theNorms->getValue(i));
+
+			if (hasPreferedOrientation)
+				vote += CCVector3::vdot(Ni,GetPreferedOrientation(preferedOrientation,*theCloud->getPoint(i),barycenter).u);
+
+			for (unsigned t=treeOffsets[i]; t<treeOffsets[i+1]; ++t)
+			{
+				unsigned j = treeNeighbours[t];
+				if (visited[j])
+					continue;
+
+				normsType& code = (*theNorms)[j];
+				if (CCVector3::vdot(Ni,ccNormalVectors::GetNormal(code)) < 0)
+					ccNormalVectors::InvertNormal(code);
+
+				visited[j] = 1;
+				queue[queueEnd++] = j;
+			}
+		}
+
+		//the whole component is flipped if it doesn't match the prefered orientation
+		if (vote < 0.0)
+			for (unsigned q=componentStart; q<queueEnd; ++q)
+				ccNormalVectors::InvertNormal((*theNorms)[queue[q]]);
+
+		++componentCount;
+
+		if (progressCb)
+		{
+			int percent = 70 + (int)((30.0*(double)queueEnd)/(double)pointCount);
+			if (percent != lastPercent)
+			{
+				progressCb->update((float)percent);
+				lastPercent = percent;
+			}
+		}
+	}
+	assert(queueEnd == pointCount);
+
+	if (progressCb)
+		progressCb->stop();
+
+	ccLog::Print(QString("[ccMinimumSpanningTreeForNormsDirection] %1 connected component(s)").arg(componentCount));
+
+	return true;
+}
@@ -0,0 +1,60 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_MST_NORMS_DIRECTION_HEADER
+#define CC_MST_NORMS_DIRECTION_HEADER
+
+//CCLib
+#include <GenericProgressCallback.h>
+
+//qCC_db
+#include <ccAdvancedTypes.h>
+
+class ccPointCloud;
+
+//! Minimum Spanning Tree based normals direction resolution
+/** Alternative to ccFastMarchingForNormsDirection (see Hoppe et al., "Surface
+	reconstruction from unorganized points", 1992). A graph is built over the
+	k nearest neighbours of each point, with edges weighted so that nearly
+	parallel normals and edges tangent to the surface are preferred. The
+	normals direction is then propagated along the Minimum Spanning Tree of
+	this graph. Contrarily to the Fast Marching approach, there's no grid: thin
+	structures are better handled.
+**/
+class ccMinimumSpanningTreeForNormsDirection
+{
+public:
+
+	//! Static entry point
+	/** Each connected component of the graph is processed independently.
+		If a prefered orientation is specified, each component is flipped
+		(as a whole) so that most of its normals match this orientation.
+		\param theCloud point cloud
+		\param theNorms normals (compressed indexes, same size as the cloud)
+		\param kNN number of neighbours per point in the graph
+		\param preferedOrientation prefered orientation (-1: none, 0:+X, 1:-X, 2:+Y, 3:-Y, 4:+Z, 5:-Z, 6:+Barycenter, 7:-Barycenter - see ccNormalVectors::ComputeCloudNormals)
+		\param progressCb progress callback
+		\return success
+	**/
+	static bool OrientNormals(ccPointCloud* theCloud,
+								NormsIndexesTableType* theNorms,
+								unsigned kNN = 6,
+								int preferedOrientation = -1,
+								CCLib::GenericProgressCallback* progressCb = 0);
+};
+
+#endif //CC_MST_NORMS_DIRECTION_HEADER
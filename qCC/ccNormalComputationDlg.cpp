@@ -35,6 +35,9 @@ ccNormalComputationDlg::ccNormalComputationDlg(QWidget* parent) : QDialog(parent
     setWindowFlags(Qt::Tool/*Qt::Dialog | Qt::WindowStaysOnTopHint*/);
 	
 	connect(localModelComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(localModelChanged(int)));
+	connect(knnCheckBox, SIGNAL(toggled(bool)), this, SLOT(updateNeighbourhoodWidgets()));
+
+	updateNeighbourhoodWidgets();
 }
 
 CC_LOCAL_MODEL_TYPES ccNormalComputationDlg::getLocalModel() const
@@ -55,7 +58,17 @@ CC_LOCAL_MODEL_TYPES ccNormalComputationDlg::getLocalModel() const
 
 void ccNormalComputationDlg::localModelChanged(int index)
 {
-	radiusDoubleSpinBox->setEnabled(index != 2);
+	updateNeighbourhoodWidgets();
+}
+
+void ccNormalComputationDlg::updateNeighbourhoodWidgets()
+{
+	int index = localModelComboBox->currentIndex();
+
+	//nearest neighbours are only supported by the 'Plane' model
+	knnCheckBox->setEnabled(index == 0);
+	knnSpinBox->setEnabled(index == 0 && knnCheckBox->isChecked());
+	radiusDoubleSpinBox->setEnabled(index != 2 && !knnSpinBox->isEnabled());
 }
 
 void ccNormalComputationDlg::setRadius(float radius)
@@ -68,6 +81,14 @@ float ccNormalComputationDlg::getRadius() const
 	return radiusDoubleSpinBox->value();
 }
 
+unsigned ccNormalComputationDlg::getKNN() const
+{
+	if (getLocalModel() != LS || !knnCheckBox->isChecked())
+		return 0;
+
+	return (unsigned)knnSpinBox->value();
+}
+
 int ccNormalComputationDlg::getPreferedOrientation() const
 {
     if (!preferedOrientationCheckBox->isChecked())
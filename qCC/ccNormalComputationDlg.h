@@ -46,6 +46,11 @@ public:
 	//! Returns local neighbourhood radius
 	float getRadius() const;
 
+	//! Returns the number of nearest neighbours to use
+	/** \return 0 if a spherical neighbourhood should be used instead
+	**/
+	unsigned getKNN() const;
+
 	//! Returns prefered orientation
     /** \return prefered orientation (-1: none, 0:+X, 1:-X, 2:+Y, 3:-Y, 4:+Z, 5:-Z)
     **/
@@ -55,6 +60,9 @@ protected slots:
 
 	//! On local model change
 	void localModelChanged(int index);
+
+	//! Updates the neighbourhood widgets state
+	void updateNeighbourhoodWidgets();
 };
 
 #endif
@@ -78,10 +78,11 @@ CCLib::ReferenceCloud* ccSubsamplingDlg::getSampledCloud(CCLib::GenericProgressC
 				octree = m_pointCloud->computeOctree(progressCb);
 			if (octree)
 			{
-				sampledCloud = CCLib::CloudSamplingTools::resampleCloudSpatially(m_pointCloud, 
-																					samplingValue->value(), 
-																					octree,
-																					progressCb);
+				sampledCloud = CCLib::CloudSamplingTools::resampleCloudSpatiallyParallel(m_pointCloud,
+																							samplingValue->value(),
+																							0,
+																							octree,
+																							progressCb);
 			}
 		}
 		break;
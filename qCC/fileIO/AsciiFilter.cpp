@@ -16,12 +16,15 @@
 //##########################################################################
 
 #include "AsciiFilter.h"
+#include "InputMemoryFile.h"
 #include "../ccCoordinatesShiftManager.h"
 
 //Qt
 #include <QFile>
 #include <QFileInfo>
 #include <QTextStream>
+#include <QThread>
+#include <QtConcurrentMap>
 
 //CClib
 #include <ScalarField.h>
@@ -439,6 +442,536 @@ cloudAttributesDescriptor prepareCloud(const AsciiOpenDlg::Sequence &openSequenc
     return cloudDesc;
 }
 
+//! Size of the blocks of lines parsed in parallel (memory-mapped files)
+static const size_t c_asciiBlockSize = (1<<22); //4 MB
+
+//! Fast conversion of an ASCII token to a double (equivalent to QString::toDouble)
+/** Doesn't allocate anything. Leading and trailing whitespaces are ignored
+	and 0 is returned if the token is not a valid number. Simple decimal
+	numbers (at most 15 significant digits, small exponent) are exactly
+	converted with 'double' operations. The other cases are left to Qt.
+**/
+static double TokenToDouble(const char* str, const char* end)
+{
+	//exact powers of 10 in double precision
+	static const double s_pow10[23] = {	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+										1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+	while (str < end && (*str == ' ' || *str == '\t' || *str == '\r' || *str == '\n'))
+		++str;
+	while (end > str && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n'))
+		--end;
+	if (str == end)
+		return 0.0;
+
+	const char* p = str;
+	bool negative = (*p == '-');
+	if (*p == '-' || *p == '+')
+		++p;
+
+	//mantissa (as an integer) and decimal exponent
+	double mantissa = 0.0;
+	int digits = 0; //significant digits
+	int exp10 = 0;
+	bool valid = false;
+	for (; p < end && *p >= '0' && *p <= '9'; ++p)
+	{
+		valid = true;
+		if (digits != 0 || *p != '0')
+		{
+			mantissa = mantissa*10.0 + (double)(*p-'0');
+			++digits;
+		}
+	}
+	if (p < end && *p == '.')
+	{
+		for (++p; p < end && *p >= '0' && *p <= '9'; ++p)
+		{
+			valid = true;
+			if (digits != 0 || *p != '0')
+			{
+				mantissa = mantissa*10.0 + (double)(*p-'0');
+				++digits;
+			}
+			--exp10;
+		}
+	}
+	if (valid && p < end && (*p == 'e' || *p == 'E'))
+	{
+		++p;
+		bool negativeExp = (p < end && *p == '-');
+		if (p < end && (*p == '-' || *p == '+'))
+			++p;
+		int e = 0;
+		valid = false;
+		for (; p < end && *p >= '0' && *p <= '9'; ++p)
+		{
+			valid = true;
+			if (e < 10000)
+				e = e*10 + (*p-'0');
+		}
+		exp10 += (negativeExp ? -e : e);
+	}
+
+	//fast path: the mantissa is exact (< 2^53) and so is the power of 10
+	if (valid && p == end && digits <= 15 && exp10 >= -22 && exp10 <= 22)
+	{
+		double value = (exp10 < 0 ? mantissa / s_pow10[-exp10] : mantissa * s_pow10[exp10]);
+		return negative ? -value : value;
+	}
+
+	//other cases (long mantissa, special values, etc.)
+	return QString::fromLatin1(str,(int)(end-str)).toDouble();
+}
+
+//! Fast conversion of an ASCII token to an integer (equivalent to QString::toInt)
+static int TokenToInt(const char* str, const char* end)
+{
+	while (str < end && (*str == ' ' || *str == '\t' || *str == '\r' || *str == '\n'))
+		++str;
+	while (end > str && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n'))
+		--end;
+
+	const char* p = str;
+	bool negative = (p < end && *p == '-');
+	if (negative)
+		++p;
+	if (p < end && end-p <= 9) //no overflow possible
+	{
+		int value = 0;
+		for (; p < end && *p >= '0' && *p <= '9'; ++p)
+			value = value*10 + (*p-'0');
+		if (p == end)
+			return negative ? -value : value;
+	}
+
+	return QString::fromLatin1(str,(int)(end-str)).toInt();
+}
+
+//! Parameters shared by all the parsing jobs (memory-mapped files)
+struct asciiParsingParams
+{
+	const cloudAttributesDescriptor* desc;
+	char separator;
+	int maxPartIndex;
+	bool hasColors;
+};
+
+//! Parsing job: block of consecutive lines (memory-mapped files)
+/** Points are stored in the same order as in the file. Coordinates are
+	not shifted yet (see ccCoordinatesShiftManager).
+**/
+struct asciiParsingJob
+{
+	//input
+	const char* begin; //first char of the block (beginning of a line)
+	const char* end; //just after the last line of the block
+	const asciiParsingParams* params;
+
+	//output
+	unsigned lineCount;
+	std::vector<double> points;
+	std::vector<PointCoordinateType> normals;
+	std::vector<colorType> colors;
+	std::vector<ScalarType> scalars;
+	//! Corrupted lines: index of the line in the block and number of parts (or -1 if empty)
+	std::vector< std::pair<unsigned,int> > corruptedLines;
+	bool memoryError;
+};
+
+//! Parses a block of lines (see asciiParsingJob)
+static void ParseAsciiBlock(asciiParsingJob& job)
+{
+	const asciiParsingParams& params = *job.params;
+	const cloudAttributesDescriptor& desc = *params.desc;
+	const size_t sfCount = desc.scalarIndexes.size();
+
+	job.lineCount = 0;
+	job.memoryError = false;
+
+	try
+	{
+		//we reserve memory for the expected number of points (based on the first line size)
+		const char* firstLineEnd = static_cast<const char*>(memchr(job.begin,'\n',job.end-job.begin));
+		size_t expectedCount = (firstLineEnd ? (size_t)(job.end-job.begin)/(size_t)(firstLineEnd-job.begin+1) : 1) + 1;
+		job.points.reserve(3*expectedCount);
+		if (desc.hasNorms)
+			job.normals.reserve(3*expectedCount);
+		if (params.hasColors)
+			job.colors.reserve(3*expectedCount);
+		if (sfCount)
+			job.scalars.reserve(sfCount*expectedCount);
+
+		//tokens (only the 'maxPartIndex+1' first ones are needed)
+		std::vector<const char*> tokens(2*(params.maxPartIndex+1));
+
+		const char* line = job.begin;
+		while (line < job.end)
+		{
+			const char* lineEnd = static_cast<const char*>(memchr(line,'\n',job.end-line));
+			if (!lineEnd)
+				lineEnd = job.end;
+			const char* next = (lineEnd < job.end ? lineEnd+1 : job.end);
+			unsigned lineIndex = job.lineCount++;
+
+			//comment
+			if (lineEnd-line >= 2 && line[0] == '/' && line[1] == '/')
+			{
+				line = next;
+				continue;
+			}
+
+			if (line == lineEnd || (line[0] == '\r' && line+1 == lineEnd))
+			{
+				job.corruptedLines.push_back(std::pair<unsigned,int>(lineIndex,-1));
+				line = next;
+				continue;
+			}
+
+			//we split the line (empty parts are skipped)
+			int nParts = 0;
+			for (const char* c = line; c < lineEnd; )
+			{
+				if (*c == params.separator)
+				{
+					++c;
+					continue;
+				}
+				const char* tokenStart = c;
+				while (c < lineEnd && *c != params.separator)
+					++c;
+				if (nParts <= params.maxPartIndex)
+				{
+					tokens[2*nParts] = tokenStart;
+					tokens[2*nParts+1] = c;
+				}
+				++nParts;
+			}
+
+			if (nParts <= params.maxPartIndex)
+			{
+				job.corruptedLines.push_back(std::pair<unsigned,int>(lineIndex,nParts));
+				line = next;
+				continue;
+			}
+
+#define CC_ASCII_TOKEN(index) tokens[2*(index)],tokens[2*(index)+1]
+
+			//(X,Y,Z)
+			job.points.push_back(desc.xCoordIndex >= 0 ? TokenToDouble(CC_ASCII_TOKEN(desc.xCoordIndex)) : 0.0);
+			job.points.push_back(desc.yCoordIndex >= 0 ? TokenToDouble(CC_ASCII_TOKEN(desc.yCoordIndex)) : 0.0);
+			job.points.push_back(desc.zCoordIndex >= 0 ? TokenToDouble(CC_ASCII_TOKEN(desc.zCoordIndex)) : 0.0);
+
+			//Normal vector
+			if (desc.hasNorms)
+			{
+				job.normals.push_back(desc.xNormIndex >= 0 ? (PointCoordinateType)TokenToDouble(CC_ASCII_TOKEN(desc.xNormIndex)) : 0);
+				job.normals.push_back(desc.yNormIndex >= 0 ? (PointCoordinateType)TokenToDouble(CC_ASCII_TOKEN(desc.yNormIndex)) : 0);
+				job.normals.push_back(desc.zNormIndex >= 0 ? (PointCoordinateType)TokenToDouble(CC_ASCII_TOKEN(desc.zNormIndex)) : 0);
+			}
+
+			//Colors
+			if (params.hasColors)
+			{
+				colorType col[3]={0,0,0};
+				if (desc.hasRGBColors)
+				{
+					if (desc.iRgbaIndex>=0)
+					{
+						const uint32_t rgb = (uint32_t)TokenToInt(CC_ASCII_TOKEN(desc.iRgbaIndex));
+						col[0] = ((rgb >> 16)	& 0x0000ff);
+						col[1] = ((rgb >> 8)	& 0x0000ff);
+						col[2] = ((rgb)			& 0x0000ff);
+					}
+					else if (desc.fRgbaIndex>=0)
+					{
+						const float rgbf = (float)TokenToDouble(CC_ASCII_TOKEN(desc.fRgbaIndex));
+						const uint32_t rgb = (uint32_t)(*((uint32_t*)&rgbf));
+						col[0] = ((rgb >> 16)	& 0x0000ff);
+						col[1] = ((rgb >> 8)	& 0x0000ff);
+						col[2] = ((rgb)			& 0x0000ff);
+					}
+					else
+					{
+						if (desc.redIndex>=0)
+							col[0]=(colorType)TokenToInt(CC_ASCII_TOKEN(desc.redIndex));
+						if (desc.greenIndex>=0)
+							col[1]=(colorType)TokenToInt(CC_ASCII_TOKEN(desc.greenIndex));
+						if (desc.blueIndex>=0)
+							col[2]=(colorType)TokenToInt(CC_ASCII_TOKEN(desc.blueIndex));
+					}
+				}
+				else //if (desc.greyIndex>=0)
+				{
+					col[0]=col[1]=col[2]=(colorType)TokenToInt(CC_ASCII_TOKEN(desc.greyIndex));
+				}
+				job.colors.push_back(col[0]);
+				job.colors.push_back(col[1]);
+				job.colors.push_back(col[2]);
+			}
+
+			//Scalar fields
+			for (size_t j=0; j<sfCount; ++j)
+				job.scalars.push_back((ScalarType)TokenToDouble(CC_ASCII_TOKEN(desc.scalarIndexes[j])));
+
+#undef CC_ASCII_TOKEN
+
+			line = next;
+		}
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		job.memoryError = true;
+	}
+}
+
+//! Stores the current cloud (if any) in the output container
+static void storeCloud(cloudAttributesDescriptor& cloudDesc, ccHObject& container)
+{
+	if (!cloudDesc.cloud)
+		return;
+
+	if (cloudDesc.cloud->size() < cloudDesc.cloud->capacity())
+		cloudDesc.cloud->resize(cloudDesc.cloud->size());
+
+	if (!cloudDesc.scalarFields.empty())
+	{
+		for (unsigned j=0;j<cloudDesc.scalarFields.size();++j)
+			cloudDesc.scalarFields[j]->computeMinAndMax();
+		cloudDesc.cloud->setCurrentDisplayedScalarField(0);
+		cloudDesc.cloud->showSF(true);
+	}
+
+	container.addChild(cloudDesc.cloud,true);
+	cloudDesc.reset();
+}
+
+//! Loads a memory-mapped ASCII file
+/** The file is split in blocks of consecutive lines (see c_asciiBlockSize)
+	that are parsed in parallel, by 'waves' (so as to limit the amount of
+	temporary memory). Parsed points are then added to the cloud(s) in the
+	same order as in the file.
+**/
+static CC_FILE_ERROR loadCloudFromMappedAsciiFile(	const char* filename,
+													const char* data,
+													size_t dataSize,
+													ccHObject& container,
+													const AsciiOpenDlg::Sequence& openSequence,
+													char separator,
+													unsigned approximateNumberOfLines,
+													unsigned skipLines,
+													bool alwaysDisplayLoadDialog,
+													bool* coordinatesShiftEnabled,
+													double* coordinatesShift)
+{
+	const char* dataEnd = data+dataSize;
+
+	//we skip lines as defined on input
+	const char* start = data;
+	for (unsigned i=0;i<skipLines;++i)
+	{
+		const char* lineEnd = (start < dataEnd ? static_cast<const char*>(memchr(start,'\n',dataEnd-start)) : 0);
+		if (!lineEnd)
+			return CC_FERR_READING;
+		start = lineEnd+1;
+	}
+
+	//we may have to "slice" clouds on opening if they are too big!
+	unsigned cloudChunkSize = std::min(CC_MAX_NUMBER_OF_POINTS_PER_CLOUD,std::max(approximateNumberOfLines,1u));
+	unsigned chunkRank = 1;
+
+	//we initialize the loading accelerator structure and point cloud
+	int maxPartIndex=-1;
+	cloudAttributesDescriptor cloudDesc = prepareCloud(openSequence, cloudChunkSize, maxPartIndex, chunkRank);
+	if (!cloudDesc.cloud)
+		return CC_FERR_NOT_ENOUGH_MEMORY;
+
+	//the attribute indexes are the same for all the clouds
+	cloudAttributesDescriptor parsingDesc = cloudDesc;
+	asciiParsingParams params;
+	params.desc = &parsingDesc;
+	params.separator = separator;
+	params.maxPartIndex = maxPartIndex;
+	params.hasColors = (cloudDesc.hasRGBColors || cloudDesc.greyIndex >= 0);
+
+	//parsing jobs (one 'wave')
+	unsigned jobCount = 4*(unsigned)std::max(QThread::idealThreadCount(),1);
+	std::vector<asciiParsingJob> jobs;
+	try
+	{
+		jobs.resize(jobCount);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		clearStructure(cloudDesc);
+		return CC_FERR_NOT_ENOUGH_MEMORY;
+	}
+
+	//progress indicator
+	ccProgressDialog pdlg(true);
+	pdlg.setMethodTitle(qPrintable(QString("Open ASCII file [%1]").arg(filename)));
+	pdlg.setInfo(qPrintable(QString("Approximate number of points: %1").arg(approximateNumberOfLines)));
+	pdlg.start();
+
+	double Pshift[3]={0.0,0.0,0.0};
+	unsigned linesRead = 0;
+	unsigned pointsRead = 0;
+	bool firstPoint = true;
+
+	CC_FILE_ERROR result = CC_FERR_NO_ERROR;
+
+	const char* waveStart = start;
+	while (waveStart < dataEnd && result == CC_FERR_NO_ERROR)
+	{
+		//we split the next part of the file in blocks of complete lines
+		unsigned count = 0;
+		for (; count<jobCount && waveStart<dataEnd; ++count)
+		{
+			asciiParsingJob& job = jobs[count];
+			job.begin = waveStart;
+			job.end = (static_cast<size_t>(dataEnd-waveStart) > c_asciiBlockSize ? waveStart+c_asciiBlockSize : dataEnd);
+			if (job.end < dataEnd)
+			{
+				const char* lineEnd = static_cast<const char*>(memchr(job.end,'\n',dataEnd-job.end));
+				job.end = (lineEnd ? lineEnd+1 : dataEnd);
+			}
+			job.params = &params;
+			job.points.clear();
+			job.normals.clear();
+			job.colors.clear();
+			job.scalars.clear();
+			job.corruptedLines.clear();
+			waveStart = job.end;
+		}
+
+		QtConcurrent::blockingMap(jobs.begin(), jobs.begin()+count, ParseAsciiBlock);
+
+		//we add the points (in order)
+		for (unsigned k=0; k<count && result == CC_FERR_NO_ERROR; ++k)
+		{
+			const asciiParsingJob& job = jobs[k];
+			if (job.memoryError)
+			{
+				ccConsole::Error("Not enough memory! Process stopped ...");
+				result = CC_FERR_NOT_ENOUGH_MEMORY;
+				break;
+			}
+
+			for (size_t j=0; j<job.corruptedLines.size(); ++j)
+			{
+				unsigned lineNumber = linesRead + job.corruptedLines[j].first + 1;
+				int nParts = job.corruptedLines[j].second;
+				if (nParts < 0)
+					ccConsole::Warning("[AsciiFilter::Load] Line %i is corrupted (empty)!",lineNumber);
+				else
+					ccConsole::Warning("[AsciiFilter::Load] Line %i is corrupted (found %i part(s) on %i attended)!",lineNumber,nParts,maxPartIndex+1);
+			}
+			linesRead += job.lineCount;
+
+			unsigned blockPoints = (unsigned)(job.points.size()/3);
+			if (blockPoints == 0)
+				continue;
+
+			//first point: check for 'big' coordinates
+			if (firstPoint)
+			{
+				firstPoint = false;
+				double P[3] = { job.points[0], job.points[1], job.points[2] };
+				bool shiftAlreadyEnabled = (coordinatesShiftEnabled && *coordinatesShiftEnabled && coordinatesShift);
+				if (shiftAlreadyEnabled)
+					memcpy(Pshift,coordinatesShift,sizeof(double)*3);
+				bool applyAll=false;
+				if (ccCoordinatesShiftManager::Handle(P,0,alwaysDisplayLoadDialog,shiftAlreadyEnabled,Pshift,0,applyAll))
+				{
+					cloudDesc.cloud->setOriginalShift(Pshift[0],Pshift[1],Pshift[2]);
+					ccConsole::Warning("[ASCIIFilter::loadFile] Cloud has been recentered! Translation: (%.2f,%.2f,%.2f)",Pshift[0],Pshift[1],Pshift[2]);
+
+					//we save coordinates shift information
+					if (applyAll && coordinatesShiftEnabled && coordinatesShift)
+					{
+						*coordinatesShiftEnabled = true;
+						coordinatesShift[0] = Pshift[0];
+						coordinatesShift[1] = Pshift[1];
+						coordinatesShift[2] = Pshift[2];
+					}
+				}
+			}
+
+			const double* P = &(job.points[0]);
+			const PointCoordinateType* N = (job.normals.empty() ? 0 : &(job.normals[0]));
+			const colorType* col = (job.colors.empty() ? 0 : &(job.colors[0]));
+			const ScalarType* D = (job.scalars.empty() ? 0 : &(job.scalars[0]));
+			const size_t sfCount = parsingDesc.scalarIndexes.size();
+
+			for (unsigned i=0; i<blockPoints; ++i, P+=3)
+			{
+				//if we have attained the current capacity
+				if (cloudDesc.cloud->size() == cloudDesc.cloud->capacity())
+				{
+					//we re-evaluate the number of remaining points (based on the average line size)
+					double averageLineSize = (double)(job.end-start)/(double)std::max(linesRead,1u);
+					unsigned remaining = (blockPoints-i) + (unsigned)((double)(dataEnd-job.end)/averageLineSize);
+					unsigned cloudSize = cloudDesc.cloud->size();
+
+					if (cloudSize < CC_MAX_NUMBER_OF_POINTS_PER_CLOUD)
+					{
+						//we enlarge the current cloud (2% at least)
+						cloudChunkSize = std::max(cloudSize+remaining,(unsigned)ceil(cloudSize*1.02));
+						cloudChunkSize = std::min(CC_MAX_NUMBER_OF_POINTS_PER_CLOUD,std::max(cloudChunkSize,cloudSize+1));
+						ccConsole::PrintDebug("[ASCII] Point %i -> we enlarge the current cloud (%i points)",pointsRead,cloudChunkSize);
+						if (!cloudDesc.cloud->reserve(cloudChunkSize))
+						{
+							ccConsole::Error("Not enough memory! Process stopped ...");
+							result = CC_FERR_NOT_ENOUGH_MEMORY;
+							break;
+						}
+					}
+					else
+					{
+						//we create a new cloud
+						storeCloud(cloudDesc,container);
+						cloudChunkSize = std::min(CC_MAX_NUMBER_OF_POINTS_PER_CLOUD,std::max(remaining,1u));
+						ccConsole::PrintDebug("[ASCII] Point %i -> we instantiate a new cloud (%i points)",pointsRead,cloudChunkSize);
+						cloudDesc = prepareCloud(openSequence, cloudChunkSize, maxPartIndex, ++chunkRank);
+						if (!cloudDesc.cloud)
+						{
+							ccConsole::Error("Not enough memory! Process stopped ...");
+							result = CC_FERR_NOT_ENOUGH_MEMORY;
+							break;
+						}
+						cloudDesc.cloud->setOriginalShift(Pshift[0],Pshift[1],Pshift[2]);
+					}
+				}
+
+				unsigned index = cloudDesc.cloud->size();
+				cloudDesc.cloud->addPoint(CCVector3(P[0]+Pshift[0],P[1]+Pshift[1],P[2]+Pshift[2]));
+				if (N)
+				{
+					cloudDesc.cloud->addNorm(N);
+					N += 3;
+				}
+				if (col)
+				{
+					cloudDesc.cloud->addRGBColor(col);
+					col += 3;
+				}
+				for (size_t j=0; j<sfCount; ++j)
+					cloudDesc.scalarFields[j]->setValue(index,*D++);
+
+				++pointsRead;
+			}
+		}
+
+		pdlg.update(100.0f*(float)(waveStart-start)/(float)std::max<size_t>(dataEnd-start,1));
+		if (pdlg.isCancelRequested())
+			result = CC_FERR_CANCELED_BY_USER;
+	}
+
+	storeCloud(cloudDesc,container);
+
+	return result;
+}
+
 CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(const char* filename,
                                                             ccHObject& container,
                                                             const AsciiOpenDlg::Sequence& openSequence,
@@ -450,6 +983,23 @@ CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(const char* filename,
 															bool* coordinatesShiftEnabled/*=0*/,
 															double* coordinatesShift/*=0*/)
 {
+	//fast path: memory-mapped file parsed in parallel
+	{
+		InputMemoryFile memFile(filename);
+		if (memFile.data() && memFile.size() != 0)
+			return loadCloudFromMappedAsciiFile(filename,
+												memFile.data(),
+												memFile.size(),
+												container,
+												openSequence,
+												separator,
+												approximateNumberOfLines,
+												skipLines,
+												alwaysDisplayLoadDialog,
+												coordinatesShiftEnabled,
+												coordinatesShift);
+	}
+
     //we may have to "slice" clouds on opening if they are too big!
     unsigned cloudChunkSize = std::min(CC_MAX_NUMBER_OF_POINTS_PER_CLOUD,approximateNumberOfLines);
     unsigned cloudChunkPos = 0;
@@ -23,6 +23,7 @@
 
 //CCLib
 #include <ScalarField.h>
+#include <ChunkAllocator.h>
 
 //qCC_db
 #include <ccPointCloud.h>
@@ -60,6 +61,11 @@ CC_FILE_ERROR BinFilter::saveToFile(ccHObject* root, const char* filename)
 	if (!root || !filename)
 		return CC_FERR_BAD_ARGUMENT;
 
+	//the file we are about to overwrite may be currently mapped in memory
+	//(see ccSerializationHelper::GenericArrayFromFile)
+	if (!ChunkAllocator::DetachFileViews(filename))
+		return CC_FERR_NOT_ENOUGH_MEMORY;
+
 	QFile out(filename);
 	if (!out.open(QIODevice::WriteOnly))
 		return CC_FERR_WRITING;
@@ -58,7 +58,11 @@ InputMemoryFile::InputMemoryFile(const char *pathname)
 		return;
 	data_ = static_cast<char*>(::MapViewOfFile(file_mapping_handle_, FILE_MAP_READ, 0, 0, 0));
 	if (data_)
-		size_ = ::GetFileSize(file_handle_, 0);
+	{
+		DWORD sizeHigh = 0;
+		DWORD sizeLow = ::GetFileSize(file_handle_, &sizeHigh);
+		size_ = static_cast<size_t>((static_cast<unsigned long long>(sizeHigh) << 32) | sizeLow);
+	}
 #endif
 }
 
@@ -18,6 +18,8 @@
 #ifdef CC_LAS_SUPPORT
 
 #include "LASFilter.h"
+#include "LASOpenDlg.h"
+#include "InputMemoryFile.h"
 
 //qCC
 #include <ccCommon.h>
@@ -35,6 +37,8 @@
 
 //Qt
 #include<QFileInfo>
+#include <QThread>
+#include <QtConcurrentMap>
 
 //System
 #include <string.h>
@@ -199,6 +203,446 @@ CC_FILE_ERROR LASFilter::saveToFile(ccHObject* entity, const char* filename)
    return CC_FERR_NO_ERROR;
 }
 
+LASFilter::LoadOptions LASFilter::s_loadOptions;
+
+//! Number of point records per block (bulk reading)
+static const unsigned c_lasBlockSize = (1<<16);
+
+//! Point record layout (uncompressed files only)
+struct lasRecordLayout
+{
+   unsigned recordLength;
+   int timeOffset; //-1 if no GPS time
+   int rgbOffset; //-1 if no color
+};
+
+//! Determines the point record layout (returns false if the point format is not supported)
+static bool GetRecordLayout(const liblas::Header& header, lasRecordLayout& layout)
+{
+   //minimal record length for point formats 0 to 5
+   static const unsigned s_minRecordLength[6] = {20,28,26,34,57,63};
+
+   unsigned format = static_cast<unsigned>(header.GetDataFormatId());
+   if (format > 5)
+      return false;
+
+   layout.recordLength = header.GetDataRecordLength();
+   if (layout.recordLength < s_minRecordLength[format])
+      return false;
+
+   layout.timeOffset = (format == 1 || format >= 3 ? 20 : -1);
+   layout.rgbOffset = (format == 2 ? 20 : (format == 3 || format == 5 ? 28 : -1));
+
+   return true;
+}
+
+//LAS files are little-endian (as all the targeted platforms)
+static inline int32_t ReadInt32(const char* p) { int32_t v; memcpy(&v,p,4); return v; }
+static inline uint16_t ReadUInt16(const char* p) { uint16_t v; memcpy(&v,p,2); return v; }
+static inline double ReadDouble(const char* p) { double v; memcpy(&v,p,8); return v; }
+
+//! Output cloud (bulk reading)
+struct lasBulkCloud
+{
+   ccPointCloud* cloud;
+   ccScalarField* classifSF;
+   ccScalarField* timeSF;
+   ccScalarField* intensitySF;
+   ccScalarField* returnNumberSF;
+};
+
+//! Parameters shared by all the bulk reading jobs
+struct lasBulkParams
+{
+   lasRecordLayout layout;
+   double scale[3];
+   double offset[3];
+   double shift[3];
+   bool filterByBox;
+   double boxMin[3];
+   double boxMax[3];
+   bool loadColors;
+   uint16_t rgbMask[3];
+   unsigned char colorCompBitDec;
+   std::vector<lasBulkCloud> clouds;
+
+   //! Returns the (unshifted) coordinates of a record and whether it passes the box filter
+   inline bool decode(const char* record, double P[3]) const
+   {
+      P[0] = ReadInt32(record  ) * scale[0] + offset[0];
+      P[1] = ReadInt32(record+4) * scale[1] + offset[1];
+      P[2] = ReadInt32(record+8) * scale[2] + offset[2];
+      return (   !filterByBox
+               || (   P[0] >= boxMin[0] && P[0] <= boxMax[0]
+                   && P[1] >= boxMin[1] && P[1] <= boxMax[1]
+                   && P[2] >= boxMin[2] && P[2] <= boxMax[2]));
+   }
+};
+
+//! Bulk reading job (block of consecutive point records)
+struct lasBulkJob
+{
+   const char* records;
+   unsigned count;
+   const lasBulkParams* params;
+   //! Number of points passing the box filter (first pass)
+   unsigned kept;
+   //! Union of all the color components bits (first pass)
+   uint16_t colorBits;
+   //! Global index of the first point of this block (second pass)
+   unsigned firstIndex;
+};
+
+//! First pass: counts the points passing the box filter and checks the colors
+static void ScanLASBlock(lasBulkJob& job)
+{
+   const lasBulkParams& params = *job.params;
+   job.kept = 0;
+   job.colorBits = 0;
+
+   const char* record = job.records;
+   for (unsigned i=0; i<job.count; ++i, record+=params.layout.recordLength)
+   {
+      double P[3];
+      if (!params.decode(record,P))
+         continue;
+      ++job.kept;
+      if (params.loadColors)
+      {
+         const char* rgb = record + params.layout.rgbOffset;
+         job.colorBits |= (ReadUInt16(rgb) & params.rgbMask[0]) | (ReadUInt16(rgb+2) & params.rgbMask[1]) | (ReadUInt16(rgb+4) & params.rgbMask[2]);
+      }
+   }
+}
+
+//! Second pass: decodes the points directly in the cloud(s) chunks
+static void DecodeLASBlock(lasBulkJob& job)
+{
+   const lasBulkParams& params = *job.params;
+
+   unsigned globalIndex = job.firstIndex;
+   unsigned currentCloud = static_cast<unsigned>(-1);
+   unsigned currentChunk = static_cast<unsigned>(-1);
+   PointCoordinateType* points = 0;
+   colorType* colors = 0;
+   ScalarType* classif = 0;
+   ScalarType* times = 0;
+   ScalarType* intensities = 0;
+   ScalarType* returnNumbers = 0;
+
+   const char* record = job.records;
+   for (unsigned i=0; i<job.count; ++i, record+=params.layout.recordLength)
+   {
+      double P[3];
+      if (!params.decode(record,P))
+         continue;
+
+      //destination
+      unsigned cloudIndex = globalIndex / CC_MAX_NUMBER_OF_POINTS_PER_CLOUD;
+      unsigned pointIndex = globalIndex % CC_MAX_NUMBER_OF_POINTS_PER_CLOUD;
+      ++globalIndex;
+      unsigned chunkIndex = (pointIndex >> CHUNK_INDEX_BIT_DEC);
+      if (cloudIndex != currentCloud || chunkIndex != currentChunk)
+      {
+         currentCloud = cloudIndex;
+         currentChunk = chunkIndex;
+         const lasBulkCloud& dest = params.clouds[cloudIndex];
+         points = dest.cloud->pointsChunkStartPtr(chunkIndex);
+         colors = (params.loadColors ? dest.cloud->rgbColors()->chunkStartPtr(chunkIndex) : 0);
+         classif = (dest.classifSF ? dest.classifSF->chunkStartPtr(chunkIndex) : 0);
+         times = (dest.timeSF ? dest.timeSF->chunkStartPtr(chunkIndex) : 0);
+         intensities = (dest.intensitySF ? dest.intensitySF->chunkStartPtr(chunkIndex) : 0);
+         returnNumbers = (dest.returnNumberSF ? dest.returnNumberSF->chunkStartPtr(chunkIndex) : 0);
+      }
+      unsigned k = (pointIndex & ELEMENT_INDEX_BIT_MASK);
+
+      PointCoordinateType* Pout = points + 3*k;
+      Pout[0] = static_cast<PointCoordinateType>(P[0]+params.shift[0]);
+      Pout[1] = static_cast<PointCoordinateType>(P[1]+params.shift[1]);
+      Pout[2] = static_cast<PointCoordinateType>(P[2]+params.shift[2]);
+
+      if (colors)
+      {
+         //Warning: LAS colors are stored on 16 bits!
+         const char* rgb = record + params.layout.rgbOffset;
+         colorType* col = colors + 3*k;
+         col[0] = static_cast<colorType>((ReadUInt16(rgb  ) & params.rgbMask[0]) >> params.colorCompBitDec);
+         col[1] = static_cast<colorType>((ReadUInt16(rgb+2) & params.rgbMask[1]) >> params.colorCompBitDec);
+         col[2] = static_cast<colorType>((ReadUInt16(rgb+4) & params.rgbMask[2]) >> params.colorCompBitDec);
+      }
+      if (intensities)
+         intensities[k] = static_cast<ScalarType>(ReadUInt16(record+12));
+      if (returnNumbers)
+         returnNumbers[k] = static_cast<ScalarType>(record[14] & 7);
+      if (classif)
+         classif[k] = static_cast<ScalarType>(record[15] & 31);
+      if (times)
+         times[k] = static_cast<ScalarType>(ReadDouble(record+params.layout.timeOffset));
+   }
+}
+
+//! Runs bulk reading jobs in parallel (by 'waves' so as to update the progress dialog)
+/** \return false if the process has been cancelled by the user
+**/
+static bool RunLASJobs(std::vector<lasBulkJob>& jobs, void (*func)(lasBulkJob&), ccProgressDialog& pdlg, float startPercent, float endPercent)
+{
+   size_t waveSize = 4*static_cast<size_t>(std::max(QThread::idealThreadCount(),1));
+   for (size_t start=0; start<jobs.size(); start+=waveSize)
+   {
+      size_t stop = std::min(start+waveSize,jobs.size());
+      QtConcurrent::blockingMap(jobs.begin()+start, jobs.begin()+stop, func);
+
+      pdlg.update(startPercent + (endPercent-startPercent)*static_cast<float>(stop)/static_cast<float>(jobs.size()));
+      if (pdlg.isCancelRequested())
+         return false;
+   }
+   return true;
+}
+
+//! Adds a (non constant) scalar field to a cloud
+/** \return false if the scalar field is constant (it is then ignored)
+**/
+static bool AddLASScalarField(ccPointCloud* cloud, ccScalarField* sf, bool isClassOrIndex, bool cloudHasColors)
+{
+   sf->computeMinAndMax();
+   if (sf->getMin() == sf->getMax())
+   {
+      ccLog::Warning(QString("[LAS FILE] All '%1' values were the same (%2)! We ignored them...").arg(sf->getName()).arg(sf->getMin()));
+      return false;
+   }
+
+   if (isClassOrIndex)
+      sf->setColorRampSteps(static_cast<int>(sf->getMax())-static_cast<int>(sf->getMin()));
+
+   int sfIndex = cloud->addScalarField(sf);
+   if (!cloud->hasDisplayedScalarField())
+   {
+      cloud->setCurrentDisplayedScalarField(sfIndex);
+      cloud->showSF(!cloudHasColors);
+   }
+   return true;
+}
+
+//! Bulk loading of an uncompressed (memory-mapped) LAS file
+/** Point records are decoded by blocks (in parallel) directly in the
+    cloud chunks. The box filter is applied during the reading and the
+    attributes that are not loaded are simply skipped.
+**/
+static CC_FILE_ERROR LoadLASRecords(const char* data,
+                                    const liblas::Header& header,
+                                    const lasRecordLayout& layout,
+                                    unsigned nbOfPoints,
+                                    bool hasColor,
+                                    const liblas::Color& rgbColorMask,
+                                    bool hasClassif,
+                                    bool hasIntensity,
+                                    bool hasTime,
+                                    bool hasReturnNumber,
+                                    ccHObject& container,
+                                    bool alwaysDisplayLoadDialog,
+                                    bool* coordinatesShiftEnabled,
+                                    double* coordinatesShift)
+{
+   const LASFilter::LoadOptions& options = LASFilter::GetLoadOptions();
+
+   lasBulkParams params;
+   params.layout = layout;
+   params.scale[0] = header.GetScaleX();
+   params.scale[1] = header.GetScaleY();
+   params.scale[2] = header.GetScaleZ();
+   params.offset[0] = header.GetOffsetX();
+   params.offset[1] = header.GetOffsetY();
+   params.offset[2] = header.GetOffsetZ();
+   params.shift[0] = params.shift[1] = params.shift[2] = 0.0;
+   params.filterByBox = options.filterByBox;
+   for (unsigned d=0; d<3; ++d)
+   {
+      params.boxMin[d] = options.boxMin[d];
+      params.boxMax[d] = options.boxMax[d];
+      params.rgbMask[d] = static_cast<uint16_t>(rgbColorMask[d]);
+   }
+   params.loadColors = (hasColor && layout.rgbOffset >= 0);
+   params.colorCompBitDec = 0;
+   hasTime &= (layout.timeOffset >= 0);
+
+   //blocks of consecutive records
+   std::vector<lasBulkJob> jobs;
+   try
+   {
+      jobs.resize((nbOfPoints+c_lasBlockSize-1) / c_lasBlockSize);
+   }
+   catch (.../*const std::bad_alloc&*/) //out of memory
+   {
+      return CC_FERR_NOT_ENOUGH_MEMORY;
+   }
+   for (size_t j=0; j<jobs.size(); ++j)
+   {
+      unsigned first = static_cast<unsigned>(j)*c_lasBlockSize;
+      jobs[j].records = data + header.GetDataOffset() + static_cast<size_t>(first)*layout.recordLength;
+      jobs[j].count = std::min(c_lasBlockSize,nbOfPoints-first);
+      jobs[j].params = &params;
+      jobs[j].kept = jobs[j].count;
+      jobs[j].colorBits = 0;
+   }
+
+   //progress dialog
+   ccProgressDialog pdlg(true); //cancel available
+   pdlg.setMethodTitle("Open LAS file");
+   pdlg.setInfo(qPrintable(QString("Points: %1").arg(nbOfPoints)));
+   pdlg.start();
+
+   //first pass (only if necessary): box filter and color depth
+   bool scan = (params.filterByBox || params.loadColors);
+   if (scan && !RunLASJobs(jobs,ScanLASBlock,pdlg,0.0f,20.0f))
+      return CC_FERR_CANCELED_BY_USER;
+
+   unsigned pointCount = 0;
+   uint16_t colorBits = 0;
+   for (size_t j=0; j<jobs.size(); ++j)
+   {
+      jobs[j].firstIndex = pointCount;
+      pointCount += jobs[j].kept;
+      colorBits |= jobs[j].colorBits;
+   }
+
+   if (pointCount == 0)
+   {
+      ccLog::Warning("[LAS FILE] No point inside the filtering box!");
+      return CC_FERR_NO_LOAD;
+   }
+   if (params.filterByBox)
+      ccLog::Print(QString("[LAS FILE] %1 points (out of %2) inside the filtering box").arg(pointCount).arg(nbOfPoints));
+
+   if (params.loadColors)
+   {
+      if (colorBits == 0)
+      {
+         ccLog::Warning("[LAS FILE] Color field was all black! We ignored it...");
+         params.loadColors = false;
+      }
+      else if (colorBits & 0xFF00)
+      {
+         //the color components are on 16 bits (standard)
+         ccLog::Print("[LAS FILE] Color components are coded on 16 bits");
+         params.colorCompBitDec = 8;
+      }
+   }
+
+   //first point: check for 'big' coordinates
+   {
+      const char* record = data + header.GetDataOffset();
+      double P[3];
+      while (!params.decode(record,P))
+         record += layout.recordLength;
+
+      bool shiftAlreadyEnabled = (coordinatesShiftEnabled && *coordinatesShiftEnabled && coordinatesShift);
+      if (shiftAlreadyEnabled)
+         memcpy(params.shift,coordinatesShift,sizeof(double)*3);
+      bool applyAll=false;
+      if (ccCoordinatesShiftManager::Handle(P,0,alwaysDisplayLoadDialog,shiftAlreadyEnabled,params.shift,0,applyAll))
+      {
+         ccConsole::Warning("[LASFilter::loadFile] Cloud has been recentered! Translation: (%.2f,%.2f,%.2f)",params.shift[0],params.shift[1],params.shift[2]);
+
+         //we save coordinates shift information
+         if (applyAll && coordinatesShiftEnabled && coordinatesShift)
+         {
+            *coordinatesShiftEnabled = true;
+            coordinatesShift[0] = params.shift[0];
+            coordinatesShift[1] = params.shift[1];
+            coordinatesShift[2] = params.shift[2];
+         }
+      }
+   }
+
+   //we allocate the output cloud(s) (the file may have to be split in multiple clouds)
+   unsigned cloudCount = (pointCount-1) / CC_MAX_NUMBER_OF_POINTS_PER_CLOUD + 1;
+   bool memoryError = false;
+   for (unsigned c=0; c<cloudCount && !memoryError; ++c)
+   {
+      unsigned count = std::min(pointCount - c*CC_MAX_NUMBER_OF_POINTS_PER_CLOUD, CC_MAX_NUMBER_OF_POINTS_PER_CLOUD);
+
+      lasBulkCloud dest;
+      dest.cloud = new ccPointCloud();
+      dest.classifSF = dest.timeSF = dest.intensitySF = dest.returnNumberSF = 0;
+      params.clouds.push_back(dest);
+
+      lasBulkCloud& newDest = params.clouds.back();
+      newDest.cloud->setOriginalShift(params.shift[0],params.shift[1],params.shift[2]);
+      if (!newDest.cloud->resize(count) || (params.loadColors && !newDest.cloud->resizeTheRGBTable(false)))
+      {
+         memoryError = true;
+         break;
+      }
+
+      const char* sfNames[4] = { CC_LAS_CLASSIFICATION_FIELD_NAME, "Time", CC_SCAN_INTENSITY_FIELD_NAME, "Return number" };
+      const bool sfEnabled[4] = { hasClassif, hasTime, hasIntensity, hasReturnNumber };
+      ccScalarField** sfs[4] = { &newDest.classifSF, &newDest.timeSF, &newDest.intensitySF, &newDest.returnNumberSF };
+      for (unsigned s=0; s<4; ++s)
+      {
+         if (!sfEnabled[s])
+            continue;
+         ccScalarField* sf = new ccScalarField(sfNames[s]);
+         sf->link();
+         *sfs[s] = sf;
+         if (!sf->resize(count))
+         {
+            memoryError = true;
+            break;
+         }
+      }
+   }
+
+   CC_FILE_ERROR result = CC_FERR_NO_ERROR;
+   if (memoryError)
+   {
+      ccLog::Warning("[LASFilter::loadFile] Not enough memory!");
+      result = CC_FERR_NOT_ENOUGH_MEMORY;
+   }
+   //second pass: we decode the points
+   else if (!RunLASJobs(jobs,DecodeLASBlock,pdlg,scan ? 20.0f : 0.0f,100.0f))
+   {
+      result = CC_FERR_CANCELED_BY_USER;
+   }
+
+   for (unsigned c=0; c<params.clouds.size(); ++c)
+   {
+      lasBulkCloud& dest = params.clouds[c];
+      if (result == CC_FERR_NO_ERROR)
+      {
+         ccPointCloud* cloud = dest.cloud;
+         cloud->invalidateBoundingBox();
+         cloud->showColors(params.loadColors);
+
+         if (dest.classifSF)
+            AddLASScalarField(cloud,dest.classifSF,true,params.loadColors);
+         if (dest.intensitySF && AddLASScalarField(cloud,dest.intensitySF,false,params.loadColors))
+            dest.intensitySF->setColorScale(ccColorScalesManager::GetDefaultScale(ccColorScalesManager::GREY));
+         if (dest.timeSF)
+            AddLASScalarField(cloud,dest.timeSF,false,params.loadColors);
+         if (dest.returnNumberSF)
+            AddLASScalarField(cloud,dest.returnNumberSF,true,params.loadColors);
+
+         cloud->setName(params.clouds.size() > 1 ? QString("unnamed - Cloud #%1").arg(c+1) : QString("unnamed - Cloud"));
+         container.addChild(cloud);
+      }
+      else
+      {
+         delete dest.cloud;
+      }
+
+      if (dest.classifSF)
+         dest.classifSF->release();
+      if (dest.timeSF)
+         dest.timeSF->release();
+      if (dest.intensitySF)
+         dest.intensitySF->release();
+      if (dest.returnNumberSF)
+         dest.returnNumberSF->release();
+   }
+
+   return result;
+}
+
 CC_FILE_ERROR LASFilter::loadFile(const char* filename, ccHObject& container, bool alwaysDisplayLoadDialog/*=true*/, bool* coordinatesShiftEnabled/*=0*/, double* coordinatesShift/*=0*/)
 {
    //opening file
@@ -273,6 +717,64 @@ CC_FILE_ERROR LASFilter::loadFile(const char* filename, ccHObject& container, bo
    }
    bool hasColor = (rgbColorMask[0] || rgbColorMask[1] || rgbColorMask[2]);
 
+   //let the user choose the attributes to load and the box filter
+   if (alwaysDisplayLoadDialog)
+   {
+      liblas::Header const& fileHeader = reader->GetHeader();
+      double bbMin[3] = { fileHeader.GetMinX(), fileHeader.GetMinY(), fileHeader.GetMinZ() };
+      double bbMax[3] = { fileHeader.GetMaxX(), fileHeader.GetMaxY(), fileHeader.GetMaxZ() };
+
+      LASOpenDlg lasOpenDlg;
+      lasOpenDlg.setPointCount(nbOfPoints);
+      lasOpenDlg.setOptions(GetLoadOptions());
+      lasOpenDlg.setAvailableAttributes(hasColor,hasIntensity,hasClassif,hasTime,hasReturnNumber);
+      lasOpenDlg.setFileBoundingBox(bbMin,bbMax);
+      if (!lasOpenDlg.exec())
+      {
+         delete reader;
+         ifs.close();
+         return CC_FERR_CANCELED_BY_USER;
+      }
+
+      //kept for the next files (see LASFilter::LoadOptions)
+      SetLoadOptions(lasOpenDlg.getOptions());
+   }
+
+   //attributes to skip
+   const LoadOptions& options = GetLoadOptions();
+   hasColor &= options.loadColors;
+   hasClassif &= options.loadClassification;
+   hasIntensity &= options.loadIntensity;
+   hasTime &= options.loadTime;
+   hasReturnNumber &= options.loadReturnNumber;
+
+   //fast path: uncompressed files are memory-mapped and decoded in bulk
+   liblas::Header header = reader->GetHeader();
+   lasRecordLayout layout;
+   if (!header.Compressed() && GetRecordLayout(header,layout))
+   {
+      InputMemoryFile memFile(filename);
+      if (memFile.data() && static_cast<unsigned long long>(header.GetDataOffset()) + static_cast<unsigned long long>(nbOfPoints)*layout.recordLength <= memFile.size())
+      {
+         delete reader;
+         ifs.close();
+         return LoadLASRecords(  memFile.data(),
+                                 header,
+                                 layout,
+                                 nbOfPoints,
+                                 hasColor,
+                                 rgbColorMask,
+                                 hasClassif,
+                                 hasIntensity,
+                                 hasTime,
+                                 hasReturnNumber,
+                                 container,
+                                 alwaysDisplayLoadDialog,
+                                 coordinatesShiftEnabled,
+                                 coordinatesShift);
+      }
+   }
+
    //progress dialog
    ccProgressDialog pdlg(true); //cancel available
    CCLib::NormalizedProgress nprogress(&pdlg,nbOfPoints);
@@ -478,6 +980,16 @@ CC_FILE_ERROR LASFilter::loadFile(const char* filename, ccHObject& container, bo
       assert(newPointAvailable);
       const liblas::Point& p = reader->GetPoint();
 
+      //box filter
+      if (options.filterByBox)
+      {
+         double x = p.GetX(), y = p.GetY(), z = p.GetZ();
+         if (   x < options.boxMin[0] || x > options.boxMax[0]
+             || y < options.boxMin[1] || y > options.boxMax[1]
+             || z < options.boxMin[2] || z > options.boxMax[2])
+            continue;
+      }
+
       //first point: check for 'big' coordinates
       if (pointsRead==0)
       {
@@ -31,6 +31,52 @@ public:
     virtual CC_FILE_ERROR loadFile(const char* filename, ccHObject& container, bool alwaysDisplayLoadDialog = true, bool* coordinatesShiftEnabled = 0, double* coordinatesShift = 0);
 	virtual CC_FILE_ERROR saveToFile(ccHObject* entity, const char* filename);
 
+	//! Loading options
+	struct LoadOptions
+	{
+		//! Whether to load colors (if any)
+		bool loadColors;
+		//! Whether to load intensities (if any)
+		bool loadIntensity;
+		//! Whether to load classification values (if any)
+		bool loadClassification;
+		//! Whether to load GPS time values (if any)
+		bool loadTime;
+		//! Whether to load return numbers (if any)
+		bool loadReturnNumber;
+
+		//! Whether to only load the points inside a box
+		bool filterByBox;
+		//! Filtering box min corner (in the file coordinate system, i.e. before any shift)
+		double boxMin[3];
+		//! Filtering box max corner (in the file coordinate system, i.e. before any shift)
+		double boxMax[3];
+
+		//! Default constructor (everything is loaded)
+		LoadOptions()
+			: loadColors(true)
+			, loadIntensity(true)
+			, loadClassification(true)
+			, loadTime(true)
+			, loadReturnNumber(true)
+			, filterByBox(false)
+		{
+			boxMin[0] = boxMin[1] = boxMin[2] = 0.0;
+			boxMax[0] = boxMax[1] = boxMax[2] = 0.0;
+		}
+	};
+
+	//! Sets the options used for the next loaded files
+	static void SetLoadOptions(const LoadOptions& options) { s_loadOptions = options; }
+
+	//! Returns the current loading options
+	static const LoadOptions& GetLoadOptions() { return s_loadOptions; }
+
+protected:
+
+	//! Current loading options
+	static LoadOptions s_loadOptions;
+
 };
 
 #endif //CC_LAS_SUPPORT
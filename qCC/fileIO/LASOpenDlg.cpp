@@ -0,0 +1,101 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "LASOpenDlg.h"
+
+#ifdef CC_LAS_SUPPORT
+
+#include <QDoubleSpinBox>
+#include <QCheckBox>
+
+LASOpenDlg::LASOpenDlg(QWidget* parent)
+	: QDialog(parent)
+{
+	setupUi(this);
+}
+
+void LASOpenDlg::setPointCount(unsigned count)
+{
+	pointCountLabel->setText(QString("Points: %1").arg(count));
+}
+
+void LASOpenDlg::setAvailableAttributes(bool colors, bool intensity, bool classification, bool time, bool returnNumber)
+{
+	colorsCheckBox->setEnabled(colors);
+	intensityCheckBox->setEnabled(intensity);
+	classificationCheckBox->setEnabled(classification);
+	timeCheckBox->setEnabled(time);
+	returnNumberCheckBox->setEnabled(returnNumber);
+}
+
+void LASOpenDlg::setFileBoundingBox(const double* bbMin, const double* bbMax)
+{
+	//only if the user hasn't defined a box yet
+	if (boxGroupBox->isChecked())
+		return;
+
+	xMinDoubleSpinBox->setValue(bbMin[0]);
+	yMinDoubleSpinBox->setValue(bbMin[1]);
+	zMinDoubleSpinBox->setValue(bbMin[2]);
+	xMaxDoubleSpinBox->setValue(bbMax[0]);
+	yMaxDoubleSpinBox->setValue(bbMax[1]);
+	zMaxDoubleSpinBox->setValue(bbMax[2]);
+}
+
+void LASOpenDlg::setOptions(const LASFilter::LoadOptions& options)
+{
+	colorsCheckBox->setChecked(options.loadColors);
+	intensityCheckBox->setChecked(options.loadIntensity);
+	classificationCheckBox->setChecked(options.loadClassification);
+	timeCheckBox->setChecked(options.loadTime);
+	returnNumberCheckBox->setChecked(options.loadReturnNumber);
+
+	boxGroupBox->setChecked(options.filterByBox);
+	if (options.filterByBox)
+	{
+		xMinDoubleSpinBox->setValue(options.boxMin[0]);
+		yMinDoubleSpinBox->setValue(options.boxMin[1]);
+		zMinDoubleSpinBox->setValue(options.boxMin[2]);
+		xMaxDoubleSpinBox->setValue(options.boxMax[0]);
+		yMaxDoubleSpinBox->setValue(options.boxMax[1]);
+		zMaxDoubleSpinBox->setValue(options.boxMax[2]);
+	}
+}
+
+LASFilter::LoadOptions LASOpenDlg::getOptions() const
+{
+	LASFilter::LoadOptions options;
+
+	//we keep the previous choice for the attributes missing in this file
+	options.loadColors = colorsCheckBox->isChecked();
+	options.loadIntensity = intensityCheckBox->isChecked();
+	options.loadClassification = classificationCheckBox->isChecked();
+	options.loadTime = timeCheckBox->isChecked();
+	options.loadReturnNumber = returnNumberCheckBox->isChecked();
+
+	options.filterByBox = boxGroupBox->isChecked();
+	options.boxMin[0] = xMinDoubleSpinBox->value();
+	options.boxMin[1] = yMinDoubleSpinBox->value();
+	options.boxMin[2] = zMinDoubleSpinBox->value();
+	options.boxMax[0] = xMaxDoubleSpinBox->value();
+	options.boxMax[1] = yMaxDoubleSpinBox->value();
+	options.boxMax[2] = zMaxDoubleSpinBox->value();
+
+	return options;
+}
+
+#endif //CC_LAS_SUPPORT
@@ -0,0 +1,61 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_LAS_OPEN_DIALOG
+#define CC_LAS_OPEN_DIALOG
+
+#include "LASFilter.h"
+
+#ifdef CC_LAS_SUPPORT
+
+//GUIs generated by Qt Designer
+#include <ui_openLASFileDlg.h>
+
+//! Dialog for configuration of LAS files opening sequence (see LASFilter::LoadOptions)
+class LASOpenDlg : public QDialog, public Ui::LASOpenDlg
+{
+    Q_OBJECT
+
+public:
+
+	//! Default constructor
+    LASOpenDlg(QWidget* parent=0);
+
+	//! Sets the number of points in the file (information only)
+	void setPointCount(unsigned count);
+
+	//! Sets which attributes are present in the file
+	/** Missing attributes can't be selected.
+	**/
+	void setAvailableAttributes(bool colors, bool intensity, bool classification, bool time, bool returnNumber);
+
+	//! Sets the file bounding-box (file coordinates)
+	/** Used as default box if the options have no box filter yet.
+	**/
+	void setFileBoundingBox(const double* bbMin, const double* bbMax);
+
+	//! Initializes the dialog with the current loading options
+	void setOptions(const LASFilter::LoadOptions& options);
+
+	//! Returns the loading options selected by the user
+	LASFilter::LoadOptions getOptions() const;
+
+};
+
+#endif //CC_LAS_SUPPORT
+
+#endif
@@ -226,7 +226,8 @@ bool tagDuplicatedVertices(const CCLib::DgmOctree::octreeCell& cell, void** addi
 	cell.parentOctree->computeCellCenter(nNSS.cellPos,cell.level,nNSS.cellCenter);
 	//*/
 
-	unsigned n = cell.points->size(); //number of points in the current cell
+	unsigned n = cell.pointCount; //number of points in the current cell
+	CCLib::GenericIndexedCloudPersist* cloud = cell.parentOctree->associatedCloud();
 	
 	//we already know some of the neighbours: the points in the current cell!
 	try
@@ -243,8 +244,8 @@ bool tagDuplicatedVertices(const CCLib::DgmOctree::octreeCell& cell, void** addi
 		CCLib::DgmOctree::NeighboursSet::iterator it = nNSS.pointsInNeighbourhood.begin();
 		for (unsigned i=0;i<n;++i,++it)
 		{
-			it->point = cell.points->getPointPersistentPtr(i);
-			it->pointIndex = cell.points->getPointGlobalIndex(i);
+			it->point = cloud->getPointPersistentPtr(cell.getPointGlobalIndex(i));
+			it->pointIndex = cell.getPointGlobalIndex(i);
 		}
 		nNSS.alreadyVisitedNeighbourhoodSize = 1;
 	}
@@ -252,10 +253,10 @@ bool tagDuplicatedVertices(const CCLib::DgmOctree::octreeCell& cell, void** addi
 	//for each point in the cell
 	for (unsigned i=0;i<n;++i)
 	{
-		int thisIndex = (int)cell.points->getPointGlobalIndex(i);
+		int thisIndex = (int)cell.getPointGlobalIndex(i);
 		if (equivalentIndexes->getValue(thisIndex)<0) //has no equivalent yet 
 		{
-			cell.points->getPoint(i,nNSS.queryPoint);
+			cloud->getPoint(cell.getPointGlobalIndex(i),nNSS.queryPoint);
 
 			//look for neighbors in a (very small) sphere
 			unsigned k = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS,c_defaultSearchRadius,false);
@@ -121,6 +121,9 @@ int main(int argc, char **argv)
 	}
 	else
 	{
+        //memory options must be applied before any entity is loaded
+        ccGui::ApplyMemoryOptions(ccGui::Parameters());
+
         //main window init.
         MainWindow::TheInstance()->show();
         QApplication::processEvents();
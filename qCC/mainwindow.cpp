@@ -55,6 +55,7 @@
 #include "ccHeightGridGeneration.h"
 #include "ccRenderingTools.h"
 #include "ccFastMarchingForNormsDirection.h"
+#include "ccMinimumSpanningTreeForNormsDirection.h"
 #include "ccCommon.h"
 
 //sub-windows
@@ -4232,6 +4233,7 @@ void MainWindow::doActionComputeNormals()
 
     CC_LOCAL_MODEL_TYPES model = NO_MODEL;
     int preferedOrientation = -1;
+	unsigned knn = 0;
 
 	//We display dialog only for point clouds
 	if (!onlyMeshes)
@@ -4245,6 +4247,7 @@ void MainWindow::doActionComputeNormals()
 		model = ncDlg.getLocalModel();
 		preferedOrientation = ncDlg.getPreferedOrientation();
 		defaultRadius = ncDlg.radiusDoubleSpinBox->value();
+		knn = ncDlg.getKNN();
 	}
 
     //Compute normals for each selected cloud
@@ -4267,7 +4270,7 @@ void MainWindow::doActionComputeNormals()
 			QElapsedTimer eTimer;
 			eTimer.start();
 			NormsIndexesTableType* normsIndexes = new NormsIndexesTableType;
-			if (!ccNormalVectors::ComputeCloudNormals(cloud, *normsIndexes, model, defaultRadius, preferedOrientation, (CCLib::GenericProgressCallback*)&pDlg, cloud->getOctree()))
+			if (!ccNormalVectors::ComputeCloudNormals(cloud, *normsIndexes, model, defaultRadius, preferedOrientation, (CCLib::GenericProgressCallback*)&pDlg, cloud->getOctree(), knn))
 			{
 				ccConsole::Error(QString("Failed to compute normals on cloud '%1'").arg(cloud->getName()));
 				continue;
@@ -4314,6 +4317,9 @@ void MainWindow::doActionComputeNormals()
 	updateUI();
 }
 
+static int s_resolveNormalsMethod = 0;
+static int s_resolveNormalsMSTNeighbours = 6;
+static int s_resolveNormalsPreferedOrientation = -1;
 void MainWindow::doActionResolveNormalsDirection()
 {
     if (m_selectedEntities.size() < 1)
@@ -4322,11 +4328,37 @@ void MainWindow::doActionResolveNormalsDirection()
         return;
     }
 
-    unsigned level;
-    ccAskOneIntValueDlg vDlg("Octree level", 1, CCLib::DgmOctree::MAX_OCTREE_LEVEL, CCLib::DgmOctree::MAX_OCTREE_LEVEL/2, "Resolve normal directions");
-    if (!vDlg.exec())
-        return;
-    level = vDlg.getValue();
+	//resolution method
+	QStringList methods;
+	methods << "Fast Marching" << "Minimum Spanning Tree";
+	bool ok;
+	QString method = QInputDialog::getItem(this, "Resolve normal directions", "Method:", methods, s_resolveNormalsMethod, false, &ok);
+	if (!ok)
+		return;
+	s_resolveNormalsMethod = methods.indexOf(method);
+	bool useMST = (s_resolveNormalsMethod == 1);
+
+    unsigned level = 0;
+	if (useMST)
+	{
+		s_resolveNormalsMSTNeighbours = QInputDialog::getInt(this, "Resolve normal directions", "Neighbours:", s_resolveNormalsMSTNeighbours, 3, 100, 1, &ok);
+		if (!ok)
+			return;
+
+		QStringList orientations;
+		orientations << "None" << "+X" << "-X" << "+Y" << "-Y" << "+Z" << "-Z" << "+Barycenter" << "-Barycenter";
+		QString orientation = QInputDialog::getItem(this, "Resolve normal directions", "Prefered orientation:", orientations, s_resolveNormalsPreferedOrientation+1, false, &ok);
+		if (!ok)
+			return;
+		s_resolveNormalsPreferedOrientation = orientations.indexOf(orientation)-1;
+	}
+	else
+	{
+		ccAskOneIntValueDlg vDlg("Octree level", 1, CCLib::DgmOctree::MAX_OCTREE_LEVEL, CCLib::DgmOctree::MAX_OCTREE_LEVEL/2, "Resolve normal directions");
+		if (!vDlg.exec())
+			return;
+		level = vDlg.getValue();
+	}
 
     for (unsigned i=0; i<m_selectedEntities.size(); i++)
     {
@@ -4336,7 +4368,7 @@ void MainWindow::doActionResolveNormalsDirection()
         ccPointCloud* cloud = static_cast<ccPointCloud*>(m_selectedEntities[i]);
         ccProgressDialog pDlg(false,this);
 
-        if (!cloud->getOctree())
+        if (!useMST && !cloud->getOctree())
             if (!cloud->computeOctree((CCLib::GenericProgressCallback*)&pDlg))
             {
                 ccConsole::Error(QString("Could not compute octree for cloud '%1'").arg(cloud->getName()));
@@ -4350,7 +4382,15 @@ void MainWindow::doActionResolveNormalsDirection()
             normsType index = cloud->getPointNormalIndex(j);
             normsIndexes->setValue(j, index);
         }
-        ccFastMarchingForNormsDirection::ResolveNormsDirectionByFrontPropagation(cloud, normsIndexes, level, (CCLib::GenericProgressCallback*)&pDlg, cloud->getOctree());
+		if (useMST)
+		{
+			if (!ccMinimumSpanningTreeForNormsDirection::OrientNormals(cloud, normsIndexes, s_resolveNormalsMSTNeighbours, s_resolveNormalsPreferedOrientation, (CCLib::GenericProgressCallback*)&pDlg))
+				ccConsole::Warning(QString("Failed to resolve the normals direction of cloud '%1'").arg(cloud->getName()));
+		}
+		else
+		{
+			ccFastMarchingForNormsDirection::ResolveNormsDirectionByFrontPropagation(cloud, normsIndexes, level, (CCLib::GenericProgressCallback*)&pDlg, cloud->getOctree());
+		}
         for (unsigned j=0; j<normsIndexes->currentSize(); j++)
             cloud->setPointNormalIndex(j, normsIndexes->getValue(j));
 
@@ -370,6 +370,7 @@ void qHPR::doAction()
 
             visiblePointCount += count;
         }
+		cloud->visibilityArrayChanged();
 
 		m_app->dispToConsole(QString("[HPR] Visible points: %1").arg(visiblePointCount));
         cloud->redrawDisplay();